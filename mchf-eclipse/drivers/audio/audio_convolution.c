@@ -14,6 +14,7 @@
 #include "audio_driver.h"
 #include "arm_const_structs.h"
 #include "filters.h"
+#include "audio_tap.h"
 
 // we cannot use a shared buffer structure with FreeDV,
 // because we need to filter with convolution and simultaneously
@@ -839,23 +840,8 @@ void AudioDriver_RxProcessorConvolution(AudioSample_t * const src, AudioSample_t
                     arm_biquad_cascade_df1_f32 (&IIR_biquad_1[1], adb.a_buffer[1],adb.a_buffer[1], blockSizeDecim);
                 }
 #endif
-#ifdef USE_RTTY_PROCESSOR
-                if (is_demod_rtty() && blockSizeDecim == 8) // only works when decimation rate is 4 --> sample rate == 12ksps
-                {
-                    AudioDriver_RxProcessor_Rtty(adb.a_buffer[0], blockSizeDecim);
-                }
-#endif
-                if (is_demod_psk() && blockSizeDecim == 8) // only works when decimation rate is 4 --> sample rate == 12ksps
-                {
-                    AudioDriver_RxProcessor_Bpsk(adb.a_buffer[0], blockSizeDecim);
-                }
-//                if(blockSizeDecim ==8 && dmod_mode == DEMOD_CW)
-//                if(ts.cw_decoder_enable && blockSizeDecim ==8 && (dmod_mode == DEMOD_CW || dmod_mode == DEMOD_AM || dmod_mode == DEMOD_SAM))
-                if(blockSizeDecim ==8 && (dmod_mode == DEMOD_CW || dmod_mode == DEMOD_AM || dmod_mode == DEMOD_SAM))
-// switch to use TUNE HELPER in AM/SAM
-                {
-                	CwDecode_RxProcessor(adb.a_buffer[0], blockSizeDecim);
-                }
+                // hand the audio to the decoders (RTTY, BPSK, CW, ...)
+                AudioTap_Publish(adb.a_buffer[0], blockSizeDecim, ads.decimated_freq);
 
                 // resample back to original sample rate while doing low-pass filtering to minimize audible aliasing effects
                 if (INTERPOLATE_RX[0].phaseLength > 0)
@@ -39,8 +39,12 @@
 #include "rtty.h"
 #include "psk.h"
 #include "cw_decoder.h"
+#include "audio_tap.h"
 #include "freedv_uhsdr.h"
 #include "freq_shift.h"
+#include "zoom_decimate.h"
+#include "snap_estimator.h"
+#include "rx_q15.h"
 #include "audio_nr.h"
 #ifdef USE_CONVOLUTION
 #include "audio_convolution.h"
@@ -67,12 +71,7 @@ typedef struct
 #endif
 
 // Decimator for Zoom FFT
-static	arm_fir_decimate_instance_f32	DECIMATE_ZOOM_FFT_I;
-float32_t			__MCHF_SPECIALMEM decimZoomFFTIState[FIR_RXAUDIO_BLOCK_SIZE + FIR_RXAUDIO_NUM_TAPS];
-
-// Decimator for Zoom FFT
-static	arm_fir_decimate_instance_f32	DECIMATE_ZOOM_FFT_Q;
-float32_t			__MCHF_SPECIALMEM decimZoomFFTQState[FIR_RXAUDIO_BLOCK_SIZE + FIR_RXAUDIO_NUM_TAPS];
+static	ZoomDecimate_t	__MCHF_SPECIALMEM zoomDecimate;
 
 // Audio RX - Interpolator
 static	arm_fir_interpolate_instance_f32 INTERPOLATE_RX[NUM_AUDIO_CHANNELS];
@@ -161,35 +160,6 @@ static arm_biquad_casd_df1_inst_f32 IIR_biquad_2[NUM_AUDIO_CHANNELS] =
 };
 
 
-// variables for ZoomFFT lowpass filtering
-static arm_biquad_casd_df1_inst_f32 IIR_biquad_Zoom_FFT_I =
-{
-        .numStages = 4,
-        .pCoeffs = (float32_t *)(float32_t [])
-        {
-            1,0,0,0,0,  1,0,0,0,0 // passthru
-        }, // 2 x 5 = 10 coefficients
-
-        .pState = (float32_t *)(float32_t [])
-        {
-            0,0,0,0,   0,0,0,0,    0,0,0,0,   0,0,0,0
-        } // 4 x 4 = 16 state variables
-};
-
-static arm_biquad_casd_df1_inst_f32 IIR_biquad_Zoom_FFT_Q =
-{
-        .numStages = 4,
-        .pCoeffs = (float32_t *)(float32_t [])
-        {
-            1,0,0,0,0,  1,0,0,0,0 // passthru
-        }, // 2 x 5 = 10 coefficients
-
-        .pState = (float32_t *)(float32_t [])
-        {
-            0,0,0,0,   0,0,0,0,   0,0,0,0,   0,0,0,0
-        } // 4 x 4 = 16 state variables
-};
-
 // sr = 12ksps, Fstop = 2k7, we lowpass-filtered the audio already in the main aido path (IIR),
 // so only the minimum size filter (4 taps) is used here
 static float32_t NR_decimate_coeffs [4] = {0.099144206287089282, 0.492752007869707798, 0.492752007869707798, 0.099144206287089282};
@@ -201,167 +171,6 @@ static float32_t NR_interpolate_coeffs [NR_INTERPOLATE_NO_TAPS] = {-495.07575866
 // 6ksps, Fstop = 2k65, KAISER
 //static float32_t NR_interpolate_coeffs [NR_INTERPOLATE_NO_TAPS] = {-903.6623076669911820E-6, 0.001594488333496738,-0.002320508982899863, 0.002832351511451895,-0.002797105957386612, 0.001852836963547170, 308.6133633078010230E-6,-0.003842008360761881, 0.008649943961959465,-0.014305251526745446, 0.020012524686320185,-0.024618364878703208, 0.026664997481476788,-0.024458388333600374, 0.016080841021827566, 818.1032282579135430E-6,-0.029933800539235892, 0.079833661336890141,-0.182038248016552551, 0.626273078268197225, 0.626273078268197225,-0.182038248016552551, 0.079833661336890141,-0.029933800539235892, 818.1032282579135430E-6, 0.016080841021827566,-0.024458388333600374, 0.026664997481476788,-0.024618364878703208, 0.020012524686320185,-0.014305251526745446, 0.008649943961959465,-0.003842008360761881, 308.6133633078010230E-6, 0.001852836963547170,-0.002797105957386612, 0.002832351511451895,-0.002320508982899863, 0.001594488333496738,-903.6623076669911820E-6};
 
-static float32_t* mag_coeffs[MAGNIFY_NUM] =
-{
-
-        // for Index 0 [1xZoom == no zoom] the mag_coeffs will a NULL  ptr, since the filter is not going to be used in this  mode!
-        NULL,
-
-        (float32_t*)(const float32_t[]) {
-            // 2x magnify - index 1
-            // 12kHz, sample rate 48k, 60dB stopband, elliptic
-            // a1 and coeffs[A2] negated! order: coeffs[B0], coeffs[B1], coeffs[B2], a1, coeffs[A2]
-            // Iowa Hills IIR Filter Designer, DD4WH Aug 16th 2016
-            0.228454526413293696,
-            0.077639329099949764,
-            0.228454526413293696,
-            0.635534925142242080,
-            -0.170083307068779194,
-
-            0.436788292542003964,
-            0.232307972937606161,
-            0.436788292542003964,
-            0.365885230717786780,
-            -0.471769788739400842,
-
-            0.535974654742658707,
-            0.557035600464780845,
-            0.535974654742658707,
-            0.125740787233286133,
-            -0.754725697183384336,
-
-            0.501116342273565607,
-            0.914877831284765408,
-            0.501116342273565607,
-            0.013862536615004284,
-            -0.930973052446900984
-        },
-
-        (float32_t*)(const float32_t[])
-        {
-            // 4x magnify - index 2
-            // 6kHz, sample rate 48k, 60dB stopband, elliptic
-            // a1 and coeffs[A2] negated! order: coeffs[B0], coeffs[B1], coeffs[B2], a1, coeffs[A2]
-            // Iowa Hills IIR Filter Designer, DD4WH Aug 16th 2016
-            0.182208761527446556,
-            -0.222492493114674145,
-            0.182208761527446556,
-            1.326111070880959810,
-            -0.468036100821178802,
-
-            0.337123762652097259,
-            -0.366352718812586853,
-            0.337123762652097259,
-            1.337053579516321200,
-            -0.644948386007929031,
-
-            0.336163175380826074,
-            -0.199246162162897811,
-            0.336163175380826074,
-            1.354952684569386670,
-            -0.828032873168141115,
-
-            0.178588201750411041,
-            0.207271695028067304,
-            0.178588201750411041,
-            1.386486967455699220,
-            -0.950935065984588657
-        },
-
-        (float32_t*)(const float32_t[])
-        {
-            // 8x magnify - index 3
-            // 3kHz, sample rate 48k, 60dB stopband, elliptic
-            // a1 and coeffs[A2] negated! order: coeffs[B0], coeffs[B1], coeffs[B2], a1, coeffs[A2]
-            // Iowa Hills IIR Filter Designer, DD4WH Aug 16th 2016
-            0.185643392652478922,
-            -0.332064345389014803,
-            0.185643392652478922,
-            1.654637402827731090,
-            -0.693859842743674182,
-
-            0.327519300813245984,
-            -0.571358085216950418,
-            0.327519300813245984,
-            1.715375037176782860,
-            -0.799055553586324407,
-
-            0.283656142708241688,
-            -0.441088976843048652,
-            0.283656142708241688,
-            1.778230635987093860,
-            -0.904453944560528522,
-
-            0.079685368654848945,
-            -0.011231810140649204,
-            0.079685368654848945,
-            1.825046003243238070,
-            -0.973184930412286708
-        },
-
-        (float32_t*)(const float32_t[])
-        {
-            // 16x magnify - index 4
-            // 1k5, sample rate 48k, 60dB stopband, elliptic
-            // a1 and coeffs[A2] negated! order: coeffs[B0], coeffs[B1], coeffs[B2], a1, coeffs[A2]
-            // Iowa Hills IIR Filter Designer, DD4WH Aug 16th 2016
-            0.194769868656866380,
-            -0.379098413160710079,
-            0.194769868656866380,
-            1.824436402073870810,
-            -0.834877726226893380,
-
-            0.333973874901496770,
-            -0.646106479315673776,
-            0.333973874901496770,
-            1.871892825636887640,
-            -0.893734096124207178,
-
-            0.272903880596429671,
-            -0.513507745397738469,
-            0.272903880596429671,
-            1.918161772571113750,
-            -0.950461788366234739,
-
-            0.053535383722369843,
-            -0.069683422367188122,
-            0.053535383722369843,
-            1.948900719896301760,
-            -0.986288064973853129
-        },
-
-        (float32_t*)(const float32_t[])
-        {
-            // 32x magnify - index 5
-            // 750Hz, sample rate 48k, 60dB stopband, elliptic
-            // a1 and coeffs[A2] negated! order: coeffs[B0], coeffs[B1], coeffs[B2], a1, coeffs[A2]
-            // Iowa Hills IIR Filter Designer, DD4WH Aug 16th 2016
-            0.201507402588557594,
-            -0.400273615727755550,
-            0.201507402588557594,
-            1.910767558906650840,
-            -0.913508748356010480,
-
-            0.340295203367131205,
-            -0.674930558961690075,
-            0.340295203367131205,
-            1.939398230905991390,
-            -0.945058078678563840,
-
-            0.271859921641011359,
-            -0.535453706265515361,
-            0.271859921641011359,
-            1.966439529620203740,
-            -0.974705666636711099,
-
-            0.047026497485465592,
-            -0.084562104085501480,
-            0.047026497485465592,
-            1.983564238653704900,
-            -0.993055129539134551
-        }
-};
-
 #ifdef USE_SIMPLE_FREEDV_FILTERS
 //******* From here 2 set of filters for the I/Q FreeDV aliasing filter**********
 // I- and Q- Filter instances for FreeDV downsampling aliasing filters
@@ -505,9 +314,9 @@ static void AudioDriver_LeakyLmsNr_Init()
     leakyLMS.den_mult = 6.25e-10;                   // den_mult
     leakyLMS.lincr =    1.0;                      // lincr
     leakyLMS.ldecr =    3.0;                     // ldecr
-    //int leakyLMS.mask = leakyLMS.dline_size - 1;
-    leakyLMS.mask = LEAKYLMSDLINE_SIZE - 1;
     leakyLMS.in_idx = 0;
+    arm_fill_f32(0.0, leakyLMS.d, 2 * LEAKYLMSDLINE_SIZE);
+    arm_fill_f32(0.0, leakyLMS.w, LEAKYLMSDLINE_SIZE);
     leakyLMS.on = 0;
     leakyLMS.notch = 0;
     /////////////////////// LEAKY LMS END
@@ -518,60 +327,97 @@ static void AudioDriver_LeakyLmsNr_Init()
 // Variable-leak LMS algorithm
 // taken from (c) Warren Pratts wdsp library 2016
 // GPLv3 licensed
-void AudioDriver_LeakyLmsNr (float32_t *in_buff, float32_t *out_buff, int buff_size, bool notch)
+// turned into a block LMS: the filter coefficients are kept constant during a block of samples
+// and updated once at the end of the block, this permits the use of the CMSIS vector functions
+static void AudioDriver_LeakyLmsNr_Block(const float32_t *in_buff, float32_t *out_buff, const int block_len, const bool notch)
 {
-    int i, j, idx;
-    float32_t c0, c1;
-    float32_t y, error, sigma, inv_sigp;
-    float32_t nel, nev;
-        for (i = 0; i < buff_size; i++)
-        {
-            leakyLMS.d[leakyLMS.in_idx] = in_buff[i];
+    const int delay = leakyLMS.delay;
+    int n_taps = leakyLMS.n_taps;
 
-            y = 0;
-            sigma = 0;
+    // the delay line has to hold the filter window of all samples of the block
+    if (n_taps > LEAKYLMSDLINE_SIZE - delay - LEAKYLMS_BLOCK_SIZE)
+    {
+        n_taps = LEAKYLMSDLINE_SIZE - delay - LEAKYLMS_BLOCK_SIZE;
+    }
 
-            for (j = 0; j < leakyLMS.n_taps; j++)
-            {
-                idx = (leakyLMS.in_idx + j + leakyLMS.delay) & leakyLMS.mask;
-                y += leakyLMS.w[j] * leakyLMS.d[idx];
-                sigma += leakyLMS.d[idx] * leakyLMS.d[idx];
-            }
-            inv_sigp = 1.0 / (sigma + 1e-10);
-            error = leakyLMS.d[leakyLMS.in_idx] - y;
+    const int first = leakyLMS.in_idx;
+    for (int i = 0; i < block_len; i++)
+    {
+        // each sample is stored twice, so that any window of up to LEAKYLMSDLINE_SIZE samples is contiguous in memory
+        const int idx = (first + i) & (LEAKYLMSDLINE_SIZE - 1);
+        leakyLMS.d[idx] = in_buff[i];
+        leakyLMS.d[idx + LEAKYLMSDLINE_SIZE] = in_buff[i];
+    }
+    leakyLMS.in_idx = (first + block_len) & (LEAKYLMSDLINE_SIZE - 1);
 
-            if(notch)
-            { // automatic notch filter
-                out_buff[i] = error;
-            }
-            else
-            { // noise reduction
-                out_buff[i] = y;
-            }
-//          leakyLMS.out_buff[2 * i + 1] = 0.0;
+    // x[i] ... x[i + n_taps - 1] are the delayed samples, oldest first, which are filtered for in_buff[i]
+    float32_t* const x = &leakyLMS.d[(first - delay - n_taps + 1) & (LEAKYLMSDLINE_SIZE - 1)];
 
-            if((nel = error * (1.0 - leakyLMS.two_mu * sigma * inv_sigp)) < 0.0) nel = -nel;
-            if((nev = leakyLMS.d[leakyLMS.in_idx] - (1.0 - leakyLMS.two_mu * leakyLMS.ngamma) * y - leakyLMS.two_mu * error * sigma * inv_sigp) < 0.0) nev = -nev;
-            if (nev < nel)
-            {
-                if((leakyLMS.lidx += leakyLMS.lincr) > leakyLMS.lidx_max) leakyLMS.lidx = leakyLMS.lidx_max;
-            }
-            else
-            {
-                if((leakyLMS.lidx -= leakyLMS.ldecr) < leakyLMS.lidx_min) leakyLMS.lidx = leakyLMS.lidx_min;
-            }
-            leakyLMS.ngamma = leakyLMS.gamma * (leakyLMS.lidx * leakyLMS.lidx) * (leakyLMS.lidx * leakyLMS.lidx) * leakyLMS.den_mult;
+    float32_t c1[LEAKYLMS_BLOCK_SIZE];
+    float32_t leak = 1.0;
+    float32_t sigma;
 
-            c0 = 1.0 - leakyLMS.two_mu * leakyLMS.ngamma;
-            c1 = leakyLMS.two_mu * error * inv_sigp;
+    arm_power_f32(x, n_taps, &sigma);
 
-            for (j = 0; j < leakyLMS.n_taps; j++)
-            {
-                idx = (leakyLMS.in_idx + j + leakyLMS.delay) & leakyLMS.mask;
-                leakyLMS.w[j] = c0 * leakyLMS.w[j] + c1 * leakyLMS.d[idx];
-            }
-            leakyLMS.in_idx = (leakyLMS.in_idx + leakyLMS.mask) & leakyLMS.mask;
+    for (int i = 0; i < block_len; i++)
+    {
+        float32_t y;
+        float32_t nel, nev;
+
+        if (i > 0)
+        {
+            // slide the window energy by one sample
+            sigma += x[i + n_taps - 1] * x[i + n_taps - 1] - x[i - 1] * x[i - 1];
+        }
+
+        arm_dot_prod_f32(&x[i], leakyLMS.w, n_taps, &y);
+
+        const float32_t inv_sigp = 1.0 / (sigma + 1e-10);
+        const float32_t input = in_buff[i];
+        const float32_t error = input - y;
+
+        if(notch)
+        { // automatic notch filter
+            out_buff[i] = error;
+        }
+        else
+        { // noise reduction
+            out_buff[i] = y;
         }
+
+        if((nel = error * (1.0 - leakyLMS.two_mu * sigma * inv_sigp)) < 0.0) nel = -nel;
+        if((nev = input - (1.0 - leakyLMS.two_mu * leakyLMS.ngamma) * y - leakyLMS.two_mu * error * sigma * inv_sigp) < 0.0) nev = -nev;
+        if (nev < nel)
+        {
+            if((leakyLMS.lidx += leakyLMS.lincr) > leakyLMS.lidx_max) leakyLMS.lidx = leakyLMS.lidx_max;
+        }
+        else
+        {
+            if((leakyLMS.lidx -= leakyLMS.ldecr) < leakyLMS.lidx_min) leakyLMS.lidx = leakyLMS.lidx_min;
+        }
+        leakyLMS.ngamma = leakyLMS.gamma * (leakyLMS.lidx * leakyLMS.lidx) * (leakyLMS.lidx * leakyLMS.lidx) * leakyLMS.den_mult;
+
+        leak *= 1.0 - leakyLMS.two_mu * leakyLMS.ngamma;
+        c1[i] = leakyLMS.two_mu * error * inv_sigp;
+    }
+
+    // coefficient update for the whole block: w = leak * w + sum(c1[i] * window[i])
+    arm_scale_f32(leakyLMS.w, leak, leakyLMS.w, n_taps);
+    for (int j = 0; j < n_taps; j++)
+    {
+        float32_t gradient;
+        arm_dot_prod_f32(&x[j], c1, block_len, &gradient);
+        leakyLMS.w[j] += gradient;
+    }
+}
+
+void AudioDriver_LeakyLmsNr (float32_t *in_buff, float32_t *out_buff, int buff_size, bool notch)
+{
+    for (int i = 0; i < buff_size; i += LEAKYLMS_BLOCK_SIZE)
+    {
+        const int block_len = (buff_size - i) < LEAKYLMS_BLOCK_SIZE ? (buff_size - i) : LEAKYLMS_BLOCK_SIZE;
+        AudioDriver_LeakyLmsNr_Block(&in_buff[i], &out_buff[i], block_len, notch);
+    }
 }
 #endif
 
@@ -663,6 +509,75 @@ static void RxProcessor_Init()
     //    ads.fade_leveler = 0;
 }
 
+// RTTY Experiment based on code from the DSP Tutorial at http://dp.nonoo.hu/projects/ham-dsp-tutorial/18-rtty-decoder-using-iir-filters/
+// Used with permission from Norbert Varga, HA2NON under GPLv3 license
+#ifdef USE_RTTY_PROCESSOR
+static void AudioDriver_RxProcessor_Rtty(const float32_t * const src, const size_t blockSize)
+{
+    for (uint16_t idx = 0; idx < blockSize; idx++)
+    {
+        Rtty_Demodulator_ProcessSample(src[idx]);
+    }
+}
+
+static bool AudioDriver_RxProcessor_RttyActive()
+{
+    return is_demod_rtty();
+}
+#endif
+
+static bool AudioDriver_RxProcessor_BpskActive()
+{
+    return is_demod_psk();
+}
+
+static void AudioDriver_RxProcessor_CwDecode(const float32_t * const src, const size_t blockSize)
+{
+    CwDecode_RxProcessor((float32_t*)src, blockSize);
+}
+
+static bool AudioDriver_RxProcessor_CwDecodeActive()
+{
+    // switch to use TUNE HELPER in AM/SAM
+    return ts.dmod_mode == DEMOD_CW || ts.dmod_mode == DEMOD_AM || ts.dmod_mode == DEMOD_SAM;
+}
+
+// all of these modems only work with 12 khz Samplerate
+// TODO: User needs feedback if the modem is not activated due to wrong decimation rate
+#ifdef USE_RTTY_PROCESSOR
+static const AudioTap_Consumer_t rtty_tap =
+{
+        .name = "RTTY", .process = AudioDriver_RxProcessor_Rtty, .is_active = AudioDriver_RxProcessor_RttyActive,
+        .sample_rate = 12000, .deferred = false,
+};
+#endif
+
+// the psk panorama decodes several channels, so this runs outside the audio interrupt
+static const AudioTap_Consumer_t bpsk_tap =
+{
+        .name = "BPSK", .process = Psk_Demodulator_ProcessBlock, .is_active = AudioDriver_RxProcessor_BpskActive,
+        .sample_rate = 12000, .deferred = true,
+};
+
+static const AudioTap_Consumer_t cw_decode_tap =
+{
+        .name = "CW", .process = AudioDriver_RxProcessor_CwDecode, .is_active = AudioDriver_RxProcessor_CwDecodeActive,
+        .sample_rate = 12000, .deferred = false,
+};
+
+/**
+ * Registers all consumers of the decimated rx audio stream with the audio tap bus
+ */
+static void AudioDriver_TapInit()
+{
+    AudioTap_Reset();
+#ifdef USE_RTTY_PROCESSOR
+    AudioTap_Register(&rtty_tap);
+#endif
+    AudioTap_Register(&bpsk_tap);
+    AudioTap_Register(&cw_decode_tap);
+}
+
 /**
  * Initializes most of the audio related data structures, must be called before audio interrupt becomes active
  * DO NOT ACTIVATE THE INTERRUPT BEFORE AudioDriver_SetProcessingChain() has been called, which handles the dynamic part
@@ -691,6 +606,7 @@ void AudioDriver_Init()
     // Codecs/Demod init
     Rtty_Modem_Init(ts.samp_rate); // RX/TX
     Psk_Modem_Init(ts.samp_rate);  // RX/TX
+    AudioDriver_TapInit();
 
     RxProcessor_Init();
     TxProcessor_Init();
@@ -963,6 +879,63 @@ void AudioDriver_CalcLowShelf(float32_t coeffs[5], float32_t f0, float32_t S, fl
 
 }
 
+/**
+ * @brief Biquad Filter Init Helper function to calculate a second order lowpass filter, Q = 0.7071 gives Butterworth response
+ */
+void AudioDriver_CalcLowpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS)
+{
+    float32_t w0 = 2 * PI * f0 / FS;
+    float32_t alpha = sinf(w0) / (2 * Q);
+    float32_t cosw0 = cosf(w0);
+
+    coeffs[B0] = (1 - cosw0) / 2;
+    coeffs[B1] = 1 - cosw0;
+    coeffs[B2] = (1 - cosw0) / 2;
+    float32_t scaling = 1 + alpha;
+    coeffs[A1] = 2 * cosw0; // already negated!
+    coeffs[A2] = alpha - 1; // already negated!
+
+    AudioDriver_ScaleBiquadCoeffs(coeffs,scaling, scaling);
+}
+
+/**
+ * @brief Biquad Filter Init Helper function to calculate a second order highpass filter, Q = 0.7071 gives Butterworth response
+ */
+void AudioDriver_CalcHighpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS)
+{
+    float32_t w0 = 2 * PI * f0 / FS;
+    float32_t alpha = sinf(w0) / (2 * Q);
+    float32_t cosw0 = cosf(w0);
+
+    coeffs[B0] = (1 + cosw0) / 2;
+    coeffs[B1] = -(1 + cosw0);
+    coeffs[B2] = (1 + cosw0) / 2;
+    float32_t scaling = 1 + alpha;
+    coeffs[A1] = 2 * cosw0; // already negated!
+    coeffs[A2] = alpha - 1; // already negated!
+
+    AudioDriver_ScaleBiquadCoeffs(coeffs,scaling, scaling);
+}
+
+/**
+ * @brief Biquad Filter Init Helper function to calculate a second order allpass filter, flat magnitude, phase shift of 180 degrees at f0
+ */
+void AudioDriver_CalcAllpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS)
+{
+    float32_t w0 = 2 * PI * f0 / FS;
+    float32_t alpha = sinf(w0) / (2 * Q);
+    float32_t cosw0 = cosf(w0);
+
+    coeffs[B0] = 1 - alpha;
+    coeffs[B1] = -2 * cosw0;
+    coeffs[B2] = 1 + alpha;
+    float32_t scaling = 1 + alpha;
+    coeffs[A1] = 2 * cosw0; // already negated!
+    coeffs[A2] = alpha - 1; // already negated!
+
+    AudioDriver_ScaleBiquadCoeffs(coeffs,scaling, scaling);
+}
+
 #if 0
 /**
  * @brief Biquad Filter Init Helper function to calculate a notch filter aka narrow bandstop filter with variable bandwidth
@@ -1054,35 +1027,16 @@ static void AudioDriver_SetRxTxAudioProcessingAudioFilters(uint8_t dmod_mode)
  */
 static void AudioDriver_Spectrum_Set()
 {
-    // this sets the coefficients for the ZoomFFT decimation filter
+    // this sets up the ZoomFFT decimation filter
     // according to the desired magnification mode sd.magnify.
-    // The magnification is 2^sd.magnify (0 - 5 -> 1x - 32x)
+    // The magnification is 2^sd.magnify (0 - 7 -> 1x - 128x)
     if(sd.magnify > MAGNIFY_MAX)
     {
         sd.magnify = MAGNIFY_MIN;
     }
 
-    // for 0 the mag_coeffs will a NULL  ptr, since the filter is not going to be used in this  mode!
-    IIR_biquad_Zoom_FFT_I.pCoeffs = mag_coeffs[sd.magnify];
-    IIR_biquad_Zoom_FFT_Q.pCoeffs = mag_coeffs[sd.magnify];
-
-
-    // Set up ZOOM FFT FIR decimation filters
-    // switch right FIR decimation filter depending on sd.magnify
-
-    arm_fir_decimate_init_f32(&DECIMATE_ZOOM_FFT_I,
-            FirZoomFFTDecimate[sd.magnify].numTaps,
-            (1 << sd.magnify),          // Decimation factor
-            FirZoomFFTDecimate[sd.magnify].pCoeffs,
-            decimZoomFFTIState,            // Filter state variables
-            FIR_RXAUDIO_BLOCK_SIZE);
-
-    arm_fir_decimate_init_f32(&DECIMATE_ZOOM_FFT_Q,
-            FirZoomFFTDecimate[sd.magnify].numTaps,
-            (1 << sd.magnify),          // Decimation factor
-            FirZoomFFTDecimate[sd.magnify].pCoeffs,
-            decimZoomFFTQState,            // Filter state variables
-            FIR_RXAUDIO_BLOCK_SIZE);
+    // for 0 the decimator is not going to be used
+    ZoomDecimate_Init(&zoomDecimate, sd.magnify);
 }
 
 /**
@@ -1320,6 +1274,134 @@ static void AudioDriver_NoiseBlanker(AudioSample_t * const src, int16_t blockSiz
 }
 #endif
 
+/*
+ * Passband power meter
+ *
+ * The receive chain feeds the signal after the last filter which defines the passband, but before the AGC,
+ * into the meter. Every 1/PASSBAND_METER_RATE seconds the mean power and the peak power are
+ * published for the S-meter, independent of the spectrum display.
+ *
+ * All powers are scaled to the equivalent power at the iq input: a carrier I = A*cos, Q = A*sin
+ * has the power A^2, both as iq signal (I^2 + Q^2) and after sideband demodulation.
+ * The sideband demodulation (I+Q or I-Q after the Hilbert filters) doubles the amplitude, the real signal
+ * 2*A*cos has a mean square of 2*A^2 and a peak square of 4*A^2.
+ */
+typedef struct
+{
+    // accumulation, interrupt only
+    float32_t sum;
+    float32_t peak;
+    uint32_t samples;           // number of samples in sum
+    uint32_t iq_samples;        // input samples since the start of the interval, defines the interval length
+
+    // results
+    volatile float32_t power;
+    volatile float32_t peak_power;
+    volatile uint32_t seq;      // incremented before and after the results are written
+} PassbandMeter;
+
+static PassbandMeter passband_meter;
+
+/**
+ * adds the real sideband demodulated signal to the passband meter
+ */
+static void AudioDriver_PassbandMeterAddReal(const float32_t* a, const uint16_t blockSize)
+{
+    float32_t sum;
+    float32_t max_value, min_value;
+    uint32_t idx;
+
+    // the CMSIS functions do not take const pointers but do not write to the input
+    arm_power_f32((float32_t*)a, blockSize, &sum);
+    arm_max_f32((float32_t*)a, blockSize, &max_value, &idx);
+    arm_min_f32((float32_t*)a, blockSize, &min_value, &idx);
+
+    const float32_t peak = (max_value > -min_value ? max_value * max_value : min_value * min_value) * 0.25;
+
+    passband_meter.sum += sum * 0.5;
+    passband_meter.samples += blockSize;
+    if (peak > passband_meter.peak)
+    {
+        passband_meter.peak = peak;
+    }
+}
+
+/**
+ * adds a filtered iq signal to the passband meter
+ */
+static void AudioDriver_PassbandMeterAddIq(const float32_t* i_buffer, const float32_t* q_buffer, const uint16_t blockSize)
+{
+    float32_t peak = passband_meter.peak;
+    float32_t sum = 0;
+
+    for (uint16_t idx = 0; idx < blockSize; idx++)
+    {
+        const float32_t power = i_buffer[idx] * i_buffer[idx] + q_buffer[idx] * q_buffer[idx];
+        sum += power;
+        if (power > peak)
+        {
+            peak = power;
+        }
+    }
+
+    passband_meter.sum += sum;
+    passband_meter.samples += blockSize;
+    passband_meter.peak = peak;
+}
+
+/**
+ * to be called once per processed iq block, publishes the results at the end of an interval
+ * @param blockSize number of iq input samples of the block
+ */
+static void AudioDriver_PassbandMeterBlockDone(const uint16_t blockSize)
+{
+    passband_meter.iq_samples += blockSize;
+
+    if (passband_meter.iq_samples >= IQ_SAMPLE_RATE / PASSBAND_METER_RATE)
+    {
+        if (passband_meter.samples > 0)
+        {
+            passband_meter.seq++;
+            __DMB();
+            passband_meter.power = passband_meter.sum / passband_meter.samples;
+            passband_meter.peak_power = passband_meter.peak;
+            __DMB();
+            passband_meter.seq++;
+        }
+
+        passband_meter.sum = 0;
+        passband_meter.peak = 0;
+        passband_meter.samples = 0;
+        passband_meter.iq_samples = 0;
+    }
+}
+
+/**
+ * gets the latest passband meter result, see AudioDriver_PassbandMeterAddReal() for the scaling.
+ * The input gain of the codec is not compensated.
+ * @param power_p mean power of the signal in the passband
+ * @param peak_p peak envelope power of the signal in the passband
+ * @return true if a new result is available since the last call
+ */
+bool AudioDriver_PassbandMeterRead(float32_t* power_p, float32_t* peak_p)
+{
+    static uint32_t last_seq;
+    uint32_t seq;
+
+    do
+    {
+        seq = passband_meter.seq;
+        __DMB();
+        *power_p = passband_meter.power;
+        *peak_p = passband_meter.peak_power;
+        __DMB();
+    } while ((seq & 1) != 0 || seq != passband_meter.seq);
+
+    const bool retval = seq != last_seq;
+    last_seq = seq;
+    return retval;
+}
+
 
 
 #ifdef USE_FREEDV
@@ -1353,11 +1435,19 @@ static bool AudioDriver_RxProcessorFreeDV (iq_buffer_t* iq_buf_p, float32_t * co
 #ifdef USE_SIMPLE_FREEDV_FILTERS
     arm_biquad_cascade_df1_f32 (&IIR_biquad_FreeDV_I, real, real_buffer, blockSize);
     arm_biquad_cascade_df1_f32 (&IIR_biquad_FreeDV_Q, imag, imag_buffer, blockSize);
+
+    AudioDriver_PassbandMeterAddIq(real_buffer, imag_buffer, blockSize);
 #else
     // we run a hilbert transform including a low pass to avoid
     // aliasing artifacts
     arm_fir_f32(&Fir_FreeDV_Rx_Hilbert_I,real,real_buffer,blockSize);
     arm_fir_f32(&Fir_FreeDV_Rx_Hilbert_Q,imag,imag_buffer,blockSize);
+
+    {
+        float32_t demod_buffer[blockSize];
+        arm_add_f32(real_buffer, imag_buffer, demod_buffer, blockSize);
+        AudioDriver_PassbandMeterAddReal(demod_buffer, blockSize);
+    }
 #endif
 
     // DOWNSAMPLING
@@ -1465,27 +1555,6 @@ static bool AudioDriver_RxProcessorFreeDV (iq_buffer_t* iq_buf_p, float32_t * co
 }
 #endif
 
-// RTTY Experiment based on code from the DSP Tutorial at http://dp.nonoo.hu/projects/ham-dsp-tutorial/18-rtty-decoder-using-iir-filters/
-// Used with permission from Norbert Varga, HA2NON under GPLv3 license
-#ifdef USE_RTTY_PROCESSOR
-static void AudioDriver_RxProcessor_Rtty(float32_t * const src, int16_t blockSize)
-{
-    for (uint16_t idx = 0; idx < blockSize; idx++)
-    {
-        Rtty_Demodulator_ProcessSample(src[idx]);
-    }
-}
-#endif
-
-static void AudioDriver_RxProcessor_Bpsk(float32_t * const src, int16_t blockSize)
-{
-
-    for (uint16_t idx = 0; idx < blockSize; idx++)
-    {
-        Psk_Demodulator_ProcessSample(src[idx]);
-    }
-}
-
 
 // FM Demodulator parameters
 #define FM_DEMOD_COEFF1     PI/4            // Factors used in arctan approximation used in FM demodulator
@@ -1773,9 +1842,11 @@ static void AudioDriver_Mix(float32_t* src, float32_t* dst, float32_t scaling, c
     arm_add_f32(dst, e3_buffer, dst, blockSize);
 }
 
-void AudioDriver_IQPhaseAdjust(uint16_t txrx_mode, float32_t* i_buffer, float32_t* q_buffer, const uint16_t blockSize)
+/**
+ * @return the iq phase correction factor for the given mode, negative: part of I is added to Q, positive: part of Q is added to I
+ */
+float32_t AudioDriver_GetIQPhaseBalance(uint16_t txrx_mode)
 {
-
     int16_t trans_idx;
 
     // right now only in TX used, may change in future
@@ -1788,7 +1859,12 @@ void AudioDriver_IQPhaseAdjust(uint16_t txrx_mode, float32_t* i_buffer, float32_
         trans_idx = IQ_TRANS_ON;
     }
 
-    float32_t iq_phase_balance =  (txrx_mode == TRX_MODE_RX)? ads.iq_phase_balance_rx: ads.iq_phase_balance_tx[trans_idx];
+    return (txrx_mode == TRX_MODE_RX)? ads.iq_phase_balance_rx: ads.iq_phase_balance_tx[trans_idx];
+}
+
+void AudioDriver_IQPhaseAdjust(uint16_t txrx_mode, float32_t* i_buffer, float32_t* q_buffer, const uint16_t blockSize)
+{
+    float32_t iq_phase_balance = AudioDriver_GetIQPhaseBalance(txrx_mode);
 
     if (iq_phase_balance < 0)   // we only need to deal with I and put a little bit of it into Q
     {
@@ -1818,11 +1894,20 @@ static void AudioDriver_SpectrumCopyIqBuffers(iq_buffer_t* iq_puf_b, const size_
         sd.FFT_RingBuffer[sd.samp_ptr] = iq_puf_b->i_buffer[i];
         sd.samp_ptr++;
 
-        if(sd.samp_ptr >= sd.fft_iq_len-1)
+        if(sd.samp_ptr >= sd.fft_ring_len)
         {
             sd.samp_ptr = 0;
         }
     }
+
+    // publish the samples only after they have been written
+    __DMB();
+    uint32_t samp_count = sd.samp_count + blockSize;
+    if (samp_count >= sd.samp_count_wrap)
+    {
+        samp_count -= sd.samp_count_wrap;
+    }
+    sd.samp_count = samp_count;
 }
 
 /**
@@ -1838,13 +1923,10 @@ static void AudioDriver_SpectrumCopyIqBuffers(iq_buffer_t* iq_puf_b, const size_
 static void AudioDriver_SpectrumNoZoomProcessSamples(iq_buffer_t* iq_puf_b, const uint16_t blockSize)
 {
 
-    if(sd.reading_ringbuffer == false && sd.fft_iq_len > 0)
+    if(sd.fft_iq_len > 0 && sd.magnify == 0)
     {
-        if(sd.magnify == 0)        //
-        {
-            AudioDriver_SpectrumCopyIqBuffers(iq_puf_b, blockSize);
-            sd.FFT_frequency = (ts.tune_freq); // spectrum shows all, LO is center frequency;
-        }
+        AudioDriver_SpectrumCopyIqBuffers(iq_puf_b, blockSize);
+        sd.FFT_frequency = (ts.tune_freq); // spectrum shows all, LO is center frequency;
     }
 }
 
@@ -1852,58 +1934,42 @@ static void AudioDriver_SpectrumNoZoomProcessSamples(iq_buffer_t* iq_puf_b, cons
  * Places IQ data in the spectrums IQ ringbuffer if a zoom level has been set. Otherwise does nothing
  * To be called from the audio interrupt side of things. Do not call otherwise as the code is not
  * reentrant will screw up things.
- * Will place blockSize / 2^sd.magnify samples in ring buffer
+ * Will place blockSize / 2^sd.magnify samples in ring buffer on average, with high zoom levels
+ * only every few calls a sample is added
  *
  * @param iq_buf_p iq data with frequency of interest centered! (after frequency shift) at IQ_SAMEPLE_RATE
  * @param blockSize IQ sample count
  */
 static void AudioDriver_SpectrumZoomProcessSamples(iq_buffer_t* iq_buf_p,  const uint16_t blockSize)
 {
-    if(sd.reading_ringbuffer == false && sd.fft_iq_len > 0)
+    if(sd.magnify != 0 && sd.fft_iq_len > 0)
+        // magnify 2, 4, 8, 16, 32, 64 or 128
     {
-        if(sd.magnify != 0)        //
-            // magnify 2, 4, 8, 16, or 32
+        // ZOOM FFT
+        // is used here to have a very close look at a small part
+        // of the spectrum display of the mcHF
+        // The ZOOM FFT is based on the principles described in Lyons (2011)
+        // 1. take the I & Q samples
+        // 2. complex conversion to baseband (at this place has already been done in audio_rx_freq_conv!)
+        // 3. lowpass and decimate I and Q separately (CIC + compensating FIR, see zoom_decimate.c)
+        // 4. apply 256-point-FFT (512-point-FFT on large displays) to decimated I&Q samples
+        //
+        // frequency resolution: spectrum bandwidth / 256
+        // example: decimate by 8 --> 48kHz / 8 = 6kHz spectrum display bandwidth
+        // frequency resolution of the display --> 6kHz / 256 = 23.44Hz
+        // in 128x Mag-mode the resolution is 1.46Hz (0.73Hz with 512 points), good enough for WSPR and QRSS
+        //
+        // With high zoom a block may produce no sample at all.
+
+        iq_buffer_t decim_iq_buf;
+
+        const uint16_t decim_size = ZoomDecimate_Process(&zoomDecimate, iq_buf_p->i_buffer, iq_buf_p->q_buffer, decim_iq_buf.i_buffer, decim_iq_buf.q_buffer, blockSize);
+
+        if(decim_size > 0)
         {
-            // ZOOM FFT
-            // is used here to have a very close look at a small part
-            // of the spectrum display of the mcHF
-            // The ZOOM FFT is based on the principles described in Lyons (2011)
-            // 1. take the I & Q samples
-            // 2. complex conversion to baseband (at this place has already been done in audio_rx_freq_conv!)
-            // 3. lowpass I and lowpass Q separately (48kHz sample rate)
-            // 4. decimate I and Q separately
-            // 5. apply 256-point-FFT to decimated I&Q samples
-            //
-            // frequency resolution: spectrum bandwidth / 256
-            // example: decimate by 8 --> 48kHz / 8 = 6kHz spectrum display bandwidth
-            // frequency resolution of the display --> 6kHz / 256 = 23.44Hz
-            // in 32x Mag-mode the resolution is 5.9Hz, not bad for such a small processor . . .
-            //
-
-            iq_buffer_t decim_iq_buf;
-
-            // lowpass Filtering
-            // Mag 2x - 12k lowpass --> 24k bandwidth
-            // Mag 4x - 6k lowpass --> 12k bandwidth
-            // Mag 8x - 3k lowpass --> 6k bandwidth
-            // Mag 16x - 1k5 lowpass --> 3k bandwidth
-            // Mag 32x - 750Hz lowpass --> 1k5 bandwidth
-
-            // 1st attempt - use low processor power biquad lowpass filters with 4 stages each
-            arm_biquad_cascade_df1_f32 (&IIR_biquad_Zoom_FFT_I, iq_buf_p->i_buffer,decim_iq_buf.i_buffer, blockSize);
-            arm_biquad_cascade_df1_f32 (&IIR_biquad_Zoom_FFT_Q, iq_buf_p->q_buffer,decim_iq_buf.q_buffer, blockSize);
-
-            // decimation
-            arm_fir_decimate_f32(&DECIMATE_ZOOM_FFT_I, decim_iq_buf.i_buffer, decim_iq_buf.i_buffer, blockSize);
-            arm_fir_decimate_f32(&DECIMATE_ZOOM_FFT_Q, decim_iq_buf.q_buffer, decim_iq_buf.q_buffer, blockSize);
-            // collect samples for spectrum display 256-point-FFT
-
-            AudioDriver_SpectrumCopyIqBuffers(&decim_iq_buf, blockSize/ (1<<sd.magnify));
+            // collect samples for spectrum display FFT
+            AudioDriver_SpectrumCopyIqBuffers(&decim_iq_buf, decim_size);
             sd.FFT_frequency = ts.tune_freq + AudioDriver_GetTranslateFreq(); // spectrum shows center at translate frequency, LO + Translate Freq  is center frequency;
-
-            // TODO: also insert sample collection for snap carrier here
-            // and subsequently rebuild snap carrier to use a much smaller FFT (say 256 or 512)
-            // in order to save many kilobytes of RAM ;-)
         }
     }
 }
@@ -2353,6 +2419,7 @@ static void AudioDriver_RxProcessorNoiseReduction(uint16_t blockSizeDecim, float
         // see below
 
         nr_params.NR_decimation_active = nr_params.NR_decimation_enable && (FilterInfo[ts.filters_p->id].width < 2701);
+        nr_params.NR_sample_rate = nr_params.NR_decimation_active ? ads.decimated_freq / 2 : ads.decimated_freq;
 
         if (nr_params.NR_decimation_active == true)
         {
@@ -2481,6 +2548,16 @@ static void RxProcessor_DemodAudioPostprocessing(float32_t (*a_buffer)[AUDIO_BLO
 #endif
     }
 
+    // the audio filter defines the passband for the sideband modes, AM and SAM have been measured before the demodulation
+    if (dmod_mode != DEMOD_AM && dmod_mode != DEMOD_SAM
+#ifdef USE_TWO_CHANNEL_AUDIO
+            && dmod_mode != DEMOD_IQ
+#endif
+    )
+    {
+        AudioDriver_PassbandMeterAddReal(a_buffer[0], blockSizeDecim);
+    }
+
     // now process the samples and perform the receiver AGC function
     AudioAgc_RunAgcWdsp(blockSizeDecim, a_buffer, use_stereo);
 
@@ -2498,7 +2575,7 @@ static void RxProcessor_DemodAudioPostprocessing(float32_t (*a_buffer)[AUDIO_BLO
     }
 #endif
 
-    if (sampleRateDecim == 12000 && (is_dsp_nb_active() || is_dsp_nr())) //start of new nb or new noise reduction
+    if (is_dsp_nb_active() || is_dsp_nr()) //start of new nb or new noise reduction
     {
         // NR_in and _out buffers are using the same physical space than the freedv_iq_buffer in a
         // shared MultiModeBuffer union.
@@ -2534,27 +2611,8 @@ static void RxProcessor_DemodAudioPostprocessing(float32_t (*a_buffer)[AUDIO_BLO
 #endif
 
 
-    // all of these modems only work with 12 khz Samplerate
-    // TODO: User needs feedback if the modem is not activated due to wrong decimation rate
-    if (sampleRateDecim == 12000)
-    {
-#ifdef USE_RTTY_PROCESSOR
-        if (is_demod_rtty()) // only works when decimation rate is 4 --> sample rate == 12ksps
-        {
-            AudioDriver_RxProcessor_Rtty(a_buffer[0], blockSizeDecim);
-        }
-#endif
-        if (is_demod_psk()) // only works when decimation rate is 4 --> sample rate == 12ksps
-        {
-            AudioDriver_RxProcessor_Bpsk(a_buffer[0], blockSizeDecim);
-        }
-
-        if((dmod_mode == DEMOD_CW || dmod_mode == DEMOD_AM || dmod_mode == DEMOD_SAM))
-            // switch to use TUNE HELPER in AM/SAM
-        {
-            CwDecode_RxProcessor(a_buffer[0], blockSizeDecim);
-        }
-    }
+    // hand the audio to the decoders (RTTY, BPSK, CW, ...)
+    AudioTap_Publish(a_buffer[0], blockSizeDecim, sampleRateDecim);
 
     // resample back to original sample rate while doing low-pass filtering to minimize audible aliasing effects
     if (INTERPOLATE_RX[0].phaseLength > 0)
@@ -2703,6 +2761,10 @@ static void AudioDriver_RxProcessor(IqSample_t * const srcCodec, AudioSample_t *
         // Spectrum display sample collect for magnify != 0
 
         AudioDriver_SpectrumZoomProcessSamples(&adb.iq_buf, blockSize);
+
+        // sample collection for the SNAP carrier frequency estimator
+        SnapEstimator_ProcessSamples(adb.iq_buf.i_buffer, adb.iq_buf.q_buffer, blockSize);
+
 #ifdef USE_FREEDV
         if (ts.dvmode == true && ts.digital_mode == DigitalMode_FreeDV)
         {
@@ -2739,13 +2801,25 @@ static void AudioDriver_RxProcessor(IqSample_t * const srcCodec, AudioSample_t *
              * SSB-> wants for wider bandwidth full IQ_SAMPLE_RATE input, shifted I and Q shifted by 90 degrees
              */
 
-            if(use_decimatedIQ)
+#ifdef USE_RX_Q15
+            // SSB and CW are handled by the Q15 implementation if it has usable filters
+            const bool use_q15 = RxQ15_IsUsable() && RadioManagement_UsesBothSidebands(dmod_mode) == false && dmod_mode != DEMOD_SAM;
+            if (use_q15)
+            {
+                RxQ15_SidebandDemod(adb.iq_buf.i_buffer, adb.iq_buf.q_buffer, adb.a_buffer[0], RadioManagement_LSBActive(dmod_mode),
+                        use_decimatedIQ, blockSize, blockSizeIQ, blockSizeDecim);
+            }
+#else
+            const bool use_q15 = false;
+#endif
+
+            if(use_decimatedIQ && use_q15 == false)
             {
                 arm_fir_decimate_f32(&DECIMATE_RX_I, adb.iq_buf.i_buffer, adb.iq_buf.i_buffer, blockSize);      // LPF built into decimation (Yes, you can decimate-in-place!)
                 arm_fir_decimate_f32(&DECIMATE_RX_Q, adb.iq_buf.q_buffer, adb.iq_buf.q_buffer, blockSize);      // LPF built into decimation (Yes, you can decimate-in-place!)
             }
 
-            if(dmod_mode != DEMOD_SAM && dmod_mode != DEMOD_AM) // for SAM & AM leave out this processor-intense filter
+            if(dmod_mode != DEMOD_SAM && dmod_mode != DEMOD_AM && use_q15 == false) // for SAM & AM leave out this processor-intense filter
             {
             	// SECOND: Hilbert transform (for all but AM/SAM)
                 arm_fir_f32(&Fir_Rx_Hilbert_I,adb.iq_buf.i_buffer, adb.iq_buf.i_buffer, blockSizeIQ);   // Hilbert lowpass +45 degrees
@@ -2754,20 +2828,27 @@ static void AudioDriver_RxProcessor(IqSample_t * const srcCodec, AudioSample_t *
             // at this point we have (low pass filtered/decimated?) IQ, with our RX frequency in the center (i.e. at 0 Hertz Shift)
             // in adb.iq_buf.i_buffer, adb.iq_buf.q_buffer, block size is in blockSizeIQ
 
-            if (RadioManagement_UsesBothSidebands(dmod_mode) || dmod_mode == DEMOD_SAM  )
+            if (use_q15)
+            {
+                // already demodulated and decimated into adb.a_buffer[0]
+            }
+            else if (RadioManagement_UsesBothSidebands(dmod_mode) || dmod_mode == DEMOD_SAM  )
             {
                 // we must go here in DEMOD_SAM even if we effectively output only a single sideband
                 switch(dmod_mode)
                 {
                 case DEMOD_AM:
                 case DEMOD_SAM:
+                    AudioDriver_PassbandMeterAddIq(adb.iq_buf.i_buffer, adb.iq_buf.q_buffer, blockSizeIQ);
                     AudioDriver_DemodSAM(adb.iq_buf.i_buffer, adb.iq_buf.q_buffer, adb.a_buffer, blockSizeIQ, sampleRateIQ); // lowpass filtering, decimation, and SAM demodulation
                     break;
                 case DEMOD_FM:
+                    AudioDriver_PassbandMeterAddIq(adb.iq_buf.i_buffer, adb.iq_buf.q_buffer, blockSizeIQ);
                     signal_active = AudioDriver_DemodFM(adb.iq_buf.i_buffer, adb.iq_buf.q_buffer, adb.a_buffer[0], blockSize);
                     break;
 #ifdef USE_TWO_CHANNEL_AUDIO
                 case DEMOD_IQ:  // leave I & Q as they are!
+                    AudioDriver_PassbandMeterAddIq(adb.iq_buf.i_buffer, adb.iq_buf.q_buffer, blockSizeIQ);
                     arm_copy_f32(adb.iq_buf.i_buffer, adb.a_buffer[0], blockSizeIQ);
                     arm_copy_f32(adb.iq_buf.q_buffer, adb.a_buffer[1], blockSizeIQ);
                     break;
@@ -2797,7 +2878,7 @@ static void AudioDriver_RxProcessor(IqSample_t * const srcCodec, AudioSample_t *
             if(dmod_mode != DEMOD_FM)       // are we NOT in FM mode?
             {
                 // If we are not, do decimation if not already done, filtering, DSP notch/noise reduction, etc.
-                if (use_decimatedIQ == false) // we did not already decimate the input earlier
+                if (use_decimatedIQ == false && use_q15 == false) // we did not already decimate the input earlier
                 {
                     // TODO HILBERT
                     arm_fir_decimate_f32(&DECIMATE_RX_I, adb.a_buffer[0], adb.a_buffer[0], blockSizeIQ);      // LPF built into decimation (Yes, you can decimate-in-place!)
@@ -2842,6 +2923,8 @@ static void AudioDriver_RxProcessor(IqSample_t * const srcCodec, AudioSample_t *
     // at this point we have audio at AUDIO_SAMPLE_RATE in our adb.a_buffer[1] (and [0] if we are in stereo)
     // if signal_active is true and we're ready to send it out
 
+    AudioDriver_PassbandMeterBlockDone(blockSize);
+
     bool do_mute_output = external_mute == true || (signal_active == false);
 
     if (do_mute_output)
@@ -2959,7 +3042,7 @@ static void AudioDriver_IqFillSilence(IqSample_t *s, size_t size)
 //* Output Parameters   :
 //* Functions called    :
 //*----------------------------------------------------------------------------
-void AudioDriver_I2SCallback(AudioSample_t *audio, IqSample_t *iq, AudioSample_t *audioDst, int16_t blockSize)
+void AudioDriver_I2SCallback(AudioSample_t *audio, IqSample_t *iq, const IqSample_t *iqLoopback, AudioSample_t *audioDst, int16_t blockSize)
 {
     static bool to_rx = false;	// used as a flag to clear the RX buffer
     static bool to_tx = false;	// used as a flag to clear the TX buffer
@@ -2990,7 +3073,8 @@ void AudioDriver_I2SCallback(AudioSample_t *audio, IqSample_t *iq, AudioSample_t
 #ifdef USE_CONVOLUTION
         AudioDriver_RxProcessorConvolution(iq, audio, blockSize, muted);
 #else
-        AudioDriver_RxProcessor(iq, audio, blockSize, muted);
+        // the iq samples are still processed if only the output is muted, e.g. for the spectrum display during a band sweep
+        AudioDriver_RxProcessor(iq, audio, blockSize, muted || ts.audio_dac_muting_flag);
 #endif
         if (ts.audio_dac_muting_buffer_count > 0)
         {
@@ -3024,7 +3108,7 @@ void AudioDriver_I2SCallback(AudioSample_t *audio, IqSample_t *iq, AudioSample_t
             }
         }
 
-        TxProcessor_Run(audio, iq, audioDst,blockSize, muted);
+        TxProcessor_Run(audio, iq, iqLoopback, audioDst,blockSize, muted);
 
         // Pause or inactivity
         if (ts.audio_dac_muting_buffer_count)
@@ -65,6 +65,9 @@ typedef struct {
 	#define FFT_IQ_BUFF_LEN		512
 #endif
 #define SPEC_BUFF_LEN (FFT_IQ_BUFF_LEN/2)
+// the spectrum ring buffer holds one FFT frame plus half a frame, so that the audio driver
+// can continue to write while the user level code is reading a frame
+#define FFT_RING_BUFF_LEN (FFT_IQ_BUFF_LEN + FFT_IQ_BUFF_LEN/2)
 
 // twice the number of samples in the each iq block buffer
 // (which is half of the total dma buffer, since in each interrupt we get half of the total dma buffer)
@@ -148,7 +151,6 @@ typedef struct
 {
     // Stereo buffers
     iq_buffer_t     iq_buf;
-    float32_t       agc_valbuf[IQ_BLOCK_SIZE];   // holder for "running" AGC value
 
     audio_block_t   a_buffer[2];
 
@@ -272,6 +274,10 @@ typedef struct AudioDriverState
 
 void AudioManagement_CalcIQPhaseAdjust(uint32_t freq);
 
+// passband power meter, measures the received signal in the filter passband for the S-meter
+#define PASSBAND_METER_RATE     50      // results per second
+#define PASSBAND_METER_DBM_OFFSET  -115.0  // dBm of a carrier with amplitude 1 at the iq input, corrected by ts.dbm_constant
+
 // S meter public
 typedef struct SMeter
 {
@@ -302,6 +308,12 @@ typedef struct SMeter
     // current measurements, used for averaging
     float32_t dbm_cur;
     float32_t dbmhz_cur;
+    float32_t dbm_peak_cur;  // peak envelope power of the last measurement interval
+
+    // peak hold of dbm_peak_cur, used for display
+    float32_t dbm_peak;
+    uint32_t dbm_peak_hold;  // remaining measurement intervals until the peak follows the signal again
+#define SMETER_PEAK_HOLD_INTERVALS  (PASSBAND_METER_RATE * 2) // 2 seconds
 
     // internal variables for dbm low pass calculation
     float32_t AttackAvedbm;
@@ -543,8 +555,11 @@ extern SnapCarrier sc;
 
 
 #ifdef USE_LEAKY_LMS
-#define LEAKYLMSDLINE_SIZE 256 //512 // was 256 //2048   // dline_size
+#define LEAKYLMSDLINE_SIZE 256 //512 // was 256 //2048   // dline_size, must be a power of 2
 // 1024 funktioniert nicht
+// max. number of samples processed with constant filter coefficients, larger buffers are split
+// n_taps + delay + LEAKYLMS_BLOCK_SIZE must not exceed LEAKYLMSDLINE_SIZE, n_taps is limited accordingly
+#define LEAKYLMS_BLOCK_SIZE 16
 typedef struct
 {// Automatic noise reduction
 	// Variable-leak LMS algorithm
@@ -567,11 +582,9 @@ typedef struct
 	float32_t den_mult;// = 6.25e-10;                   // den_mult
 	float32_t lincr;// =    1.0;                      // lincr
 	float32_t ldecr;// =    3.0;                     // ldecr
-	//int ANR_mask = ANR_dline_size - 1;
-	int mask;// = DLINE_SIZE - 1;
 	int in_idx;// = 0;
-	float32_t d [LEAKYLMSDLINE_SIZE];
-	float32_t w [LEAKYLMSDLINE_SIZE];
+	float32_t d [2 * LEAKYLMSDLINE_SIZE]; // delay line, every sample is stored twice
+	float32_t w [LEAKYLMSDLINE_SIZE];     // filter coefficients, w[0] applies to the oldest sample
 	uint8_t on;// = 0;
 	uint8_t notch;// = 0;
 } lLMS;
@@ -648,15 +661,20 @@ void AudioDriver_SetProcessingChain(uint8_t dmod_mode, bool reset_dsp_nr);
 int32_t AudioDriver_GetTranslateFreq(void);
 void AudioDriver_SetSamPllParameters (void);
 
-void AudioDriver_I2SCallback(AudioSample_t *audio, IqSample_t *iq, AudioSample_t *audioDst, int16_t size);
+void AudioDriver_I2SCallback(AudioSample_t *audio, IqSample_t *iq, const IqSample_t *iqLoopback, AudioSample_t *audioDst, int16_t size);
 
 
 void AudioDriver_CalcLowShelf(float32_t coeffs[5], float32_t f0, float32_t S, float32_t gain, float32_t FS);
 void AudioDriver_CalcHighShelf(float32_t coeffs[5], float32_t f0, float32_t S, float32_t gain, float32_t FS);
 void AudioDriver_CalcBandpass(float32_t coeffs[5], float32_t f0, float32_t FS);
+void AudioDriver_CalcLowpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS);
+void AudioDriver_CalcHighpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS);
+void AudioDriver_CalcAllpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS);
 void AudioDriver_SetBiquadCoeffs(float32_t* coeffsTo,const float32_t* coeffsFrom);
 
 void AudioDriver_IQPhaseAdjust(uint16_t txrx_mode, float32_t* i_buffer, float32_t* q_buffer, const uint16_t blockSize);
+float32_t AudioDriver_GetIQPhaseBalance(uint16_t txrx_mode);
 void AudioDriver_AgcWdsp_Set(void);
+bool AudioDriver_PassbandMeterRead(float32_t* power_p, float32_t* peak_p);
 
 #endif
@@ -16,6 +16,7 @@
 #include "audio_filter.h"
 #include "audio_driver.h"
 #include "filters.h"
+#include "rx_q15.h"
 
 #include "arm_math.h"
 #include "math.h"
@@ -1220,6 +1221,11 @@ void 	AudioFilter_SetRxHilbertAndDecimationFIR(uint8_t dmod_mode)
                 decimState_Q,            // Filter state variables
                 FIR_RXAUDIO_BLOCK_SIZE);
     }
+
+#ifdef USE_RX_Q15
+    // AM and SAM use the Hilbert coefficients for decimation, these modes are not handled by the Q15 path
+    RxQ15_SetRxHilbertAndDecimationFIR(&Fir_Rx_Hilbert_I, &Fir_Rx_Hilbert_Q, dmod_mode != DEMOD_SAM && dmod_mode != DEMOD_AM ? &DECIMATE_RX_I : NULL);
+#endif
 }
 
 
@@ -16,6 +16,7 @@
 #define DRIVERS_AUDIO_AUDIO_FILTER_H_
 
 #include "uhsdr_types.h"
+#include "uhsdr_board_config.h"
 #include "arm_math.h"
 
 // TODO: Decide if we switch to use this struct
@@ -18,34 +18,30 @@
 #ifdef USE_ALTERNATE_NR
 
 static void alt_noise_blanking();
-static void spectral_noise_reduction_3();
+static void spectral_noise_reduction_3(const float32_t* in_buffer, float32_t* out_buffer);
 static void AudioNr_RunNoiseReduction(float32_t* inputsamples, float32_t* outputsamples );
 
 typedef struct NoiseReduction // declaration
 {
-    float32_t                   last_iFFT_result [NR_FFT_L_2 / 2];
+    arm_rfft_fast_instance_f32  rfft; // real FFT instance for the current fft_l
+    float32_t                   window[NR_FFT_L_2]; // sqrt von Hann window, used for analysis and synthesis
+    float32_t                   last_iFFT_result [NR_FFT_L_2 / 2]; // windowed second half of the last synthesis frame
     float32_t                   last_sample_buffer_L [NR_FFT_L_2 / 2];
-    float32_t                   FFT_buffer[NR_FFT_L_2 * 2];
-    float32_t                   Nest[NR_FFT_L_2 / 2][2]; // noise estimates for the current and the last FFT frame
-    float32_t                   vk; // saved 0.24kbytes
-    float32_t                   SNR_prio[NR_FFT_L_2 / 2];
-    float32_t                   SNR_post[NR_FFT_L_2 / 2];
-    float32_t                   SNR_post_pos; // saved 0.24kbytes
+    float32_t                   FFT_buffer[NR_FFT_L_2]; // time domain frame, gets destroyed by the FFT
+    float32_t                   FFT_spectrum[NR_FFT_L_2]; // packed real FFT result [re0, reL/2, re1, im1, re2, im2 . . .]
+    float32_t                   Nest[NR_FFT_L_2 / 2 + 1]; // initial noise estimate, later reused for the gain smoothing sums
+    float32_t                   xt[NR_FFT_L_2 / 2]; // MMSE noise power estimate
+    float32_t                   pslp[NR_FFT_L_2 / 2]; // smoothed speech presence probability
     float32_t                   Hk_old[NR_FFT_L_2 / 2];
-//  float32_t                   VAD;
-//  float32_t                   VAD_Esch; // holds the VAD sum for the Esh & Vary 2009 type of VAD
-//  float32_t                   notch1_f;
-//  bool                        notch1_enable;
-//  float32_t                   notch2_f;
-//  bool                        notch2_enable;
-    //ulong                     long_tone_counter;
+    uint32_t                    sample_rate; // sample rate the engine state was set up for
+    uint16_t                    fft_l; // FFT length the engine state was set up for
     uint16_t current_buffer_idx;
     bool was_here;
 
 } NoiseReduction;
 
 
-NoiseReduction __MCHF_SPECIALMEM 	NR; // definition
+NoiseReduction 	NR; // definition, not in the mcHF CCM, the NR runs outside the audio interrupt
 NoiseReduction2 NR2; // definition
 
 __IO int32_t NR_in_head = 0;
@@ -73,8 +69,6 @@ NR_Buffer* NR_out_buffers[NR_BUFFER_FIFO_SIZE];
 	      0.362598137, 0.339436063, 0.316066292, 0.292503125, 0.268760979, 0.244854382, 0.220797963, 0.196606441,
 	      0.172294617, 0.14787737, 0.123369638, 0.098786418, 0.074142753, 0.04945372, 0.024734427, 0.00000000};
 */
-const float32_t SQRT_von_Hann_256[256] = {0,0.01231966,0.024637449,0.036951499,0.049259941,0.061560906,0.073852527,0.086132939,0.098400278,0.110652682,0.122888291,0.135105247,0.147301698,0.159475791,0.171625679,0.183749518,0.195845467,0.207911691,0.219946358,0.231947641,0.24391372,0.255842778,0.267733003,0.279582593,0.291389747,0.303152674,0.314869589,0.326538713,0.338158275,0.349726511,0.361241666,0.372701992,0.384105749,0.395451207,0.406736643,0.417960345,0.429120609,0.440215741,0.451244057,0.462203884,0.473093557,0.483911424,0.494655843,0.505325184,0.515917826,0.526432163,0.536866598,0.547219547,0.557489439,0.567674716,0.577773831,0.587785252,0.597707459,0.607538946,0.617278221,0.626923806,0.636474236,0.645928062,0.65528385,0.664540179,0.673695644,0.682748855,0.691698439,0.700543038,0.709281308,0.717911923,0.726433574,0.734844967,0.743144825,0.75133189,0.759404917,0.767362681,0.775203976,0.78292761,0.790532412,0.798017227,0.805380919,0.812622371,0.819740483,0.826734175,0.833602385,0.840344072,0.846958211,0.853443799,0.859799851,0.866025404,0.872119511,0.878081248,0.88390971,0.889604013,0.895163291,0.900586702,0.905873422,0.911022649,0.916033601,0.920905518,0.92563766,0.930229309,0.934679767,0.938988361,0.943154434,0.947177357,0.951056516,0.954791325,0.958381215,0.961825643,0.965124085,0.968276041,0.971281032,0.974138602,0.976848318,0.979409768,0.981822563,0.984086337,0.986200747,0.988165472,0.989980213,0.991644696,0.993158666,0.994521895,0.995734176,0.996795325,0.99770518,0.998463604,0.999070481,0.99952572,0.99982925,0.999981027,0.999981027,0.99982925,0.99952572,0.999070481,0.998463604,0.99770518,0.996795325,0.995734176,0.994521895,0.993158666,0.991644696,0.989980213,0.988165472,0.986200747,0.984086337,0.981822563,0.979409768,0.976848318,0.974138602,0.971281032,0.968276041,0.965124085,0.961825643,0.958381215,0.954791325,0.951056516,0.947177357,0.943154434,0.938988361,0.934679767,0.930229309,0.92563766,0.920905518,0.916033601,0.911022649,0.905873422,0.900586702,0.895163291,0.889604013,0.88390971,0.878081248,0.872119511,0.866025404,0.859799851,0.853443799,0.846958211,0.840344072,0.833602385,0.826734175,0.819740483,0.812622371,0.805380919,0.798017227,0.790532412,0.78292761,0.775203976,0.767362681,0.759404917,0.75133189,0.743144825,0.734844967,0.726433574,0.717911923,0.709281308,0.700543038,0.691698439,0.682748855,0.673695644,0.664540179,0.65528385,0.645928062,0.636474236,0.626923806,0.617278221,0.607538946,0.597707459,0.587785252,0.577773831,0.567674716,0.557489439,0.547219547,0.536866598,0.526432163,0.515917826,0.505325184,0.494655843,0.483911424,0.473093557,0.462203884,0.451244057,0.440215741,0.429120609,0.417960345,0.406736643,0.395451207,0.384105749,0.372701992,0.361241666,0.349726511,0.338158275,0.326538713,0.314869589,0.303152674,0.291389747,0.279582593,0.267733003,0.255842778,0.24391372,0.231947641,0.219946358,0.207911691,0.195845467,0.183749518,0.171625679,0.159475791,0.147301698,0.135105247,0.122888291,0.110652682,0.098400278,0.086132939,0.073852527,0.061560906,0.049259941,0.036951499,0.024637449,0.01231966,0};
-
 void NR_Init()
 {
     nr_params.alpha = 0.94; // spectral noise reduction
@@ -82,6 +76,8 @@ void NR_Init()
     nr_params.enable = false;
     nr_params.NR_FFT_L = 256;
     nr_params.NR_FFT_LOOP_NO = 1;
+    nr_params.NR_sample_rate = 6000;
+    nr_params.cycles_peak = 0;
 
     nr_params.first_time = 1;
     nr_params.NR_decimation_enable = true;
@@ -368,26 +364,22 @@ static void AudioNr_RunNoiseReduction(float32_t* inputsamples, float32_t* output
     if(is_dsp_nr())
     {
 		profileTimedEventStart(ProfileTP8);
+		const uint32_t cycles_start = profileCycleCount_get();
 
-		/*	// spectral_noise_reduction_2(inputsamples);
-		if (nr_params.mode == 0)
-		  spectral_noise_reduction(inputsamples);
-		else
-		  if (nr_params.mode == 1)
-			spectral_noise_reduction_2(inputsamples);
-		  else
-			  */
-
-		spectral_noise_reduction_3(inputsamples);
+		spectral_noise_reduction_3(inputsamples, outputsamples);
 
+		const uint32_t cycles = profileCycleCount_get() - cycles_start;
 		profileTimedEventStop(ProfileTP8);
-    }
 
-    for (int k=0; k < NR_FFT_SIZE;  k++)
+		if (cycles > nr_params.cycles_peak)
+		{
+		    nr_params.cycles_peak = cycles;
+		}
+    }
+    else
     {
-        outputsamples[k] = inputsamples[k];
+        arm_copy_f32(inputsamples, outputsamples, NR_FFT_SIZE);
     }
-
 }
 
 // debugging switches
@@ -1838,7 +1830,89 @@ float32_t uf_freq = (offset + width/2) / (NR_sample_rate / nr_params.NR_FFT_L);
 }
 #endif
 
-void spectral_noise_reduction_3 (float* in_buffer)
+/**
+ * Sets the spectral NR engine up for a new FFT length and/or sample rate and resets its state
+ * @param fft_l FFT length, power of 2, fft_l / 2 has to divide NR_FFT_SIZE
+ * @param sample_rate sample rate of the NR buffer content
+ */
+static void spectral_noise_reduction_3_setup(const uint16_t fft_l, const uint32_t sample_rate)
+{
+    const uint16_t hop = fft_l / 2;
+
+    NR.fft_l = fft_l;
+    NR.sample_rate = sample_rate;
+    nr_params.NR_FFT_L = fft_l;
+    nr_params.NR_FFT_LOOP_NO = NR_FFT_SIZE / hop;
+
+    arm_rfft_fast_init_f32(&NR.rfft, fft_l);
+
+    // periodic sqrt von Hann, analysis and synthesis window multiplied add up to exactly one at 50% overlap
+    for (int idx = 0; idx < fft_l; idx++)
+    {
+        NR.window[idx] = sinf(PI * idx / fft_l);
+    }
+
+    // the time constants of the noise estimator are given in seconds
+    // so the smoothing factors depend on the frame time tinc
+    const float32_t tinc = (float32_t)hop / sample_rate;
+    NR2.ax = expf(-tinc / 0.071); // noise output smoothing time constant tax = 71ms
+    NR2.ap = expf(-tinc / 0.152); // speech prob smoothing time constant tap = 152ms
+
+    // each NR buffer of NR_FFT_SIZE samples has to be processed before the next one is complete
+    nr_params.cycles_budget = (uint32_t)(((uint64_t)SystemCoreClock * NR_FFT_SIZE) / sample_rate);
+    nr_params.cycles_peak = 0;
+
+    arm_fill_f32(0.0, NR.last_sample_buffer_L, hop);
+    arm_fill_f32(0.0, NR.last_iFFT_result, hop);
+    arm_fill_f32(1.0, NR2.Hk, hop);
+    arm_fill_f32(1.0, NR.Hk_old, hop); // old gain or xu in development mode
+    arm_fill_f32(0.0, NR.Nest, hop);
+    arm_fill_f32(0.5, NR.pslp, hop);
+}
+
+/**
+ * Musical noise "artefact" reduction: averages the gains of the bins [bin_low, bin_high) over NN neighbouring bins.
+ * Near the edges of the passband the averaging window is shifted to stay inside the passband.
+ */
+static void spectral_noise_reduction_3_smooth_gains(const uint16_t bin_low, const uint16_t bin_high, uint16_t NN)
+{
+    const uint16_t bins = bin_high - bin_low;
+    float32_t* const sum = NR.Nest; // running sums of the gains, Nest is not needed once the estimator runs
+
+    if (NN > bins)
+    {
+        NN = bins;
+    }
+
+    sum[0] = 0.0;
+    for (uint16_t idx = 0; idx < bins; idx++)
+    {
+        sum[idx + 1] = sum[idx] + NR2.Hk[bin_low + idx];
+    }
+
+    const float32_t scale = 1.0 / NN;
+    for (int32_t idx = 0; idx < bins; idx++)
+    {
+        int32_t start = idx - NN / 2;
+        if (start < 0)
+        {
+            start = 0;
+        }
+        else if (start > bins - NN)
+        {
+            start = bins - NN;
+        }
+        NR2.Hk[bin_low + idx] = (sum[start + NN] - sum[start]) * scale;
+    }
+}
+
+/**
+ * Spectral noise reduction engine, processes NR_FFT_SIZE samples per call.
+ * Runs from the high priority task (PendSV), see AudioNr_HandleNoiseReduction()
+ * @param in_buffer NR_FFT_SIZE input samples at nr_params.NR_sample_rate
+ * @param out_buffer NR_FFT_SIZE processed output samples, may be identical to in_buffer
+ */
+static void spectral_noise_reduction_3(const float32_t* in_buffer, float32_t* out_buffer)
 {
     ////////////////////////////////////////////////////////////////////////////////////////
 
@@ -1850,242 +1924,139 @@ void spectral_noise_reduction_3 (float* in_buffer)
     // https://github.com/df8oe/UHSDR/wiki/Noise-reduction
     //
     // half-overlapping input buffers (= overlap 50%)
-    // Hann window on 128 or 256 samples
-    // FFT128 - inverse FFT128 or FFT256 / iFFT256
+    // sqrt von Hann window on 128 or 256 samples for analysis and synthesis
+    // real FFT128 - inverse FFT128 or FFT256 / iFFT256
     // overlap-add
 
     const float32_t width = FilterInfo[ts.filters_p->id].width;
     const float32_t offset = ts.filters_p->offset;
 
-    float32_t NR_sample_rate = nr_params.NR_decimation_active? 6000.0: 12000.0;
+    const uint16_t fft_l = nr_params.fft_256_enable ? 256 : 128;
+    const uint32_t NR_sample_rate = nr_params.NR_sample_rate;
+    const uint16_t hop = fft_l / 2;
 
     static uint8_t NR_init_counter = 0;
-    uint8_t VAD_low=0;
-    uint8_t VAD_high=63;
-
-    float32_t lf_freq = (offset - width/2) / (NR_sample_rate / nr_params.NR_FFT_L); // bin BW is 93.75Hz [12000Hz / 128 bins]
-    float32_t uf_freq = (offset + width/2) / (NR_sample_rate / nr_params.NR_FFT_L);
 
-    //const float32_t tinc = 0.00533333; // frame time 5.3333ms
-    //const float32_t tax=0.071;	// noise output smoothing time constant - absolut value in seconds
-    //const float32_t tap=0.152;	// speech prob smoothing time constant  - absolut value in seconds
     const float32_t psthr=0.99;	// threshold for smoothed speech probability [0.99]
     const float32_t pnsaf=0.01;	// noise probability safety value [0.01]
-    //const float32_t asnr=15; 	// active SNR in dB
     const float32_t psini=0.5;	// initial speech probability [0.5]
     const float32_t pspri=0.5;	// prior speech probability [0.5]
 
-    // for 12ksps and FFT128
-    //NR2.ax = 0.9276; 		//expf(-tinc / tax);
-    //NR2.ap = 0.9655; 		//expf(-tinc / tap);
+    if (fft_l != NR.fft_l || NR_sample_rate != NR.sample_rate)
+    {
+        nr_params.first_time = 1;
+    }
+
+    if(nr_params.first_time == 1)
+    {
+        spectral_noise_reduction_3_setup(fft_l, NR_sample_rate);
+        NR_init_counter = 0;
+        nr_params.first_time = 2; // we need to do some more a bit later down
+    }
 
-    // for 6ksps and FFT256
-    NR2.ax = 0.7405;
-    NR2.ap = 0.8691;
-    //NR2.xih1 = 31.62; 		//powf(10, (float32_t)NR2.asnr / 10.0);
     NR2.xih1 = pow10f((float32_t)NR2.asnr / 10.0);
     NR2.xih1r = 1.0 / (1.0 + NR2.xih1) - 1.0;
     NR2.pfac= (1.0 / pspri - 1.0) * (1.0 + NR2.xih1);
     NR2.snr_prio_min = 0.001; 			//powf(10, - (float32_t)NR2.snr_prio_min_int / 10.0);  //range should be down to -30dB min
     NR2.power_threshold = (float32_t)(NR2.power_threshold_int)/100.0;
-    static float32_t pslp[NR_FFT_SIZE];
-    static float32_t xt[NR_FFT_SIZE];
-    float32_t xtr;
-    float32_t ph1y[NR_FFT_SIZE];
-
-    //ax and ap adjustment according to FFT-size and decimation
-    // for 12KS and 128'er FFT we are doing well with the above values
-    // This table shows the tinc values in ms for the calculation of the coefficients ax and ap
-    //
-    // 	   FFT Size:  |	128		256
-    //    		______|________________________
-    // Samplerate:  12KS  | 5.333		10.666
-    //		      |
-    //		 6KS  |10.666		21.333
 
+    // only the bins inside the filter passband are processed
+    // if you do this for all the bins, you will get distorted audio: plopping !
+    const float32_t bin_bw = (float32_t)NR_sample_rate / fft_l; // e.g. 46.875Hz [12000Hz / 256 bins]
+    int32_t VAD_low = (offset - width/2) / bin_bw;
+    int32_t VAD_high = (offset + width/2) / bin_bw;
 
-    /*if (nr_params.fft_256_enable && nr_params.NR_decimation_enable)
-  {
-    NR2.ax = 0.7405;
-    NR2.ap = 0.8691;
-  }
-else
-  if (nr_params.fft_256_enable || nr_params.NR_decimation_enable)
+    if(VAD_low < 1)
     {
-      NR2.ax = 0.8605;
-      NR2.ap = 0.9322;
-    } */
-
-
-    if(nr_params.first_time == 1)
-    { // TODO: properly initialize all the variables
-
-        for(int bindx = 0; bindx < nr_params.NR_FFT_L / 2; bindx++)
-        {
-            NR.last_sample_buffer_L[bindx] = 0.0;
-            NR2.Hk[bindx] = 1.0;
-            //xu[bindx] = 1.0;  //has to be replaced by other variable
-            NR.Hk_old[bindx] = 1.0; // old gain or xu in development mode
-            NR.Nest[bindx][0] = 0.0;
-            NR.Nest[bindx][1] = 1.0;
-            pslp[bindx] = 0.5;
-            //              NR2.long_tone_gain[bindx] = 1.0;
-        }
-        nr_params.first_time = 2; // we need to do some more a bit later down
+        VAD_low = 1;
+    }
+    else if(VAD_low > hop - 2)
+    {
+        VAD_low = hop - 2;
+    }
+    if(VAD_high <= VAD_low)
+    {
+        VAD_high = VAD_low + 1;
+    }
+    else if(VAD_high > hop)
+    {
+        VAD_high = hop;
     }
 
     for(int k = 0; k < nr_params.NR_FFT_LOOP_NO; k++)
     {
-        // NR_FFT_buffer is 256 floats big
-        // interleaved r, i, r, i . . .
-        // fill first half of FFT_buffer with last events audio samples
-        for(int i = 0; i < nr_params.NR_FFT_L / 2; i++)
-        {
-            NR.FFT_buffer[i * 2] = NR.last_sample_buffer_L[i]; // real
-            NR.FFT_buffer[i * 2 + 1] = 0.0; // imaginary
-        }
-        // copy recent samples to last_sample_buffer for next time!
-        for(int i = 0; i < nr_params.NR_FFT_L  / 2; i++)
-        {
-            NR.last_sample_buffer_L [i] = in_buffer[i + k * (nr_params.NR_FFT_L / 2)];
-        }
-        // now fill recent audio samples into second half of FFT_buffer
-        for(int i = 0; i < nr_params.NR_FFT_L / 2; i++)
-        {
-            NR.FFT_buffer[nr_params.NR_FFT_L + i * 2] = in_buffer[i+ k * (nr_params.NR_FFT_L / 2)]; // real
-            NR.FFT_buffer[nr_params.NR_FFT_L + i * 2 + 1] = 0.0;
-        }
-        /////////////////////////////////7
-        // WINDOWING
-
-        //          if(nr_params.fft_256_enable)
-        {
-            for (int idx = 0; idx < nr_params.NR_FFT_L; idx++)
-            {
-                NR.FFT_buffer[idx * 2] *= SQRT_von_Hann_256[idx];
-            }
-            arm_cfft_f32(&arm_cfft_sR_f32_len256, NR.FFT_buffer, 0, 1);
-        }
-        /*else
-          {
-              for (int idx = 0; idx < nr_params.NR_FFT_L; idx++)
-              {
-            	  NR.FFT_buffer[idx * 2] *= SQRT_van_hann[idx];
-              }
-              arm_cfft_f32(&arm_cfft_sR_f32_len128, NR.FFT_buffer, 0, 1);
-          }*/
-
-        // NR_FFT
-        // calculation is performed in-place the FFT_buffer [re, im, re, im, re, im . . .]
+        const float32_t* in = &in_buffer[k * hop];
+        float32_t* out = &out_buffer[k * hop];
 
+        // ANALYSIS: window last and recent audio samples straight into the FFT frame
+        arm_mult_f32(NR.last_sample_buffer_L, NR.window, NR.FFT_buffer, hop);
+        arm_mult_f32((float32_t*)in, &NR.window[hop], &NR.FFT_buffer[hop], hop);
+        // copy recent samples to last_sample_buffer for next time!
+        arm_copy_f32((float32_t*)in, NR.last_sample_buffer_L, hop);
 
+        arm_rfft_fast_f32(&NR.rfft, NR.FFT_buffer, NR.FFT_spectrum, 0);
 
-        for(int bindx = 0; bindx < nr_params.NR_FFT_L / 2; bindx++)
-        {
-            //here we need squared magnitude
-            NR2.X[bindx][0] = (NR.FFT_buffer[bindx * 2] * NR.FFT_buffer[bindx * 2] + NR.FFT_buffer[bindx * 2 + 1] * NR.FFT_buffer[bindx * 2 + 1]);
-        }
+        // here we need squared magnitude, the packed FFT carries the real Nyquist bin in the imaginary part of bin 0
+        arm_cmplx_mag_squared_f32(NR.FFT_spectrum, NR2.X, hop);
+        NR2.X[0] = NR.FFT_spectrum[0] * NR.FFT_spectrum[0];
 
         if(nr_params.first_time == 2)
         {
-            for(int bindx = 0; bindx < nr_params.NR_FFT_L / 2; bindx++)
-            {
-                NR.Nest[bindx][0] = NR.Nest[bindx][0] + 0.05* NR2.X[bindx][0];// we do it 20 times to average over 20 frames for app. 100ms only on NR_on/bandswitch/modeswitch,...
-                xt[bindx] = psini * NR.Nest[bindx][0];
-            }
+            // we do it 20 times to average over 20 frames only on NR_on/bandswitch/modeswitch,...
+            arm_scale_f32(NR2.X, 0.05, NR.xt, hop);
+            arm_add_f32(NR.Nest, NR.xt, NR.Nest, hop);
+            arm_scale_f32(NR.Nest, psini, NR.xt, hop);
+
             NR_init_counter++;
-            if (NR_init_counter > 19)//average over 20 frames for app. 100ms
+            if (NR_init_counter > 19)//average over 20 frames
             {
                 NR_init_counter = 0;
                 nr_params.first_time = 3;  // now we did all the necessary initialization to actually start the noise reduction
             }
         }
-        if (nr_params.first_time == 3)
+        else if (nr_params.first_time == 3)
         {
-
             //new noise estimate MMSE based!!!
-
-            for(int bindx = 0; bindx < nr_params.NR_FFT_L / 2; bindx++)// 1. Step of NR - calculate the SNR's
-            {
-                ph1y[bindx] = 1.0 / (1.0 + NR2.pfac * expf(NR2.xih1r * NR2.X[bindx][0]/xt[bindx]));
-                pslp[bindx] = NR2.ap * pslp[bindx] + (1.0 - NR2.ap) * ph1y[bindx];
-                //ph1y[bindx] = fmin(ph1y[bindx], 1.0 - pnsaf * (pslp[bindx] > psthr)); //?????
-
-                if (pslp[bindx] > psthr)
-                {
-                    ph1y[bindx] = 1.0 - pnsaf;
-                }
-                else
-                {
-                    ph1y[bindx] = fmin(ph1y[bindx] , 1.0);
-                }
-                xtr = (1.0 - ph1y[bindx]) * NR2.X[bindx][0] + ph1y[bindx] * xt[bindx];
-                xt[bindx] = NR2.ax * xt[bindx] + (1.0 - NR2.ax) * xtr;
-            }
-
-
-            for(int bindx = 0; bindx < nr_params.NR_FFT_L / 2; bindx++)// 1. Step of NR - calculate the SNR's
+            for(int bindx = 0; bindx < hop; bindx++)
             {
-                NR.SNR_post[bindx] = fmax(fmin(NR2.X[bindx][0] / xt[bindx],1000.0), NR2.snr_prio_min); // limited to +30 /-15 dB, might be still too much of reduction, let's try it?
+                const float32_t X = NR2.X[bindx];
+                const float32_t xt = NR.xt[bindx];
 
-                NR.SNR_prio[bindx] = fmax(nr_params.alpha * NR.Hk_old[bindx] + (1.0 - nr_params.alpha) * fmax(NR.SNR_post[bindx] - 1.0, 0.0), 0.0);
-            }
-
-            VAD_low = (int)lf_freq;
-
-            VAD_high = (int)uf_freq;
+                float32_t ph1y = 1.0 / (1.0 + NR2.pfac * expf(NR2.xih1r * X / xt));
+                NR.pslp[bindx] = NR2.ap * NR.pslp[bindx] + (1.0 - NR2.ap) * ph1y;
 
-            if(VAD_low == VAD_high)
-            {
-                VAD_high++;
-            }
-            if(VAD_low < 1)
-            {
-                VAD_low = 1;
-            }
-            else
-                if(VAD_low > nr_params.NR_FFT_L / 2 - 2)
-                {
-                    VAD_low = nr_params.NR_FFT_L / 2 - 2;
-                }
-            if(VAD_high < 1)
-            {
-                VAD_high = 1;
-            }
-            else
-                if(VAD_high > nr_params.NR_FFT_L / 2)
+                if (NR.pslp[bindx] > psthr)
                 {
-                    VAD_high = nr_params.NR_FFT_L / 2;
+                    ph1y = 1.0 - pnsaf;
                 }
 
-
-            // 4    calculate v = SNRprio(n, bin[i]) / (SNRprio(n, bin[i]) + 1) * SNRpost(n, bin[i]) (eq. 12 of Schmitt et al. 2002, eq. 9 of Romanin et al. 2009)
-            //		   and calculate the HK's
-
-            for(int bindx = VAD_low; bindx < VAD_high; bindx++)// maybe we should limit this to the signal containing bins (filtering!!)
-            {
-                float32_t v = NR.SNR_prio[bindx] * NR.SNR_post[bindx] / (1.0 + NR.SNR_prio[bindx]);
-
-                NR2.Hk[bindx] = fmax(1.0 / NR.SNR_post[bindx] * sqrtf((0.7212 * v + v * v)),0.001); //limit HK's to 0.001'
-
-                NR.Hk_old[bindx] = NR.SNR_post[bindx] * NR2.Hk[bindx] * NR2.Hk[bindx]; //
-
-
-                /*if(!(ts.dsp_active & DSP_NR_ENABLE)) // if NR is not enabled (but notch is enabled !)
-			  {
-				  NR2.Hk[bindx] = 1.0;
-			  } */
+                const float32_t xtr = (1.0 - ph1y) * X + ph1y * xt;
+                NR.xt[bindx] = NR2.ax * xt + (1.0 - NR2.ax) * xtr;
             }
-            // musical noise "artefact" reduction by dynamic averaging - depending on SNR ratio
+
+            // calculate the SNR's and the gains, v = SNRprio(n, bin[i]) / (SNRprio(n, bin[i]) + 1) * SNRpost(n, bin[i])
+            // (eq. 12 of Schmitt et al. 2002, eq. 9 of Romanin et al. 2009)
+            // and sum up the powers before and after the gains for the musical noise reduction
             NR2.pre_power = 0.0;
             NR2.post_power = 0.0;
+
             for(int bindx = VAD_low; bindx < VAD_high; bindx++)
             {
-                NR2.pre_power += NR2.X[bindx][0];
-                NR2.post_power += NR2.Hk[bindx] * NR2.Hk[bindx]  * NR2.X[bindx][0];
+                const float32_t X = NR2.X[bindx];
+                const float32_t SNR_post = fmaxf(fminf(X / NR.xt[bindx], 1000.0), NR2.snr_prio_min); // limited to +30 /-15 dB
+                const float32_t SNR_prio = fmaxf(nr_params.alpha * NR.Hk_old[bindx] + (1.0 - nr_params.alpha) * fmaxf(SNR_post - 1.0, 0.0), 0.0);
+                const float32_t v = SNR_prio * SNR_post / (1.0 + SNR_prio);
+                const float32_t Hk = fmaxf(sqrtf(0.7212 * v + v * v) / SNR_post, 0.001); //limit HK's to 0.001'
+
+                NR2.Hk[bindx] = Hk;
+                NR.Hk_old[bindx] = SNR_post * Hk * Hk;
+
+                NR2.pre_power += X;
+                NR2.post_power += Hk * Hk * X;
             }
 
-            NR2.power_ratio = NR2.post_power / NR2.pre_power;
+            // musical noise "artefact" reduction by dynamic averaging - depending on SNR ratio
+            NR2.power_ratio = NR2.pre_power > 0.0 ? NR2.post_power / NR2.pre_power : 1.0;
             if (NR2.power_ratio > NR2.power_threshold)
             {
                 NR2.power_ratio = 1.0;
@@ -2096,102 +2067,24 @@ else
                 NR2.NN = 1 + 2 * (int)(0.5 + NR2.width * (1.0 - NR2.power_ratio / NR2.power_threshold));
             }
 
-            for(int bindx = VAD_low + NR2.NN/2; bindx < VAD_high - NR2.NN/2; bindx++)
-            {
-                NR.Nest[bindx][0] = 0.0;
-                for(int m = bindx - NR2.NN/2; m <= bindx + NR2.NN/2;m++)
-                {
-                    NR.Nest[bindx][0] += NR2.Hk[m];
-                }
-                NR.Nest[bindx][0] /= (float32_t)NR2.NN;
-            }
-
-            // and now the edges - only going NN steps forward and taking the average
-            // lower edge
-            for(int bindx = VAD_low; bindx < VAD_low + NR2.NN/2; bindx++)
-            {
-                NR.Nest[bindx][0] = 0.0;
-                for(int m = bindx; m < (bindx + NR2.NN);m++)
-                {
-                    NR.Nest[bindx][0] += NR2.Hk[m];
-                }
-                NR.Nest[bindx][0] /= (float32_t)NR2.NN;
-            }
-
-            // upper edge - only going NN steps backward and taking the average
-            for(int bindx = VAD_high - NR2.NN; bindx < VAD_high; bindx++)
-            {
-                NR.Nest[bindx][0] = 0.0;
-                for(int m = bindx; m > (bindx - NR2.NN); m--)
-                {
-                    NR.Nest[bindx][0] += NR2.Hk[m];
-                }
-                NR.Nest[bindx][0] /= (float32_t)NR2.NN;
-            }
-
-            // end of edge treatment
-
-            for(int bindx = VAD_low + NR2.NN/2; bindx < VAD_high - NR2.NN/2; bindx++)
+            if (NR2.NN > 1)
             {
-                NR2.Hk[bindx] = NR.Nest[bindx][0];
+                spectral_noise_reduction_3_smooth_gains(VAD_low, VAD_high, NR2.NN);
             }
-            // end of musical noise reduction
-        }	//end of "if nr_params.first_time == 3"
-
 
-        // FINAL SPECTRAL WEIGHTING: Multiply current FFT results with NR_FFT_buffer for 64 bins with the 64 bin-specific gain factors
-        // only do this for the bins inside the filter passband
-        // if you do this for all the bins, you will get distorted audio: plopping !
-        //              for(int bindx = 0; bindx < nr_params.NR_FFT_L / 2; bindx++) // plopping !!!!
-        for(int bindx = VAD_low; bindx < VAD_high; bindx++) // no plopping
-        {
-            NR.FFT_buffer[bindx * 2] = 						NR.FFT_buffer [bindx * 2] * NR2.Hk[bindx]; // real part
-            NR.FFT_buffer[bindx * 2 + 1] = 					NR.FFT_buffer [bindx * 2 + 1] * NR2.Hk[bindx]; // imag part
-            NR.FFT_buffer[nr_params.NR_FFT_L * 2 - bindx * 2 - 2] = 	NR.FFT_buffer[nr_params.NR_FFT_L * 2 - bindx * 2 - 2] * NR2.Hk[bindx]; // real part conjugate symmetric
-            NR.FFT_buffer[nr_params.NR_FFT_L * 2 - bindx * 2 - 1] = 	NR.FFT_buffer[nr_params.NR_FFT_L * 2 - bindx * 2 - 1] * NR2.Hk[bindx]; // imag part conjugate symmetric
-            //                  NR.FFT_buffer[bindx * 2] = NR.FFT_buffer [bindx * 2] * NR2.Hk[bindx] * NR2.long_tone_gain[bindx]; // real part
-            //                  NR.FFT_buffer[bindx * 2 + 1] = NR.FFT_buffer [bindx * 2 + 1] * NR2.Hk[bindx] * NR2.long_tone_gain[bindx]; // imag part
-            //                  NR.FFT_buffer[nr_params.NR_FFT_L * 2 - bindx * 2 - 2] = NR.FFT_buffer[nr_params.NR_FFT_L * 2 - bindx * 2 - 2] * NR2.Hk[bindx] * NR2.long_tone_gain[bindx]; // real part conjugate symmetric
-            //                  NR.FFT_buffer[nr_params.NR_FFT_L * 2 - bindx * 2 - 1] = NR.FFT_buffer[nr_params.NR_FFT_L * 2 - bindx * 2 - 1] * NR2.Hk[bindx] * NR2.long_tone_gain[bindx]; // imag part conjugate symmetric
+            // FINAL SPECTRAL WEIGHTING: multiply the passband bins with their gain factors
+            // the real FFT only holds the positive frequencies, so there is no conjugate symmetric half to take care of
+            arm_cmplx_mult_real_f32(&NR.FFT_spectrum[VAD_low * 2], &NR2.Hk[VAD_low], &NR.FFT_spectrum[VAD_low * 2], VAD_high - VAD_low);
         }
 
-        /*****************************************************************
-         * NOISE REDUCTION CODE ENDS HERE
-         *****************************************************************/
-        // NR_iFFT
-        // & Window on exit!
-        //      if(nr_params.fft_256_enable)
-        {
-            arm_cfft_f32(&arm_cfft_sR_f32_len256, NR.FFT_buffer, 1, 1);
-            for (int idx = 0; idx < nr_params.NR_FFT_L; idx++)
-            {
-                NR.FFT_buffer[idx * 2] *= SQRT_von_Hann_256[idx];
-            }
-        }
-        /*else
-      {
-          arm_cfft_f32(&arm_cfft_sR_f32_len128, NR.FFT_buffer, 1, 1);
-          for (int idx = 0; idx < nr_params.NR_FFT_L; idx++)
-          {
-        	  NR.FFT_buffer[idx * 2] *= SQRT_van_hann[idx];
-          }
-      }*/
+        // SYNTHESIS: inverse FFT & window on exit!
+        arm_rfft_fast_f32(&NR.rfft, NR.FFT_spectrum, NR.FFT_buffer, 1);
+        arm_mult_f32(NR.FFT_buffer, NR.window, NR.FFT_buffer, fft_l);
 
-        // do the overlap & add
-        for(int i = 0; i < nr_params.NR_FFT_L / 2; i++)
-        { // take real part of first half of current iFFT result and add to 2nd half of last iFFT_result
-            //              NR_output_audio_buffer[i + k * (nr_params.NR_FFT_L / 2)] = NR_FFT_buffer[i * 2] + NR_last_iFFT_result[i];
-            in_buffer[i + k * (nr_params.NR_FFT_L / 2)] = NR.FFT_buffer[i * 2] + NR.last_iFFT_result[i];
-        }
-        for(int i = 0; i < nr_params.NR_FFT_L / 2; i++)
-        {
-            NR.last_iFFT_result[i] = NR.FFT_buffer[nr_params.NR_FFT_L + i * 2];
-        }
-        // end of "for" loop which repeats the FFT_iFFT_chain two times !!!
+        // do the overlap & add, first half goes out together with the saved second half of the last frame
+        arm_add_f32(NR.FFT_buffer, NR.last_iFFT_result, out, hop);
+        arm_copy_f32(&NR.FFT_buffer[hop], NR.last_iFFT_result, hop);
     }
-
-    // IIR biquad notch filter with four independent notches
-    //  arm_biquad_cascade_df1_f32 (&NR_notch_biquad, in_buffer, in_buffer, nr_params.NR_FFT_L);
 }
 
 //alt noise blanking is trying to localize some impulse noise within the samples and after that
@@ -39,7 +39,7 @@
 typedef struct NoiseReduction2 // declaration
 {
     float32_t                   Hk[NR_FFT_L_2 / 2]; // gain factors
-	float32_t 					X[NR_FFT_L_2 / 2][2]; // magnitudes of the current and the last FFT bins
+	float32_t 					X[NR_FFT_L_2 / 2]; // squared magnitudes of the current FFT bins
 	//float32_t 					X[NR_FFT_L/2]; // magnitudes of the current and the last FFT bins
 //	float32_t 					long_tone_gain[NR_FFT_L_2 / 2];
 //	float32_t 					long_tone[NR_FFT_L_2 / 2][2];
@@ -103,8 +103,12 @@ typedef struct
 
     uint16_t NR_FFT_L; // resulting FFT length: 128 or 256
     uint8_t NR_FFT_LOOP_NO;
-    bool NR_decimation_enable; // set to true, if we want to use another decimation step for the spectral NR leading to 6ksps sample rate
-    bool NR_decimation_active; // set to true if the current buffer content is "double decimated" down to 6khz, set by the buffer producer
+    bool NR_decimation_enable; // set to true, if we want to use another decimation step for the spectral NR, halving the sample rate
+    bool NR_decimation_active; // set to true if the current buffer content is "double decimated", set by the buffer producer
+    uint32_t NR_sample_rate; // sample rate of the current buffer content (6, 12 or 24ksps), set by the buffer producer
+
+    uint32_t cycles_budget; // cpu cycles available for processing one buffer of NR_FFT_SIZE samples
+    uint32_t cycles_peak; // longest measured processing time of one buffer in cpu cycles, shown and reset by the debug info display
 
 } audio_nr_params_t;
 
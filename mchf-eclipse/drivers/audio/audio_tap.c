@@ -0,0 +1,238 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     audio_tap.c                                                     **
+ **  Description:   distributes the decimated rx audio stream to decoders           **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * The audio tap bus hands the decimated and filtered rx audio to all registered
+ * consumers (digital mode decoders, tune helpers, ...).
+ *
+ * Consumers which are cheap are called directly from the audio interrupt and get
+ * a pointer to the audio buffer, no data is copied for them.
+ *
+ * Consumers registered as deferred are executed from the high priority task
+ * (PendSV) instead. For these the audio is copied exactly once per block into a
+ * shared history buffer, each deferred consumer keeps its own read position in it.
+ * If a deferred consumer falls behind more than the history holds, the oldest data is
+ * dropped and an overrun is counted for that consumer, see the debug info display.
+ */
+
+#include "uhsdr_board.h"
+#include "audio_tap.h"
+
+#define AUDIO_TAP_RING_MASK     (AUDIO_TAP_RING_SIZE - 1)
+// samples kept free between writer and slowest reader, covers the block the
+// audio interrupt may write while a deferred consumer is executing
+#define AUDIO_TAP_RING_MARGIN   32
+
+#if (AUDIO_TAP_RING_SIZE & AUDIO_TAP_RING_MASK) != 0
+#error AUDIO_TAP_RING_SIZE must be a power of 2
+#endif
+
+typedef struct
+{
+    const AudioTap_Consumer_t* consumer;
+    uint32_t rd_idx;        // free running index of next sample to read, deferred consumers only
+    uint32_t generation;    // stream generation the rd_idx belongs to
+    uint32_t overruns;
+} AudioTap_Subscriber_t;
+
+typedef struct
+{
+    AudioTap_Subscriber_t subscriber[AUDIO_TAP_CONSUMERS_MAX];
+    uint8_t count;
+
+    float32_t ring[AUDIO_TAP_RING_SIZE];
+    volatile uint32_t wr_idx;           // free running index of next sample to write
+    volatile uint32_t sample_rate;      // sample rate of the data in the ring
+    volatile uint32_t generation;       // incremented whenever the sample rate changes
+    volatile uint32_t generation_start; // wr_idx at the time of the last sample rate change
+} AudioTap_State_t;
+
+static AudioTap_State_t audio_tap;
+
+static inline bool AudioTap_IsFed(const AudioTap_Consumer_t* const consumer, const uint32_t sampleRate)
+{
+    return (consumer->sample_rate == 0 || consumer->sample_rate == sampleRate)
+            && (consumer->is_active == NULL || consumer->is_active());
+}
+
+/**
+ * Removes all consumers from the bus. Must not be called while the audio interrupt is running.
+ */
+void AudioTap_Reset()
+{
+    audio_tap.count = 0;
+    audio_tap.wr_idx = 0;
+    audio_tap.sample_rate = 0;
+    audio_tap.generation = 0;
+    audio_tap.generation_start = 0;
+}
+
+/**
+ * Adds a consumer to the bus. Must not be called while the audio interrupt is running.
+ *
+ * @param consumer descriptor of the consumer, has to be in static storage since only the pointer is kept
+ * @return false if no more consumers can be registered
+ */
+bool AudioTap_Register(const AudioTap_Consumer_t* const consumer)
+{
+    bool retval = false;
+
+    if (audio_tap.count < AUDIO_TAP_CONSUMERS_MAX && consumer != NULL && consumer->process != NULL)
+    {
+        AudioTap_Subscriber_t* sub = &audio_tap.subscriber[audio_tap.count];
+
+        sub->consumer = consumer;
+        sub->rd_idx = audio_tap.wr_idx;
+        sub->generation = audio_tap.generation;
+        sub->overruns = 0;
+
+        audio_tap.count++;
+        retval = true;
+    }
+
+    return retval;
+}
+
+/**
+ * Feeds a block of decimated audio to all consumers. Called from the audio interrupt.
+ *
+ * @param src audio samples, only valid during this call
+ * @param blockSize number of samples in src
+ * @param sampleRate sample rate of src
+ */
+void AudioTap_Publish(const float32_t* const src, const size_t blockSize, const uint32_t sampleRate)
+{
+    bool store = false;
+
+    for (uint8_t idx = 0; idx < audio_tap.count; idx++)
+    {
+        const AudioTap_Consumer_t* const consumer = audio_tap.subscriber[idx].consumer;
+
+        if (AudioTap_IsFed(consumer, sampleRate))
+        {
+            if (consumer->deferred)
+            {
+                store = true;
+            }
+            else
+            {
+                consumer->process(src, blockSize);
+            }
+        }
+    }
+
+    if (store)
+    {
+        uint32_t wr_idx = audio_tap.wr_idx;
+
+        if (sampleRate != audio_tap.sample_rate)
+        {
+            // readers restart at the first sample with the new rate
+            audio_tap.generation_start = wr_idx;
+            audio_tap.sample_rate = sampleRate;
+            audio_tap.generation++;
+        }
+
+        for (size_t idx = 0; idx < blockSize; idx++)
+        {
+            audio_tap.ring[wr_idx & AUDIO_TAP_RING_MASK] = src[idx];
+            wr_idx++;
+        }
+        audio_tap.wr_idx = wr_idx;
+    }
+}
+
+/**
+ * Runs all deferred consumers on the audio collected since the last call.
+ * Called from the high priority task.
+ */
+void AudioTap_ProcessDeferred()
+{
+    const uint32_t wr_idx = audio_tap.wr_idx;
+    const uint32_t generation = audio_tap.generation;
+    const uint32_t sampleRate = audio_tap.sample_rate;
+
+    for (uint8_t idx = 0; idx < audio_tap.count; idx++)
+    {
+        AudioTap_Subscriber_t* sub = &audio_tap.subscriber[idx];
+        const AudioTap_Consumer_t* const consumer = sub->consumer;
+
+        if (consumer->deferred == false)
+        {
+            continue;
+        }
+
+        if (AudioTap_IsFed(consumer, sampleRate) == false)
+        {
+            // when getting active again we start with fresh data
+            sub->rd_idx = wr_idx;
+            sub->generation = generation;
+            continue;
+        }
+
+        if (sub->generation != generation)
+        {
+            sub->rd_idx = audio_tap.generation_start;
+            sub->generation = generation;
+        }
+
+        uint32_t avail = wr_idx - sub->rd_idx;
+
+        if (avail > AUDIO_TAP_RING_SIZE - AUDIO_TAP_RING_MARGIN)
+        {
+            // we are too far behind, drop the oldest half of the history
+            sub->overruns++;
+            avail = AUDIO_TAP_RING_SIZE / 2;
+            sub->rd_idx = wr_idx - avail;
+        }
+
+        while (avail > 0)
+        {
+            const uint32_t pos = sub->rd_idx & AUDIO_TAP_RING_MASK;
+            uint32_t len = (avail < AUDIO_TAP_RING_SIZE - pos) ? avail : AUDIO_TAP_RING_SIZE - pos;
+            if (len > AUDIO_TAP_DEFERRED_CHUNK)
+            {
+                len = AUDIO_TAP_DEFERRED_CHUNK;
+            }
+
+            consumer->process(&audio_tap.ring[pos], len);
+
+            sub->rd_idx += len;
+            avail -= len;
+        }
+    }
+}
+
+/**
+ * Overrun statistics for the debug display
+ *
+ * @param overruns_p returns the number of times the consumer lost audio
+ * @return name of the first deferred consumer which is currently fed, NULL if there is none
+ */
+const char* AudioTap_GetDeferredOverruns(uint32_t* overruns_p)
+{
+    const char* retval = NULL;
+
+    for (uint8_t idx = 0; idx < audio_tap.count && retval == NULL; idx++)
+    {
+        const AudioTap_Subscriber_t* sub = &audio_tap.subscriber[idx];
+
+        if (sub->consumer->deferred && AudioTap_IsFed(sub->consumer, audio_tap.sample_rate))
+        {
+            *overruns_p = sub->overruns;
+            retval = sub->consumer->name;
+        }
+    }
+
+    return retval;
+}
@@ -0,0 +1,46 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     audio_tap.h                                                     **
+ **  Description:   distributes the decimated rx audio stream to decoders           **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#ifndef __AUDIO_TAP_H
+#define __AUDIO_TAP_H
+
+#include "uhsdr_types.h"
+#include "arm_math.h"
+
+// maximum number of consumers which can be registered with the tap bus
+#define AUDIO_TAP_CONSUMERS_MAX     6
+// size of the shared history for deferred consumers in samples, must be a power of 2
+// at 12ksps this holds ~21ms of audio, i.e. 32 audio interrupts worth of data
+#define AUDIO_TAP_RING_SIZE         256
+// deferred consumers get the collected audio in chunks of at most this many samples
+#define AUDIO_TAP_DEFERRED_CHUNK    32
+
+typedef void (*AudioTap_ProcessFunc_t)(const float32_t* const src, const size_t blockSize);
+typedef bool (*AudioTap_ActiveFunc_t)(void);
+
+typedef struct
+{
+    const char* name;                   // shown with the overrun count in the debug display, at most 4 characters
+    AudioTap_ProcessFunc_t process;     // gets called with the audio samples
+    AudioTap_ActiveFunc_t is_active;    // consumer is only fed if this returns true, NULL means always
+    uint32_t sample_rate;               // required stream sample rate, 0 accepts any rate
+    bool deferred;                      // if true, process() is called from the high priority task instead of the audio interrupt
+} AudioTap_Consumer_t;
+
+bool AudioTap_Register(const AudioTap_Consumer_t* const consumer);
+void AudioTap_Reset(void);
+void AudioTap_Publish(const float32_t* const src, const size_t blockSize, const uint32_t sampleRate);
+void AudioTap_ProcessDeferred(void);
+const char* AudioTap_GetDeferredOverruns(uint32_t* overruns_p);
+
+#endif
@@ -92,6 +92,7 @@ static void MchfHw_Codec_HandleBlock(uint16_t which)
 
     AudioSample_t *audio;
     IqSample_t    *iq;
+    IqSample_t    *iqLoopback = NULL;
 
     if (ts.txrx_mode != TRX_MODE_TX)
     {
@@ -102,12 +103,16 @@ static void MchfHw_Codec_HandleBlock(uint16_t which)
     {
         audio = &dma.audio_buf.in[offset];
         iq = &dma.iq_buf.out[offset];
+#if CODEC_NUM > 1
+        // the iq codec input keeps running during tx, it is the tx loopback for the predistortion
+        iqLoopback = &dma.iq_buf.in[offset];
+#endif
     }
 
     AudioSample_t *audioDst = &dma.audio_buf.out[offset];
 
     // Handle
-    AudioDriver_I2SCallback(audio, iq, audioDst, sz);
+    AudioDriver_I2SCallback(audio, iq, iqLoopback, audioDst, sz);
 
 #ifdef EXEC_PROFILING
     // Profiling pin (low level)
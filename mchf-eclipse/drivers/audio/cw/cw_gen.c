@@ -32,7 +32,16 @@
 // Open issues
 // - in internal keyer pause between dits and dots is too long
 //   Not changes as issue had not been reported yet
-// - Try interpolation with smoothing table to use less RAM
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+//
+// Keying envelope cache
+//
+// The rise and fall curves are calculated once per sample for the selected
+// shape (Blackman-Harris or raised cosine) and edge time into a cache.
+// The cache is only rebuilt by CwGen_SetSpeed() if shape or edge time changed,
+// the tx path applies an edge with a single vector multiply per block.
 // ----------------------------------------------------------------------------
 
 // Common
@@ -59,10 +68,20 @@
 #define CW_DIT_PROC         0x04
 #define CW_END_PROC         0x10
 
-#define CW_SMOOTH_LEN       2	// with sm_table size of 128 -> 2 => ~5.3ms for edges, ~ 9 steps of 0.66 ms,
-// 1 => 2.7ms , 5 steps of 0.66ms required.
-// 3 => 8ms, 13 steps
-#define CW_SMOOTH_STEPS		9	// 1 step = 0.6ms; 13 for 8ms, 9 for 5.4 ms, for internal keyer
+// longest possible edge in samples
+#define CW_EDGE_LEN_MAX     ((CW_EDGE_TIME_MAX * IQ_SAMPLE_RATE) / 1000)
+
+typedef struct
+{
+    float32_t rise[CW_EDGE_LEN_MAX];
+    float32_t fall[CW_EDGE_LEN_MAX];    // rise backwards, so that it can be applied with a forward vector multiply
+    uint32_t len;                       // edge length in samples
+    int32_t steps;                      // number of audio interrupts (1 step = 0.66ms) the internal keyer reserves for an edge
+    uint8_t shape;                      // shape and time the cache was built for
+    uint8_t time;
+} CwGen_EdgeCache_t;
+
+static CwGen_EdgeCache_t cw_edge = { .shape = CW_EDGE_SHAPE_NUM };
 
 
 typedef struct PaddleState
@@ -82,7 +101,7 @@ typedef struct PaddleState
 	int32_t   break_timer;
 	int32_t   space_timer;
 
-	// Key clicks smoothing table current ptr
+	// Key clicks smoothing, envelope level as position in the rise curve, 0 == off, cw_edge.len == full level
 	uint32_t   sm_tbl_ptr;
 
 	uint32_t   ultim;
@@ -250,150 +269,65 @@ const char cw_sign_onechar[CW_SIGN_CODES] =
 };
 
 
-// Blackman-Harris function to keep CW signal bandwidth narrow
-#define CW_SMOOTH_TBL_SIZE  128
-static const float sm_table[CW_SMOOTH_TBL_SIZE] =
+/**
+ * @brief (re)builds the keying envelope cache for the shape and edge time set in ts.
+ * Blackman-Harris keeps the CW signal bandwidth narrow, see https://en.wikipedia.org/wiki/Window_function
+ * The rising half of a window of length 2 * len - 1 is used as rise curve.
+ */
+static void CwGen_BuildEdgeCache(void)
 {
-		0.0,
-		0.0000686004957883,
-		0.0000945542356652,
-		0.0001383179721175,
-		0.0002006529396865,
-		0.0002826248158738,
-		0.0003856036471126,
-		0.0005112637206964,
-		0.0006615833583608,
-		0.0008388446022225,
-		0.0010456327590236,
-		0.0012848357641460,
-		0.0015596433227128,
-		0.0018735457812732,
-		0.0022303326801620,
-		0.0026340909336119,
-		0.0030892025821568,
-		0.0036003420597745,
-		0.0041724729166402,
-		0.0048108439372987,
-		0.0055209845935232,
-		0.0063086997711494,
-		0.0071800637107376,
-		0.0081414131030473,
-		0.0091993392820062,
-		0.0103606794601087,
-		0.0116325069539978,
-		0.0130221203513468,
-		0.0145370315740592,
-		0.0161849527972270,
-		0.0179737821882093,
-		0.0199115884355984,
-		0.0220065940436903,
-		0.0242671573743564,
-		0.0267017534248783,
-		0.0293189533373318,
-		0.0321274026424438,
-		0.0351357982484650,
-		0.0383528641934459,
-		0.0417873261873527,
-		0.0454478849786327,
-		0.0493431885881256,
-		0.0534818034615354,
-		0.0578721846000008,
-		0.0625226447365667,
-		0.0674413226345205,
-		0.0726361505915551,
-		0.0781148212415210,
-		0.0838847537530600,
-		0.0899530595316440,
-		0.0963265075384118,
-		0.1030114893456630,
-		0.1100139840548870,
-		0.1173395232087210,
-		0.1249931558332360,
-		0.1329794137513460,
-		0.1413022773119520,
-		0.1499651416825930,
-		0.1589707838558700,
-		0.1683213305216760,
-		0.1780182269583640,
-		0.1880622070962730,
-		0.1984532649066170,
-		0.2091906272675180,
-		0.2202727284569900,
-		0.2316971864198910,
-		0.2434607809523230,
-		0.2555594339426260,
-		0.2679881918029900,
-		0.2807412102198870,
-		0.2938117413448940,
-		0.3071921235401840,
-		0.3208737737849510,
-		0.3348471828403530,
-		0.3491019132612700,
-		0.3636266003332790,
-		0.3784089560027740,
-		0.3934357758572420,
-		0.4086929492012480,
-		0.4241654722618500,
-		0.4398374645449960,
-		0.4556921883519000,
-		0.4717120714516800,
-		0.4878787328935640,
-		0.5041730119288920,
-		0.5205749999999980,
-		0.5370640757398780,
-		0.5536189429134430,
-		0.5702176712181650,
-		0.5868377398491150,
-		0.6034560837207990,
-		0.6200491422259460,
-		0.6365929103995070,
-		0.6530629923446170,
-		0.6694346567663080,
-		0.6856828944482830,
-		0.7017824774982180,
-		0.7177080201778180,
-		0.7334340411253520,
-		0.7489350267705930,
-		0.7641854957350820,
-		0.7791600640044710,
-		0.7938335106543350,
-		0.8081808439064380,
-		0.8221773672888840,
-		0.8357987456709900,
-		0.8490210709420900,
-		0.8618209271027980,
-		0.8741754545375520,
-		0.8860624132385800,
-		0.8974602447536510,
-		0.9083481326332570,
-		0.9187060611570670,
-		0.9285148721246550,
-		0.9377563195016140,
-		0.9464131217191720,
-		0.9544690114333140,
-		0.9619087825581750,
-		0.9687183343980040,
-		0.9748847127123550,
-		0.9803961475602210,
-		0.9852420877805500,
-		0.9894132319790110,
-		0.9929015559037870,
-		0.9957003361066840,
-		0.9978041697997700,
-		0.9992089908321180,
-		0.9999120817258750
-};
+	uint8_t time = ts.cw_edge_time;
+	if (time < CW_EDGE_TIME_MIN || time > CW_EDGE_TIME_MAX)
+	{
+		time = CW_EDGE_TIME_DEFAULT;
+	}
+
+	const uint32_t len = (time * IQ_SAMPLE_RATE) / 1000;
+	const float32_t w = 2 * PI / (2 * len - 1);
+
+	for (uint32_t idx = 0; idx < len; idx++)
+	{
+		float32_t val;
+		if (ts.cw_edge_shape == CW_EDGE_SHAPE_RAISED_COSINE)
+		{
+			val = 0.5 - 0.5 * cosf(w * idx);
+		}
+		else
+		{
+			val = 0.35875 - 0.48829 * cosf(w * idx) + 0.14128 * cosf(2 * w * idx) - 0.01168 * cosf(3 * w * idx);
+		}
+		cw_edge.rise[idx] = val;
+		cw_edge.fall[len - 1 - idx] = val;
+	}
+	// start from real silence, Blackman-Harris is not exactly zero at its ends
+	cw_edge.rise[0] = 0.0;
+	cw_edge.fall[len - 1] = 0.0;
+
+	cw_edge.len = len;
+	// one extra step, the signal stays off for one block after the falling edge
+	cw_edge.steps = (len + IQ_BLOCK_SIZE - 1) / IQ_BLOCK_SIZE + 1;
+	cw_edge.shape = ts.cw_edge_shape;
+	cw_edge.time = ts.cw_edge_time;
+}
 
 void CwGen_SetSpeed()
 {
+	if (cw_edge.shape != ts.cw_edge_shape || cw_edge.time != ts.cw_edge_time)
+	{
+		CwGen_BuildEdgeCache();
+	}
+
 	// 1800000 = 1.2s per dit == 1WPM ; 1500 impulse per second audio irq = 1800 ticks per 1 WPM dit
 	// we scale with 100 for better precision and easier use of the weight value which is scaled by 100.
 	// so 1800 * 100 = 180000
 
 	// weight 1.00
-	int32_t dit_time         = 180000/ts.cw_keyer_speed + CW_SMOOTH_STEPS*100;  // +9 =  6ms * 1/1500 =  0,006*1500
-	int32_t dah_time         = 3*180000/ts.cw_keyer_speed + CW_SMOOTH_STEPS*100;  // +9 =  6ms * 1/1500 =  0,006*1500
-	int32_t pause_time       = 180000/ts.cw_keyer_speed - CW_SMOOTH_STEPS*100;  // -9 = -6ms * 1/1500 = -0,006*1500
+	// the element times are extended by the edge time, the pause is shortened accordingly
+	// e.g. 5ms edge -> 9 steps of 1/1500s
+	int32_t edge_time        = cw_edge.steps*100;
+	int32_t dit_time         = 180000/ts.cw_keyer_speed + edge_time;
+	int32_t dah_time         = 3*180000/ts.cw_keyer_speed + edge_time;
+	int32_t pause_time       = 180000/ts.cw_keyer_speed - edge_time;
 	int32_t space_time       = 6*180000/ts.cw_keyer_speed;
 
 	int32_t weight_corr = ((int32_t)ts.cw_keyer_weight-100) * dit_time/100;
@@ -403,6 +337,12 @@ void CwGen_SetSpeed()
 	ps.dah_time = (dah_time + weight_corr)/100;
 	ps.pause_time = (pause_time - weight_corr)/100;
 	ps.space_time = space_time / 100;
+
+	// long edges at high speed and weight must not eat up the pause completely
+	if (ps.pause_time < 1)
+	{
+		ps.pause_time = 1;
+	}
 }
 
 static uint32_t CwGen_GetBreakTime( )
@@ -445,65 +385,56 @@ void CwGen_Init(void)
 
 /**
  * @brief remove clicks at start of tone
+ * Applies the rise curve from the current envelope position on, samples behind the end of the edge are left as they are.
  */
 static void CwGen_RemoveClickOnRisingEdge( float32_t* i_buffer, float32_t* q_buffer, uint32_t size )
 {
     assert( i_buffer && q_buffer );
-    assert( !( size < CW_SMOOTH_LEN )); // size shouldn't be less
 	// Do not overload
-	if(ps.sm_tbl_ptr < (CW_SMOOTH_TBL_SIZE ))
+	if(ps.sm_tbl_ptr < cw_edge.len)
 	{
-		for(int i = 0, j = 0; i < size; i++)
+		uint32_t count = cw_edge.len - ps.sm_tbl_ptr;
+		if (count > size)
 		{
-			i_buffer[i] = i_buffer[i] * sm_table[ps.sm_tbl_ptr];
-			q_buffer[i] = q_buffer[i] * sm_table[ps.sm_tbl_ptr];
+			count = size;
+		}
 
-			j++;
-			if(j == CW_SMOOTH_LEN)
-			{
-				j = 0;
+		arm_mult_f32(i_buffer, &cw_edge.rise[ps.sm_tbl_ptr], i_buffer, count);
+		arm_mult_f32(q_buffer, &cw_edge.rise[ps.sm_tbl_ptr], q_buffer, count);
 
-				ps.sm_tbl_ptr++;
-				if(ps.sm_tbl_ptr > (CW_SMOOTH_TBL_SIZE - 1))
-				{
-					break;
-					// leave loop and return
-				}
-			}
-		}
+		ps.sm_tbl_ptr += count;
 	}
 }
 
 /**
  * @brief remove clicks at end of tone
+ * Applies the fall curve starting at the current envelope level, samples behind the end of the edge are silenced.
  */
 static void CwGen_RemoveClickOnFallingEdge( float32_t* i_buffer, float32_t* q_buffer, uint32_t size )
 {
     assert( i_buffer && q_buffer );
-    assert( !( size < CW_SMOOTH_LEN )); // size shouldn't be less
 	// Do not overload
-		// Fix ptr, so we start from the last element
-    if(ps.sm_tbl_ptr > (CW_SMOOTH_TBL_SIZE - 1))
+    if(ps.sm_tbl_ptr > cw_edge.len)
     {
-        ps.sm_tbl_ptr = (CW_SMOOTH_TBL_SIZE - 1);
+        ps.sm_tbl_ptr = cw_edge.len;
     }
 
-    for( uint32_t i = 0,j = 0; i < size; i++) // iterate over the I&Q audio buffer elements
+    uint32_t count = ps.sm_tbl_ptr;
+    if (count > size)
     {
-        i_buffer[i] = i_buffer[i] * sm_table[ps.sm_tbl_ptr];
-        q_buffer[i] = q_buffer[i] * sm_table[ps.sm_tbl_ptr];
+        count = size;
+    }
 
-        j++;
-        if(j == CW_SMOOTH_LEN)
-        {
-            j = 0;
+    // if the rising edge was not completed, the falling edge starts at the same level
+    float32_t* fall = &cw_edge.fall[cw_edge.len - ps.sm_tbl_ptr];
+    arm_mult_f32(i_buffer, fall, i_buffer, count);
+    arm_mult_f32(q_buffer, fall, q_buffer, count);
 
-            if(ps.sm_tbl_ptr > 0) // keep value @ ptr=0 to prevent trailing CW spike
-            {
-                ps.sm_tbl_ptr--;
-            }
-        }
-    }
+    // keep silence after the edge to prevent trailing CW spike
+    arm_fill_f32(0.0, &i_buffer[count], size - count);
+    arm_fill_f32(0.0, &q_buffer[count], size - count);
+
+    ps.sm_tbl_ptr -= count;
 }
 
 /**
@@ -700,7 +631,7 @@ static bool CwGen_ProcessStraightKey( float32_t *i_buffer, float32_t *q_buffer,
 		if(ps.key_timer > 2)
 		{
 			CwGen_RemoveClickOnRisingEdge(i_buffer,q_buffer,blockSize);
-			if( ps.sm_tbl_ptr >= CW_SMOOTH_TBL_SIZE ) // end of rising edge when pointer at end of table
+			if( ps.sm_tbl_ptr >= cw_edge.len ) // end of rising edge when pointer at end of table
 			{
 				ps.key_timer = 2;	// at end of rising edge change to constant signal phase
 			}
@@ -968,7 +899,7 @@ static bool CwGen_ProcessIambic( float32_t* i_buffer, float32_t* q_buffer, uint3
 					CwGen_RemoveClickOnRisingEdge(i_buffer,q_buffer,blockSize);
 				}
 				// Smooth end of element
-				if(ps.key_timer < CW_SMOOTH_STEPS)
+				if(ps.key_timer < cw_edge.steps)
 				{
 					CwGen_RemoveClickOnFallingEdge(i_buffer,q_buffer,blockSize);
 				}
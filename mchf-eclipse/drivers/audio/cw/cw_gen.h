@@ -16,6 +16,14 @@
 
 #include "arm_math.h"
 
+// shape of the keying envelope edges
+typedef enum
+{
+    CW_EDGE_SHAPE_BLACKMAN_HARRIS = 0,  // narrowest spectrum
+    CW_EDGE_SHAPE_RAISED_COSINE,        // steeper, a bit wider spectrum at the same edge time
+    CW_EDGE_SHAPE_NUM
+} CwGen_EdgeShape_t;
+
 void    CwGen_Init(void);
 
 void    CwGen_PrepareTx(void);
@@ -25,9 +25,20 @@ typedef struct {
     const int num_taps;
 } IQ_FilterDescriptor;
 
+// zoom fft: decimation by 2^magnify in a CIC followed by a compensating FIR, see fir_zoom_fft_decimate.c
+#define ZOOM_FFT_DECIMATE_NUM 8
+
+typedef struct {
+    uint16_t cic_rate;          // decimation factor of the CIC stages, 1 == no CIC
+    uint16_t fir_rate;          // decimation factor of the compensating FIR
+    uint16_t num_taps;
+    const float32_t* pCoeffs;   // symmetric
+} ZoomFFT_Decimator_t;
+
+extern const ZoomFFT_Decimator_t ZoomFFTDecimate[ZOOM_FFT_DECIMATE_NUM];
+
 extern const arm_fir_decimate_instance_f32 FirRxDecimate;
 extern const arm_fir_decimate_instance_f32 FirRxDecimate_sideband_supp;
-extern const arm_fir_decimate_instance_f32 FirZoomFFTDecimate[6];
 extern const arm_fir_decimate_instance_f32 FirRxDecimateMinLPF;
 extern const arm_fir_interpolate_instance_f32 FirRxInterpolate;
 extern const arm_fir_interpolate_instance_f32 FirRxInterpolate_4_5k;
@@ -103,82 +103,3 @@ const arm_fir_decimate_instance_f32 FirRxDecimate_sideband_supp =
 //        -596.2286796599541960E-6,-927.3655504344595780E-6,-940.6330523057968090E-6,-298.4871913266846950E-6, 0.001186311749146407, 0.003340717388857422, 0.005503534826465819, 0.006586352026602872, 0.005378691189561175, 0.001056745384724361,-0.006253091035763602,-0.015078013363837874,-0.022588392594615103,-0.025094197603292432,-0.018999101368626720,-0.001976514919694041, 0.025998282705991884, 0.062138450304126999, 0.101110564031515582, 0.136092352983227610, 0.160375863194488072, 0.169067382812500000, 0.160375863194488072, 0.136092352983227610, 0.101110564031515582, 0.062138450304126999, 0.025998282705991884,-0.001976514919694041,-0.018999101368626720,-0.025094197603292432,-0.022588392594615103,-0.015078013363837874,-0.006253091035763602, 0.001056745384724361, 0.005378691189561175, 0.006586352026602872, 0.005503534826465819, 0.003340717388857422, 0.001186311749146407,-298.4871913266846950E-6,-940.6330523057968090E-6,-927.3655504344595780E-6,-596.2286796599541960E-6
 //    }
 //};
-
-
-const arm_fir_decimate_instance_f32 FirZoomFFTDecimate[] =
-{
-        {
-                .numTaps = 4,
-                .pCoeffs = (float*) (const float[])
-                {
-                    -0.3105711170561,
-                    -0.2100034101786,
-                    -0.2099936469089,
-                    -0.3105557871709
-                },
-                .pState = NULL // we don't use this directly
-        },
-        // 48ksps, 12kHz lowpass
-        {
-                .numTaps = 4,
-                .pCoeffs = (float*) (const float[])
-                {
-                    475.1179397144384210E-6,
-                    0.503905202786044337,
-                    0.503905202786044337,
-                    475.1179397144384210E-6
-                },
-                .pState = NULL // we don't use this directly
-        },
-        // 48ksps, 6kHz lowpass
-        {
-                .numTaps = 4,
-                .pCoeffs = (float*) (const float[])
-                {
-                    0.198273254218889416,
-                    0.298085149879260325,
-                    0.298085149879260325,
-                    0.198273254218889416
-                },
-                .pState = NULL // we don't use this directly
-        },
-        // 48ksps, 3kHz lowpass
-        {
-                .numTaps = 4,
-                .pCoeffs = (float*) (const float[])
-                {
-                    0.199820836596682871,
-                    0.272777397353925699,
-                    0.272777397353925699,
-                    0.199820836596682871
-                },
-                .pState = NULL // we don't use this directly
-        },
-        // 48ksps, 1.5kHz lowpass
-        {
-                .numTaps = 4,
-                .pCoeffs = (float*) (const float[])
-                {
-                    0.199820836596682871,
-                    0.272777397353925699,
-                    0.272777397353925699,
-                    0.199820836596682871
-                },
-                .pState = NULL // we don't use this directly
-        },
-        // 48ksps, 750Hz lowpass
-        {
-                .numTaps = 4,
-                .pCoeffs = (float*) (const float[])
-                {
-                    0.199820836596682871,
-                    0.272777397353925699,
-                    0.272777397353925699,
-                    0.199820836596682871
-                },
-                .pState = NULL // we don't use this directly
-        }
-};
-
-
-
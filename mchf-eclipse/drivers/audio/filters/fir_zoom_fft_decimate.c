@@ -0,0 +1,173 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     fir_zoom_fft_decimate.c                                         **
+ **  Description:   CIC compensating decimation filters for the zoom fft           **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#include "filters.h"
+
+/**************************************************************
+
+The zoom fft decimates by 2^magnify. Above 2x the bulk of the decimation is done
+by a 4 stage CIC filter, the last factor of 4 (2 for 2x) by one of the FIR filters
+below. Up to 4x there is no CIC stage, the FIR gets the 48ksps IQ data directly.
+
+Each FIR is designed for the CIC in front of it:
+- least squares design, passband follows 1/H_cic up to 0.4 * output sample rate
+- stopband starts at 0.6 * output sample rate, stopband weight 300
+- CIC + FIR: 0.25dB passband ripple, everything which aliases into the
+  inner 80% of the displayed spectrum is attenuated by 60dB or more
+- symmetric, DC gain 1.0
+
+**************************************************************/
+
+static const float32_t ZoomFFT_Comp_x2[31] =
+{
+    8.157678915726e-04, 2.644745137219e-03, 1.226183418335e-03, -5.134623885009e-03,
+    -5.073072944073e-03, 8.360756856280e-03, 1.229008530983e-02, -1.198064468633e-02,
+    -2.487395345400e-02, 1.554824085052e-02, 4.726721934197e-02, -1.856933599782e-02,
+    -9.535505706298e-02, 2.059356376732e-02, 3.136962004856e-01, 4.770878499432e-01,
+    3.136962004856e-01, 2.059356376732e-02, -9.535505706298e-02, -1.856933599782e-02,
+    4.726721934197e-02, 1.554824085052e-02, -2.487395345400e-02, -1.198064468633e-02,
+    1.229008530983e-02, 8.360756856280e-03, -5.073072944073e-03, -5.134623885009e-03,
+    1.226183418335e-03, 2.644745137219e-03, 8.157678915726e-04,
+};
+
+static const float32_t ZoomFFT_Comp_x4[63] =
+{
+    8.301676691252e-05, 3.594546937028e-04, 8.201372110451e-04, 1.270082776355e-03,
+    1.336792009074e-03, 6.627324424429e-04, -7.840336116984e-04, -2.477227771558e-03,
+    -3.412725288859e-03, -2.599919329147e-03, 2.158751537837e-04, 4.037145699465e-03,
+    6.770628009530e-03, 6.216605837086e-03, 1.514667284761e-03, -5.787392091546e-03,
+    -1.190160460416e-02, -1.250863581709e-02, -5.378800354642e-03, 7.512569060673e-03,
+    1.988103990956e-02, 2.369670694892e-02, 1.359913163610e-02, -8.973626109656e-03,
+    -3.441028636744e-02, -4.772573879312e-02, -3.489624970870e-02, 9.952645321853e-03,
+    8.006263952953e-02, 1.568912211272e-01, 2.165000326227e-01, 2.389462316138e-01,
+    2.165000326227e-01, 1.568912211272e-01, 8.006263952953e-02, 9.952645321853e-03,
+    -3.489624970870e-02, -4.772573879312e-02, -3.441028636744e-02, -8.973626109656e-03,
+    1.359913163610e-02, 2.369670694892e-02, 1.988103990956e-02, 7.512569060673e-03,
+    -5.378800354642e-03, -1.250863581709e-02, -1.190160460416e-02, -5.787392091546e-03,
+    1.514667284761e-03, 6.216605837086e-03, 6.770628009530e-03, 4.037145699465e-03,
+    2.158751537837e-04, -2.599919329147e-03, -3.412725288859e-03, -2.477227771558e-03,
+    -7.840336116984e-04, 6.627324424429e-04, 1.336792009074e-03, 1.270082776355e-03,
+    8.201372110451e-04, 3.594546937028e-04, 8.301676691252e-05,
+};
+
+static const float32_t ZoomFFT_Comp_x8[63] =
+{
+    8.831829815112e-05, 3.838129085982e-04, 8.774746954053e-04, 1.361560276429e-03,
+    1.437376632084e-03, 7.203425891862e-04, -8.274868290930e-04, -2.646660754540e-03,
+    -3.663177567084e-03, -2.811564019743e-03, 1.918973245455e-04, 4.291966991514e-03,
+    7.253509586048e-03, 6.712320264250e-03, 1.720868946392e-03, -6.098395466462e-03,
+    -1.271352005973e-02, -1.349048366128e-02, -5.987937399835e-03, 7.766266733086e-03,
+    2.112508858488e-02, 2.551227391214e-02, 1.510201447504e-02, -8.771916020868e-03,
+    -3.610193208560e-02, -5.111076185687e-02, -3.891923645538e-02, 6.849443643933e-03,
+    7.929347416450e-02, 1.590758976498e-01, 2.211234852429e-01, 2.445113585153e-01,
+    2.211234852429e-01, 1.590758976498e-01, 7.929347416450e-02, 6.849443643933e-03,
+    -3.891923645538e-02, -5.111076185687e-02, -3.610193208560e-02, -8.771916020868e-03,
+    1.510201447504e-02, 2.551227391214e-02, 2.112508858488e-02, 7.766266733086e-03,
+    -5.987937399835e-03, -1.349048366128e-02, -1.271352005973e-02, -6.098395466462e-03,
+    1.720868946392e-03, 6.712320264250e-03, 7.253509586048e-03, 4.291966991514e-03,
+    1.918973245455e-04, -2.811564019743e-03, -3.663177567084e-03, -2.646660754540e-03,
+    -8.274868290930e-04, 7.203425891862e-04, 1.437376632084e-03, 1.361560276429e-03,
+    8.774746954053e-04, 3.838129085982e-04, 8.831829815112e-05,
+};
+
+static const float32_t ZoomFFT_Comp_x16[63] =
+{
+    8.968702278391e-05, 3.901165757016e-04, 8.923304287145e-04, 1.385286968766e-03,
+    1.463505746125e-03, 7.353793451854e-04, -8.386281784673e-04, -2.690506467743e-03,
+    -3.728157784331e-03, -2.866668111946e-03, 1.852993831634e-04, 4.357663840940e-03,
+    7.378596292760e-03, 6.841215634322e-03, 1.775211677966e-03, -6.177926899968e-03,
+    -1.292328669229e-02, -1.374534133046e-02, -6.147578842276e-03, 7.829191914607e-03,
+    2.144475009190e-02, 2.598182422867e-02, 1.549399061686e-02, -8.712792113989e-03,
+    -3.652967681567e-02, -5.197574417534e-02, -3.995134131052e-02, 6.050321723120e-03,
+    7.909131957477e-02, 1.596309023204e-01, 2.223041846890e-01, 2.459337412944e-01,
+    2.223041846890e-01, 1.596309023204e-01, 7.909131957477e-02, 6.050321723120e-03,
+    -3.995134131052e-02, -5.197574417534e-02, -3.652967681567e-02, -8.712792113989e-03,
+    1.549399061686e-02, 2.598182422867e-02, 2.144475009190e-02, 7.829191914607e-03,
+    -6.147578842276e-03, -1.374534133046e-02, -1.292328669229e-02, -6.177926899968e-03,
+    1.775211677966e-03, 6.841215634322e-03, 7.378596292760e-03, 4.357663840940e-03,
+    1.852993831634e-04, -2.866668111946e-03, -3.728157784331e-03, -2.690506467743e-03,
+    -8.386281784673e-04, 7.353793451854e-04, 1.463505746125e-03, 1.385286968766e-03,
+    8.923304287145e-04, 3.901165757016e-04, 8.968702278391e-05,
+};
+
+static const float32_t ZoomFFT_Comp_x32[63] =
+{
+    9.003196330665e-05, 3.917061486629e-04, 8.960776404818e-04, 1.391273400551e-03,
+    1.470100864205e-03, 7.391791759335e-04, -8.414310872371e-04, -2.701562743103e-03,
+    -3.744554025673e-03, -2.880584453908e-03, 1.836108379698e-04, 4.374214650607e-03,
+    7.410146484539e-03, 6.873756937651e-03, 1.788976710203e-03, -6.197921909633e-03,
+    -1.297616037400e-02, -1.380965530698e-02, -6.187960314844e-03, 7.844888154780e-03,
+    2.152521346591e-02, 2.610020777407e-02, 1.559302097340e-02, -8.697453831982e-03,
+    -3.663691569197e-02, -5.219317690981e-02, -4.021104183877e-02, 5.849057981086e-03,
+    7.904015181915e-02, 1.597702124142e-01, 2.226009354964e-01, 2.462913111896e-01,
+    2.226009354964e-01, 1.597702124142e-01, 7.904015181915e-02, 5.849057981086e-03,
+    -4.021104183877e-02, -5.219317690981e-02, -3.663691569197e-02, -8.697453831982e-03,
+    1.559302097340e-02, 2.610020777407e-02, 2.152521346591e-02, 7.844888154780e-03,
+    -6.187960314844e-03, -1.380965530698e-02, -1.297616037400e-02, -6.197921909633e-03,
+    1.788976710203e-03, 6.873756937651e-03, 7.410146484539e-03, 4.374214650607e-03,
+    1.836108379698e-04, -2.880584453908e-03, -3.744554025673e-03, -2.701562743103e-03,
+    -8.414310872371e-04, 7.391791759335e-04, 1.470100864205e-03, 1.391273400551e-03,
+    8.960776404818e-04, 3.917061486629e-04, 9.003196330665e-05,
+};
+
+static const float32_t ZoomFFT_Comp_x64[63] =
+{
+    9.011837169547e-05, 3.921043997520e-04, 8.970165343026e-04, 1.392773449549e-03,
+    1.471753593460e-03, 7.401316896472e-04, -8.421329156668e-04, -2.704332769627e-03,
+    -3.748662586512e-03, -2.884072361035e-03, 1.831862390651e-04, 4.378360298905e-03,
+    7.418051528596e-03, 6.881912216264e-03, 1.792429254258e-03, -6.202927684885e-03,
+    -1.298940591890e-02, -1.382577146857e-02, -6.198085306320e-03, 7.848809962440e-03,
+    2.154536367597e-02, 2.612986618164e-02, 1.561784365452e-02, -8.693584211609e-03,
+    -3.666374433845e-02, -5.224760955468e-02, -4.027607204071e-02, 5.798648936134e-03,
+    7.902732036080e-02, 1.598050749761e-01, 2.226752220686e-01, 2.463808275306e-01,
+    2.226752220686e-01, 1.598050749761e-01, 7.902732036080e-02, 5.798648936134e-03,
+    -4.027607204071e-02, -5.224760955468e-02, -3.666374433845e-02, -8.693584211609e-03,
+    1.561784365452e-02, 2.612986618164e-02, 2.154536367597e-02, 7.848809962440e-03,
+    -6.198085306320e-03, -1.382577146857e-02, -1.298940591890e-02, -6.202927684885e-03,
+    1.792429254258e-03, 6.881912216264e-03, 7.418051528596e-03, 4.378360298905e-03,
+    1.831862390651e-04, -2.884072361035e-03, -3.748662586512e-03, -2.704332769627e-03,
+    -8.421329156668e-04, 7.401316896472e-04, 1.471753593460e-03, 1.392773449549e-03,
+    8.970165343026e-04, 3.921043997520e-04, 9.011837169547e-05,
+};
+
+static const float32_t ZoomFFT_Comp_x128[63] =
+{
+    9.013998463385e-05, 3.922040162078e-04, 8.972513886099e-04, 1.393148677156e-03,
+    1.472167022981e-03, 7.403699780766e-04, -8.423084416491e-04, -2.705025649080e-03,
+    -3.749690321308e-03, -2.884944889980e-03, 1.830799350913e-04, 4.379397208123e-03,
+    7.420028884511e-03, 6.883952284714e-03, 1.793293096848e-03, -6.204179567835e-03,
+    -1.299271900233e-02, -1.382980286624e-02, -6.200618408451e-03, 7.849790272618e-03,
+    2.155040337822e-02, 2.613728469539e-02, 1.562405339809e-02, -8.692614612477e-03,
+    -3.667045268318e-02, -5.226122237386e-02, -4.029233616473e-02, 5.786040849203e-03,
+    7.902411002311e-02, 1.598137928081e-01, 2.226937998969e-01, 2.464032143650e-01,
+    2.226937998969e-01, 1.598137928081e-01, 7.902411002311e-02, 5.786040849203e-03,
+    -4.029233616473e-02, -5.226122237386e-02, -3.667045268318e-02, -8.692614612477e-03,
+    1.562405339809e-02, 2.613728469539e-02, 2.155040337822e-02, 7.849790272618e-03,
+    -6.200618408451e-03, -1.382980286624e-02, -1.299271900233e-02, -6.204179567835e-03,
+    1.793293096848e-03, 6.883952284714e-03, 7.420028884511e-03, 4.379397208123e-03,
+    1.830799350913e-04, -2.884944889980e-03, -3.749690321308e-03, -2.705025649080e-03,
+    -8.423084416491e-04, 7.403699780766e-04, 1.472167022981e-03, 1.393148677156e-03,
+    8.972513886099e-04, 3.922040162078e-04, 9.013998463385e-05,
+};
+
+const ZoomFFT_Decimator_t ZoomFFTDecimate[ZOOM_FFT_DECIMATE_NUM] =
+{
+        { .cic_rate =  1, .fir_rate = 1, .num_taps =  0, .pCoeffs = NULL },               // 1x, not used, no zoom
+        { .cic_rate =  1, .fir_rate = 2, .num_taps = 31, .pCoeffs = ZoomFFT_Comp_x2 },    // 48ksps -> 24ksps
+        { .cic_rate =  1, .fir_rate = 4, .num_taps = 63, .pCoeffs = ZoomFFT_Comp_x4 },    // 48ksps -> 12ksps
+        { .cic_rate =  2, .fir_rate = 4, .num_taps = 63, .pCoeffs = ZoomFFT_Comp_x8 },    // 24ksps -> 6ksps
+        { .cic_rate =  4, .fir_rate = 4, .num_taps = 63, .pCoeffs = ZoomFFT_Comp_x16 },   // 12ksps -> 3ksps
+        { .cic_rate =  8, .fir_rate = 4, .num_taps = 63, .pCoeffs = ZoomFFT_Comp_x32 },   // 6ksps -> 1k5sps
+        { .cic_rate = 16, .fir_rate = 4, .num_taps = 63, .pCoeffs = ZoomFFT_Comp_x64 },   // 3ksps -> 750sps
+        { .cic_rate = 32, .fir_rate = 4, .num_taps = 63, .pCoeffs = ZoomFFT_Comp_x128 },  // 1k5sps -> 375sps
+};
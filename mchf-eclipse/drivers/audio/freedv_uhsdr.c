@@ -11,6 +11,7 @@
  **  Last Modified:                                                                 **
  **  Licence:       GNU GPLv3                                                      **
  ************************************************************************************/
+#include <stdlib.h>
 #include "ui_driver.h"
 #include "freedv_uhsdr.h"
 #include "ui_lcd_layouts.h"
@@ -47,6 +48,97 @@ typedef struct {
 
 static uint16_t freedv_display_x_offset;
 
+freedv_tx_stats_t freedv_tx_stats;
+
+// the modem samples run at 8ksps, this is the number of them consumed per audio interrupt
+#define FDV_TX_SAMPLES_PER_BLOCK    ((IQ_BLOCK_SIZE * 8000 + IQ_SAMPLE_RATE - 1) / IQ_SAMPLE_RATE)
+// the encoder is started from PendSV which is delayed by the audio interrupt, so we keep two blocks of margin
+#define FDV_TX_LEAD_IN_MARGIN       (2 * FDV_TX_SAMPLES_PER_BLOCK)
+
+/**
+ * Forgets the measured encoder timing, to be called if the mode changes since the encoders have very different run times
+ */
+static void FreeDv_TxTimingReset()
+{
+    freedv_tx_stats.comptx_cycles = 0;
+    freedv_tx_stats.lead_in_extra = 0;
+    freedv_tx_stats.underruns = 0;
+    // until we have measured anything, we wait for a complete second frame
+    freedv_tx_stats.lead_in = f_FREEDV != NULL ? freedv_get_n_nom_modem_samples(f_FREEDV) : 0;
+}
+
+/**
+ * Calculates the lead-in required to cover the encoding time of the next frame
+ * from the measured peak encoding time and what we learned from underruns.
+ * The lead-in is never larger than a frame, this is the maximum the iq buffer can provide in addition to the frame being sent.
+ */
+static void FreeDv_TxTimingUpdate(uint32_t comptx_cycles)
+{
+    // peak hold with slow decay, so that a single slow frame is remembered for a while
+    if (comptx_cycles > freedv_tx_stats.comptx_cycles)
+    {
+        freedv_tx_stats.comptx_cycles = comptx_cycles;
+    }
+    else
+    {
+        freedv_tx_stats.comptx_cycles -= (freedv_tx_stats.comptx_cycles - comptx_cycles) / 16;
+    }
+
+    int32_t lead_in = (((uint64_t)freedv_tx_stats.comptx_cycles * 8000) + SystemCoreClock - 1) / SystemCoreClock;
+    lead_in += FDV_TX_LEAD_IN_MARGIN + freedv_tx_stats.lead_in_extra;
+
+    const int32_t frame_len = freedv_get_n_nom_modem_samples(f_FREEDV);
+    freedv_tx_stats.lead_in = lead_in > frame_len ? frame_len : lead_in;
+}
+
+#ifdef FDV_MODE_AUTO
+/**
+ * Automatic mode selection: the decoder of the mode found last runs as usual and a modem only
+ * sync detector of the other mode listens to the same samples. If the detector has sync and the decoder
+ * has not, the swap is requested. Closing and opening the modes uses the heap and takes longer
+ * than an audio block, so the swap is done by the main loop in FreeDv_HandleAutoSwitch(), the same way
+ * a mode change from the menu is done.
+ * A decoder plus the detector of the other mode needs about 40kB less heap than two decoders,
+ * see "make freedv-bench FREEDV_BENCH_ARGS=-a".
+ */
+typedef struct {
+    uint8_t active;                                 // index in freedv_modes[] of the mode the decoder runs, 0 = 1600, 1 = 700D
+    struct freedv_sync_detector* detector;          // detector of the other mode, NULL if not in auto mode
+    volatile bool switch_req;                       // set by the receiver if the detector found its mode, cleared by the switch
+} freedv_auto_t;
+
+static freedv_auto_t freedv_auto;
+
+#define FDV_AUTO_OTHER(idx) (1 - (idx))
+
+// heap peak of the 700D decoder plus the 1600 detector as measured by freedv-bench -a on a 64 bit host,
+// the 32 bit firmware needs a little less because of the smaller pointers
+#define FDV_AUTO_HEAP_SIZE  (136*1024)
+
+static bool FreeDv_AutoDetect(int16_t* samples, int n);
+#endif
+
+/**
+ * @return number of 8ksps modem samples the transmitter has to wait after the first frame has been encoded before it starts sending
+ */
+int32_t FreeDV_Tx_Get_LeadIn()
+{
+    return freedv_tx_stats.lead_in;
+}
+
+/**
+ * To be called by the modulator if it ran out of encoded samples while transmitting.
+ * The lead-in is increased by one audio block each time this happens.
+ */
+void FreeDV_Tx_ReportUnderrun()
+{
+    freedv_tx_stats.underruns++;
+    if (f_FREEDV != NULL && freedv_tx_stats.lead_in_extra < freedv_get_n_nom_modem_samples(f_FREEDV))
+    {
+        freedv_tx_stats.lead_in_extra += FDV_TX_SAMPLES_PER_BLOCK;
+    }
+}
+
 /**
  * Returns the internal UHSDR  configuration value in the value range for display and use with the freedv_api
  * @param freedv_conf_p
@@ -193,9 +285,11 @@ void FreeDv_HandleFreeDv()
             RingBuffer_GetSamples(&fdv_audio_rb, &audio_buffer, freedv_get_n_speech_samples(f_FREEDV));
 
             profileTimedEventStart(7);
+            const uint32_t comptx_start = profileCycleCount_get();
             freedv_comptx(f_FREEDV,
                     iq_buffer,
                     audio_buffer); // start the encoding process
+            FreeDv_TxTimingUpdate(profileCycleCount_get() - comptx_start);
             profileTimedEventStop(7);
 
             for (int idx = 0; idx < freedv_get_n_nom_modem_samples(f_FREEDV); idx++)
@@ -245,10 +339,11 @@ void FreeDv_HandleFreeDv()
             while (RingBuffer_GetData(&input_rb) >= freedv_nin(f_FREEDV)
                     && RingBuffer_GetRoom(&fdv_audio_rb) >= freedv_nin(f_FREEDV))
             {
+                const int nin = freedv_nin(f_FREEDV);
                 // MchfBoard_GreenLed(LED_STATE_OFF);
                  // if we arrive here the rx_buffer is full enough and will be consumed now.
 #ifdef USE_SIMPLE_FREEDV_FILTERS
-                for (int idx = 0; idx < freedv_nin(f_FREEDV); idx++ )
+                for (int idx = 0; idx < nin; idx++ )
                 {
                     input_rb_item_t sample;
                     RingBuffer_GetSamples(&input_rb, &sample, 1);
@@ -256,7 +351,7 @@ void FreeDv_HandleFreeDv()
                     input_buffer[idx].imag = sample.imag;
                 }
 #else
-                RingBuffer_GetSamples(&input_rb, &input_buffer, freedv_nin(f_FREEDV));
+                RingBuffer_GetSamples(&input_rb, &input_buffer, nin);
 #endif
 
                 int count = FREEDV_RX_FUNC(f_FREEDV, audio_buffer, input_buffer); // run the decoding process
@@ -265,6 +360,13 @@ void FreeDv_HandleFreeDv()
                 {
                     RingBuffer_PutSamples(&fdv_audio_rb, &audio_buffer, count);
                 }
+#ifdef FDV_MODE_AUTO
+                if (freedv_auto.detector != NULL && freedv_auto.switch_req == false && FreeDv_AutoDetect(input_buffer, nin))
+                {
+                    // the decoder keeps running in the old mode until the main loop has done the switch
+                    freedv_auto.switch_req = true;
+                }
+#endif
             }
         }
     }
@@ -314,6 +416,9 @@ freedv_mode_desc_t freedv_modes[] =
 #ifdef USE_FREEDV_700D
         { "700D", "FD700D", FREEDV_MODE_700D },
 #endif
+#ifdef FDV_MODE_AUTO
+        { "AUTO", "FDAUTO", FDV_MODE_AUTO },
+#endif
 };
 
 const uint8_t freedv_modes_num = sizeof(freedv_modes)/sizeof(freedv_modes[0]);
@@ -332,6 +437,159 @@ void  FreeDV_Init()
 
 }
 
+/**
+ * Opens the decoder / encoder for a FreeDV mode and applies our settings
+ * @param freedv_id FreeDV API mode
+ * @return true if f_FREEDV is ready for use
+ */
+static bool FreeDv_Open(uint8_t freedv_id)
+{
+    f_FREEDV = freedv_open(freedv_id);
+
+    bool retval = f_FREEDV != NULL;
+    if (retval)
+    {
+        sprintf(my_cb_state.tx_str, ts.special_functions_enabled == 1 ? FREEDV_TX_DF8OE_MESSAGE : FREEDV_TX_MESSAGE);
+
+        my_cb_state.ptx_str = my_cb_state.tx_str;
+        freedv_set_callback_txt(f_FREEDV, &my_put_next_rx_char, &my_get_next_tx_char, &my_cb_state);
+
+        if (FreeDV_Is_Squelch_Enable(&freedv_conf))
+        {
+            freedv_set_squelch_en(f_FREEDV,1);
+            freedv_set_snr_squelch_thresh(f_FREEDV, FreeDV_Get_Squelch_SNR(&freedv_conf));
+        }
+        else
+        {
+            freedv_set_squelch_en(f_FREEDV,0);
+        }
+
+        freedv_set_tx_bpf(f_FREEDV, 0);
+        FreeDv_TxTimingReset();
+    }
+    return retval;
+}
+
+#ifdef FDV_MODE_AUTO
+static void FreeDv_AutoStop()
+{
+    if (freedv_auto.detector != NULL)
+    {
+        freedv_sync_detector_destroy(freedv_auto.detector);
+        freedv_auto.detector = NULL;
+    }
+    freedv_auto.switch_req = false;
+}
+
+/**
+ * @return true if the detector for the other mode could be created
+ */
+static bool FreeDv_AutoStart()
+{
+    freedv_auto.detector = freedv_sync_detector_create(freedv_modes[FDV_AUTO_OTHER(freedv_auto.active)].freedv_id);
+    return freedv_auto.detector != NULL;
+}
+
+/**
+ * Checks if the heap can take the largest decoder plus detector combination the auto mode may switch to.
+ * Must be called with no decoder open. A single block is requested, which is a bit stricter than needed
+ * since FreeDV allocates many smaller blocks.
+ * @return true if auto mode fits into the heap
+ */
+static bool FreeDv_AutoHeapFits()
+{
+    void* probe = malloc(FDV_AUTO_HEAP_SIZE);
+    const bool retval = probe != NULL;
+    free(probe);
+    return retval;
+}
+
+/**
+ * Opens the decoder of the mode found last and the detector of the other mode
+ * @return true if auto mode is ready for use, false if there is not enough heap, nothing is left open then
+ */
+static bool FreeDv_AutoOpen()
+{
+    bool retval = FreeDv_AutoHeapFits() && FreeDv_Open(freedv_modes[freedv_auto.active].freedv_id);
+    if (retval)
+    {
+        retval = FreeDv_AutoStart();
+        if (retval == false)
+        {
+            freedv_close(f_FREEDV);
+            f_FREEDV = NULL;
+        }
+    }
+    return retval;
+}
+
+/**
+ * Feeds the samples the decoder just used to the detector of the other mode. The detector listens
+ * all the time, so it is usually in sync already when the decoder loses its signal.
+ * @return true if the other mode has been found and the decoder has no sync
+ */
+static bool FreeDv_AutoDetect(int16_t* samples, int n)
+{
+    return freedv_sync_detector_rx(freedv_auto.detector, samples, n) != 0 && freedv_get_sync(f_FREEDV) == 0;
+}
+
+/**
+ * Makes the mode of the detector the decoder mode and vice versa
+ */
+static void FreeDv_AutoSwitch()
+{
+    // stops the receiver in FreeDv_HandleFreeDv() while decoder and detector are replaced
+    ads.af_disabled++;
+
+    // the detector has to go first, ofdm.c supports only one 700D modem at a time
+    FreeDv_AutoStop();
+    freedv_close(f_FREEDV);
+
+    freedv_auto.active = FDV_AUTO_OTHER(freedv_auto.active);
+    if (FreeDv_Open(freedv_modes[freedv_auto.active].freedv_id) == false)
+    {
+        // we just freed the memory of the previous decoder, so it will fit again
+        freedv_auto.active = FDV_AUTO_OTHER(freedv_auto.active);
+        FreeDv_Open(freedv_modes[freedv_auto.active].freedv_id);
+    }
+    FreeDv_AutoStart();
+
+    ads.af_disabled--;
+}
+
+/**
+ * Main loop part of the auto mode: executes a mode switch requested by the receiver and
+ * updates the mode display. Requests coming in while transmitting are dropped.
+ */
+void FreeDv_HandleAutoSwitch()
+{
+    if (freedv_auto.switch_req == true)
+    {
+        if (ts.txrx_mode == TRX_MODE_RX && freedv_auto.detector != NULL)
+        {
+            FreeDv_AutoSwitch();
+            UiDriver_DisplayDemodMode();
+        }
+        freedv_auto.switch_req = false;
+    }
+}
+#endif
+
+/**
+ * @return label of the current mode for the mode display, in auto mode the mode the decoder currently runs
+ */
+const char* FreeDV_Get_ModeLabel()
+{
+    const char* retval = freedv_modes[freedv_conf.mode].label;
+#ifdef FDV_MODE_AUTO
+    if (freedv_modes[freedv_conf.mode].freedv_id == FDV_MODE_AUTO)
+    {
+        retval = freedv_auto.active == 0 ? "AU1600" : "AU700D";
+    }
+#endif
+    return retval;
+}
+
 /**
  *
  * @return true if mode was activated, false if old mode is still active
@@ -355,6 +613,9 @@ int32_t FreeDV_SetMode(uint8_t fdv_mode, int32_t firstTime)
         retval = (ts.txrx_mode == TRX_MODE_RX);
         if (retval == true && f_FREEDV != NULL && freedv_conf.mode != fdv_mode)
         {
+#ifdef FDV_MODE_AUTO
+            FreeDv_AutoStop();
+#endif
             freedv_close(f_FREEDV);
             f_FREEDV = NULL;
         }
@@ -365,27 +626,21 @@ int32_t FreeDV_SetMode(uint8_t fdv_mode, int32_t firstTime)
     // really
     if (retval && f_FREEDV == NULL)
     {
-        f_FREEDV = freedv_open(freedv_modes[fdv_mode].freedv_id);
-
-        retval = f_FREEDV != NULL;
-        if (retval)
+#ifdef FDV_MODE_AUTO
+        if (freedv_modes[fdv_mode].freedv_id == FDV_MODE_AUTO)
         {
-            sprintf(my_cb_state.tx_str, ts.special_functions_enabled == 1 ? FREEDV_TX_DF8OE_MESSAGE : FREEDV_TX_MESSAGE);
-
-            my_cb_state.ptx_str = my_cb_state.tx_str;
-            freedv_set_callback_txt(f_FREEDV, &my_put_next_rx_char, &my_get_next_tx_char, &my_cb_state);
-
-            if (FreeDV_Is_Squelch_Enable(&freedv_conf))
-            {
-                freedv_set_squelch_en(f_FREEDV,1);
-                freedv_set_snr_squelch_thresh(f_FREEDV, FreeDV_Get_Squelch_SNR(&freedv_conf));
-            }
-            else
+            // we start with the decoder of the mode found last time
+            retval = FreeDv_AutoOpen();
+            if (retval == false && firstTime == false)
             {
-                freedv_set_squelch_en(f_FREEDV,0);
+                // auto mode does not fit into the heap, we keep the previous mode
+                FreeDv_Open(freedv_modes[freedv_conf.mode].freedv_id);
             }
-
-            freedv_set_tx_bpf(f_FREEDV, 0);
+        }
+        else
+#endif
+        {
+            retval = FreeDv_Open(freedv_modes[fdv_mode].freedv_id);
         }
     }
 
@@ -78,6 +78,11 @@ typedef struct {
     uint8_t freedv_id;
 } freedv_mode_desc_t;
 
+#ifdef USE_FREEDV_700D
+// pseudo mode: receive scans for 1600 and 700D and switches the decoder to the mode found on the channel
+#define FDV_MODE_AUTO 0xff
+#endif
+
 extern    freedv_mode_desc_t freedv_modes[];
 extern    const uint8_t freedv_modes_num;
 
@@ -97,14 +102,33 @@ typedef struct {
 
 extern freedv_conf_t freedv_conf;
 
+/**
+ * Timing of the FreeDV transmit pipeline. The encoder runs one frame ahead of the modulator
+ * and the modulator delays its start by the lead-in to cover the encoding time of the next frame.
+ */
+typedef struct {
+    uint32_t underruns;         // number of times the modulator ran out of encoded samples during transmit
+    uint32_t comptx_cycles;     // peak cycles used by freedv_comptx for a single frame, slowly decaying
+    uint32_t lead_in_extra;     // additional lead-in learned from underruns, in 8ksps samples
+    int32_t lead_in;            // current lead-in in 8ksps samples
+} freedv_tx_stats_t;
+
+extern freedv_tx_stats_t freedv_tx_stats;
+
 
 void FreeDv_HandleFreeDv(void);
 void FreeDV_Init(void);
 int32_t FreeDV_SetMode(uint8_t fdv_mode, int32_t firstTime);
+const char* FreeDV_Get_ModeLabel(void);
+#ifdef FDV_MODE_AUTO
+void FreeDv_HandleAutoSwitch(void);
+#endif
 void FreeDV_Test(void);
 
 int32_t FreeDV_Iq_Get_FrameLen(void);
 int32_t FreeDV_Audio_Get_FrameLen(void);
+int32_t FreeDV_Tx_Get_LeadIn(void);
+void FreeDV_Tx_ReportUnderrun(void);
 
 
 void FreeDv_DisplayClear(void);
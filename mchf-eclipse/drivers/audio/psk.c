@@ -11,26 +11,84 @@
 #include "psk.h"
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include "softdds.h"
 #include "uhsdr_digi_buffer.h"
 #include "ui_driver.h" // only necessary because of UiDriver_TextMsgPutChar
 #include "radio_management.h" // only necessary because of RadioManagement_Request_TxOff
+#include "audio_driver.h" // only necessary because of ads.af_disabled
 
 
 // RX,TX common constants
 #define PSK_SAMPLE_RATE 12000 // TODO This should come from elsewhere, to be fixed
 
 // RX constants
-#define PSK_BND_FLT_LEN 5
-#define PSK_BUF_LEN (PSK_SAMPLE_RATE / PSK_OFFSET)
-// this must be an integer result without remainder and must be a multiple of 4
-
-#define PSK_SHIFT_DIFF (1.0 * PSK_OFFSET / PSK_SAMPLE_RATE) // phase change between two samples of PSK_OFFSET Hz
+// the mixer output of each channel is lowpass filtered and decimated by PSK_DECIM_FACTOR
+// which gives us a complex baseband stream at PSK_DECIM_RATE for the symbol rate processing
+#define PSK_DECIM_RATE PSK_OFFSET
+#define PSK_DECIM_FACTOR (PSK_SAMPLE_RATE / PSK_DECIM_RATE)
+// this must be an integer result without remainder
+#define PSK_DECIM_TAPS 159
+
+#define PSK_SYMBOL_LEN_MAX 16 // decimated samples per symbol at 31.25 baud, the slowest speed
+
+#define PSK_SYNC_DECAY 0.9 // averaging of the symbol timing energy
+#define PSK_QUALITY_DECAY 0.9 // averaging of the signal quality
+#define PSK_LOCK_ON 0.6 // signal quality above which a channel is considered locked
+#define PSK_LOCK_OFF 0.3 // signal quality below which a channel loses lock
+#define PSK_AFC_QUALITY_MIN 0.2 // below this signal quality the AFC is not used
+#define PSK_AFC_GAIN 0.2 // part of the measured frequency error corrected per symbol
+#define PSK_DISC_DECAY 0.99 // averaging of the frequency discriminator at PSK_DECIM_RATE
+#define PSK_SEARCH_STEP 1.0 // Hz per symbol an unlocked panorama channel moves through its slot
+
+#define PSK_TEXT_LEN 12 // panorama output is collected in words of this max. length
 
 // TX constants
 #define SAMPLE_MAX 32766 // max amplitude of generated samples
 
 
+typedef struct
+{
+    soft_dds_t dds;             // channel VCO at PSK_SAMPLE_RATE
+    float32_t freq_nominal;     // center of the channel
+    float32_t freq;             // current VCO frequency including AFC correction
+    float32_t freq_range;       // max. deviation from freq_nominal for AFC and carrier search
+    bool search;                // move through the channel range if nothing is received
+
+    float32_t mix_re[PSK_DECIM_FACTOR]; // mixer output collected for the next decimated sample
+    float32_t mix_im[PSK_DECIM_FACTOR];
+    uint16_t mix_len;
+
+    arm_fir_decimate_instance_f32 decim_re;
+    arm_fir_decimate_instance_f32 decim_im;
+    float32_t decim_re_state[PSK_DECIM_TAPS + PSK_DECIM_FACTOR - 1];
+    float32_t decim_im_state[PSK_DECIM_TAPS + PSK_DECIM_FACTOR - 1];
+
+    arm_biquad_casd_df1_inst_f32 lpf_re;
+    arm_biquad_casd_df1_inst_f32 lpf_im;
+    float32_t lpf_re_state[4];
+    float32_t lpf_im_state[4];
+
+    float32_t sync_energy[PSK_SYMBOL_LEN_MAX]; // averaged power for each sampling position within a symbol
+    uint16_t symbol_idx;        // current sampling position within the symbol
+    uint16_t sample_point;      // sampling position used for the symbol decision
+
+    float32_t last_re;          // baseband value of the previous symbol
+    float32_t last_im;
+    float32_t prev_re;          // baseband value of the previous decimated sample
+    float32_t prev_im;
+    float32_t disc_re;          // averaged z[n] * conj(z[n-1]), its phase is the frequency error per decimated sample
+    float32_t disc_im;
+    float32_t quality;          // averaged cos(2 * phase difference), close to 1 for clean BPSK, around 0 for noise
+    bool locked;
+
+    int8_t last_bit;
+    uint32_t word;
+
+    char text[PSK_TEXT_LEN];
+    uint8_t text_len;
+} PskChannel_t;
+
 typedef struct
 {
     uint16_t rate;
@@ -46,24 +104,10 @@ typedef struct
     int16_t tx_ones;
     bool tx_win;
 
-    float32_t rx_phase;
-    float32_t rx_samples_in[PSK_BND_FLT_LEN];
-    float32_t rx_samples[PSK_BND_FLT_LEN];
-    int16_t rx_bnd_idx;
-    float32_t rx_cos_prod[PSK_BUF_LEN];
-    float32_t rx_sin_prod[PSK_BUF_LEN];
-    float32_t rx_scmix[PSK_BUF_LEN];
-    int32_t rx_idx;
-    int8_t rx_last_bit;
-    float32_t rx_err; // could be of interest for tuning
-    float32_t rx_last_symbol;
-    int16_t rx_symbol_len; // how many buffers fit into one bit
-    int16_t rx_symbol_idx;
-    // float32_t rx_symbol_buf[PSK_MAX_SYMBOL_BUF];
-    uint32_t rx_word;
+    int16_t rx_symbol_len; // how many decimated samples fit into one bit
+    uint8_t rx_last_channel; // channel which has written to the text output last
     psk_modulator_t tx_mod_state;
-    float32_t rx_sum_sin;
-    float32_t rx_sum_cos;
+    PskChannel_t rx_chan[PSK_PANORAMA_CHANNELS];
 } PskState_Internal_t;
 
 
@@ -330,100 +374,83 @@ static const uint16_t psk_varicode[] = {
 #define PSK_VARICODE_NUM (sizeof(psk_varicode)/sizeof(*psk_varicode))
 
 
-static const float32_t PskBndPassB_31[] = {
-		6.6165543533213894e-05,
-		0.0,
-		-0.00013233108706642779,
-		0.0,
-		6.6165543533213894e-05
-};
-
-static const float32_t PskBndPassA_31[] = {
-		1.0,
-		-3.8414813063247664,
-		5.6662277107033248,
-		-3.7972899991488904,
-		0.9771256616899302
-};
-
-static const float32_t PskBndPassB_63[] = {
-		0.0002616526950658905,
-		0.0,
-		-0.000523305390131781,
-		0.0,
-		0.0002616526950658905
+// decimation lowpass from PSK_SAMPLE_RATE to PSK_DECIM_RATE
+// equiripple design, passband up to 125Hz (the widest symbol rate lowpass) with 0.1dB ripple,
+// stopband from PSK_DECIM_RATE - 125Hz on with 72dB attenuation, so nothing aliases into the
+// passband of the symbol rate lowpass. Symmetric, DC gain 1.0
+static const float32_t PskDecimate[PSK_DECIM_TAPS] =
+{
+    1.600327610039e-04, 1.115033564689e-04, 1.478450633805e-04, 1.898765866572e-04,
+    2.376180886649e-04, 2.908628736856e-04, 3.491961649114e-04, 4.119573622844e-04,
+    4.782425395313e-04, 5.469254357600e-04, 6.166456081307e-04, 6.857949514556e-04,
+    7.524882667463e-04, 8.145658878691e-04, 8.696714266896e-04, 9.153268145334e-04,
+    9.489367313696e-04, 9.677629756837e-04, 9.689591876644e-04, 9.497319112538e-04,
+    9.075175822981e-04, 8.399436513075e-04, 7.447095993494e-04, 6.198164280809e-04,
+    4.639851419387e-04, 2.763661975944e-04, 5.608961589115e-05, -1.959603052384e-04,
+    -4.792209002899e-04, -7.916421681385e-04, -1.130724713619e-03, -1.492947782032e-03,
+    -1.873944316977e-03, -2.268436687307e-03, -2.670283965593e-03, -3.072531034720e-03,
+    -3.467408729937e-03, -3.846403762234e-03, -4.200380454662e-03, -4.519694250170e-03,
+    -4.794302910193e-03, -5.013890875813e-03, -5.168038969319e-03, -5.246434342834e-03,
+    -5.239025142810e-03, -5.136142597274e-03, -4.928738998801e-03, -4.608650226089e-03,
+    -4.168693337197e-03, -3.602779882745e-03, -2.906242828043e-03, -2.075951489730e-03,
+    -1.110223038435e-03, -9.404325709152e-06, 1.224640352754e-03, 2.587893061443e-03,
+    4.074585216618e-03, 5.676906363598e-03, 7.385228549994e-03, 9.188066721767e-03,
+    1.107217462018e-02, 1.302272083492e-02, 1.502342661321e-02, 1.705674488950e-02,
+    1.910407181128e-02, 2.114597261739e-02, 2.316245714458e-02, 2.513325564965e-02,
+    2.703805920147e-02, 2.885681206306e-02, 3.057004342029e-02, 3.215912508045e-02,
+    3.360651267655e-02, 3.489604888793e-02, 3.601321228203e-02, 3.694529024965e-02,
+    3.768162378873e-02, 3.821376476758e-02, 3.853549593522e-02, 3.864318605172e-02,
+    3.853549593522e-02, 3.821376476758e-02, 3.768162378873e-02, 3.694529024965e-02,
+    3.601321228203e-02, 3.489604888793e-02, 3.360651267655e-02, 3.215912508045e-02,
+    3.057004342029e-02, 2.885681206306e-02, 2.703805920147e-02, 2.513325564965e-02,
+    2.316245714458e-02, 2.114597261739e-02, 1.910407181128e-02, 1.705674488950e-02,
+    1.502342661321e-02, 1.302272083492e-02, 1.107217462018e-02, 9.188066721767e-03,
+    7.385228549994e-03, 5.676906363598e-03, 4.074585216618e-03, 2.587893061443e-03,
+    1.224640352754e-03, -9.404325709152e-06, -1.110223038435e-03, -2.075951489730e-03,
+    -2.906242828043e-03, -3.602779882745e-03, -4.168693337197e-03, -4.608650226089e-03,
+    -4.928738998801e-03, -5.136142597274e-03, -5.239025142810e-03, -5.246434342834e-03,
+    -5.168038969319e-03, -5.013890875813e-03, -4.794302910193e-03, -4.519694250170e-03,
+    -4.200380454662e-03, -3.846403762234e-03, -3.467408729937e-03, -3.072531034720e-03,
+    -2.670283965593e-03, -2.268436687307e-03, -1.873944316977e-03, -1.492947782032e-03,
+    -1.130724713619e-03, -7.916421681385e-04, -4.792209002899e-04, -1.959603052384e-04,
+    5.608961589115e-05, 2.763661975944e-04, 4.639851419387e-04, 6.198164280809e-04,
+    7.447095993494e-04, 8.399436513075e-04, 9.075175822981e-04, 9.497319112538e-04,
+    9.689591876644e-04, 9.677629756837e-04, 9.489367313696e-04, 9.153268145334e-04,
+    8.696714266896e-04, 8.145658878691e-04, 7.524882667463e-04, 6.857949514556e-04,
+    6.166456081307e-04, 5.469254357600e-04, 4.782425395313e-04, 4.119573622844e-04,
+    3.491961649114e-04, 2.908628736856e-04, 2.376180886649e-04, 1.898765866572e-04,
+    1.478450633805e-04, 1.115033564689e-04, 1.600327610039e-04,
 };
 
-static const float32_t PskBndPassA_63[] = {
-		1.0,
-		-3.8195192250239174,
-		5.6013869366249818,
-		-3.7321386869273105,
-		0.95477455992103932
+// 2nd order butterworth lowpass filters at PSK_DECIM_RATE with cutoff at the symbol rate
+// order: b0, b1, b2, a1, a2 with a1 and a2 negated as required by arm_biquad_cascade_df1_f32
+static const float32_t PskLowPass_31[] = {
+		2.9954582208e-02, 5.9909164416e-02, 2.9954582208e-02, 1.4542435863e+00, -5.7406191508e-01
 };
 
-static const float32_t PskBndPassB_125[] = {
-		0.0010232176384709002,
-		0.0,
-		-0.0020464352769418003,
-		0.0,
-		0.0010232176384709002
+static const float32_t PskLowPass_63[] = {
+		9.7631072938e-02, 1.9526214588e-01, 9.7631072938e-02, 9.4280904158e-01, -3.3333333333e-01
 };
 
-static const float32_t PskBndPassA_125[] = {
-		1.0,
-		-3.7763786572915334,
-		5.4745855184361272,
-		-3.6055008493327723,
-		0.91159449659996006
+static const float32_t PskLowPass_125[] = {
+		2.9289321881e-01, 5.8578643763e-01, 2.9289321881e-01, 0.0, -1.7157287525e-01
 };
 
 static soft_dds_t psk_dds;
 static soft_dds_t psk_bit_dds;
-static soft_dds_t psk_rx_dds;
-
-
-#if 0
-static void PskBufAdd(int len, float32_t buf[], float32_t v)
-{
-	for (int i = len - 1; i > 0; i--)
-	{
-		buf[i] = buf[i-1];
-	}
-	buf[0] = v;
-}
-#endif
-
-static float32_t Psk_IirNext(const float32_t bpf_b[], const float32_t bpf_a[], float32_t x[], float32_t y[], int idx, int taps)
-{
-	float32_t resp = 0;
-	int iidx; 
-
-	for (int i = 0; i < taps; i++)
-	{
-		iidx = (idx - i + taps) % taps;
-		resp += bpf_b[i] * x[iidx];
-		if (i>0)
-		{
-			resp -= bpf_a[i] * y[iidx];
-		}
-	}
-	return resp / bpf_a[0];
-}
-
-
-
 
 const psk_speed_item_t psk_speeds[PSK_SPEED_NUM] =
 {
-		{ .id =PSK_SPEED_31, .value = 31.25,  .bpf_b = PskBndPassB_31, .bpf_a = PskBndPassA_31, .rate = 384, .label = " 31" },
-		{ .id =PSK_SPEED_63, .value = 62.5,   .bpf_b = PskBndPassB_63, .bpf_a = PskBndPassA_63, .rate = 192, .label = " 63"  },
-		{ .id =PSK_SPEED_125, .value = 125.0, .bpf_b = PskBndPassB_125, .bpf_a = PskBndPassA_125, .rate = 96, .label = "125" }
+		{ .id =PSK_SPEED_31, .value = 31.25,  .lpf_coeffs = PskLowPass_31, .rate = 384, .label = " 31" },
+		{ .id =PSK_SPEED_63, .value = 62.5,   .lpf_coeffs = PskLowPass_63, .rate = 192, .label = " 63"  },
+		{ .id =PSK_SPEED_125, .value = 125.0, .lpf_coeffs = PskLowPass_125, .rate = 96, .label = "125" }
 };
 
 psk_ctrl_t psk_ctrl_config =
 {
-		.speed_idx = PSK_SPEED_31
+		.speed_idx = PSK_SPEED_31,
+		.afc_enable = true,
+		.panorama_enable = false,
 };
 
 PskState_Internal_t  psk_state;
@@ -439,46 +466,57 @@ void Psk_Modulator_PrepareTx()
 	Psk_Modulator_SetState(PSK_MOD_PREAMBLE);
 }
 
+static void Bpsk_Channel_SetFreq(PskChannel_t* chan, float32_t freq)
+{
+    chan->freq = freq;
+    softdds_setFreqDDS(&chan->dds, freq, PSK_SAMPLE_RATE, true);
+}
+
+static void Bpsk_Channel_Init(PskChannel_t* chan, float32_t freq_nominal, float32_t freq_range, bool search)
+{
+    memset(chan, 0, sizeof(*chan));
+
+    chan->freq_nominal = freq_nominal;
+    chan->freq_range = freq_range;
+    chan->search = search;
+    softdds_setFreqDDS(&chan->dds, freq_nominal, PSK_SAMPLE_RATE, false);
+    chan->freq = freq_nominal;
+
+    arm_fir_decimate_init_f32(&chan->decim_re, PSK_DECIM_TAPS, PSK_DECIM_FACTOR, (float32_t*)PskDecimate, chan->decim_re_state, PSK_DECIM_FACTOR);
+    arm_fir_decimate_init_f32(&chan->decim_im, PSK_DECIM_TAPS, PSK_DECIM_FACTOR, (float32_t*)PskDecimate, chan->decim_im_state, PSK_DECIM_FACTOR);
+
+    arm_biquad_cascade_df1_init_f32(&chan->lpf_re, 1, (float32_t*)psk_speeds[psk_ctrl_config.speed_idx].lpf_coeffs, chan->lpf_re_state);
+    arm_biquad_cascade_df1_init_f32(&chan->lpf_im, 1, (float32_t*)psk_speeds[psk_ctrl_config.speed_idx].lpf_coeffs, chan->lpf_im_state);
+
+    chan->sample_point = psk_state.rx_symbol_len / 2;
+}
+
 void Bpsk_Demodulator_Init()
 {
-	psk_state.rx_phase = 0;
-	psk_state.rx_bnd_idx = 0;
-	
-	for (int i = 0; i < PSK_BND_FLT_LEN; i++)
-	{
-		psk_state.rx_samples_in[i] = 0;
-		psk_state.rx_samples[i] = 0;
-	}
-	
-	for (int i = 0; i < PSK_BUF_LEN; i++)
+	psk_state.rx_symbol_len = psk_state.rate / PSK_DECIM_FACTOR;
+	psk_state.rx_last_channel = 0;
+
+	// the tuned channel never leaves the signal we have been tuned to
+	Bpsk_Channel_Init(&psk_state.rx_chan[0], PSK_OFFSET, PSK_AFC_RANGE, false);
+
+	for (int channel = 1; channel < PSK_PANORAMA_CHANNELS; channel++)
 	{
-		psk_state.rx_cos_prod[i] = 0;
-		psk_state.rx_sin_prod[i] = 0;
-		psk_state.rx_scmix[i] = 0;
+		Bpsk_Channel_Init(&psk_state.rx_chan[channel], PSK_OFFSET + channel * PSK_PANORAMA_SPACING, PSK_PANORAMA_SPACING / 2, true);
 	}
-
-	psk_state.rx_idx = 0;
-	psk_state.rx_last_bit = 0;
-	psk_state.rx_last_symbol = 0;
-	psk_state.rx_symbol_len = psk_state.rate / PSK_BUF_LEN;
-	psk_state.rx_symbol_idx = 0;
-	
-	// for (int i = 0; i < psk_state.rx_symbol_len; i ++)
-	// {
-	// 	psk_state.rx_symbol_buf[i];
-	// }
-
-	psk_state.rx_word = 0;
 }
 
 
+/**
+ * (Re)initializes modulator and demodulator, e.g. after a speed change. The demodulator runs
+ * in the audio interrupt / PendSV context, so audio processing is stopped while its state is reset.
+ */
 void Psk_Modem_Init(uint32_t output_sample_rate)
 {
+	ads.af_disabled++;
 
 	psk_state.tx_idx = 0;
 
 	softdds_setFreqDDS(&psk_dds,    PSK_OFFSET, output_sample_rate, true);
-	softdds_setFreqDDS(&psk_rx_dds, PSK_OFFSET, PSK_SAMPLE_RATE,    true);
     // we use a sine wave with a frequency of half of the bit rate
     // as envelope generator
     softdds_setFreqDDS(&psk_bit_dds, (float32_t)psk_speeds[psk_ctrl_config.speed_idx].value / 2.0, output_sample_rate, false);
@@ -487,6 +525,8 @@ void Psk_Modem_Init(uint32_t output_sample_rate)
 	psk_state.rate = PSK_SAMPLE_RATE / psk_speeds[psk_ctrl_config.speed_idx].value;
 
 	Bpsk_Demodulator_Init();
+
+	ads.af_disabled--;
 }
 
 
@@ -521,166 +561,281 @@ static uint16_t Bpsk_FindCharReversed(uint8_t c)
 }
 
 /**
- *
- * Basically samples the phase every bit length based on a sample which is one full sine wave
- * of the carrier frequency. So it is not using multiple sampling points or anything.
- * We throw away a lot of phase differences symbols
- * using more of these should make the code more robust, shouldn't it?
- *
- * @param symbol_out averaged phase of the samples.
+ * Writes a decoded character to the text output. In panorama mode the characters of a channel are collected
+ * into words which are prefixed with the channel number if the output switches to a different channel,
+ * otherwise the text of all channels would end up mixed character by character.
  */
-
-static void BpskDecoder_NextSymbol(float32_t symbol_out)
+static void BpskDecoder_OutputChar(PskChannel_t* chan, uint8_t channel, char c)
 {
-    int8_t bit;
-
-    static float32_t symbol_store = 0;
-
-    // if (psk_state.rx_symbol_len - psk_state.rx_symbol_idx < 6)
+    if (psk_ctrl_config.panorama_enable == false)
     {
-        symbol_store = symbol_out;
+        UiDriver_TextMsgPutChar(c);
     }
-
-    psk_state.rx_symbol_idx += 1;
-    if (psk_state.rx_symbol_idx >= psk_state.rx_symbol_len)
+    else
     {
-        psk_state.rx_symbol_idx = 0;
-        // TODO here should come additional part to check if timing of sampling should be moved
-        if (psk_state.rx_last_symbol * symbol_store < 0)
+        if (c > ' ' && chan->text_len < PSK_TEXT_LEN)
         {
-            bit = 0;
+            chan->text[chan->text_len++] = c;
         }
-        else
+
+        if ((c <= ' ' || chan->text_len == PSK_TEXT_LEN) && chan->text_len > 0)
         {
-            bit = 1;
+            if (channel != psk_state.rx_last_channel)
+            {
+                UiDriver_TextMsgPutChar('|');
+                UiDriver_TextMsgPutChar('0' + channel);
+                UiDriver_TextMsgPutChar(':');
+                psk_state.rx_last_channel = channel;
+            }
+            for (int idx = 0; idx < chan->text_len; idx++)
+            {
+                UiDriver_TextMsgPutChar(chan->text[idx]);
+            }
+            UiDriver_TextMsgPutChar(' ');
+            chan->text_len = 0;
         }
+    }
+}
 
-        psk_state.rx_last_symbol = symbol_store;
-        symbol_store = 0;
+/**
+ * Moves the channel VCO based on the phase drift between two symbols. Unlocked
+ * channels which are permitted to search slowly sweep through their frequency range.
+ *
+ * The phase drift is only known modulo 180 degrees, so a carrier half the baud rate away
+ * from the VCO looks like a perfect BPSK signal too. The frequency discriminator running at
+ * the decimated rate is not precise but unambiguous and tells us which of these candidates is the carrier.
+ *
+ * @param phase_drift phase change between the last two symbols with BPSK modulation removed
+ */
+static void BpskDecoder_Afc(PskChannel_t* chan, float32_t phase_drift)
+{
+    float32_t freq = chan->freq;
 
-        // have we found 2 consecutive 0 bits? And previously at least one received bit == 1?
-        // indicates an end of character
-        if (psk_state.rx_last_bit == 0 && bit == 0 && psk_state.rx_word != 0)
+    if (chan->quality > PSK_AFC_QUALITY_MIN)
+    {
+        if (psk_ctrl_config.afc_enable)
         {
-            // we lookup up the bits received (minus the last zero, which we shift out to the right)
-            // and put it into the buffer
-            UiDriver_TextMsgPutChar(Bpsk_DecodeVaricode(psk_state.rx_word >> 1));
-
-            // clean out the stored bit pattern
-            psk_state.rx_word = 0;
+            const float32_t baud = psk_speeds[psk_ctrl_config.speed_idx].value;
+            // the VCO quadrature output is Q = -cos, so the baseband phase turns forwards
+            // if the signal is above our VCO frequency
+            const float32_t freq_err = phase_drift * baud / (2 * PI);
+            const float32_t disc_err = atan2f(chan->disc_im, chan->disc_re) * PSK_DECIM_RATE / (2 * PI);
+            // if we sit on a wrong candidate we jump directly to the right one, between the candidates
+            // the quality is too low for the AFC
+            const float32_t ambiguity = roundf((disc_err - freq_err) / (baud / 2)) * (baud / 2);
+            freq += ambiguity + PSK_AFC_GAIN * freq_err;
         }
-        else
+    }
+    else if (chan->search && chan->locked == false)
+    {
+        freq += PSK_SEARCH_STEP;
+        if (freq > chan->freq_nominal + chan->freq_range)
         {
-            psk_state.rx_word = (psk_state.rx_word << 1) | bit;
+            freq = chan->freq_nominal - chan->freq_range;
         }
+    }
 
-        psk_state.rx_last_bit = bit;
+    if (freq > chan->freq_nominal + chan->freq_range)
+    {
+        freq = chan->freq_nominal + chan->freq_range;
+    }
+    else if (freq < chan->freq_nominal - chan->freq_range)
+    {
+        freq = chan->freq_nominal - chan->freq_range;
+    }
 
+    if (freq != chan->freq)
+    {
+        Bpsk_Channel_SetFreq(chan, freq);
     }
 }
 
-static float32_t BpskDecoder_Bandpass(float32_t sample)
+/**
+ * Decides on the bit value of a symbol by comparing its phase to the phase of the previous symbol.
+ * Using the differential phase makes the decision independent of the absolute carrier phase, so
+ * a small remaining frequency error of the VCO does not hurt.
+ *
+ * @param re, im baseband value at the sampling point of the symbol
+ */
+static void BpskDecoder_NextSymbol(PskChannel_t* chan, uint8_t channel, float32_t re, float32_t im)
 {
-    // save original sample in bpf's input buffer
-    psk_state.rx_samples_in[psk_state.rx_bnd_idx] = sample;
+    // d = z[k] * conj(z[k-1])
+    const float32_t d_re = re * chan->last_re + im * chan->last_im;
+    const float32_t d_im = im * chan->last_re - re * chan->last_im;
 
-    // IIR bandpass for signal frequency range, implemented in a ring buffer
-    float32_t retval = Psk_IirNext(psk_speeds[psk_ctrl_config.speed_idx].bpf_b, psk_speeds[psk_ctrl_config.speed_idx].bpf_a, psk_state.rx_samples_in,
-        psk_state.rx_samples, psk_state.rx_bnd_idx, PSK_BND_FLT_LEN);
+    chan->last_re = re;
+    chan->last_im = im;
 
-    // save filtered sample in state buffer, used in next run;
-    psk_state.rx_samples[psk_state.rx_bnd_idx] = retval;
+    const int8_t bit = d_re < 0 ? 0 : 1;
 
-    // increment our ring buffer index
-    psk_state.rx_bnd_idx++;
-    psk_state.rx_bnd_idx %= PSK_BND_FLT_LEN;
+    // squaring d removes the BPSK modulation, what is left is twice the phase drift
+    const float32_t d_mag2 = d_re * d_re + d_im * d_im;
+    if (d_mag2 > 0)
+    {
+        const float32_t d2_re = d_re * d_re - d_im * d_im;
+        const float32_t d2_im = 2 * d_re * d_im;
 
-    return retval;
+        chan->quality = PSK_QUALITY_DECAY * chan->quality + (1 - PSK_QUALITY_DECAY) * d2_re / d_mag2;
+
+        if (chan->locked == false && chan->quality > PSK_LOCK_ON)
+        {
+            chan->locked = true;
+        }
+        else if (chan->locked == true && chan->quality < PSK_LOCK_OFF)
+        {
+            chan->locked = false;
+        }
+
+        BpskDecoder_Afc(chan, atan2f(d2_im, d2_re) / 2);
+    }
+
+    // have we found 2 consecutive 0 bits? And previously at least one received bit == 1?
+    // indicates an end of character
+    if (chan->last_bit == 0 && bit == 0 && chan->word != 0)
+    {
+        // in panorama mode we do not want to see the noise decoded on empty channels
+        if (channel == 0 || chan->locked)
+        {
+            // we lookup up the bits received (minus the last zero, which we shift out to the right)
+            // and put it into the buffer
+            BpskDecoder_OutputChar(chan, channel, Bpsk_DecodeVaricode(chan->word >> 1));
+        }
+        // clean out the stored bit pattern
+        chan->word = 0;
+    }
+    else
+    {
+        chan->word = (chan->word << 1) | bit;
+    }
+
+    chan->last_bit = bit;
 }
 
 /**
- * Process an audio sample and decode signal.
- *
- * @param audio sample at PSK_SAMPLE_RATE
+ * Symbol rate part of the demodulator, processes one baseband sample at PSK_DECIM_RATE.
+ * The symbol timing is recovered from the signal power which drops at each phase reversal,
+ * the sampling point is moved towards the position with the highest average power.
  */
-void Psk_Demodulator_ProcessSample(float32_t sample)
+static void BpskDecoder_ProcessBaseband(PskChannel_t* chan, uint8_t channel, float32_t re_in, float32_t im_in)
 {
-    float32_t fsample = BpskDecoder_Bandpass(sample);
+    float32_t re, im;
 
-	// VCO generates a sine/cosine wave "carrier" with PSK_OFFSET Hz as frequency
-    float32_t vco_sin, vco_cos;
-    // we have to use a different DDS as for TX (different sample rates), IQ gives us sin and cos waves of PSK_OFFSET Hz
-    softdds_genIQSingleTone(&psk_rx_dds, &vco_sin , &vco_cos, 1);
+    arm_biquad_cascade_df1_f32(&chan->lpf_re, &re_in, &re, 1);
+    arm_biquad_cascade_df1_f32(&chan->lpf_im, &im_in, &im, 1);
 
-	// we now multiple these carriers with our signal
-	// this allows us to compare phase differences
-    float32_t sin_mix = vco_sin * fsample;
-    float32_t cos_mix = vco_cos * fsample;
+    chan->disc_re = PSK_DISC_DECAY * chan->disc_re + re * chan->prev_re + im * chan->prev_im;
+    chan->disc_im = PSK_DISC_DECAY * chan->disc_im + im * chan->prev_re - re * chan->prev_im;
+    chan->prev_re = re;
+    chan->prev_im = im;
 
-    // update sums by differences between old and new value in ringbuffer
-    psk_state.rx_sum_sin += sin_mix - psk_state.rx_sin_prod[psk_state.rx_idx];
-    psk_state.rx_sum_cos += cos_mix - psk_state.rx_cos_prod[psk_state.rx_idx];
+    chan->sync_energy[chan->symbol_idx] = PSK_SYNC_DECAY * chan->sync_energy[chan->symbol_idx] + (1 - PSK_SYNC_DECAY) * (re * re + im * im);
 
-    // store new value
-    psk_state.rx_sin_prod[psk_state.rx_idx] = sin_mix;
-    psk_state.rx_cos_prod[psk_state.rx_idx] = cos_mix;
+    if (chan->symbol_idx == chan->sample_point)
+    {
+        BpskDecoder_NextSymbol(chan, channel, re, im);
+    }
 
-	// we now calculate an average
-	float32_t symbol_out = psk_state.rx_sum_sin / PSK_BUF_LEN;
-	float32_t cos_out    = psk_state.rx_sum_cos / PSK_BUF_LEN;
+    chan->symbol_idx++;
+    if (chan->symbol_idx >= psk_state.rx_symbol_len)
+    {
+        chan->symbol_idx = 0;
 
-    // GUESS: now try to estimate the frequency error of our VCO vs. the incoming signal
-	float32_t rx_scmix = symbol_out * cos_out;
-	psk_state.rx_err += rx_scmix - psk_state.rx_scmix[psk_state.rx_idx];
-	psk_state.rx_scmix[psk_state.rx_idx] = rx_scmix;
+        float32_t max_energy;
+        uint32_t max_idx;
+        arm_max_f32(chan->sync_energy, psk_state.rx_symbol_len, &max_energy, &max_idx);
 
+        // we move the sampling point only one step per symbol in the shorter direction
+        int32_t distance = (int32_t)max_idx - chan->sample_point;
+        if (distance > psk_state.rx_symbol_len / 2)
+        {
+            distance -= psk_state.rx_symbol_len;
+        }
+        else if (distance < -psk_state.rx_symbol_len / 2)
+        {
+            distance += psk_state.rx_symbol_len;
+        }
 
-	float32_t smax = 0;
+        if (distance > 0)
+        {
+            chan->sample_point = (chan->sample_point + 1) % psk_state.rx_symbol_len;
+        }
+        else if (distance < 0)
+        {
+            chan->sample_point = (chan->sample_point + psk_state.rx_symbol_len - 1) % psk_state.rx_symbol_len;
+        }
+    }
+}
 
-	for (int i = 0; i < PSK_BUF_LEN; i++)
-	{
-		if (fabsf(psk_state.rx_cos_prod[i]) > smax)
-		{
-			smax = fabsf(psk_state.rx_cos_prod[i]);
-		}
-		if (fabsf(psk_state.rx_sin_prod[i]) > smax)
-		{
-			smax = fabsf(psk_state.rx_sin_prod[i]);
-		}
-	}
+/**
+ * Mixes a block of audio samples down to baseband using the channel's VCO
+ * and decimates the result by PSK_DECIM_FACTOR.
+ */
+static void BpskDecoder_ProcessChannel(PskChannel_t* chan, uint8_t channel, const float32_t* const src, const size_t blockSize)
+{
+    float32_t vco_sin[blockSize];
+    float32_t vco_cos[blockSize];
 
-	// calculate the final correction value from rx_err
-	// avoid division by zero if smax is 0
-	float32_t rx_err_corr = psk_state.rx_err/ (PSK_BUF_LEN * ((smax != 0) ? (smax * smax * 4.0) : 1.0));
+    softdds_genIQSingleTone(&chan->dds, vco_sin, vco_cos, blockSize);
 
-	// if the error is too large, we limit it to +/- 0.1
-	if(fabsf(rx_err_corr) > 0.1)
-	{
-		rx_err_corr = (rx_err_corr > 0) ? 0.1 : -0.1;
-	}
-	rx_err_corr = 0;
+    size_t idx = 0;
+    while (idx < blockSize)
+    {
+        // the blocks from the audio tap have any length, but the decimator wants a multiple of
+        // PSK_DECIM_FACTOR, so the mixer output is collected until we have one decimated sample
+        size_t len = PSK_DECIM_FACTOR - chan->mix_len;
+        if (len > blockSize - idx)
+        {
+            len = blockSize - idx;
+        }
 
-	// now advance our phase counter with our error correction
-    psk_state.rx_phase += PSK_SHIFT_DIFF + rx_err_corr * PSK_SHIFT_DIFF;
+        arm_mult_f32((float32_t*)&src[idx], &vco_cos[idx], &chan->mix_re[chan->mix_len], len);
+        arm_mult_f32((float32_t*)&src[idx], &vco_sin[idx], &chan->mix_im[chan->mix_len], len);
 
+        chan->mix_len += len;
+        idx += len;
 
-	// we just passed one "full" offset frequency wave length?
-	// now see if we have enough symbols to decide if it is a 1 or 0
-    // the symbol is basically an averaged phase difference over the last PSK_BUF_LEN
-    // samples.
-	if (psk_state.rx_phase > 1)
-	{
-		psk_state.rx_phase -= 1;
-		BpskDecoder_NextSymbol(symbol_out);
-	}
+        if (chan->mix_len == PSK_DECIM_FACTOR)
+        {
+            float32_t re, im;
+            arm_fir_decimate_f32(&chan->decim_re, chan->mix_re, &re, PSK_DECIM_FACTOR);
+            arm_fir_decimate_f32(&chan->decim_im, chan->mix_im, &im, PSK_DECIM_FACTOR);
 
-	if (psk_state.rx_phase < 0)
-	{
-		psk_state.rx_phase += 1;
-	}
+            BpskDecoder_ProcessBaseband(chan, channel, re, im);
+            chan->mix_len = 0;
+        }
+    }
+}
+
+/**
+ * Process a block of audio samples and decode signal(s).
+ *
+ * @param src audio samples at PSK_SAMPLE_RATE
+ * @param blockSize number of samples
+ */
+void Psk_Demodulator_ProcessBlock(const float32_t* const src, const size_t blockSize)
+{
+    const uint8_t channels = psk_ctrl_config.panorama_enable ? PSK_PANORAMA_CHANNELS : 1;
+
+    for (uint8_t channel = 0; channel < channels; channel++)
+    {
+        BpskDecoder_ProcessChannel(&psk_state.rx_chan[channel], channel, src, blockSize);
+    }
+}
 
-    // we prepare us for the next sample in our ring buffer
-    psk_state.rx_idx = (psk_state.rx_idx + 1) % PSK_BUF_LEN;
+/**
+ * @returns the current (AFC corrected) audio frequency of a demodulator channel
+ */
+float32_t Psk_Demodulator_GetChannelFreq(uint8_t channel)
+{
+    return channel < PSK_PANORAMA_CHANNELS ? psk_state.rx_chan[channel].freq : 0;
+}
+
+/**
+ * @returns true if a demodulator channel currently receives a BPSK signal
+ */
+bool Psk_Demodulator_IsChannelLocked(uint8_t channel)
+{
+    return channel < PSK_PANORAMA_CHANNELS ? psk_state.rx_chan[channel].locked : false;
 }
 
 static bool bit_start(uint16_t tx_bit_phase)
@@ -17,6 +17,13 @@
 #define PSK_OFFSET 500
 #define PSK_SNAP_RANGE 100 // defines the range within which the SNAP algorithm in spectrum.c searches for the PSK carrier
 
+// PSK panorama: channel 0 is always the tuned channel at PSK_OFFSET,
+// the other channels cover the audio passband above it in slots of PSK_PANORAMA_SPACING Hz
+#define PSK_PANORAMA_CHANNELS 6
+#define PSK_PANORAMA_SPACING 300
+
+#define PSK_AFC_RANGE 25 // max. deviation of AFC from the nominal channel frequency in Hz
+
 
 typedef enum {
     PSK_SPEED_31,
@@ -29,8 +36,7 @@ typedef struct
 {
     psk_speed_t id;
     float32_t value;
-    const float32_t* bpf_b;
-    const float32_t* bpf_a;
+    const float32_t* lpf_coeffs; // biquad lowpass at decimated rate, CMSIS order b0,b1,b2,-a1,-a2
     uint16_t rate;
     char* label;
 } psk_speed_item_t;
@@ -41,6 +47,8 @@ extern const psk_speed_item_t psk_speeds[PSK_SPEED_NUM];
 typedef struct
 {
     psk_speed_t speed_idx;
+    bool afc_enable;
+    bool panorama_enable; // decode all PSK_PANORAMA_CHANNELS instead of just the tuned one
 }  psk_ctrl_t;
 
 extern psk_ctrl_t psk_ctrl_config;
@@ -59,7 +67,9 @@ psk_modulator_t Psk_Modulator_SetState(psk_modulator_t newState);
 
 void Psk_Modem_Init(uint32_t output_sample_rate);
 void Psk_Modulator_PrepareTx(void);
-void Psk_Demodulator_ProcessSample(float32_t sample);
+void Psk_Demodulator_ProcessBlock(const float32_t* const src, const size_t blockSize);
+float32_t Psk_Demodulator_GetChannelFreq(uint8_t channel);
+bool Psk_Demodulator_IsChannelLocked(uint8_t channel);
 int16_t Psk_Modulator_GenSample(void);
 
 #endif
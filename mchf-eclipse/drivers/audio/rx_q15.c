@@ -0,0 +1,161 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     rx_q15.c                                                        **
+ **  Description:   Q15 decimation and Hilbert transform of the SSB/CW receiver     **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * Q15 variant of the decimation, Hilbert transform and sideband demodulation of the SSB/CW
+ * receiver, see USE_RX_Q15. The filters are set up from their float counterparts of
+ * AudioFilter_SetRxHilbertAndDecimationFIR(), AudioDriver_RxProcessor() uses the demodulation
+ * instead of the float processing if the filters are usable.
+ *
+ * Runs on the host against the float path, see misc/rx_q15_test.c.
+ */
+
+#include "uhsdr_board.h"
+#include "filters.h"
+#include "rx_q15.h"
+
+#ifdef USE_RX_Q15
+// coefficient tables have room for one additional tap, since arm_fir_q15 requires
+// an even number of taps
+typedef struct
+{
+    arm_fir_instance_q15    hilbert_i;
+    arm_fir_instance_q15    hilbert_q;
+    arm_fir_decimate_instance_q15   decimate_i;
+    arm_fir_decimate_instance_q15   decimate_q;
+
+    q15_t   hilbert_taps_i[IQ_RX_NUM_TAPS_MAX + 1];
+    q15_t   hilbert_taps_q[IQ_RX_NUM_TAPS_MAX + 1];
+    q15_t   decimate_taps[IQ_RX_NUM_TAPS];
+
+    q15_t   hilbert_state_i[IQ_RX_NUM_TAPS_MAX + 1 + IQ_RX_BLOCK_SIZE];
+    q15_t   hilbert_state_q[IQ_RX_NUM_TAPS_MAX + 1 + IQ_RX_BLOCK_SIZE];
+    q15_t   decimate_state_i[IQ_RX_NUM_TAPS + IQ_RX_BLOCK_SIZE];
+    q15_t   decimate_state_q[IQ_RX_NUM_TAPS + IQ_RX_BLOCK_SIZE];
+} RxQ15_t;
+
+static RxQ15_t   __MCHF_SPECIALMEM     rx_q15;
+
+/**
+ * Converts float FIR coefficients to Q15, an odd number of taps is padded with a leading
+ * zero tap, which does not change the filter response
+ *
+ * @return number of taps in dst
+ */
+static uint16_t RxQ15_FirCoeffsToQ15(const float32_t* src, q15_t* dst, uint16_t numTaps)
+{
+    uint16_t offset = 0;
+
+    if (numTaps & 1)
+    {
+        dst[0] = 0;
+        offset = 1;
+    }
+    arm_float_to_q15((float32_t*)src, &dst[offset], numTaps);
+
+    return numTaps + offset;
+}
+
+/**
+ * Initializes the Q15 Hilbert and decimation filters from their already initialized float counterparts
+ *
+ * @param decimate decimation filter, used for I and Q; NULL if the mode cannot use the Q15 path
+ */
+void RxQ15_SetRxHilbertAndDecimationFIR(const arm_fir_instance_f32* hilbert_i, const arm_fir_instance_f32* hilbert_q, const arm_fir_decimate_instance_f32* decimate)
+{
+    const uint16_t rx_iq_num_taps = RxQ15_FirCoeffsToQ15(hilbert_i->pCoeffs, rx_q15.hilbert_taps_i, hilbert_i->numTaps);
+    RxQ15_FirCoeffsToQ15(hilbert_q->pCoeffs, rx_q15.hilbert_taps_q, hilbert_q->numTaps);
+
+    arm_fir_init_q15(&rx_q15.hilbert_i, rx_iq_num_taps, rx_q15.hilbert_taps_i, rx_q15.hilbert_state_i, IQ_RX_BLOCK_SIZE);
+    arm_fir_init_q15(&rx_q15.hilbert_q, rx_iq_num_taps, rx_q15.hilbert_taps_q, rx_q15.hilbert_state_q, IQ_RX_BLOCK_SIZE);
+
+    rx_q15.decimate_i.numTaps = 0;
+    rx_q15.decimate_q.numTaps = 0;
+
+    if (decimate != NULL && decimate->numTaps > 0 && decimate->numTaps <= IQ_RX_NUM_TAPS)
+    {
+        arm_float_to_q15((float32_t*)decimate->pCoeffs, rx_q15.decimate_taps, decimate->numTaps);
+
+        arm_fir_decimate_init_q15(&rx_q15.decimate_i, decimate->numTaps, decimate->M,
+                rx_q15.decimate_taps, rx_q15.decimate_state_i, IQ_RX_BLOCK_SIZE);
+        arm_fir_decimate_init_q15(&rx_q15.decimate_q, decimate->numTaps, decimate->M,
+                rx_q15.decimate_taps, rx_q15.decimate_state_q, IQ_RX_BLOCK_SIZE);
+    }
+}
+
+/**
+ * @return true if the filters have been set up for the current mode and the demodulation may be used
+ */
+bool RxQ15_IsUsable()
+{
+    return rx_q15.decimate_i.numTaps > 0;
+}
+
+/**
+ * SSB/CW demodulation using Q15 arithmetic for decimation and Hilbert transform, the sideband demodulation is done in float.
+ *
+ * @param i_in, q_in IQ samples at IQ_SAMPLE_RATE, scaled to the 16 bit range, not changed
+ * @param dst blockSizeDecim audio samples
+ * @param is_lsb demodulate lower sideband, otherwise upper sideband
+ * @param use_decimatedIQ decimate before the Hilbert transform, otherwise after it
+ * @param blockSize number of IQ samples, at most IQ_RX_BLOCK_SIZE
+ * @param blockSizeIQ number of samples going into the Hilbert transform
+ * @param blockSizeDecim number of audio samples placed into dst
+ */
+void RxQ15_SidebandDemod(const float32_t* i_in, const float32_t* q_in, float32_t* dst, const bool is_lsb, const bool use_decimatedIQ,
+                         const uint16_t blockSize, const uint16_t blockSizeIQ, const uint16_t blockSizeDecim)
+{
+    q15_t i_buffer[IQ_RX_BLOCK_SIZE];
+    q15_t q_buffer[IQ_RX_BLOCK_SIZE];
+
+    // the float samples are already scaled to the 16 bit range, so we only need to saturate
+    for (uint16_t idx = 0; idx < blockSize; idx++)
+    {
+        i_buffer[idx] = __SSAT((int32_t)i_in[idx], 16);
+        q_buffer[idx] = __SSAT((int32_t)q_in[idx], 16);
+    }
+
+    if (use_decimatedIQ)
+    {
+        arm_fir_decimate_q15(&rx_q15.decimate_i, i_buffer, i_buffer, blockSize);
+        arm_fir_decimate_q15(&rx_q15.decimate_q, q_buffer, q_buffer, blockSize);
+    }
+
+    // we use the non-"fast" variants, their 64 bit accumulators avoid overflows with our long filters
+    arm_fir_q15(&rx_q15.hilbert_i, i_buffer, i_buffer, blockSizeIQ);   // Hilbert lowpass +45 degrees
+    arm_fir_q15(&rx_q15.hilbert_q, q_buffer, q_buffer, blockSizeIQ);   // Hilbert lowpass -45 degrees
+
+    if (use_decimatedIQ == false)
+    {
+        arm_fir_decimate_q15(&rx_q15.decimate_i, i_buffer, i_buffer, blockSizeIQ);
+        arm_fir_decimate_q15(&rx_q15.decimate_q, q_buffer, q_buffer, blockSizeIQ);
+    }
+
+    // the sum of I and Q reaches twice the input level and would saturate in Q15 above -6dBFS,
+    // so the sideband demodulation is done while converting to float
+    if (is_lsb)
+    {
+        for (uint16_t idx = 0; idx < blockSizeDecim; idx++)
+        {
+            dst[idx] = (float32_t)i_buffer[idx] - q_buffer[idx];   // difference of I and Q - LSB
+        }
+    }
+    else
+    {
+        for (uint16_t idx = 0; idx < blockSizeDecim; idx++)
+        {
+            dst[idx] = (float32_t)i_buffer[idx] + q_buffer[idx];   // sum of I and Q - USB
+        }
+    }
+}
+#endif
@@ -0,0 +1,25 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     rx_q15.h                                                        **
+ **  Description:   Q15 decimation and Hilbert transform of the SSB/CW receiver     **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#ifndef __RX_Q15_H
+#define __RX_Q15_H
+
+#include "uhsdr_types.h"
+#include "arm_math.h"
+
+void RxQ15_SetRxHilbertAndDecimationFIR(const arm_fir_instance_f32* hilbert_i, const arm_fir_instance_f32* hilbert_q, const arm_fir_decimate_instance_f32* decimate);
+bool RxQ15_IsUsable(void);
+void RxQ15_SidebandDemod(const float32_t* i_in, const float32_t* q_in, float32_t* dst, const bool is_lsb, const bool use_decimatedIQ,
+                         const uint16_t blockSize, const uint16_t blockSizeIQ, const uint16_t blockSizeDecim);
+
+#endif
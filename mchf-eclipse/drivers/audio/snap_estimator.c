@@ -0,0 +1,302 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     snap_estimator.c                                                **
+ **  Description:   sub-bin carrier frequency estimator for SNAP                    **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * SNAP needs the frequency of a single carrier close to a known position (the "center"):
+ * the CW carrier at the sidetone offset, the AM carrier at the rx frequency or the BPSK carrier
+ * at PSK_OFFSET. Instead of using the bins of the spectrum display FFT, whose resolution depends
+ * on the FFT size and the zoom, we use our own narrow band signal:
+ *
+ * audio interrupt (SnapEstimator_ProcessSamples):
+ * - the iq signal with the rx frequency at 0 Hz is shifted by -center, so the expected carrier is at 0 Hz
+ * - it is decimated by 2^SNAP_ESTIMATOR_MAGNIFY with the zoom fft decimator (CIC + compensating FIR)
+ * - the decimated samples go into a small ring buffer
+ *
+ * main loop (SnapEstimator_Estimate), every SNAP_ESTIMATOR_HOP new samples:
+ * - the latest SNAP_ESTIMATOR_LEN samples are Hann windowed
+ * - a short FFT finds the strongest bin within +/- range
+ * - the frequency is refined by evaluating the DTFT of the windowed samples (a single frequency
+ *   DFT, the same as a Goertzel filter) left and right of the current estimate and moving to the
+ *   vertex of the parabola through the three powers. The spacing is reduced in each step, so a few
+ *   iterations reach the maximum of the periodogram, which is the maximum likelihood estimate
+ *   of the frequency of a single tone. With a clean carrier the result is well within 0.1 Hz.
+ *
+ * With 750sps and 128 samples an estimate covers 171ms and a new one is available every 43ms.
+ *
+ * In the I + jQ signal a carrier above the rx frequency has a positive frequency, so the
+ * estimated frequency is the distance of the carrier from the center on the dial.
+ */
+
+#include "uhsdr_board.h"
+#include "arm_const_structs.h"
+#include "zoom_decimate.h"
+#include "snap_estimator.h"
+
+#define SNAP_ESTIMATOR_SAMPLE_RATE      (IQ_SAMPLE_RATE_F / (1 << SNAP_ESTIMATOR_MAGNIFY))
+#define SNAP_ESTIMATOR_BIN_WIDTH        (SNAP_ESTIMATOR_SAMPLE_RATE / SNAP_ESTIMATOR_LEN)
+#define SNAP_ESTIMATOR_RING_LEN         256         // power of 2, >= SNAP_ESTIMATOR_LEN + samples arriving while we estimate
+
+#define SNAP_ESTIMATOR_MIN_PEAK_RATIO   16.0        // carrier power / mean bin power, 12dB, pure noise rarely exceeds 8dB
+#define SNAP_ESTIMATOR_ITERATIONS       4
+#define SNAP_ESTIMATOR_PRECISION        0.01        // Hz, stop refining if the correction is smaller
+
+typedef struct
+{
+    // configuration, written by the main loop
+    volatile bool enable;
+    volatile float32_t center;          // Hz, expected distance of the carrier from the rx frequency
+    volatile uint32_t config_seq;       // incremented by the main loop to restart the sample collection
+    float32_t range;                    // Hz, carrier search range around the center
+
+    // interrupt
+    uint32_t applied_seq;
+    float32_t osc_cos;                  // oscillator step
+    float32_t osc_sin;
+    float32_t osc_i;                    // oscillator phasor
+    float32_t osc_q;
+    volatile uint32_t count;            // decimated samples written since the restart, ring position is count % SNAP_ESTIMATOR_RING_LEN
+    volatile uint32_t generation;       // config_seq the samples in the ring belong to
+
+    // main loop
+    uint32_t last_count;                // count at the last estimate
+} SnapEstimator_t;
+
+static SnapEstimator_t snap_estimator;
+
+static ZoomDecimate_t snap_decimate;
+static float32_t snap_ring_i[SNAP_ESTIMATOR_RING_LEN];
+static float32_t snap_ring_q[SNAP_ESTIMATOR_RING_LEN];
+
+static float32_t snap_samples[2 * SNAP_ESTIMATOR_LEN];  // windowed samples, interleaved I,Q
+static float32_t snap_fft[2 * SNAP_ESTIMATOR_LEN];
+
+/**
+ * Sets what to look for. The sample collection only restarts if something changed,
+ * so this may be called in each main loop run.
+ * @param enable false stops the sample collection in the audio interrupt
+ * @param center expected distance of the carrier from the rx frequency in Hz
+ * @param range in Hz, the carrier is searched within center +/- range, at most SNAP_ESTIMATOR_RANGE_MAX
+ */
+void SnapEstimator_Configure(bool enable, float32_t center, float32_t range)
+{
+    snap_estimator.range = range < SNAP_ESTIMATOR_RANGE_MAX ? range : SNAP_ESTIMATOR_RANGE_MAX;
+
+    if (enable != snap_estimator.enable || center != snap_estimator.center)
+    {
+        snap_estimator.enable = enable;
+        snap_estimator.center = center;
+        SnapEstimator_Restart();
+    }
+}
+
+/**
+ * Discards the collected samples, the next estimate will only use samples received from now on
+ */
+void SnapEstimator_Restart()
+{
+    snap_estimator.last_count = 0;
+    __DMB();
+    snap_estimator.config_seq++;
+}
+
+/**
+ * Collects the samples for the estimator, to be called from the audio interrupt
+ * @param i_buffer, q_buffer iq signal at IQ_SAMPLE_RATE with the rx frequency at 0 Hz
+ */
+void SnapEstimator_ProcessSamples(const float32_t* i_buffer, const float32_t* q_buffer, const uint16_t blockSize)
+{
+    const uint32_t config_seq = snap_estimator.config_seq;
+
+    if (config_seq != snap_estimator.applied_seq)
+    {
+        snap_estimator.applied_seq = config_seq;
+
+        ZoomDecimate_Init(&snap_decimate, SNAP_ESTIMATOR_MAGNIFY);
+
+        // cosf/sinf, the table interpolation of arm_cos_f32/arm_sin_f32 would shift the oscillator by up to 0.1 Hz
+        const float32_t rate = - 2 * PI * snap_estimator.center / IQ_SAMPLE_RATE_F;
+        snap_estimator.osc_cos = cosf(rate);
+        snap_estimator.osc_sin = sinf(rate);
+        snap_estimator.osc_i = 1.0;
+        snap_estimator.osc_q = 0.0;
+
+        snap_estimator.count = 0;
+        __DMB();
+        snap_estimator.generation = config_seq;
+    }
+
+    if (snap_estimator.enable)
+    {
+        float32_t i_shifted[blockSize];
+        float32_t q_shifted[blockSize];
+
+        float32_t osc_i = snap_estimator.osc_i;
+        float32_t osc_q = snap_estimator.osc_q;
+
+        for (uint16_t idx = 0; idx < blockSize; idx++)
+        {
+            i_shifted[idx] = i_buffer[idx] * osc_i - q_buffer[idx] * osc_q;
+            q_shifted[idx] = i_buffer[idx] * osc_q + q_buffer[idx] * osc_i;
+
+            const float32_t next_i = osc_i * snap_estimator.osc_cos - osc_q * snap_estimator.osc_sin;
+            osc_q = osc_q * snap_estimator.osc_cos + osc_i * snap_estimator.osc_sin;
+            osc_i = next_i;
+        }
+
+        // keep the amplitude of the oscillator at 1, a first order correction is sufficient
+        const float32_t gain = 1.5 - 0.5 * (osc_i * osc_i + osc_q * osc_q);
+        snap_estimator.osc_i = osc_i * gain;
+        snap_estimator.osc_q = osc_q * gain;
+
+        const uint16_t decim_size = ZoomDecimate_Process(&snap_decimate, i_shifted, q_shifted, i_shifted, q_shifted, blockSize);
+
+        uint32_t count = snap_estimator.count;
+        for (uint16_t idx = 0; idx < decim_size; idx++)
+        {
+            snap_ring_i[count % SNAP_ESTIMATOR_RING_LEN] = i_shifted[idx];
+            snap_ring_q[count % SNAP_ESTIMATOR_RING_LEN] = q_shifted[idx];
+            count++;
+        }
+
+        // publish the samples only after they have been written
+        __DMB();
+        snap_estimator.count = count;
+    }
+}
+
+/**
+ * Power of the DTFT of the windowed samples at a single frequency
+ */
+static float32_t SnapEstimator_Power(const float32_t freq)
+{
+    // not arm_cos_f32/arm_sin_f32, their error moves the refined estimate by several 10 mHz
+    const float32_t rate = - 2 * PI * freq / SNAP_ESTIMATOR_SAMPLE_RATE;
+    const float32_t step_cos = cosf(rate);
+    const float32_t step_sin = sinf(rate);
+
+    float32_t osc_i = 1.0;
+    float32_t osc_q = 0.0;
+    float32_t sum_i = 0.0;
+    float32_t sum_q = 0.0;
+
+    for (uint16_t idx = 0; idx < SNAP_ESTIMATOR_LEN; idx++)
+    {
+        const float32_t i = snap_samples[2 * idx];
+        const float32_t q = snap_samples[2 * idx + 1];
+
+        sum_i += i * osc_i - q * osc_q;
+        sum_q += i * osc_q + q * osc_i;
+
+        const float32_t next_i = osc_i * step_cos - osc_q * step_sin;
+        osc_q = osc_q * step_cos + osc_i * step_sin;
+        osc_i = next_i;
+    }
+
+    return sum_i * sum_i + sum_q * sum_q;
+}
+
+/**
+ * Calculates a new estimate if enough new samples have been collected, to be called from the main loop
+ * @param delta_p returns the distance of the carrier from the center in Hz (positive = carrier above the center)
+ * @return true if there is a new estimate, false if there are not enough new samples or no carrier has been found
+ */
+bool SnapEstimator_Estimate(float32_t* delta_p)
+{
+    bool retval = false;
+
+    const uint32_t generation = snap_estimator.generation;
+    const uint32_t count = snap_estimator.count;
+
+    if (snap_estimator.enable && generation == snap_estimator.config_seq
+            && count >= SNAP_ESTIMATOR_LEN && count - snap_estimator.last_count >= SNAP_ESTIMATOR_HOP)
+    {
+        snap_estimator.last_count = count;
+        __DMB();
+
+        // copy the latest samples with a Hann window applied
+        const uint32_t start = count - SNAP_ESTIMATOR_LEN;
+        for (uint16_t idx = 0; idx < SNAP_ESTIMATOR_LEN; idx++)
+        {
+            const float32_t window = 0.5 - 0.5 * arm_cos_f32(2 * PI * idx / SNAP_ESTIMATOR_LEN);
+            snap_samples[2 * idx] = snap_ring_i[(start + idx) % SNAP_ESTIMATOR_RING_LEN] * window;
+            snap_samples[2 * idx + 1] = snap_ring_q[(start + idx) % SNAP_ESTIMATOR_RING_LEN] * window;
+        }
+
+        // coarse estimate: strongest FFT bin within the search range
+        arm_copy_f32(snap_samples, snap_fft, 2 * SNAP_ESTIMATOR_LEN);
+        arm_cfft_f32(&arm_cfft_sR_f32_len128, snap_fft, 0, 1);
+        arm_cmplx_mag_squared_f32(snap_fft, snap_fft, SNAP_ESTIMATOR_LEN);   // in place is fine, output index <= input index
+
+        float32_t mean_power;
+        arm_mean_f32(snap_fft, SNAP_ESTIMATOR_LEN, &mean_power);
+
+        const int16_t range_bins = snap_estimator.range / SNAP_ESTIMATOR_BIN_WIDTH;
+        float32_t max_power = 0.0;
+        int16_t max_bin = 0;
+
+        for (int16_t bin = -range_bins; bin <= range_bins; bin++)
+        {
+            const float32_t power = snap_fft[bin & (SNAP_ESTIMATOR_LEN - 1)];
+            if (power > max_power)
+            {
+                max_power = power;
+                max_bin = bin;
+            }
+        }
+
+        if (max_power > SNAP_ESTIMATOR_MIN_PEAK_RATIO * mean_power)
+        {
+            // fine estimate: iterative parabolic interpolation on the DTFT power around the maximum
+            float32_t freq = max_bin * SNAP_ESTIMATOR_BIN_WIDTH;
+            float32_t spacing = SNAP_ESTIMATOR_BIN_WIDTH / 2;
+
+            for (uint16_t iteration = 0; iteration < SNAP_ESTIMATOR_ITERATIONS; iteration++)
+            {
+                const float32_t power_left = SnapEstimator_Power(freq - spacing);
+                const float32_t power_center = SnapEstimator_Power(freq);
+                const float32_t power_right = SnapEstimator_Power(freq + spacing);
+
+                const float32_t curvature = power_left - 2 * power_center + power_right;
+                if (curvature >= 0)
+                {
+                    // not a maximum, can only happen if the carrier is buried in noise
+                    break;
+                }
+
+                float32_t correction = 0.5 * spacing * (power_left - power_right) / curvature;
+                if (correction > spacing)
+                {
+                    correction = spacing;
+                }
+                else if (correction < -spacing)
+                {
+                    correction = -spacing;
+                }
+                freq += correction;
+
+                if (fabsf(correction) < SNAP_ESTIMATOR_PRECISION)
+                {
+                    break;
+                }
+                if (spacing > SNAP_ESTIMATOR_BIN_WIDTH / 32)
+                {
+                    spacing /= 4;
+                }
+            }
+
+            *delta_p = freq;
+            retval = true;
+        }
+    }
+    return retval;
+}
@@ -0,0 +1,30 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     snap_estimator.h                                                **
+ **  Description:   sub-bin carrier frequency estimator for SNAP                    **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#ifndef __SNAP_ESTIMATOR_H
+#define __SNAP_ESTIMATOR_H
+
+#include "uhsdr_types.h"
+#include "arm_math.h"
+
+#define SNAP_ESTIMATOR_MAGNIFY      6           // decimation by 2^6: 48ksps -> 750sps
+#define SNAP_ESTIMATOR_LEN          128         // samples per estimate, 171ms at 750sps
+#define SNAP_ESTIMATOR_HOP          32          // new samples between two estimates, 43ms at 750sps
+#define SNAP_ESTIMATOR_RANGE_MAX    250.0       // Hz, largest usable distance of the carrier from the center
+
+void SnapEstimator_Configure(bool enable, float32_t center, float32_t range);
+void SnapEstimator_Restart(void);
+void SnapEstimator_ProcessSamples(const float32_t* i_buffer, const float32_t* q_buffer, const uint16_t blockSize);
+bool SnapEstimator_Estimate(float32_t* delta_p);
+
+#endif
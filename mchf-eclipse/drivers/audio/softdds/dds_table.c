@@ -15,75 +15,42 @@
 #include "uhsdr_types.h"
 #include "dds_table.h"
 
-// this table represents 2*PI, i.e. a full sine wave
-const int16_t DDS_TABLE[DDS_TBL_SIZE] =
+// this table represents PI/2, i.e. a quarter of a sine wave with amplitude 2^15-1
+// in DDS_TBL_SIZE / 4 steps. The first entries of the next quarter are appended,
+// so that the linear interpolation never has to wrap around.
+const float32_t DDS_QTABLE[DDS_QTBL_SIZE + 2] =
 {
-
-    // 1024 points
-    0,
-    201, 402, 603, 804, 1005, 1206, 1406, 1607, 1808, 2009, 2209, 2410, 2610, 2811, 3011,
-    3211, 3411, 3611, 3811, 4011, 4210, 4409, 4608, 4807, 5006, 5205, 5403, 5601, 5799, 5997, 6195,
-    6392, 6589, 6786, 6982, 7179, 7375, 7571, 7766, 7961, 8156, 8351, 8545, 8739, 8932, 9126, 9319,
-    9511, 9703, 9895, 10087, 10278, 10469, 10659, 10849, 11038, 11227, 11416, 11604, 11792, 11980, 12166, 12353,
-    12539, 12724, 12909, 13094, 13278, 13462, 13645, 13827, 14009, 14191, 14372, 14552, 14732, 14911, 15090, 15268,
-    15446, 15623, 15799, 15975, 16150, 16325, 16499, 16672, 16845, 17017, 17189, 17360, 17530, 17699, 17868, 18036,
-    18204, 18371, 18537, 18702, 18867, 19031, 19194, 19357, 19519, 19680, 19840, 20000, 20159, 20317, 20474, 20631,
-    20787, 20942, 21096, 21249, 21402, 21554, 21705, 21855, 22004, 22153, 22301, 22448, 22594, 22739, 22883, 23027,
-    23169, 23311, 23452, 23592, 23731, 23869, 24006, 24143, 24278, 24413, 24546, 24679, 24811, 24942, 25072, 25201,
-    25329, 25456, 25582, 25707, 25831, 25954, 26077, 26198, 26318, 26437, 26556, 26673, 26789, 26905, 27019, 27132,
-    27244, 27355, 27466, 27575, 27683, 27790, 27896, 28001, 28105, 28208, 28309, 28410, 28510, 28608, 28706, 28802,
-    28897, 28992, 29085, 29177, 29268, 29358, 29446, 29534, 29621, 29706, 29790, 29873, 29955, 30036, 30116, 30195,
-    30272, 30349, 30424, 30498, 30571, 30643, 30713, 30783, 30851, 30918, 30984, 31049, 31113, 31175, 31236, 31297,
-    31356, 31413, 31470, 31525, 31580, 31633, 31684, 31735, 31785, 31833, 31880, 31926, 31970, 32014, 32056, 32097,
-    32137, 32176, 32213, 32249, 32284, 32318, 32350, 32382, 32412, 32441, 32468, 32495, 32520, 32544, 32567, 32588,
-    32609, 32628, 32646, 32662, 32678, 32692, 32705, 32717, 32727, 32736, 32744, 32751, 32757, 32761, 32764, 32766,
-    32766, 32766, 32764, 32761, 32757, 32751, 32744, 32736, 32727, 32717, 32705, 32692, 32678, 32662, 32646, 32628,
-    32609, 32588, 32567, 32544, 32520, 32495, 32468, 32441, 32412, 32382, 32350, 32318, 32284, 32249, 32213, 32176,
-    32137, 32097, 32056, 32014, 31970, 31926, 31880, 31833, 31785, 31735, 31684, 31633, 31580, 31525, 31470, 31413,
-    31356, 31297, 31236, 31175, 31113, 31049, 30984, 30918, 30851, 30783, 30713, 30643, 30571, 30498, 30424, 30349,
-    30272, 30195, 30116, 30036, 29955, 29873, 29790, 29706, 29621, 29534, 29446, 29358, 29268, 29177, 29085, 28992,
-    28897, 28802, 28706, 28608, 28510, 28410, 28309, 28208, 28105, 28001, 27896, 27790, 27683, 27575, 27466, 27355,
-    27244, 27132, 27019, 26905, 26789, 26673, 26556, 26437, 26318, 26198, 26077, 25954, 25831, 25707, 25582, 25456,
-    25329, 25201, 25072, 24942, 24811, 24679, 24546, 24413, 24278, 24143, 24006, 23869, 23731, 23592, 23452, 23311,
-    23169, 23027, 22883, 22739, 22594, 22448, 22301, 22153, 22004, 21855, 21705, 21554, 21402, 21249, 21096, 20942,
-    20787, 20631, 20474, 20317, 20159, 20000, 19840, 19680, 19519, 19357, 19194, 19031, 18867, 18702, 18537, 18371,
-    18204, 18036, 17868, 17699, 17530, 17360, 17189, 17017, 16845, 16672, 16499, 16325, 16150, 15975, 15799, 15623,
-    15446, 15268, 15090, 14911, 14732, 14552, 14372, 14191, 14009, 13827, 13645, 13462, 13278, 13094, 12909, 12724,
-    12539, 12353, 12166, 11980, 11792, 11604, 11416, 11227, 11038, 10849, 10659, 10469, 10278, 10087, 9895, 9703,
-    9511, 9319, 9126, 8932, 8739, 8545, 8351, 8156, 7961, 7766, 7571, 7375, 7179, 6982, 6786, 6589,
-    6392, 6195, 5997, 5799, 5601, 5403, 5205, 5006, 4807, 4608, 4409, 4210, 4011, 3811, 3611, 3411,
-    3211, 3011, 2811, 2610, 2410, 2209, 2009, 1808, 1607, 1406, 1206, 1005, 804, 603, 402, 201,
-    0,
-    -201, -402, -603, -804, -1005, -1206, -1406, -1607, -1808, -2009, -2209, -2410, -2610, -2811, -3011,
-    -3211, -3411, -3611, -3811, -4011, -4210, -4409, -4608, -4807, -5006, -5205, -5403, -5601, -5799, -5997, -6195,
-    -6392, -6589, -6786, -6982, -7179, -7375, -7571, -7766, -7961, -8156, -8351, -8545, -8739, -8932, -9126, -9319,
-    -9511, -9703, -9895, -10087, -10278, -10469, -10659, -10849, -11038, -11227, -11416, -11604, -11792, -11980, -12166, -12353,
-    -12539, -12724, -12909, -13094, -13278, -13462, -13645, -13827, -14009, -14191, -14372, -14552, -14732, -14911, -15090, -15268,
-    -15446, -15623, -15799, -15975, -16150, -16325, -16499, -16672, -16845, -17017, -17189, -17360, -17530, -17699, -17868, -18036,
-    -18204, -18371, -18537, -18702, -18867, -19031, -19194, -19357, -19519, -19680, -19840, -20000, -20159, -20317, -20474, -20631,
-    -20787, -20942, -21096, -21249, -21402, -21554, -21705, -21855, -22004, -22153, -22301, -22448, -22594, -22739, -22883, -23027,
-    -23169, -23311, -23452, -23592, -23731, -23869, -24006, -24143, -24278, -24413, -24546, -24679, -24811, -24942, -25072, -25201,
-    -25329, -25456, -25582, -25707, -25831, -25954, -26077, -26198, -26318, -26437, -26556, -26673, -26789, -26905, -27019, -27132,
-    -27244, -27355, -27466, -27575, -27683, -27790, -27896, -28001, -28105, -28208, -28309, -28410, -28510, -28608, -28706, -28802,
-    -28897, -28992, -29085, -29177, -29268, -29358, -29446, -29534, -29621, -29706, -29790, -29873, -29955, -30036, -30116, -30195,
-    -30272, -30349, -30424, -30498, -30571, -30643, -30713, -30783, -30851, -30918, -30984, -31049, -31113, -31175, -31236, -31297,
-    -31356, -31413, -31470, -31525, -31580, -31633, -31684, -31735, -31785, -31833, -31880, -31926, -31970, -32014, -32056, -32097,
-    -32137, -32176, -32213, -32249, -32284, -32318, -32350, -32382, -32412, -32441, -32468, -32495, -32520, -32544, -32567, -32588,
-    -32609, -32628, -32646, -32662, -32678, -32692, -32705, -32717, -32727, -32736, -32744, -32751, -32757, -32761, -32764, -32766,
-    -32766, -32766, -32764, -32761, -32757, -32751, -32744, -32736, -32727, -32717, -32705, -32692, -32678, -32662, -32646, -32628,
-    -32609, -32588, -32567, -32544, -32520, -32495, -32468, -32441, -32412, -32382, -32350, -32318, -32284, -32249, -32213, -32176,
-    -32137, -32097, -32056, -32014, -31970, -31926, -31880, -31833, -31785, -31735, -31684, -31633, -31580, -31525, -31470, -31413,
-    -31356, -31297, -31236, -31175, -31113, -31049, -30984, -30918, -30851, -30783, -30713, -30643, -30571, -30498, -30424, -30349,
-    -30272, -30195, -30116, -30036, -29955, -29873, -29790, -29706, -29621, -29534, -29446, -29358, -29268, -29177, -29085, -28992,
-    -28897, -28802, -28706, -28608, -28510, -28410, -28309, -28208, -28105, -28001, -27896, -27790, -27683, -27575, -27466, -27355,
-    -27244, -27132, -27019, -26905, -26789, -26673, -26556, -26437, -26318, -26198, -26077, -25954, -25831, -25707, -25582, -25456,
-    -25329, -25201, -25072, -24942, -24811, -24679, -24546, -24413, -24278, -24143, -24006, -23869, -23731, -23592, -23452, -23311,
-    -23169, -23027, -22883, -22739, -22594, -22448, -22301, -22153, -22004, -21855, -21705, -21554, -21402, -21249, -21096, -20942,
-    -20787, -20631, -20474, -20317, -20159, -20000, -19840, -19680, -19519, -19357, -19194, -19031, -18867, -18702, -18537, -18371,
-    -18204, -18036, -17868, -17699, -17530, -17360, -17189, -17017, -16845, -16672, -16499, -16325, -16150, -15975, -15799, -15623,
-    -15446, -15268, -15090, -14911, -14732, -14552, -14372, -14191, -14009, -13827, -13645, -13462, -13278, -13094, -12909, -12724,
-    -12539, -12353, -12166, -11980, -11792, -11604, -11416, -11227, -11038, -10849, -10659, -10469, -10278, -10087, -9895, -9703,
-    -9511, -9319, -9126, -8932, -8739, -8545, -8351, -8156, -7961, -7766, -7571, -7375, -7179, -6982, -6786, -6589,
-    -6392, -6195, -5997, -5799, -5601, -5403, -5205, -5006, -4807, -4608, -4409, -4210, -4011, -3811, -3611, -3411,
-    -3211, -3011, -2811, -2610, -2410, -2209, -2009, -1808, -1607, -1406, -1206, -1005, -804, -603, -402, -201
+    0.0000, 201.0545, 402.1015, 603.1333, 804.1424, 1005.1213, 1206.0623, 1406.9579,
+    1607.8005, 1808.5826, 2009.2966, 2209.9349, 2410.4901, 2610.9544, 2811.3205, 3011.5808,
+    3211.7276, 3411.7536, 3611.6511, 3811.4126, 4011.0306, 4210.4976, 4409.8061, 4608.9485,
+    4807.9175, 5006.7054, 5205.3048, 5403.7082, 5601.9082, 5799.8973, 5997.6680, 6195.2129,
+    6392.5246, 6589.5956, 6786.4185, 6982.9859, 7179.2903, 7375.3245, 7571.0810, 7766.5525,
+    7961.7316, 8156.6109, 8351.1831, 8545.4409, 8739.3769, 8932.9840, 9126.2547, 9319.1818,
+    9511.7580, 9703.9762, 9895.8289, 10087.3092, 10278.4096, 10469.1230, 10659.4423, 10849.3603,
+    11038.8698, 11227.9637, 11416.6349, 11604.8762, 11792.6807, 11980.0411, 12166.9505, 12353.4018,
+    12539.3880, 12724.9021, 12909.9372, 13094.4862, 13278.5421, 13462.0982, 13645.1474, 13827.6829,
+    14009.6977, 14191.1852, 14372.1383, 14552.5503, 14732.4144, 14911.7239, 15090.4719, 15268.6518,
+    15446.2569, 15623.2804, 15799.7157, 15975.5561, 16150.7951, 16325.4260, 16499.4422, 16672.8373,
+    16845.6046, 17017.7377, 17189.2301, 17360.0754, 17530.2670, 17699.7986, 17868.6639, 18036.8564,
+    18204.3698, 18371.1979, 18537.3342, 18702.7727, 18867.5070, 19031.5310, 19194.8384, 19357.4232,
+    19519.2791, 19680.4002, 19840.7803, 20000.4134, 20159.2935, 20317.4147, 20474.7708, 20631.3562,
+    20787.1647, 20942.1907, 21096.4282, 21249.8714, 21402.5145, 21554.3519, 21705.3778, 21855.5865,
+    22004.9723, 22153.5296, 22301.2529, 22448.1365, 22594.1750, 22739.3629, 22883.6946, 23027.1647,
+    23169.7679, 23311.4988, 23452.3520, 23592.3222, 23731.4042, 23869.5927, 24006.8825, 24143.2685,
+    24278.7455, 24413.3085, 24546.9522, 24679.6718, 24811.4623, 24942.3186, 25072.2358, 25201.2091,
+    25329.2335, 25456.3044, 25582.4168, 25707.5660, 25831.7474, 25954.9562, 26077.1879, 26198.4377,
+    26318.7012, 26437.9738, 26556.2510, 26673.5284, 26789.8016, 26905.0661, 27019.3177, 27132.5520,
+    27244.7648, 27355.9518, 27466.1089, 27575.2319, 27683.3168, 27790.3593, 27896.3556, 28001.3016,
+    28105.1934, 28208.0270, 28309.7986, 28410.5043, 28510.1404, 28608.7032, 28706.1888, 28802.5936,
+    28897.9141, 28992.1465, 29085.2874, 29177.3333, 29268.2807, 29358.1261, 29446.8662, 29534.4977,
+    29621.0172, 29706.4214, 29790.7073, 29873.8716, 29955.9111, 30036.8228, 30116.6036, 30195.2505,
+    30272.7606, 30349.1310, 30424.3587, 30498.4410, 30571.3750, 30643.1581, 30713.7874, 30783.2604,
+    30851.5744, 30918.7268, 30984.7152, 31049.5371, 31113.1899, 31175.6713, 31236.9790, 31297.1107,
+    31356.0640, 31413.8368, 31470.4268, 31525.8321, 31580.0503, 31633.0797, 31684.9180, 31735.5635,
+    31785.0141, 31833.2680, 31880.3234, 31926.1786, 31970.8317, 32014.2812, 32056.5253, 32097.5625,
+    32137.3913, 32176.0101, 32213.4175, 32249.6121, 32284.5925, 32318.3574, 32350.9056, 32382.2357,
+    32412.3467, 32441.2374, 32468.9067, 32495.3535, 32520.5769, 32544.5759, 32567.3497, 32588.8973,
+    32609.2179, 32628.3109, 32646.1754, 32662.8107, 32678.2164, 32692.3917, 32705.3362, 32717.0493,
+    32727.5307, 32736.7799, 32744.7966, 32751.5804, 32757.1312, 32761.4487, 32764.5327, 32766.3832,
+    32767.0000, 32766.3832
 };
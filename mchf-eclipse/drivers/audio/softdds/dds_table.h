@@ -16,9 +16,14 @@
 #define __DDS_TABLE_H
 
 
+#include "uhsdr_types.h"
+
+// resolution of the table in steps per full sine wave, only a quarter wave is stored
 #define DDS_TBL_BITS        10
 #define DDS_TBL_SIZE        (1 << DDS_TBL_BITS) // 10 = 1024
+#define DDS_QTBL_BITS       (DDS_TBL_BITS - 2)
+#define DDS_QTBL_SIZE       (1 << DDS_QTBL_BITS) // 256
 
-extern const int16_t DDS_TABLE[DDS_TBL_SIZE];
+extern const float32_t DDS_QTABLE[DDS_QTBL_SIZE + 2];
 
 #endif
@@ -14,8 +14,16 @@
 
 // Credits - SDR cube!!!
 
+// The sine wave is taken from a quarter wave table with linear interpolation,
+// the worst case error is below 5E-6 of full scale, i.e. spurs are below -100dBc.
+//
+// IQ signals are generated in blocks: the start of each block is taken from the
+// table, the following samples are calculated by rotating the IQ vector by one
+// dds step. This costs less than two table lookups per sample and since we restart
+// from the exact phase of the accumulator with every block, no error accumulates.
+
 // Common
-#include "uhsdr_board.h"
+#include "uhsdr_types.h"
 #include "dds_table.h"
 #include "softdds.h"
 
@@ -44,6 +52,11 @@ void softdds_setFreqDDS(soft_dds_t* softdds_p, float32_t freq, uint32_t samp_rat
     }
     // Calculate new step
     softdds_p->step = softdds_stepForSampleRate(freq,samp_rate);
+
+    // and the IQ vector rotation for one step
+    const float32_t step_rad = (2 * PI / 4294967296.0) * softdds_p->step;
+    softdds_p->rot_cos = cosf(step_rad);
+    softdds_p->rot_sin = sinf(step_rad);
 }
 
 
@@ -57,24 +70,49 @@ void softdds_configRunIQ(float freq[2],uint32_t samp_rate,uint8_t smooth)
     softdds_setFreqDDS(&dbldds[1],freq[1],samp_rate,smooth);
   }
 
+/**
+ * Generates IQ data for a single tone, I = sin(a), Q = -cos(a), i.e. Q is shifted by -90 degrees
+ * @param dds the previously initialized dds configuration
+ * @param i_buff I output, added to if accumulate is true
+ * @param q_buff Q output, added to if accumulate is true
+ * @param size number of samples
+ * @param scaling applied to the generated samples
+ * @param accumulate add to the buffers instead of overwriting them
+ */
+static inline void softdds_genIQBlock(soft_dds_t* dds, float32_t *i_buff, float32_t *q_buff, const uint16_t size, const float32_t scaling, const bool accumulate)
+{
+    // start vector of the block, exact phase of the accumulator
+    float32_t sin_a = softdds_sinPhase(dds->acc) * scaling;
+    float32_t cos_a = softdds_sinPhase(dds->acc + SOFTDDS_QUARTER) * scaling;
+
+    const float32_t rot_cos = dds->rot_cos;
+    const float32_t rot_sin = dds->rot_sin;
+
+    for(uint16_t i = 0; i < size; i++)
+    {
+        if (accumulate)
+        {
+            i_buff[i] += sin_a;
+            q_buff[i] -= cos_a;
+        }
+        else
+        {
+            i_buff[i] = sin_a;
+            q_buff[i] = -cos_a;
+        }
+
+        // rotate by one step
+        const float32_t sin_next = sin_a * rot_cos + cos_a * rot_sin;
+        cos_a = cos_a * rot_cos - sin_a * rot_sin;
+        sin_a = sin_next;
+    }
+
+    dds->acc += dds->step * size;
+}
+
 void softdds_genIQSingleTone(soft_dds_t* dds, float32_t *i_buff,float32_t *q_buff,uint16_t size)
 {
-	for(uint16_t i = 0; i < size; i++)
-	{
-		// Calculate next sample
-		uint32_t k    = softdds_nextSampleIndex(dds);
-
-		// Load I value (sin)
-		*i_buff = DDS_TABLE[k];
-
-		// -90 degrees shift (cos)
-		// Load Q value
-		*q_buff = DDS_TABLE[softdds_phase_shift90(k)];
-
-		// Next ptr
-		i_buff++;
-		q_buff++;
-	}
+    softdds_genIQBlock(dds, i_buff, q_buff, size, 1.0, false);
 }
 
 /*
@@ -84,22 +122,9 @@ void softdds_genIQSingleTone(soft_dds_t* dds, float32_t *i_buff,float32_t *q_buf
  */
 void softdds_genIQTwoTone(soft_dds_t* ddsA, soft_dds_t* ddsB, float *i_buff,float *q_buff,ushort size)
 {
-    for(int i = 0; i < size; i++)
-    {
-        uint32_t k[2];
-        // Calculate next sample
-        k[0]    = softdds_nextSampleIndex(ddsA);
-        k[1]    = softdds_nextSampleIndex(ddsB);
-
-        // Load I value 0.5*(sin(a)+sin(b))
-        *i_buff = ((int32_t)DDS_TABLE[k[0]] + (int32_t)DDS_TABLE[k[1]])/2;
-
-        *q_buff = ((int32_t)DDS_TABLE[softdds_phase_shift90(k[0])] + (int32_t)DDS_TABLE[softdds_phase_shift90(k[1])])/2;
-
-        // Next ptr
-        i_buff++;
-        q_buff++;
-    }
+    // 0.5*(sin(a)+sin(b))
+    softdds_genIQBlock(ddsA, i_buff, q_buff, size, 0.5, false);
+    softdds_genIQBlock(ddsB, i_buff, q_buff, size, 0.5, true);
 }
 
 /**
@@ -114,7 +139,7 @@ void softdds_addSingleTone(soft_dds_t* dds_ptr, float32_t* buffer, const size_t
 {
     for(int i=0; i < blockSize; i++)                            // transfer to DMA buffer and do conversion to INT
     {
-        buffer[i] += (float32_t)softdds_nextSample(dds_ptr) * scaling; // load indexed sine wave value, adding it to audio, scaling the amplitude and putting it on "b" - speaker (ONLY)
+        buffer[i] += softdds_nextSampleFloat(dds_ptr) * scaling; // load indexed sine wave value, adding it to audio, scaling the amplitude and putting it on "b" - speaker (ONLY)
     }
 }
 
@@ -132,7 +157,7 @@ void softdds_addSingleToneToTwobuffers(soft_dds_t* dds_ptr, float32_t* buffer1,
     float32_t Tone;
     for(int i=0; i < blockSize; i++)                            // transfer to DMA buffer and do conversion to INT
     {
-        Tone=(float32_t) softdds_nextSample(dds_ptr) * scaling; // load indexed sine wave value, adding it to audio, scaling the amplitude and putting it on "b" - speaker (ONLY)
+        Tone=softdds_nextSampleFloat(dds_ptr) * scaling; // load indexed sine wave value, adding it to audio, scaling the amplitude and putting it on "b" - speaker (ONLY)
         buffer1[i] += Tone;
         buffer2[i] += Tone;
     }
@@ -17,9 +17,15 @@
 
 #include "dds_table.h"
 
-// we use a 32 bit accumulator
+// we use a 32 bit accumulator, the full accumulator range represents 2*PI
 #define SOFTDDS_ACC_SHIFT       (32-DDS_TBL_BITS)
 
+// the upper two bits of the phase select the quarter of the sine wave,
+// the next DDS_QTBL_BITS the table entry, the rest is used for the interpolation
+#define SOFTDDS_QUARTER         (1UL << 30)
+#define SOFTDDS_FRAC_BITS       (30-DDS_QTBL_BITS)
+#define SOFTDDS_FRAC_MASK       ((1UL << SOFTDDS_FRAC_BITS) - 1)
+
 // Soft DDS public structure
 typedef struct
 {
@@ -28,41 +34,52 @@ typedef struct
 
 	// DDS step - not working if part of the structure
 	uint32_t   step;
+
+	// rotation by one step, used for the block generation of IQ data
+	float32_t  rot_cos;
+	float32_t  rot_sin;
 } soft_dds_t;
 
 
 /**
- * Execute a single step in the sinus generation
+ * Get the sine value for a given phase, linear interpolation in the quarter wave table
+ * min/max value is +/-2^15-1
+ * @param phase 0 ... 2^32-1 represents 0 ... 2*PI
  */
-inline uint32_t softdds_nextSampleIndex(soft_dds_t* dds)
+static inline float32_t softdds_sinPhase(uint32_t phase)
 {
-    uint32_t retval = (dds->acc >> SOFTDDS_ACC_SHIFT)%DDS_TBL_SIZE;
-
-	dds->acc += dds->step;
-
-	// now scale down precision and  make sure that
-	// index wraps around properly
-	return retval;
+    uint32_t pos = phase & (SOFTDDS_QUARTER - 1);
+    if (phase & SOFTDDS_QUARTER)
+    {
+        // second and fourth quarter are the mirrored first one
+        pos = SOFTDDS_QUARTER - pos;
+    }
+
+    const uint32_t idx = pos >> SOFTDDS_FRAC_BITS;
+    const float32_t frac = (float32_t)(pos & SOFTDDS_FRAC_MASK) * (1.0f / (1UL << SOFTDDS_FRAC_BITS));
+    const float32_t val = DDS_QTABLE[idx] + (DDS_QTABLE[idx + 1] - DDS_QTABLE[idx]) * frac;
+
+    // second half of the wave is negative
+    return (phase & (2 * SOFTDDS_QUARTER)) ? -val : val;
 }
 
-/*
- * Get the index which represents a -90 degree shift compared to
- * k, i.e. get  k = sin(a) => cos(a)
+/**
+ * Execute a single step in the sinus generation and return actual sample value
  */
-inline uint32_t softdds_phase_shift90(uint32_t k)
+static inline float32_t softdds_nextSampleFloat(soft_dds_t* dds)
 {
-    // make sure that
-    // index wraps around properly
-    return (k+(3*DDS_TBL_SIZE/4))%DDS_TBL_SIZE;
+    const float32_t retval = softdds_sinPhase(dds->acc);
+    dds->acc += dds->step;
+    return retval;
 }
 
-
 /**
  * Execute a single step in the sinus generation and return actual sample value
  */
-inline int16_t softdds_nextSample(soft_dds_t* dds)
+static inline int16_t softdds_nextSample(soft_dds_t* dds)
 {
-	return DDS_TABLE[softdds_nextSampleIndex(dds)];
+    const float32_t val = softdds_nextSampleFloat(dds);
+    return val < 0 ? val - 0.5f : val + 0.5f;
 }
 
 
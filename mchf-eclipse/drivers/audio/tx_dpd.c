@@ -0,0 +1,554 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     tx_dpd.c                                                        **
+ **  Description:   lookup table based digital predistortion of the tx iq signal   **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * The predistorter multiplies each tx iq sample with a complex correction factor which
+ * depends on the envelope magnitude of the sample. The correction factors (gain for AM/AM,
+ * phase for AM/PM) are kept in a small table with TX_DPD_LUT_SIZE knots, values between the
+ * knots are linearly interpolated.
+ *
+ * Adaptation: pairs of PA input (what we send to the DAC) and PA output (tx loopback) are collected.
+ * The loopback is time aligned to the PA input by searching the delay with the best envelope
+ * correlation (TxDpd_Align), no adaptation happens if the loopback does not correlate. For each knot a least squares estimate of the complex PA gain is
+ * accumulated. Once enough samples are in, the PA characteristic is normalized to its small signal
+ * gain, inverted and the result is blended into the table of the band. As the PA input is collected
+ * after the predistortion, the measured characteristic does not depend on the table in use,
+ * so the same fit works offline (on a captured data set) and online.
+ *
+ * The table math (TxDpd_Table*, TxDpd_Process, TxDpd_Stats*, TxDpd_Fit, TxDpd_Align*) and the
+ * transmitter interface use nothing but float math and are run on the host together with
+ * a PA model, see misc/tx_dpd_test.c.
+ */
+
+#include <math.h>
+#include "uhsdr_types.h"
+#include "tx_dpd.h"
+
+// knots with less captured energy are not used for the fit
+#define TX_DPD_MIN_ENERGY   1e-6
+// how much of a new fit is taken over into the table, smoothes out measurement noise
+#define TX_DPD_ADAPT_MU     0.5
+
+TxDpd_Store_t tx_dpd_store;
+
+typedef struct
+{
+    TxDpd_Lut_t lut;
+    uint8_t lut_band;           // band the lut was prepared for
+    volatile bool lut_dirty;    // table of lut_band has changed, lut has to be prepared again
+
+    TxDpd_PaStats_t stats;
+    uint8_t stats_band;         // band the loopback statistics belong to
+} TxDpd_State_t;
+
+static TxDpd_State_t tx_dpd;
+// only used if there is a tx loopback
+static TxDpd_Align_t tx_dpd_align;
+
+static inline int16_t TxDpd_ToFixed(const float32_t value, const float32_t scale)
+{
+    return roundf(value * scale);
+}
+
+/**
+ * Sets a table to "no predistortion"
+ */
+void TxDpd_TableIdentity(TxDpd_Table_t* table)
+{
+    for (uint16_t idx = 0; idx < TX_DPD_LUT_SIZE; idx++)
+    {
+        table->gain[idx] = TX_DPD_GAIN_ONE;
+        table->phase[idx] = 0;
+    }
+}
+
+/**
+ * Converts a stored table into the complex multipliers used by TxDpd_ProcessSample()
+ */
+void TxDpd_TableToLut(const TxDpd_Table_t* table, TxDpd_Lut_t* lut)
+{
+    for (uint16_t idx = 0; idx < TX_DPD_LUT_SIZE; idx++)
+    {
+        const float32_t gain = (float32_t)table->gain[idx] / TX_DPD_GAIN_ONE;
+        const float32_t phase = (float32_t)table->phase[idx] / TX_DPD_PHASE_SCALE;
+
+        lut->re[idx] = gain * cosf(phase);
+        lut->im[idx] = gain * sinf(phase);
+    }
+}
+
+/**
+ * Predistorts a block of iq samples in place, sample by sample as the final tx stage does it
+ * @param lut prepared table
+ * @param full_scale sample magnitude which corresponds to the last knot of the table
+ */
+void TxDpd_Process(const TxDpd_Lut_t* lut, float32_t* i_buffer, float32_t* q_buffer, const uint16_t blockSize, const float32_t full_scale)
+{
+    const float32_t scale = 1.0 / full_scale;
+
+    for (uint16_t idx = 0; idx < blockSize; idx++)
+    {
+        TxDpd_ProcessSample(lut, &i_buffer[idx], &q_buffer[idx], scale);
+    }
+}
+
+void TxDpd_StatsReset(TxDpd_PaStats_t* stats)
+{
+    for (uint16_t idx = 0; idx < TX_DPD_LUT_SIZE; idx++)
+    {
+        stats->yx_re[idx] = 0.0;
+        stats->yx_im[idx] = 0.0;
+        stats->xx[idx] = 0.0;
+    }
+    stats->count = 0;
+}
+
+/**
+ * Adds time aligned PA input/output samples to the PA characteristic
+ * @param x_i, x_q PA input, i.e. the predistorted samples sent to the DAC
+ * @param y_i, y_q PA output from the loopback, any fixed gain and phase of the loopback path is removed by the fit
+ * @param full_scale sample magnitude which corresponds to the last knot of the table
+ */
+void TxDpd_StatsAccumulate(TxDpd_PaStats_t* stats, const float32_t* x_i, const float32_t* x_q, const float32_t* y_i, const float32_t* y_q, const uint16_t blockSize, const float32_t full_scale)
+{
+    const float32_t scale = 1.0 / full_scale;
+
+    for (uint16_t idx = 0; idx < blockSize; idx++)
+    {
+        const float32_t xi = x_i[idx] * scale;
+        const float32_t xq = x_q[idx] * scale;
+        const float32_t yi = y_i[idx];
+        const float32_t yq = y_q[idx];
+
+        const float32_t xx = xi * xi + xq * xq;
+        // y * conj(x)
+        const float32_t yx_re = yi * xi + yq * xq;
+        const float32_t yx_im = yq * xi - yi * xq;
+
+        float32_t frac;
+        const uint16_t knot = TxDpd_Knot(sqrtf(xx), &frac);
+        const float32_t w0 = 1.0 - frac;
+
+        stats->yx_re[knot] += w0 * yx_re;
+        stats->yx_im[knot] += w0 * yx_im;
+        stats->xx[knot] += w0 * xx;
+        stats->yx_re[knot + 1] += frac * yx_re;
+        stats->yx_im[knot + 1] += frac * yx_im;
+        stats->xx[knot + 1] += frac * xx;
+    }
+    stats->count += blockSize;
+}
+
+/**
+ * Fits a predistortion table to the collected PA characteristic
+ * @param stats PA characteristic, needs at least TX_DPD_CAPTURE_MIN samples
+ * @param table table to be updated
+ * @param mu amount of the new fit taken over into the table, 1.0 replaces the table
+ * @return false if the data was not sufficient for a fit, table is unchanged in this case
+ */
+bool TxDpd_Fit(const TxDpd_PaStats_t* stats, TxDpd_Table_t* table, const float32_t mu)
+{
+    float32_t amp[TX_DPD_LUT_SIZE]; // PA output amplitude at the knots, normalized to small signal gain
+    float32_t phi[TX_DPD_LUT_SIZE]; // PA phase shift at the knots relative to small signal
+    int16_t ref = -1;
+    int16_t last = 0;
+
+    if (stats->count < TX_DPD_CAPTURE_MIN)
+    {
+        return false;
+    }
+
+    // the lowest knot with data gives the small signal gain the PA is linearized to
+    for (uint16_t k = 1; k < TX_DPD_LUT_SIZE && ref < 0; k++)
+    {
+        if (stats->xx[k] > TX_DPD_MIN_ENERGY)
+        {
+            ref = k;
+        }
+    }
+    if (ref < 0)
+    {
+        return false;
+    }
+
+    const float32_t g0_re = stats->yx_re[ref] / stats->xx[ref];
+    const float32_t g0_im = stats->yx_im[ref] / stats->xx[ref];
+    const float32_t g0_mag2 = g0_re * g0_re + g0_im * g0_im;
+
+    if (g0_mag2 == 0.0)
+    {
+        return false;
+    }
+
+    amp[0] = 0.0;
+    phi[0] = 0.0;
+
+    for (uint16_t k = 1; k < TX_DPD_LUT_SIZE; k++)
+    {
+        const float32_t r = (float32_t)k / (TX_DPD_LUT_SIZE - 1);
+
+        if (k < ref)
+        {
+            // below the first knot with data the PA is assumed to be linear
+            amp[k] = r;
+            phi[k] = 0.0;
+        }
+        else if (stats->xx[k] > TX_DPD_MIN_ENERGY)
+        {
+            const float32_t g_re = stats->yx_re[k] / stats->xx[k];
+            const float32_t g_im = stats->yx_im[k] / stats->xx[k];
+            // G / G0
+            const float32_t rel_re = (g_re * g0_re + g_im * g0_im) / g0_mag2;
+            const float32_t rel_im = (g_im * g0_re - g_re * g0_im) / g0_mag2;
+
+            amp[k] = r * sqrtf(rel_re * rel_re + rel_im * rel_im);
+            phi[k] = atan2f(rel_im, rel_re);
+
+            // a falling AM/AM curve cannot be inverted, treat it as saturated
+            if (amp[k] < amp[k - 1])
+            {
+                amp[k] = amp[k - 1];
+            }
+        }
+        else
+        {
+            // no data for higher envelopes, the table is held constant there
+            break;
+        }
+        last = k;
+    }
+
+    if (last < 2)
+    {
+        return false;
+    }
+
+    float32_t gain[TX_DPD_LUT_SIZE];
+    float32_t phase[TX_DPD_LUT_SIZE];
+
+    // invert the PA: find the PA input r which produces the desired output amplitude a
+    for (uint16_t j = 1; j < TX_DPD_LUT_SIZE; j++)
+    {
+        const float32_t a = (float32_t)j / (TX_DPD_LUT_SIZE - 1);
+        const float32_t r_last = (float32_t)last / (TX_DPD_LUT_SIZE - 1);
+        float32_t r = r_last;
+        float32_t p = phi[last];
+
+        if (a >= amp[last])
+        {
+            // PA is saturated, we drive it with the highest known level
+            // or, if we have no data for higher levels, the correction of the last known level is kept
+            r = last == TX_DPD_LUT_SIZE - 1 ? r_last : a * r_last / amp[last];
+        }
+        else
+        {
+            for (uint16_t k = 0; k < last; k++)
+            {
+                if (a < amp[k + 1])
+                {
+                    const float32_t t = (a - amp[k]) / (amp[k + 1] - amp[k]);
+                    r = (k + t) / (TX_DPD_LUT_SIZE - 1);
+                    p = phi[k] + t * (phi[k + 1] - phi[k]);
+                    break;
+                }
+            }
+        }
+
+        gain[j] = fminf(r / a, TX_DPD_GAIN_MAX);
+        phase[j] = -p;
+    }
+    // for very small signals we use the correction of the first knot
+    gain[0] = gain[1];
+    phase[0] = phase[1];
+
+    for (uint16_t j = 0; j < TX_DPD_LUT_SIZE; j++)
+    {
+        const float32_t old_gain = (float32_t)table->gain[j] / TX_DPD_GAIN_ONE;
+        const float32_t old_phase = (float32_t)table->phase[j] / TX_DPD_PHASE_SCALE;
+
+        table->gain[j] = TxDpd_ToFixed(old_gain + mu * (gain[j] - old_gain), TX_DPD_GAIN_ONE);
+        table->phase[j] = TxDpd_ToFixed(old_phase + mu * (phase[j] - old_phase), TX_DPD_PHASE_SCALE);
+    }
+
+    return true;
+}
+
+void TxDpd_AlignReset(TxDpd_Align_t* align)
+{
+    for (uint16_t idx = 0; idx < TX_DPD_HISTORY_SIZE; idx++)
+    {
+        align->x_i[idx] = 0.0;
+        align->x_q[idx] = 0.0;
+        align->x_env[idx] = 0.0;
+    }
+    align->pos = 0;
+    align->delay = -1;
+    align->mirrored = false;
+    align->state = TxDpdAlignSearch;
+    align->count = 0;
+    align->sum_x = align->sum_xx = align->sum_y = align->sum_yy = 0.0;
+    for (uint16_t d = 0; d < TX_DPD_DELAY_MAX; d++)
+    {
+        align->corr[d] = 0.0;
+    }
+}
+
+/**
+ * Picks the delay with the highest envelope correlation coefficient
+ * @return the delay or -1 if the loopback does not correlate well enough with the PA input
+ */
+static int16_t TxDpd_AlignBestDelay(const TxDpd_Align_t* align)
+{
+    const float32_t n = align->count;
+    const float32_t mean_x = align->sum_x / n;
+    const float32_t mean_y = align->sum_y / n;
+    const float32_t var_x = align->sum_xx / n - mean_x * mean_x;
+    const float32_t var_y = align->sum_yy / n - mean_y * mean_y;
+    int16_t retval = -1;
+
+    if (var_x > 0.0 && var_y > 0.0)
+    {
+        const float32_t norm = 1.0 / sqrtf(var_x * var_y);
+        float32_t best = TX_DPD_ALIGN_MIN_CORR;
+
+        for (int16_t d = 0; d < TX_DPD_DELAY_MAX; d++)
+        {
+            const float32_t rho = (align->corr[d] / n - mean_x * mean_y) * norm;
+            if (rho > best)
+            {
+                best = rho;
+                retval = d;
+            }
+        }
+    }
+    return retval;
+}
+
+/**
+ * Time aligns the loopback with the PA input. Each call adds a block of PA input and loopback samples,
+ * once the delay and the orientation of the loopback are known, the aligned pairs are returned.
+ * Call TxDpd_AlignReset() whenever the loopback path may have changed.
+ *
+ * @param x_i, x_q PA input, i.e. the samples sent to the DAC
+ * @param y_i, y_q loopback samples received at the same time
+ * @param xa_i, xa_q PA input aligned with ya
+ * @param ya_i, ya_q loopback, conjugated if the loopback has I and Q swapped
+ * @param blockSize number of samples, at most TX_DPD_HISTORY_SIZE - TX_DPD_DELAY_MAX
+ * @return true if xa and ya have been filled
+ */
+bool TxDpd_Align(TxDpd_Align_t* align, const float32_t* x_i, const float32_t* x_q, const float32_t* y_i, const float32_t* y_q,
+                 float32_t* xa_i, float32_t* xa_q, float32_t* ya_i, float32_t* ya_q, const uint16_t blockSize)
+{
+    const uint16_t mask = TX_DPD_HISTORY_SIZE - 1;
+    const uint16_t start = align->pos;
+
+    for (uint16_t idx = 0; idx < blockSize; idx++)
+    {
+        const uint16_t pos = (start + idx) & mask;
+        align->x_i[pos] = x_i[idx];
+        align->x_q[pos] = x_q[idx];
+        align->x_env[pos] = x_i[idx] * x_i[idx] + x_q[idx] * x_q[idx];
+    }
+    align->pos = (start + blockSize) & mask;
+
+    switch (align->state)
+    {
+    case TxDpdAlignSearch:
+        for (uint16_t idx = 0; idx < blockSize; idx++)
+        {
+            const uint16_t pos = start + idx;
+            const float32_t env_x = align->x_env[pos & mask];
+            const float32_t env_y = y_i[idx] * y_i[idx] + y_q[idx] * y_q[idx];
+
+            align->sum_x += env_x;
+            align->sum_xx += env_x * env_x;
+            align->sum_y += env_y;
+            align->sum_yy += env_y * env_y;
+
+            for (uint16_t d = 0; d < TX_DPD_DELAY_MAX; d++)
+            {
+                align->corr[d] += env_y * align->x_env[(pos - d) & mask];
+            }
+        }
+        align->count += blockSize;
+
+        if (align->count >= TX_DPD_ALIGN_SAMPLES)
+        {
+            align->delay = TxDpd_AlignBestDelay(align);
+            if (align->delay >= 0)
+            {
+                align->state = TxDpdAlignOrient;
+                align->yx_re = align->yx_im = align->yxm_re = align->yxm_im = 0.0;
+            }
+            else
+            {
+                // no usable loopback signal (yet), start over
+                align->sum_x = align->sum_xx = align->sum_y = align->sum_yy = 0.0;
+                for (uint16_t d = 0; d < TX_DPD_DELAY_MAX; d++)
+                {
+                    align->corr[d] = 0.0;
+                }
+            }
+            align->count = 0;
+        }
+        break;
+
+    case TxDpdAlignOrient:
+        for (uint16_t idx = 0; idx < blockSize; idx++)
+        {
+            const uint16_t pos = (start + idx - align->delay) & mask;
+            const float32_t xi = align->x_i[pos];
+            const float32_t xq = align->x_q[pos];
+
+            // y * conj(x) and y * x, a swapped loopback is a constant times conj(PA output)
+            align->yx_re += y_i[idx] * xi + y_q[idx] * xq;
+            align->yx_im += y_q[idx] * xi - y_i[idx] * xq;
+            align->yxm_re += y_i[idx] * xi - y_q[idx] * xq;
+            align->yxm_im += y_q[idx] * xi + y_i[idx] * xq;
+        }
+        align->count += blockSize;
+
+        if (align->count >= TX_DPD_ALIGN_SAMPLES)
+        {
+            align->mirrored = align->yxm_re * align->yxm_re + align->yxm_im * align->yxm_im >
+                              align->yx_re * align->yx_re + align->yx_im * align->yx_im;
+            align->state = TxDpdAlignLocked;
+        }
+        break;
+
+    case TxDpdAlignLocked:
+        for (uint16_t idx = 0; idx < blockSize; idx++)
+        {
+            const uint16_t pos = (start + idx - align->delay) & mask;
+            xa_i[idx] = align->x_i[pos];
+            xa_q[idx] = align->x_q[pos];
+            ya_i[idx] = y_i[idx];
+            ya_q[idx] = align->mirrored ? -y_q[idx] : y_q[idx];
+        }
+        break;
+    }
+
+    return align->state == TxDpdAlignLocked;
+}
+
+/**
+ * Checks the predistortion data loaded from the configuration store, sets up identity tables if not valid.
+ * Call after loading the configuration.
+ */
+void TxDpd_Init()
+{
+    if (tx_dpd_store.magic != TX_DPD_STORE_MAGIC)
+    {
+        tx_dpd_store.magic = TX_DPD_STORE_MAGIC;
+        tx_dpd_store.enable = false;
+        for (uint8_t band = 0; band < TX_DPD_BANDS; band++)
+        {
+            TxDpd_TableIdentity(&tx_dpd_store.band[band]);
+        }
+    }
+
+    tx_dpd.lut_dirty = true;
+    tx_dpd.stats_band = TX_DPD_BANDS;
+    TxDpd_StatsReset(&tx_dpd.stats);
+}
+
+void TxDpd_SetEnable(bool enable)
+{
+    tx_dpd_store.enable = enable;
+}
+
+bool TxDpd_IsEnabled()
+{
+    return tx_dpd_store.enable != false;
+}
+
+/**
+ * Removes the predistortion of a band, adaptation starts from scratch
+ */
+void TxDpd_ResetBand(uint8_t band)
+{
+    if (band < TX_DPD_BANDS)
+    {
+        TxDpd_TableIdentity(&tx_dpd_store.band[band]);
+        tx_dpd.stats_band = TX_DPD_BANDS;
+        tx_dpd.lut_dirty = true;
+    }
+}
+
+/**
+ * Returns the processing table for a band, for callers which apply the predistortion themselves with TxDpd_ProcessSample().
+ * @return NULL if predistortion is off or not available for the band
+ */
+const TxDpd_Lut_t* TxDpd_GetLut(const uint8_t band)
+{
+    const TxDpd_Lut_t* retval = NULL;
+
+    if (tx_dpd_store.enable && band < TX_DPD_BANDS)
+    {
+        if (tx_dpd.lut_dirty || band != tx_dpd.lut_band)
+        {
+            tx_dpd.lut_dirty = false;
+            tx_dpd.lut_band = band;
+            TxDpd_TableToLut(&tx_dpd_store.band[band], &tx_dpd.lut);
+        }
+        retval = &tx_dpd.lut;
+    }
+    return retval;
+}
+
+/**
+ * Restarts the loopback alignment, call before transmitting
+ */
+void TxDpd_CaptureReset()
+{
+    TxDpd_AlignReset(&tx_dpd_align);
+}
+
+/**
+ * Online adaptation: feeds the samples sent to the DAC and the samples received at the same time from the tx loopback.
+ * Every TX_DPD_CAPTURE_MIN aligned samples the table of the band is updated. Called from the audio interrupt.
+ * The updated tables are written to the configuration store together with the other settings.
+ */
+void TxDpd_Capture(const float32_t* tx_i, const float32_t* tx_q, const float32_t* fb_i, const float32_t* fb_q, const uint16_t blockSize, const uint8_t band, const float32_t full_scale)
+{
+    float32_t x_i[blockSize], x_q[blockSize], y_i[blockSize], y_q[blockSize];
+
+    if (tx_dpd_store.enable && band < TX_DPD_BANDS &&
+            TxDpd_Align(&tx_dpd_align, tx_i, tx_q, fb_i, fb_q, x_i, x_q, y_i, y_q, blockSize))
+    {
+        if (band != tx_dpd.stats_band)
+        {
+            TxDpd_StatsReset(&tx_dpd.stats);
+            tx_dpd.stats_band = band;
+        }
+
+        TxDpd_StatsAccumulate(&tx_dpd.stats, x_i, x_q, y_i, y_q, blockSize, full_scale);
+
+        if (tx_dpd.stats.count >= TX_DPD_CAPTURE_MIN)
+        {
+            if (TxDpd_Fit(&tx_dpd.stats, &tx_dpd_store.band[band], TX_DPD_ADAPT_MU))
+            {
+                tx_dpd.lut_dirty = true;
+            }
+            TxDpd_StatsReset(&tx_dpd.stats);
+        }
+    }
+}
+
+/**
+ * @return loopback delay in samples found by the alignment, -1 if the loopback is not (yet) usable
+ */
+int16_t TxDpd_CaptureDelay()
+{
+    return tx_dpd_align.state == TxDpdAlignLocked ? tx_dpd_align.delay : -1;
+}
@@ -0,0 +1,171 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     tx_dpd.h                                                        **
+ **  Description:   lookup table based digital predistortion of the tx iq signal   **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#ifndef __TX_DPD_H
+#define __TX_DPD_H
+
+#include "uhsdr_types.h"
+
+// number of knots of the AM/AM and AM/PM tables, equally spaced over the envelope magnitude 0 ... full scale
+#define TX_DPD_LUT_SIZE         16
+// number of bands with their own table, only the tx capable bands, general coverage excluded
+#define TX_DPD_BANDS            17
+// number of loopback samples which have to be collected before the PA characteristic is fitted
+#define TX_DPD_CAPTURE_MIN      4096
+
+// loopback alignment: the delay from the DAC samples to the loopback samples is searched in 0 ... TX_DPD_DELAY_MAX - 1
+#define TX_DPD_DELAY_MAX        128
+#define TX_DPD_HISTORY_SIZE     256     // power of 2, at least TX_DPD_DELAY_MAX plus the block size
+#define TX_DPD_ALIGN_SAMPLES    1536    // samples correlated for the delay search and for the orientation check
+#define TX_DPD_ALIGN_MIN_CORR   0.7     // envelope correlation the loopback must reach to be used
+
+// fixed point representation of the stored tables
+#define TX_DPD_GAIN_ONE         4096    // gain 1.0
+#define TX_DPD_GAIN_MAX         2.0     // predistortion never more than doubles the drive
+#define TX_DPD_PHASE_SCALE      8192.0  // phase in rad * TX_DPD_PHASE_SCALE
+
+#define TX_DPD_STORE_MAGIC      0xD9D1
+
+/**
+ * Predistortion table in the form it is stored in the configuration:
+ * gain and phase correction for each knot, the knots are indexed by the envelope magnitude
+ * of the undistorted signal.
+ */
+typedef struct
+{
+    int16_t gain[TX_DPD_LUT_SIZE];  // AM/AM correction, TX_DPD_GAIN_ONE == 1.0
+    int16_t phase[TX_DPD_LUT_SIZE]; // AM/PM correction, rad * TX_DPD_PHASE_SCALE
+} TxDpd_Table_t;
+
+/**
+ * Predistortion table prepared for the sample processing, one complex multiplier per knot
+ */
+typedef struct
+{
+    float32_t re[TX_DPD_LUT_SIZE];
+    float32_t im[TX_DPD_LUT_SIZE];
+} TxDpd_Lut_t;
+
+/**
+ * PA characteristic collected from the tx loopback, complex gain of the PA per knot in least squares form
+ * The knots are indexed by the envelope magnitude of the PA input signal.
+ */
+typedef struct
+{
+    float32_t yx_re[TX_DPD_LUT_SIZE];   // sum of weight * y * conj(x)
+    float32_t yx_im[TX_DPD_LUT_SIZE];
+    float32_t xx[TX_DPD_LUT_SIZE];      // sum of weight * |x|^2
+    uint32_t count;
+} TxDpd_PaStats_t;
+
+typedef enum
+{
+    TxDpdAlignSearch = 0,   // searching the loopback delay
+    TxDpdAlignOrient,       // delay found, checking if the loopback has I and Q swapped
+    TxDpdAlignLocked,       // loopback samples are aligned with the PA input
+} TxDpd_AlignState_t;
+
+/**
+ * Time alignment of the PA input and the loopback samples.
+ * The delay is the maximum of the cross correlation of the envelopes (|x|^2, |y|^2), which
+ * neither depends on the phase nor on the orientation of the loopback.
+ */
+typedef struct
+{
+    float32_t x_i[TX_DPD_HISTORY_SIZE];     // PA input history
+    float32_t x_q[TX_DPD_HISTORY_SIZE];
+    float32_t x_env[TX_DPD_HISTORY_SIZE];   // |x|^2 of the history
+    uint16_t pos;                           // next write position in the history
+
+    TxDpd_AlignState_t state;
+    uint32_t count;                         // samples collected in the current state
+    float32_t corr[TX_DPD_DELAY_MAX];       // sum of |y(n)|^2 * |x(n-d)|^2
+    float32_t sum_x, sum_xx, sum_y, sum_yy; // sums of the envelopes and their squares
+    float32_t yx_re, yx_im;                 // sum of y * conj(x) at the found delay
+    float32_t yxm_re, yxm_im;               // sum of y * x at the found delay, large if I and Q are swapped
+    int16_t delay;                          // -1 if not known
+    bool mirrored;                          // loopback I and Q are swapped, y is conjugated
+} TxDpd_Align_t;
+
+typedef struct
+{
+    uint16_t magic;
+    uint16_t enable;
+    TxDpd_Table_t band[TX_DPD_BANDS];
+} TxDpd_Store_t;
+
+// this is the image of the predistortion data in the configuration store
+extern TxDpd_Store_t tx_dpd_store;
+
+/**
+ * Maps a normalized envelope magnitude to the lower knot and the interpolation factor between this and the next knot
+ */
+static inline uint16_t TxDpd_Knot(const float32_t magnitude, float32_t* frac)
+{
+    const float32_t pos = magnitude * (TX_DPD_LUT_SIZE - 1);
+    uint16_t knot;
+
+    if (pos >= TX_DPD_LUT_SIZE - 1)
+    {
+        knot = TX_DPD_LUT_SIZE - 2;
+        *frac = 1.0;
+    }
+    else
+    {
+        knot = pos;
+        *frac = pos - knot;
+    }
+    return knot;
+}
+
+/**
+ * Predistorts a single iq sample
+ * @param scale 1 / full scale, i.e. the sample magnitude which corresponds to the last knot
+ */
+static inline void TxDpd_ProcessSample(const TxDpd_Lut_t* lut, float32_t* i_sample, float32_t* q_sample, const float32_t scale)
+{
+    const float32_t i = *i_sample;
+    const float32_t q = *q_sample;
+
+    float32_t frac;
+    const uint16_t knot = TxDpd_Knot(sqrtf(i * i + q * q) * scale, &frac);
+
+    const float32_t c_re = lut->re[knot] + frac * (lut->re[knot + 1] - lut->re[knot]);
+    const float32_t c_im = lut->im[knot] + frac * (lut->im[knot + 1] - lut->im[knot]);
+
+    *i_sample = i * c_re - q * c_im;
+    *q_sample = i * c_im + q * c_re;
+}
+
+// table math, no dependencies on the hardware
+void TxDpd_TableIdentity(TxDpd_Table_t* table);
+void TxDpd_TableToLut(const TxDpd_Table_t* table, TxDpd_Lut_t* lut);
+void TxDpd_Process(const TxDpd_Lut_t* lut, float32_t* i_buffer, float32_t* q_buffer, const uint16_t blockSize, const float32_t full_scale);
+void TxDpd_StatsReset(TxDpd_PaStats_t* stats);
+void TxDpd_StatsAccumulate(TxDpd_PaStats_t* stats, const float32_t* x_i, const float32_t* x_q, const float32_t* y_i, const float32_t* y_q, const uint16_t blockSize, const float32_t full_scale);
+bool TxDpd_Fit(const TxDpd_PaStats_t* stats, TxDpd_Table_t* table, const float32_t mu);
+void TxDpd_AlignReset(TxDpd_Align_t* align);
+bool TxDpd_Align(TxDpd_Align_t* align, const float32_t* x_i, const float32_t* x_q, const float32_t* y_i, const float32_t* y_q,
+                 float32_t* xa_i, float32_t* xa_q, float32_t* ya_i, float32_t* ya_q, const uint16_t blockSize);
+
+// transmitter interface
+void TxDpd_Init(void);
+void TxDpd_SetEnable(bool enable);
+bool TxDpd_IsEnabled(void);
+void TxDpd_ResetBand(uint8_t band);
+const TxDpd_Lut_t* TxDpd_GetLut(const uint8_t band);
+void TxDpd_CaptureReset(void);
+void TxDpd_Capture(const float32_t* tx_i, const float32_t* tx_q, const float32_t* fb_i, const float32_t* fb_q, const uint16_t blockSize, const uint8_t band, const float32_t full_scale);
+int16_t TxDpd_CaptureDelay(void);
+
+#endif
@@ -0,0 +1,377 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     tx_mbc.c                                                        **
+ **  Description:   multiband tx speech compressor with look-ahead peak limiter     **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * The tx audio is split into three bands by two 4th order Linkwitz-Riley crossovers:
+ *
+ *   low  = AP2(LP1(x))
+ *   rest = HP1(x)
+ *   mid  = LP2(rest)
+ *   high = HP2(rest)
+ *
+ * Lowpass and highpass of a Linkwitz-Riley crossover add up to a 2nd order allpass, the allpass AP2
+ * gives the low band the phase of mid + high. So the bands add up to AP1(AP2(x)), which has a flat
+ * magnitude response. Subtracting a lowpass output from the input instead would also reconstruct the
+ * input, but the difference contains most of the low band signal because of the phase shift of the lowpass.
+ *
+ * Each band has its own envelope detector which is updated once per audio block from
+ * the block peak. The compressor gain is calculated once per block from the envelope
+ * and ramped linearly over the next block, so there is exactly one powf() per band and block.
+ *
+ * The sum of the bands goes through a peak limiter which looks ahead one audio block:
+ * the audio is delayed by one block in a circular buffer and the gain needed for
+ * the newest block is already applied while its predecessor leaves the delay line.
+ * Peaks between the samples are estimated by a 4 point interpolation at the midpoints,
+ * so the limiter also catches most of the overshoots of the later filtering stages.
+ */
+
+#include "uhsdr_board.h"
+#include "audio_driver.h"
+#include "tx_mbc.h"
+
+#define TX_MBC_SAMPLE_RATE      AUDIO_SAMPLE_RATE
+#define TX_MBC_XOVER_LOW_FREQ   600.0   // Hz
+#define TX_MBC_XOVER_HIGH_FREQ  1800.0  // Hz
+#define TX_MBC_XOVER_Q          0.7071  // two Butterworth stages give a 4th order Linkwitz-Riley filter
+#define TX_MBC_XOVER_STAGES_MAX 3       // the low band filter has the allpass as third stage
+
+typedef enum
+{
+    TX_MBC_XOVER_LOW = 0,   // LP1 and AP2
+    TX_MBC_XOVER_REST,      // HP1
+    TX_MBC_XOVER_MID,       // LP2
+    TX_MBC_XOVER_HIGH,      // HP2
+    TX_MBC_XOVER_NUM
+} TxMbc_Xover_t;
+
+typedef struct
+{
+    const char* name;
+    float32_t threshold_db[TX_MBC_BANDS];   // compression threshold relative to the limiter ceiling
+    float32_t ratio[TX_MBC_BANDS];
+    float32_t makeup_db[TX_MBC_BANDS];
+    float32_t attack_ms;
+    float32_t release_ms;
+    float32_t limiter_release_ms;
+} TxMbc_PresetInfo_t;
+
+static const TxMbc_PresetInfo_t tx_mbc_presets[TX_MBC_PRESET_NUM] =
+{
+    [TX_MBC_PRESET_OFF]    = { .name = "OFF" },
+    [TX_MBC_PRESET_LIGHT]  =
+    {
+        .name = "LIGHT",
+        .threshold_db = { -12, -12, -12 },
+        .ratio = { 2, 2, 2 },
+        .makeup_db = { 5, 6, 6 },
+        .attack_ms = 5, .release_ms = 200, .limiter_release_ms = 60,
+    },
+    [TX_MBC_PRESET_MEDIUM] =
+    {
+        .name = "MEDIUM",
+        .threshold_db = { -18, -18, -20 },
+        .ratio = { 3, 3, 3 },
+        .makeup_db = { 9, 12, 13 },
+        .attack_ms = 4, .release_ms = 150, .limiter_release_ms = 40,
+    },
+    [TX_MBC_PRESET_DX]     =
+    {
+        .name = "DX",
+        .threshold_db = { -20, -26, -28 },
+        .ratio = { 4, 6, 6 },
+        .makeup_db = { 10, 21, 23 },
+        .attack_ms = 3, .release_ms = 100, .limiter_release_ms = 25,
+    },
+};
+
+typedef struct
+{
+    float32_t threshold;    // linear, absolute
+    float32_t exponent;     // 1/ratio - 1, gain = makeup * (env/threshold)^exponent above the threshold
+    float32_t makeup;
+    float32_t env;
+    float32_t gain;         // gain reached at the end of the last block
+} TxMbc_Band_t;
+
+typedef struct
+{
+    uint8_t preset;         // preset the coefficients below were calculated for
+    float32_t ceiling;
+
+    float32_t xover_coeffs[TX_MBC_XOVER_NUM][5 * TX_MBC_XOVER_STAGES_MAX];
+    float32_t xover_state[TX_MBC_XOVER_NUM][4 * TX_MBC_XOVER_STAGES_MAX];
+    arm_biquad_casd_df1_inst_f32 xover[TX_MBC_XOVER_NUM];
+
+    TxMbc_Band_t band[TX_MBC_BANDS];
+    float32_t attack;       // per block smoothing factors of the envelope detectors
+    float32_t release;
+
+    float32_t band_buf[TX_MBC_BANDS][TX_MBC_BLOCK_SIZE_MAX];
+
+    // look-ahead limiter
+    float32_t delay[TX_MBC_BLOCK_SIZE_MAX];
+    uint16_t delay_len;
+    uint16_t delay_idx;
+    float32_t hist[3];      // last 3 input samples, for the inter sample peak estimation
+    float32_t required_prev;// gain required by the block currently in the delay line
+    float32_t lim_gain;     // gain reached at the end of the last block
+    float32_t lim_release;
+    float32_t gain_reduction;
+} TxMbc_State_t;
+
+static TxMbc_State_t tx_mbc = { .preset = TX_MBC_PRESET_NUM };
+
+/**
+ * Converts a time constant into the smoothing factor of a first order filter updated once per block
+ */
+static float32_t TxMbc_BlockCoeff(const float32_t time_ms, const uint16_t blockSize)
+{
+    return 1.0 - expf(-(float32_t)blockSize * 1000.0 / (time_ms * TX_MBC_SAMPLE_RATE));
+}
+
+/**
+ * Sets up one of the crossover filters: two identical Butterworth stages, optionally followed by an allpass
+ */
+static void TxMbc_SetupXover(const TxMbc_Xover_t idx, const float32_t coeffs[5], const float32_t* allpass_coeffs)
+{
+    uint8_t stages = 0;
+
+    AudioDriver_SetBiquadCoeffs(&tx_mbc.xover_coeffs[idx][stages++ * 5], coeffs);
+    AudioDriver_SetBiquadCoeffs(&tx_mbc.xover_coeffs[idx][stages++ * 5], coeffs);
+    if (allpass_coeffs != NULL)
+    {
+        AudioDriver_SetBiquadCoeffs(&tx_mbc.xover_coeffs[idx][stages++ * 5], allpass_coeffs);
+    }
+    tx_mbc.xover[idx].numStages = stages;
+    tx_mbc.xover[idx].pCoeffs = tx_mbc.xover_coeffs[idx];
+    tx_mbc.xover[idx].pState = tx_mbc.xover_state[idx];
+}
+
+/**
+ * Calculates all preset dependent values. Also called from the audio interrupt on preset change, no state is cleared here
+ * so switching presets while transmitting does not click.
+ */
+static void TxMbc_Configure(const uint8_t preset, const uint16_t blockSize, const float32_t ceiling)
+{
+    const TxMbc_PresetInfo_t* info = &tx_mbc_presets[preset];
+    float32_t coeffs[5];
+    float32_t allpass_coeffs[5];
+
+    AudioDriver_CalcAllpass(allpass_coeffs, TX_MBC_XOVER_HIGH_FREQ, TX_MBC_XOVER_Q, TX_MBC_SAMPLE_RATE);
+    AudioDriver_CalcLowpass(coeffs, TX_MBC_XOVER_LOW_FREQ, TX_MBC_XOVER_Q, TX_MBC_SAMPLE_RATE);
+    TxMbc_SetupXover(TX_MBC_XOVER_LOW, coeffs, allpass_coeffs);
+    AudioDriver_CalcHighpass(coeffs, TX_MBC_XOVER_LOW_FREQ, TX_MBC_XOVER_Q, TX_MBC_SAMPLE_RATE);
+    TxMbc_SetupXover(TX_MBC_XOVER_REST, coeffs, NULL);
+    AudioDriver_CalcLowpass(coeffs, TX_MBC_XOVER_HIGH_FREQ, TX_MBC_XOVER_Q, TX_MBC_SAMPLE_RATE);
+    TxMbc_SetupXover(TX_MBC_XOVER_MID, coeffs, NULL);
+    AudioDriver_CalcHighpass(coeffs, TX_MBC_XOVER_HIGH_FREQ, TX_MBC_XOVER_Q, TX_MBC_SAMPLE_RATE);
+    TxMbc_SetupXover(TX_MBC_XOVER_HIGH, coeffs, NULL);
+
+    for (int idx = 0; idx < TX_MBC_BANDS; idx++)
+    {
+        tx_mbc.band[idx].threshold = ceiling * pow10f(info->threshold_db[idx] / 20.0);
+        tx_mbc.band[idx].exponent = 1.0 / info->ratio[idx] - 1.0;
+        tx_mbc.band[idx].makeup = pow10f(info->makeup_db[idx] / 20.0);
+    }
+
+    tx_mbc.attack = TxMbc_BlockCoeff(info->attack_ms, blockSize);
+    tx_mbc.release = TxMbc_BlockCoeff(info->release_ms, blockSize);
+    tx_mbc.lim_release = TxMbc_BlockCoeff(info->limiter_release_ms, blockSize);
+    tx_mbc.ceiling = ceiling;
+    tx_mbc.preset = preset;
+}
+
+/**
+ * Clears the filter states, the envelopes and the delay line. Call before going into transmit.
+ */
+void TxMbc_Reset()
+{
+    arm_fill_f32(0.0, &tx_mbc.xover_state[0][0], sizeof(tx_mbc.xover_state) / sizeof(float32_t));
+    arm_fill_f32(0.0, tx_mbc.delay, TX_MBC_BLOCK_SIZE_MAX);
+    arm_fill_f32(0.0, tx_mbc.hist, 3);
+
+    for (int idx = 0; idx < TX_MBC_BANDS; idx++)
+    {
+        tx_mbc.band[idx].env = 0.0;
+        tx_mbc.band[idx].gain = tx_mbc.band[idx].makeup;
+    }
+
+    tx_mbc.delay_len = 0; // forces the delay line to be set up with the next block size
+    tx_mbc.delay_idx = 0;
+    tx_mbc.required_prev = 1.0;
+    tx_mbc.lim_gain = 1.0;
+    tx_mbc.gain_reduction = 1.0;
+}
+
+/**
+ * Splits the block into the bands and updates the band envelopes with the block peaks
+ */
+static void TxMbc_SplitBands(const float32_t* in, const uint16_t blockSize, float32_t peak[TX_MBC_BANDS])
+{
+    float32_t* low = tx_mbc.band_buf[0];
+    float32_t* mid = tx_mbc.band_buf[1];
+    float32_t* high = tx_mbc.band_buf[2];
+    float32_t pk_low = 0.0, pk_mid = 0.0, pk_high = 0.0;
+
+    arm_biquad_cascade_df1_f32(&tx_mbc.xover[TX_MBC_XOVER_LOW], (float32_t*)in, low, blockSize);
+    arm_biquad_cascade_df1_f32(&tx_mbc.xover[TX_MBC_XOVER_REST], (float32_t*)in, high, blockSize);
+    arm_biquad_cascade_df1_f32(&tx_mbc.xover[TX_MBC_XOVER_MID], high, mid, blockSize);
+    // in place, the rest is not needed anymore
+    arm_biquad_cascade_df1_f32(&tx_mbc.xover[TX_MBC_XOVER_HIGH], high, high, blockSize);
+
+    for (uint16_t i = 0; i < blockSize; i++)
+    {
+        pk_low = fmaxf(pk_low, fabsf(low[i]));
+        pk_mid = fmaxf(pk_mid, fabsf(mid[i]));
+        pk_high = fmaxf(pk_high, fabsf(high[i]));
+    }
+
+    peak[0] = pk_low;
+    peak[1] = pk_mid;
+    peak[2] = pk_high;
+}
+
+/**
+ * Limiter stage: feeds the new block into the delay line and returns the delayed block with the limiter gain applied.
+ * The gain ramp of a block never exceeds the gain required by that block and ends at or below the gain required
+ * by the block behind it, so the ceiling is kept at all times.
+ */
+static void TxMbc_Limit(float32_t* buffer, const uint16_t blockSize, const float32_t gain_scaling)
+{
+    // true peak estimate of the new block, samples and midpoints between the samples
+    float32_t xm3 = tx_mbc.hist[0], xm2 = tx_mbc.hist[1], xm1 = tx_mbc.hist[2];
+    float32_t peak = 0.0;
+
+    for (uint16_t i = 0; i < blockSize; i++)
+    {
+        const float32_t x = buffer[i];
+        const float32_t x_mid = 0.5625 * (xm2 + xm1) - 0.0625 * (xm3 + x); // between xm2 and xm1
+        peak = fmaxf(peak, fmaxf(fabsf(x), fabsf(x_mid)));
+        xm3 = xm2;
+        xm2 = xm1;
+        xm1 = x;
+    }
+    tx_mbc.hist[0] = xm3;
+    tx_mbc.hist[1] = xm2;
+    tx_mbc.hist[2] = xm1;
+
+    const float32_t required = peak > tx_mbc.ceiling ? tx_mbc.ceiling / peak : 1.0;
+    const float32_t target = fminf(required, tx_mbc.required_prev);
+
+    float32_t gain = tx_mbc.lim_gain;
+    float32_t gain_end = target;
+    if (target > gain)
+    {
+        // release slowly
+        gain_end = fminf(target, gain + (1.0 - gain) * tx_mbc.lim_release);
+    }
+    tx_mbc.required_prev = required;
+    tx_mbc.lim_gain = gain_end;
+
+    const float32_t gain_step = (gain_end - gain) * gain_scaling / blockSize;
+    gain *= gain_scaling;
+
+    // swap the new samples into the delay line and the delayed ones out, no copying of blocks
+    uint16_t idx = tx_mbc.delay_idx;
+    for (uint16_t i = 0; i < blockSize; i++)
+    {
+        gain += gain_step;
+        const float32_t delayed = tx_mbc.delay[idx];
+        tx_mbc.delay[idx] = buffer[i];
+        buffer[i] = delayed * gain;
+        idx++;
+        if (idx == tx_mbc.delay_len)
+        {
+            idx = 0;
+        }
+    }
+    tx_mbc.delay_idx = idx;
+}
+
+/**
+ * Runs the multiband compressor and the limiter on a block of tx audio. Runs in the audio interrupt.
+ *
+ * @param buffer audio samples, processed in place, the output is delayed by one block
+ * @param blockSize number of samples, at most TX_MBC_BLOCK_SIZE_MAX
+ * @param preset compressor settings, one of TxMbc_Preset_t except TX_MBC_PRESET_OFF
+ * @param ceiling the absolute value the output will not exceed before the gain_scaling is applied
+ * @param gain_scaling scaling applied to the output after limiting
+ */
+void TxMbc_Process(float32_t* buffer, const uint16_t blockSize, const uint8_t preset, const float32_t ceiling, const float32_t gain_scaling)
+{
+    if (preset != tx_mbc.preset || ceiling != tx_mbc.ceiling)
+    {
+        TxMbc_Configure(preset, blockSize, ceiling);
+    }
+
+    if (blockSize != tx_mbc.delay_len)
+    {
+        tx_mbc.delay_len = blockSize;
+        tx_mbc.delay_idx = 0;
+    }
+
+    float32_t peak[TX_MBC_BANDS];
+    TxMbc_SplitBands(buffer, blockSize, peak);
+
+    // one gain calculation per band and block, ramped over the block
+    float32_t gain[TX_MBC_BANDS], gain_step[TX_MBC_BANDS];
+    float32_t compression = 1.0;
+
+    for (int b = 0; b < TX_MBC_BANDS; b++)
+    {
+        TxMbc_Band_t* band = &tx_mbc.band[b];
+
+        band->env += (peak[b] - band->env) * (peak[b] > band->env ? tx_mbc.attack : tx_mbc.release);
+
+        float32_t gain_new = band->makeup;
+        if (band->env > band->threshold)
+        {
+            const float32_t reduction = powf(band->env / band->threshold, band->exponent);
+            gain_new *= reduction;
+            compression = fminf(compression, reduction);
+        }
+
+        gain[b] = band->gain;
+        gain_step[b] = (gain_new - band->gain) / blockSize;
+        band->gain = gain_new;
+    }
+
+    const float32_t* low = tx_mbc.band_buf[0];
+    const float32_t* mid = tx_mbc.band_buf[1];
+    const float32_t* high = tx_mbc.band_buf[2];
+
+    for (uint16_t i = 0; i < blockSize; i++)
+    {
+        gain[0] += gain_step[0];
+        gain[1] += gain_step[1];
+        gain[2] += gain_step[2];
+        buffer[i] = low[i] * gain[0] + mid[i] * gain[1] + high[i] * gain[2];
+    }
+
+    TxMbc_Limit(buffer, blockSize, gain_scaling);
+
+    tx_mbc.gain_reduction = compression * tx_mbc.lim_gain;
+}
+
+/**
+ * @return the current gain reduction of the strongest compressed band and the limiter, 1.0 means no reduction
+ */
+float32_t TxMbc_GetGainReduction()
+{
+    return tx_mbc.gain_reduction;
+}
+
+const char* TxMbc_GetPresetName(const uint8_t preset)
+{
+    return preset < TX_MBC_PRESET_NUM ? tx_mbc_presets[preset].name : "???";
+}
@@ -0,0 +1,41 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     tx_mbc.h                                                        **
+ **  Description:   multiband tx speech compressor with look-ahead peak limiter     **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#ifndef __TX_MBC_H
+#define __TX_MBC_H
+
+#include "uhsdr_types.h"
+#include "arm_math.h"
+
+// number of compressor bands, the crossover frequencies are fixed
+#define TX_MBC_BANDS            3
+// the limiter looks ahead exactly one audio block, so this is the largest block size we can process
+#define TX_MBC_BLOCK_SIZE_MAX   IQ_BLOCK_SIZE
+
+typedef enum
+{
+    TX_MBC_PRESET_OFF = 0,  // multiband processor bypassed, the classic single band ALC is used
+    TX_MBC_PRESET_LIGHT,    // gentle compression, natural sounding for rag chewing
+    TX_MBC_PRESET_MEDIUM,   // more talk power for normal operation
+    TX_MBC_PRESET_DX,       // maximum talk power, reduced bass, for weak signal / pile up conditions
+    TX_MBC_PRESET_NUM
+} TxMbc_Preset_t;
+
+#define TX_MBC_PRESET_DEFAULT   TX_MBC_PRESET_OFF
+
+void TxMbc_Reset(void);
+void TxMbc_Process(float32_t* buffer, const uint16_t blockSize, const uint8_t preset, const float32_t ceiling, const float32_t gain_scaling);
+float32_t TxMbc_GetGainReduction(void);
+const char* TxMbc_GetPresetName(const uint8_t preset);
+
+#endif
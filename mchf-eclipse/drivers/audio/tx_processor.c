@@ -22,6 +22,8 @@
 #include "freedv_uhsdr.h"
 #include "freq_shift.h"
 #include "cw_gen.h"
+#include "tx_dpd.h"
+#include "tx_mbc.h"
 
 #include "usbd_audio_if.h"
 
@@ -34,6 +36,9 @@
 
 #define IIR_TX_STATE_ARRAY_SIZE    (IIR_RXAUDIO_BLOCK_SIZE + IIR_RXAUDIO_NUM_STAGES_MAX)
 
+// sample magnitude of the final tx iq samples which corresponds to the DAC full scale
+#define TX_DPD_FULL_SCALE   (32768.0 * IQ_BIT_SCALE_UP)
+
 // variables for TX IIR filter
 static float32_t       iir_tx_state[IIR_TX_STATE_ARRAY_SIZE];
 static arm_iir_lattice_instance_f32    IIR_TXFilter;
@@ -56,6 +61,10 @@ static arm_biquad_casd_df1_inst_f32 IIR_TX_biquad =
 
 static float32_t   __MCHF_SPECIALMEM audio_delay_buffer    [AUDIO_DELAY_BUFSIZE];
 
+#ifdef USE_FREEDV
+static void TxProcessor_FreeDVReset(void);
+#endif
+
 /**
  * This runs the preparation directly before going into transmit (runs in interrupt!)
  * Keep as short as possible
@@ -63,6 +72,11 @@ static float32_t   __MCHF_SPECIALMEM audio_delay_buffer    [AUDIO_DELAY_BUFSIZE]
 void TxProcessor_PrepareRun()
 {
     arm_fill_f32(0, audio_delay_buffer, AUDIO_DELAY_BUFSIZE);
+    TxMbc_Reset();
+    TxDpd_CaptureReset();
+#ifdef USE_FREEDV
+    TxProcessor_FreeDVReset();
+#endif
 }
 
 /**
@@ -165,6 +179,7 @@ static void TxProcessor_FillSideToneAudioBuffer(audio_block_t const src, AudioSa
 
 /**
  * @brief audio speech compressor (look-ahead type) by KA7OEI
+ * If a multiband preset is selected, the multiband compressor with look-ahead limiter is used instead of the single band ALC.
  * @param buffer input (and output) buffer for audio samples
  * @param blockSize number of samples to process
  * @param gain_scaling scaling applied to buffer
@@ -172,7 +187,7 @@ static void TxProcessor_FillSideToneAudioBuffer(audio_block_t const src, AudioSa
  */
 static void TxProcessor_VoiceCompressor(audio_block_t a_block, int16_t blockSize, float gain_scaling)
 {
-    static uint32_t alc_delay_inbuf = 0, alc_delay_outbuf;
+    static uint32_t alc_delay_inbuf = 0;
 
     if (ts.tx_comp_level > -1)
     {
@@ -187,13 +202,25 @@ static void TxProcessor_VoiceCompressor(audio_block_t a_block, int16_t blockSize
             arm_scale_f32(a_block, gain_calc, a_block, blockSize);      // use optimized function to apply scaling to I/Q buffers
         }
 
-        // Do ALC processing on audio buffer - look-ahead type by KA7OEI
-        if (false)
+        if (ts.tx_mbc_preset != TX_MBC_PRESET_OFF)
         {
-            arm_fill_f32(ALC_VAL_MAX * gain_scaling, adb.agc_valbuf, blockSize);
+            TxMbc_Process(a_block, blockSize, ts.tx_mbc_preset, ALC_KNEE, gain_scaling);
+            ads.alc_val = TxMbc_GetGainReduction(); // for the ALC meter
         }
         else
         {
+            // Delay the post-ALC audio slightly so that the ALC's "attack" will very slightly lead the audio being acted upon by the ALC.
+            // This eliminates a "click" that can occur when a very strong signal appears due to the ALC lag.  The delay is adjusted based on
+            // decimation rate so that it is constant for all settings.
+            // The delay buffer is used as circular buffer, new samples are written where the oldest ones are read
+            // so the delay is AUDIO_DELAY_BUFSIZE - blockSize samples.
+            uint32_t alc_delay_outbuf = alc_delay_inbuf + blockSize;
+            if (alc_delay_outbuf >= AUDIO_DELAY_BUFSIZE)
+            {
+                alc_delay_outbuf -= AUDIO_DELAY_BUFSIZE;
+            }
+
+            // Do ALC processing on audio buffer - look-ahead type by KA7OEI
             for(uint16_t i = 0; i < blockSize; i++)
             {
                 // perform ALC on post-filtered audio (You will notice the striking similarity to the AGC code!)
@@ -220,24 +247,21 @@ static void TxProcessor_VoiceCompressor(audio_block_t a_block, int16_t blockSize
                     ads.alc_val = ALC_VAL_MAX;
                 }
 
-                adb.agc_valbuf[i] = (ads.alc_val * gain_scaling);   // store in "running" ALC history buffer for later application to audio data
+                // put new sample into the delay buffer, take the old one out and apply the ALC gain to it
+                const float32_t delayed = audio_delay_buffer[alc_delay_outbuf];
+                audio_delay_buffer[alc_delay_inbuf] = a_block[i];
+                a_block[i] = delayed * ads.alc_val * gain_scaling;
+
+                if (++alc_delay_inbuf == AUDIO_DELAY_BUFSIZE)
+                {
+                    alc_delay_inbuf = 0;
+                }
+                if (++alc_delay_outbuf == AUDIO_DELAY_BUFSIZE)
+                {
+                    alc_delay_outbuf = 0;
+                }
             }
         }
-
-        // Delay the post-ALC audio slightly so that the ALC's "attack" will very slightly lead the audio being acted upon by the ALC.
-        // This eliminates a "click" that can occur when a very strong signal appears due to the ALC lag.  The delay is adjusted based on
-        // decimation rate so that it is constant for all settings.
-
-        // Update the in/out pointers to the ALC delay buffer
-        alc_delay_inbuf += blockSize;
-        alc_delay_outbuf = alc_delay_inbuf + blockSize;
-        alc_delay_inbuf %= AUDIO_DELAY_BUFSIZE;
-        alc_delay_outbuf %= AUDIO_DELAY_BUFSIZE;
-
-        arm_copy_f32(a_block, &audio_delay_buffer[alc_delay_inbuf], blockSize);  // put new data into the delay buffer
-        arm_copy_f32(&audio_delay_buffer[alc_delay_outbuf], a_block, blockSize); // take old data out of the delay buffer
-
-        arm_mult_f32(a_block, adb.agc_valbuf, a_block, blockSize);        // Apply ALC gain corrections to TX audio channels
     }
 }
 
@@ -269,9 +293,69 @@ static void TxProcessor_CwInputForDigitalModes(audio_block_t* a_blocks, uint16_t
     }
 }
 
+// largest magnitude of the final tx iq samples we can represent in the DAC data format
+#define TX_IQ_SAMPLE_MAX    ((float32_t)(32767 * IQ_BIT_SCALE_UP))
+
+// 2x2 matrix applied to the iq samples, combines iq gain and phase correction
+typedef struct
+{
+    float32_t ii, iq;   // I out = ii * I + iq * Q
+    float32_t qi, qq;   // Q out = qi * I + qq * Q
+} TxProcessor_IqMatrix_t;
+
+static inline iq_data_t TxProcessor_IqSaturate(const float32_t sample)
+{
+    return fmaxf(fminf(sample, TX_IQ_SAMPLE_MAX), -TX_IQ_SAMPLE_MAX);
+}
+
+/**
+ * Final tx stage kernel: applies the correction matrix and optionally the predistortion, saturates,
+ * converts to the DAC data format and interleaves the samples, all in one pass.
+ *
+ * @param m correction matrix
+ * @param lut predistortion table or NULL
+ * @param i_buffer, q_buffer iq input, not changed
+ * @param dst interleaved DAC samples
+ */
+static void TxProcessor_IqFinalKernel(const TxProcessor_IqMatrix_t* m, const TxDpd_Lut_t* lut, const float32_t* i_buffer, const float32_t* q_buffer, IqSample_t* const dst, const uint16_t blockSize)
+{
+    const float32_t ii = m->ii, iq = m->iq, qi = m->qi, qq = m->qq;
+
+    if (lut == NULL)
+    {
+        for(uint16_t idx = 0; idx < blockSize; idx++)
+        {
+            const float32_t i = i_buffer[idx];
+            const float32_t q = q_buffer[idx];
+
+            // Prepare data for DAC
+            dst[idx].l = I2S_correctHalfWord(TxProcessor_IqSaturate(ii * i + iq * q)); // save left channel
+            dst[idx].r = I2S_correctHalfWord(TxProcessor_IqSaturate(qi * i + qq * q)); // save right channel
+        }
+    }
+    else
+    {
+        // PA linearization, the tables are referenced to the DAC full scale
+        const float32_t dpd_scale = 1.0 / TX_DPD_FULL_SCALE;
+
+        for(uint16_t idx = 0; idx < blockSize; idx++)
+        {
+            const float32_t i = i_buffer[idx];
+            const float32_t q = q_buffer[idx];
+
+            float32_t i_out = ii * i + iq * q;
+            float32_t q_out = qi * i + qq * q;
+            TxDpd_ProcessSample(lut, &i_out, &q_out, dpd_scale);
+
+            dst[idx].l = I2S_correctHalfWord(TxProcessor_IqSaturate(i_out));
+            dst[idx].r = I2S_correctHalfWord(TxProcessor_IqSaturate(q_out));
+        }
+    }
+}
+
 /**
  * @brief Equalize based on band and simultaneously apply I/Q gain AND phase adjustments
- * The input is IQ data in the adb.iq.i_buffer and adb.iq.q_buffer
+ * The input is IQ data in the adb.iq.i_buffer and adb.iq.q_buffer, it is not changed.
  *
  * @param dst output buffer for generated IQ audio samples
  * @param blockSize number of samples (input/output)
@@ -314,19 +398,39 @@ static void TxProcessor_IqFinalProcessing(float32_t scaling, bool swap, iq_buffe
         final_q_buffer = iq_buf_p->i_buffer;
     }
 
-    // this is the IQ gain / amplitude adjustment
-    arm_scale_f32(final_i_buffer, final_i_gain, final_i_buffer, blockSize);
-    arm_scale_f32(final_q_buffer, final_q_gain, final_q_buffer, blockSize);
+    // the IQ gain / amplitude adjustment is on the diagonal,
+    // the IQ phase adjustment puts a little bit of I into Q or vice versa, see AudioDriver_IQPhaseAdjust()
+    const float32_t iq_phase_balance = AudioDriver_GetIQPhaseBalance(ts.txrx_mode);
+    const TxProcessor_IqMatrix_t m =
+    {
+        .ii = final_i_gain,
+        .iq = iq_phase_balance > 0 ? iq_phase_balance * final_q_gain : 0,
+        .qi = iq_phase_balance < 0 ? iq_phase_balance * final_i_gain : 0,
+        .qq = final_q_gain,
+    };
+
+    TxProcessor_IqFinalKernel(&m, TxDpd_GetLut(ts.band->band_mode), final_i_buffer, final_q_buffer, dst, blockSize);
+}
 
-    // this is the IQ phase adjustment
-    AudioDriver_IQPhaseAdjust(ts.txrx_mode, final_i_buffer, final_q_buffer,blockSize);
-    for(int i = 0; i < blockSize; i++)
+/**
+ * Passes the final tx iq samples and the tx loopback received at the same time to the predistortion adaptation
+ *
+ * @param dst final tx iq samples as sent to the DAC
+ * @param iqLoopback samples from the iq codec input
+ */
+static void TxProcessor_DpdCapture(const IqSample_t* const dst, const IqSample_t* const iqLoopback, const uint16_t blockSize)
+{
+    float32_t x_i[blockSize], x_q[blockSize], y_i[blockSize], y_q[blockSize];
+
+    for(uint16_t idx = 0; idx < blockSize; idx++)
     {
-        // Prepare data for DAC
-        dst[i].l = I2S_correctHalfWord(final_i_buffer[i]); // save left channel
-        dst[i].r = I2S_correctHalfWord(final_q_buffer[i]); // save right channel
+        x_i[idx] = I2S_correctHalfWord(dst[idx].l);
+        x_q[idx] = I2S_correctHalfWord(dst[idx].r);
+        y_i[idx] = I2S_correctHalfWord(iqLoopback[idx].l);
+        y_q[idx] = I2S_correctHalfWord(iqLoopback[idx].r);
     }
 
+    TxDpd_Capture(x_i, x_q, y_i, y_q, blockSize, ts.band->band_mode, TX_DPD_FULL_SCALE);
 }
 
 /**
@@ -504,11 +608,8 @@ static bool TxProcessor_SSB(audio_block_t a_block, iq_buffer_t* iq_buf_p, const
 #define FM_MOD_ACC_BITS 16
 #define FM_MOD_ACC_MAX_VALUE (1 << FM_MOD_ACC_BITS)
 
-// this is the generic formula for the conversion from the accumulator to the
-// table index
-// #define FM_MOD_ACC_DIV (FM_MOD_ACC_MAX_VALUE/DDS_TBL_SIZE)
-// but we simply state how many bits to shift to the right
-#define FM_MOD_DDS_ACC_SHIFT   (FM_MOD_ACC_BITS-DDS_TBL_BITS)
+// the soft dds works with a 32 bit phase, so this is how many bits we have to shift to the left
+#define FM_MOD_DDS_PHASE_SHIFT   (32-FM_MOD_ACC_BITS)
 
 //
 // For subaudible and burst:  FM Tone word calculation:  freq / (sample rate/2^24) => freq / (IQ_SAMPLE_RATE/16777216) => freq * 349.52533333
@@ -578,11 +679,11 @@ static bool TxProcessor_FM(audio_block_t* a_blocks,  iq_buffer_t* iq_buf_p, uint
         fm_mod_accum    += fm_freq_mod_word + (a_blocks[1][i] * FM_MOD_SCALING * fm_mod_mult);   // change frequency using scaled audio
         fm_mod_accum    %= FM_MOD_ACC_MAX_VALUE;             // limit to 64k range
 
-        uint32_t fm_mod_idx = fm_mod_accum >> FM_MOD_DDS_ACC_SHIFT; // this value must be in valid table index range by construction
-        i_buffer[i] = DDS_TABLE[fm_mod_idx];
+        const uint32_t fm_mod_phase = fm_mod_accum << FM_MOD_DDS_PHASE_SHIFT;
+        i_buffer[i] = softdds_sinPhase(fm_mod_phase);
 
-        // do 90 degree shifted signal for Q
-        q_buffer[i] = DDS_TABLE[softdds_phase_shift90(fm_mod_idx)];
+        // do -90 degree shifted signal for Q
+        q_buffer[i] = softdds_sinPhase(fm_mod_phase + 3 * SOFTDDS_QUARTER);
     }
 
     return true;
@@ -590,6 +691,30 @@ static bool TxProcessor_FM(audio_block_t* a_blocks,  iq_buffer_t* iq_buf_p, uint
 
 #ifdef USE_FREEDV
 
+// state of the FreeDV modulator, see TxProcessor_FreeDV()
+static struct
+{
+    int16_t modulus_Interpolate;
+    bool bufferFilled;          // lead-in is over, we are sending encoded samples
+    int32_t leadInCountdown;    // 48ksps samples left before sending starts, negative if no frame has been encoded yet
+    uint16_t ringOutBlocks;     // blocks of zeros still to be pushed through the interpolation filter after an underrun
+} fdv_tx;
+
+/**
+ * Resets the FreeDV modulator at the start of each transmission, so that we never start sending
+ * with the filter state or the buffer fill state of the previous over.
+ */
+static void TxProcessor_FreeDVReset()
+{
+    fdv_tx.modulus_Interpolate = 0;
+    fdv_tx.bufferFilled = false;
+    fdv_tx.leadInCountdown = -1;
+    fdv_tx.ringOutBlocks = 0;
+
+    arm_fill_f32(0, Fir_TxFreeDV_Interpolate_I.pState, Fir_TxFreeDV_Interpolate_I.numTaps + IQ_BLOCK_SIZE - 1);
+    arm_fill_f32(0, Fir_TxFreeDV_Interpolate_Q.pState, Fir_TxFreeDV_Interpolate_Q.numTaps + IQ_BLOCK_SIZE - 1);
+}
+
 /**
  * Runs FreeDV modulation on audio input signal. This signal is correctly shifted away from center frequency by the receive frequency shift both by absolute value and direction
  *
@@ -602,12 +727,10 @@ static bool TxProcessor_FreeDV (audio_block_t a_block, iq_buffer_t* iq_buf_p, in
 {
     // Freedv DL2FW
     static int16_t modulus_Decimate = 0;
-    static int16_t modulus_Interpolate = 0;
 
     const int32_t factor_Decimate = IQ_SAMPLE_RATE/8000; // 6x @ 48ksps
     const int32_t factor_Interpolate = AUDIO_SAMPLE_RATE/8000; // 6x @ 48ksps
 
-    static bool bufferFilled = false;
     bool retval = false;
 
     // depending on the side band setting we switch the iq buffers accordingly to achieve the right sideband
@@ -638,14 +761,27 @@ static bool TxProcessor_FreeDV (audio_block_t a_block, iq_buffer_t* iq_buf_p, in
     }
 
 
-    // we wait for at least two frames being processed until we start transmitting
-    // we could switch to frame plus 1 block to minimize delay
-    if (bufferFilled == false && RingBuffer_GetData(&fdv_iq_rb) > FreeDV_Iq_Get_FrameLen())
+    // once the first frame has been encoded, we wait for the lead-in before we start transmitting
+    // the lead-in covers the encoding time of the next frame, so that it is ready before the first one is sent completely
+    // this is much less delay than waiting for two complete frames
+    if (fdv_tx.bufferFilled == false && RingBuffer_GetData(&fdv_iq_rb) >= FreeDV_Iq_Get_FrameLen())
     {
-        bufferFilled = true;
+        if (fdv_tx.leadInCountdown < 0)
+        {
+            fdv_tx.leadInCountdown = FreeDV_Tx_Get_LeadIn() * factor_Interpolate;
+        }
+        else
+        {
+            fdv_tx.leadInCountdown -= blockSize;
+        }
+
+        if (fdv_tx.leadInCountdown <= 0)
+        {
+            fdv_tx.bufferFilled = true;
+        }
     }
 
-    if (bufferFilled == true && RingBuffer_GetData(&fdv_iq_rb) >= (modulus_Interpolate == 1?5:6))
+    if (fdv_tx.bufferFilled == true && RingBuffer_GetData(&fdv_iq_rb) >= (fdv_tx.modulus_Interpolate == 1?5:6))
     {
         // Best thing here would be to use the arm_fir_decimate function! Why?
         // --> we need phase linear filters, because we have to filter I & Q and preserve their phase relationship
@@ -660,7 +796,7 @@ static bool TxProcessor_FreeDV (audio_block_t a_block, iq_buffer_t* iq_buf_p, in
         // UPSAMPLING [by hand]
         for (int j = 0; j < blockSize; j++) //  now we are doing upsampling by 6
         {
-            if (modulus_Interpolate == 0) // put in sample pair
+            if (fdv_tx.modulus_Interpolate == 0) // put in sample pair
             {
                 fdv_iq_rb_item_t sample;
                 RingBuffer_GetSamples(&fdv_iq_rb, &sample, 1);
@@ -674,10 +810,10 @@ static bool TxProcessor_FreeDV (audio_block_t a_block, iq_buffer_t* iq_buf_p, in
             }
 
             // increment and wrap
-            modulus_Interpolate++;
-            if (modulus_Interpolate == factor_Interpolate)
+            fdv_tx.modulus_Interpolate++;
+            if (fdv_tx.modulus_Interpolate == factor_Interpolate)
             {
-                modulus_Interpolate = 0;
+                fdv_tx.modulus_Interpolate = 0;
             }
         }
 
@@ -698,8 +834,27 @@ static bool TxProcessor_FreeDV (audio_block_t a_block, iq_buffer_t* iq_buf_p, in
     }
     else
     {
-        profileEvent(FreeDVTXUnderrun);
-        bufferFilled = false;
+        if (fdv_tx.bufferFilled == true)
+        {
+            // we ran out of encoded samples while sending, wait for the next frame plus a (now longer) lead-in
+            profileEvent(FreeDVTXUnderrun);
+            FreeDV_Tx_ReportUnderrun();
+            fdv_tx.bufferFilled = false;
+            fdv_tx.leadInCountdown = -1;
+            fdv_tx.modulus_Interpolate = 0;
+            fdv_tx.ringOutBlocks = (Fir_TxFreeDV_Interpolate_I.numTaps + blockSize - 1) / blockSize;
+        }
+
+        if (fdv_tx.ringOutBlocks > 0 && ads.tx_filter_adjusting == 0)
+        {
+            // let the interpolation filter ring out instead of cutting the signal hard, a hard cut splatters
+            arm_fill_f32(0, i_buffer, blockSize);
+            arm_fill_f32(0, q_buffer, blockSize);
+            arm_fir_f32(&Fir_TxFreeDV_Interpolate_I, i_buffer, i_buffer,blockSize);
+            arm_fir_f32(&Fir_TxFreeDV_Interpolate_Q, q_buffer, q_buffer, blockSize);
+            fdv_tx.ringOutBlocks--;
+            retval = true;
+        }
     }
 
     return retval;
@@ -888,7 +1043,7 @@ static bool TxProcessor_CW(audio_block_t a_block, iq_buffer_t* iq_buf_p, uint16_
 }
 
 
-void TxProcessor_Run(AudioSample_t * const srcCodec, IqSample_t * const dst, AudioSample_t * const audioDst, uint16_t blockSize, bool external_mute)
+void TxProcessor_Run(AudioSample_t * const srcCodec, IqSample_t * const dst, const IqSample_t * const iqLoopback, AudioSample_t * const audioDst, uint16_t blockSize, bool external_mute)
 {
 
     /*
@@ -1065,6 +1220,12 @@ void TxProcessor_Run(AudioSample_t * const srcCodec, IqSample_t * const dst, Aud
     // now do the final processing including adjusting the IQ according to the calibration data
     TxProcessor_IqFinalProcessing(iq_gain_comp, false, &adb.iq_buf, dst, blockSize);
 
+    // the predistortion learns from the tx loopback, if the hardware has one
+    if (iqLoopback != NULL && TxDpd_IsEnabled())
+    {
+        TxProcessor_DpdCapture(dst, iqLoopback, blockSize);
+    }
+
     if (ts.stream_tx_audio == STREAM_TX_AUDIO_DIGIQ)
     {
         for(int i = 0; i < blockSize; i++)
@@ -22,5 +22,5 @@
 void TxProcessor_Init(void);
 void TxProcessor_Set(uint8_t dmod_mode);
 void TxProcessor_PrepareRun(void);
-void TxProcessor_Run(AudioSample_t * const srcCodec, IqSample_t * const dst, AudioSample_t * const audioDst, uint16_t blockSize, bool external_mute);
+void TxProcessor_Run(AudioSample_t * const srcCodec, IqSample_t * const dst, const IqSample_t * const iqLoopback, AudioSample_t * const audioDst, uint16_t blockSize, bool external_mute);
 #endif
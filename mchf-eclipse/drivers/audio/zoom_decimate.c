@@ -0,0 +1,196 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     zoom_decimate.c                                                 **
+ **  Description:   CIC + compensating FIR iq decimator for the zoom fft            **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * The zoom fft needs the iq signal around the rx frequency decimated by 2^magnify.
+ *
+ * The decimation is split into two parts (see ZoomFFTDecimate[] for the factors):
+ * - a 4 stage CIC filter does the bulk of the decimation. Per input sample this costs
+ *   4 integer additions per channel, independent of the decimation factor. The comb
+ *   sections run at the CIC output rate.
+ * - a symmetric FIR filter compensates the passband droop of the CIC, provides the
+ *   steep skirts and decimates by the remaining factor of 4 (2 for 2x zoom).
+ *   It is only evaluated for the samples we keep.
+ *
+ * So the higher the zoom, the less work is left for the FIR, the cost of the CIC stays constant.
+ *
+ * The CIC integrators grow without bounds, this is intended: they run in modulo 2^64 arithmetic
+ * and the wrap arounds cancel out in the comb sections as long as the output fits, which it
+ * does with a lot of margin (28 bit input, 4 * log2(32) = 20 bit CIC gain at most).
+ * The input is scaled by ZOOM_DECIMATE_INPUT_SCALE before the conversion to integer to
+ * keep the fractional bits of the 16 bit range samples.
+ *
+ * Since the number of output samples per input block is not necessarily an integer
+ * (e.g. 32 samples in, 128x zoom), the decimation phases are kept across calls.
+ */
+
+#include "uhsdr_board.h"
+#include "filters.h"
+#include "zoom_decimate.h"
+
+#define ZOOM_DECIMATE_INPUT_SCALE   4096.0
+
+/**
+ * Sets up the decimator for a zoom level and clears all filter state
+ * @param magnify decimation is 2^magnify, 1 ... ZOOM_FFT_DECIMATE_NUM-1
+ */
+void ZoomDecimate_Init(ZoomDecimate_t* zd, const uint8_t magnify)
+{
+    memset(zd, 0, sizeof(*zd));
+
+    if (magnify > 0 && magnify < ZOOM_FFT_DECIMATE_NUM)
+    {
+        const ZoomFFT_Decimator_t* desc = &ZoomFFTDecimate[magnify];
+
+        zd->coeffs = desc->pCoeffs;
+        zd->num_taps = desc->num_taps;
+        zd->cic_rate = desc->cic_rate;
+        zd->fir_rate = desc->fir_rate;
+
+        float32_t cic_gain = 1.0;
+        for (int stage = 0; stage < ZOOM_DECIMATE_CIC_STAGES; stage++)
+        {
+            cic_gain *= zd->cic_rate;
+        }
+        zd->cic_scale = 1.0 / (cic_gain * ZOOM_DECIMATE_INPUT_SCALE);
+    }
+}
+
+/**
+ * Adds a sample to the FIR history and runs the FIR if an output sample is due
+ * @return true if an output sample was written to out
+ */
+static inline bool ZoomDecimate_Fir(const ZoomDecimate_t* zd, ZoomDecimate_Channel_t* ch, const float32_t sample,
+        uint16_t* history_idx, uint16_t* fir_phase, float32_t* out)
+{
+    bool retval = false;
+    uint16_t idx = *history_idx;
+
+    ch->history[idx] = sample;
+    ch->history[idx + zd->num_taps] = sample;
+
+    idx++;
+    if (idx == zd->num_taps)
+    {
+        idx = 0;
+    }
+    *history_idx = idx;
+
+    (*fir_phase)++;
+    if (*fir_phase == zd->fir_rate)
+    {
+        *fir_phase = 0;
+        // the coefficients are symmetric, so we don't care about the order of the history
+        arm_dot_prod_f32(&ch->history[idx], (float32_t*)zd->coeffs, zd->num_taps, out);
+        retval = true;
+    }
+    return retval;
+}
+
+/**
+ * Decimates one channel, the shared decimation phases are read from zd and returned through the pointers
+ * @return number of output samples
+ */
+static uint16_t ZoomDecimate_ProcessChannel(const ZoomDecimate_t* zd, ZoomDecimate_Channel_t* ch, const float32_t* in, float32_t* out,
+        const uint16_t blockSize, uint16_t* cic_phase_p, uint16_t* fir_phase_p, uint16_t* history_idx_p)
+{
+    uint16_t cic_phase = zd->cic_phase;
+    uint16_t fir_phase = zd->fir_phase;
+    uint16_t history_idx = zd->history_idx;
+    uint16_t out_count = 0;
+
+    if (zd->cic_rate == 1)
+    {
+        for (uint16_t idx = 0; idx < blockSize; idx++)
+        {
+            if (ZoomDecimate_Fir(zd, ch, in[idx], &history_idx, &fir_phase, &out[out_count]))
+            {
+                out_count++;
+            }
+        }
+    }
+    else
+    {
+        uint64_t int0 = ch->integrator[0];
+        uint64_t int1 = ch->integrator[1];
+        uint64_t int2 = ch->integrator[2];
+        uint64_t int3 = ch->integrator[3];
+
+        for (uint16_t idx = 0; idx < blockSize; idx++)
+        {
+            const int32_t sample = in[idx] * ZOOM_DECIMATE_INPUT_SCALE;
+
+            int0 += (int64_t)sample;
+            int1 += int0;
+            int2 += int1;
+            int3 += int2;
+
+            cic_phase++;
+            if (cic_phase == zd->cic_rate)
+            {
+                cic_phase = 0;
+
+                uint64_t comb = int3;
+                for (int stage = 0; stage < ZOOM_DECIMATE_CIC_STAGES; stage++)
+                {
+                    const uint64_t delayed = ch->comb[stage];
+                    ch->comb[stage] = comb;
+                    comb -= delayed;
+                }
+
+                if (ZoomDecimate_Fir(zd, ch, (int64_t)comb * zd->cic_scale, &history_idx, &fir_phase, &out[out_count]))
+                {
+                    out_count++;
+                }
+            }
+        }
+
+        ch->integrator[0] = int0;
+        ch->integrator[1] = int1;
+        ch->integrator[2] = int2;
+        ch->integrator[3] = int3;
+    }
+
+    *cic_phase_p = cic_phase;
+    *fir_phase_p = fir_phase;
+    *history_idx_p = history_idx;
+
+    return out_count;
+}
+
+/**
+ * Decimates a block of iq samples by the factor set with ZoomDecimate_Init()
+ * In place operation (i_out == i_in, q_out == q_in) is fine.
+ *
+ * @param blockSize number of input samples
+ * @return number of output samples, at most blockSize / 2^magnify rounded up
+ */
+uint16_t ZoomDecimate_Process(ZoomDecimate_t* zd, const float32_t* i_in, const float32_t* q_in, float32_t* i_out, float32_t* q_out, const uint16_t blockSize)
+{
+    uint16_t out_count = 0;
+
+    if (zd->num_taps != 0)
+    {
+        uint16_t cic_phase, fir_phase, history_idx;
+
+        // both channels start from the same phases and end with the same phases
+        ZoomDecimate_ProcessChannel(zd, &zd->i, i_in, i_out, blockSize, &cic_phase, &fir_phase, &history_idx);
+        out_count = ZoomDecimate_ProcessChannel(zd, &zd->q, q_in, q_out, blockSize, &cic_phase, &fir_phase, &history_idx);
+
+        zd->cic_phase = cic_phase;
+        zd->fir_phase = fir_phase;
+        zd->history_idx = history_idx;
+    }
+
+    return out_count;
+}
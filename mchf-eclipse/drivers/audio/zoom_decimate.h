@@ -0,0 +1,52 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     zoom_decimate.h                                                 **
+ **  Description:   CIC + compensating FIR iq decimator for the zoom fft            **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#ifndef __ZOOM_DECIMATE_H
+#define __ZOOM_DECIMATE_H
+
+#include "uhsdr_types.h"
+#include "arm_math.h"
+
+#define ZOOM_DECIMATE_CIC_STAGES        4
+#define ZOOM_DECIMATE_NUM_TAPS_MAX      63
+
+typedef struct
+{
+    // CIC integrators and comb delays, unsigned since the integrators are supposed to wrap around
+    uint64_t integrator[ZOOM_DECIMATE_CIC_STAGES];
+    uint64_t comb[ZOOM_DECIMATE_CIC_STAGES];
+    // FIR input, each sample is stored twice so that the last num_taps samples are always contiguous
+    float32_t history[2 * ZOOM_DECIMATE_NUM_TAPS_MAX];
+} ZoomDecimate_Channel_t;
+
+typedef struct
+{
+    ZoomDecimate_Channel_t i;
+    ZoomDecimate_Channel_t q;
+
+    const float32_t* coeffs;
+    uint16_t num_taps;
+    uint16_t cic_rate;
+    uint16_t fir_rate;
+    float32_t cic_scale;    // 1 / (CIC gain * input scaling)
+
+    // shared by i and q
+    uint16_t cic_phase;
+    uint16_t fir_phase;
+    uint16_t history_idx;
+} ZoomDecimate_t;
+
+void ZoomDecimate_Init(ZoomDecimate_t* zd, const uint8_t magnify);
+uint16_t ZoomDecimate_Process(ZoomDecimate_t* zd, const float32_t* i_in, const float32_t* q_in, float32_t* i_out, float32_t* q_out, const uint16_t blockSize);
+
+#endif
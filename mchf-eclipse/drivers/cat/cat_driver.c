@@ -22,6 +22,8 @@
 #include "audio_driver.h"
 #include "radio_management.h"
 #include "config_storage.h"
+#include "cat_spectrum.h"
+#include "profiling.h"
 
 uint8_t limit_4bits(uint32_t in)
 {
@@ -735,6 +737,8 @@ typedef enum
     FT817_NOOP          = 0xff,
 
     UHSDR_ID            = 0x42, // this command is not known to the FT817 so we can use this to identify a UHSDR
+    UHSDR_SPECTRUM_STREAM = 0x43, // P1 = spectrum frames per second, 0 = off, see cat_spectrum.c
+    UHSDR_UI_PROFILE    = 0x44, // returns the UI statistics of the last interval, see ProfileUiStats_t
 } Ft817_CatCmd_t;
 
 struct FT817 ft817;
@@ -1313,6 +1317,15 @@ static void CatDriver_HandleCommands()
             resp[4] = 'R';
             bc = 5;
             break;
+        case UHSDR_SPECTRUM_STREAM:
+            CatSpectrum_SetRate(ft817.req[0]);
+            resp[0] = CatSpectrum_GetRate();
+            bc = 1;
+            break;
+        case UHSDR_UI_PROFILE:
+            memcpy(resp, &eventProfile.ui_stats, sizeof(eventProfile.ui_stats));
+            bc = sizeof(eventProfile.ui_stats);
+            break;
             // default:
             // while (1);
 
@@ -1330,6 +1343,7 @@ void CatDriver_HandleProtocol()
         if (ft817.state != CAT_INIT)
         {
             cat_buffer_reset();
+            CatSpectrum_SetRate(0);
             ft817.state = CAT_INIT;
         }
     }
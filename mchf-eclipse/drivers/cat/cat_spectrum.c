@@ -0,0 +1,265 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     cat_spectrum.c                                                  **
+ **  Description:   spectrum streaming over the USB CAT (CDC) port                  **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * If enabled with the UHSDR CAT command 0x43, the averaged spectrum is sent as binary frames
+ * over the CAT port, in between the normal CAT responses. A decoder is in support/python/uhsdr.py.
+ *
+ * Frame format, all multi byte values little endian:
+ *
+ *  offset  size
+ *   0      3    sync 0xA5 'S' 'P'
+ *   3      1    version (CAT_SPECTRUM_VERSION)
+ *   4      2    frame sequence number
+ *   6      2    number of bins
+ *   8      2    index of the bin at the center frequency
+ *  10      4    center frequency in Hz
+ *  14      4    bin width in mHz
+ *  18      2    level of the value 0 in 0.5 dB steps, signed
+ *  20      1    level step in 0.1 dB
+ *  21      1    zoom level (magnify)
+ *  22      2    payload length in bytes
+ *  24      n    payload, bins in ascending frequency order
+ *  24+n    2    Fletcher-16 checksum of all bytes before
+ *
+ * The bins are the spectrum power in dB quantized to 8 bit. The payload codes the difference to the
+ * previous bin (starting with 0):
+ *  00aaabbb            two bins, 3 bit signed differences a, then b
+ *  01dddddd            one bin, 6 bit signed difference
+ *  10nnnnnn            n+1 bins equal to the previous one
+ *  11000000 vvvvvvvv   one bin with the absolute value v
+ *  all other codes are reserved
+ *
+ * The frames are only queued if they fit completely into the USB transmit buffer, so the main loop
+ * never waits for the host. If a frame does not fit, it is dropped and the frame interval is doubled,
+ * if frames fit easily, the interval is slowly reduced down to the requested rate.
+ */
+
+#include "uhsdr_board.h"
+#include "cat_spectrum.h"
+#include "cat_driver.h"
+#include "usbd_cdc_if.h"
+#include "ui_spectrum.h"
+#include "uhsdr_math.h"
+
+#define CAT_SPECTRUM_VERSION        1
+#define CAT_SPECTRUM_HEADER_LEN     24
+#define CAT_SPECTRUM_FRAME_MAX      (CAT_SPECTRUM_HEADER_LEN + 2*SPEC_BUFF_LEN + 2)
+
+#define CAT_SPECTRUM_LEVEL_STEP     5       // in 0.1dB, 8 bit cover 127.5dB
+#define CAT_SPECTRUM_CAT_RESERVE    64      // bytes left free in the transmit buffer for CAT responses
+
+#define CAT_SPECTRUM_INTERVAL_MAX   100     // in sysclock ticks (10ms), at least one frame per second
+
+typedef struct
+{
+    uint8_t rate;               // requested frames per second, 0 = off
+    uint16_t interval;          // current frame interval in sysclock ticks
+    uint16_t interval_min;      // frame interval of the requested rate
+    uint32_t last_time;         // sysclock of the last frame
+    uint16_t seq;
+} CatSpectrum_t;
+
+static CatSpectrum_t cat_spectrum;
+
+static uint8_t cat_spectrum_frame[CAT_SPECTRUM_FRAME_MAX];
+
+static void CatSpectrum_Put16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = value & 0xff;
+    buf[1] = value >> 8;
+}
+
+static void CatSpectrum_Put32(uint8_t* buf, uint32_t value)
+{
+    CatSpectrum_Put16(&buf[0], value & 0xffff);
+    CatSpectrum_Put16(&buf[2], value >> 16);
+}
+
+static uint16_t CatSpectrum_Fletcher16(const uint8_t* buf, uint16_t len)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+
+    for (uint16_t idx = 0; idx < len; idx++)
+    {
+        sum1 = (sum1 + buf[idx]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+/**
+ * Codes the quantized levels as described above
+ * @return payload length
+ */
+static uint16_t CatSpectrum_EncodeLevels(const uint8_t* levels, uint16_t num_bins, uint8_t* buf)
+{
+    uint16_t len = 0;
+    int16_t prev = 0;
+    uint16_t idx = 0;
+
+    while (idx < num_bins)
+    {
+        const int16_t diff = levels[idx] - prev;
+
+        if (diff == 0)
+        {
+            uint16_t run = 1;
+            while (idx + run < num_bins && run < 64 && levels[idx + run] == prev)
+            {
+                run++;
+            }
+            buf[len++] = 0x80 | (run - 1);
+            idx += run;
+        }
+        else
+        {
+            const int16_t diff2 = idx + 1 < num_bins ? levels[idx + 1] - levels[idx] : 0x7fff;
+
+            if (diff >= -4 && diff <= 3 && diff2 >= -4 && diff2 <= 3)
+            {
+                prev = levels[idx + 1];
+                buf[len++] = ((diff & 0x07) << 3) | (diff2 & 0x07);
+                idx += 2;
+            }
+            else if (diff >= -32 && diff <= 31)
+            {
+                prev = levels[idx];
+                buf[len++] = 0x40 | (diff & 0x3f);
+                idx++;
+            }
+            else
+            {
+                prev = levels[idx];
+                buf[len++] = 0xc0;
+                buf[len++] = prev;
+                idx++;
+            }
+        }
+    }
+    return len;
+}
+
+/**
+ * Builds a complete frame from the averaged spectrum power data
+ * @return frame length in bytes
+ */
+static uint16_t CatSpectrum_BuildFrame(uint8_t* buf)
+{
+    const uint16_t num_bins = sd.spec_len;
+    // the quantized levels are stored at the end of the buffer, the payload never overtakes them
+    // since each level needs 2 bytes at most and is read before its code is written
+    uint8_t* levels = &buf[CAT_SPECTRUM_FRAME_MAX - num_bins];
+
+    // spectrum power in 0.5 dB steps relative to the weakest bin, in ascending frequency order (see UiSpectrum_ScaleFFT)
+    float32_t power_min;
+    uint32_t power_min_idx;
+    arm_min_f32(sd.FFT_AVGData, num_bins, &power_min, &power_min_idx);
+    const int16_t level_min = roundf(Math_log10f_fast(power_min) * (100.0 / CAT_SPECTRUM_LEVEL_STEP));
+
+    for (uint16_t bin = 0; bin < num_bins; bin++)
+    {
+        const float32_t power = sd.FFT_AVGData[(num_bins - 1 - bin + num_bins/2) % num_bins];
+        const int16_t level = roundf(Math_log10f_fast(power) * (100.0 / CAT_SPECTRUM_LEVEL_STEP)) - level_min;
+        levels[bin] = level < 0 ? 0 : (level > UINT8_MAX ? UINT8_MAX : level);
+    }
+
+    const uint16_t payload_len = CatSpectrum_EncodeLevels(levels, num_bins, &buf[CAT_SPECTRUM_HEADER_LEN]);
+
+    const float32_t bin_width = IQ_SAMPLE_RATE_F / ((1 << sd.magnify) * num_bins);
+
+    buf[0] = 0xA5;
+    buf[1] = 'S';
+    buf[2] = 'P';
+    buf[3] = CAT_SPECTRUM_VERSION;
+    CatSpectrum_Put16(&buf[4], cat_spectrum.seq);
+    CatSpectrum_Put16(&buf[6], num_bins);
+    CatSpectrum_Put16(&buf[8], num_bins/2 - 1);         // the DC bin of the FFT
+    CatSpectrum_Put32(&buf[10], sd.FFT_frequency);
+    CatSpectrum_Put32(&buf[14], bin_width * 1000.0);
+    CatSpectrum_Put16(&buf[18], level_min);
+    buf[20] = CAT_SPECTRUM_LEVEL_STEP;
+    buf[21] = sd.magnify;
+    CatSpectrum_Put16(&buf[22], payload_len);
+
+    const uint16_t len = CAT_SPECTRUM_HEADER_LEN + payload_len;
+    CatSpectrum_Put16(&buf[len], CatSpectrum_Fletcher16(buf, len));
+
+    return len + 2;
+}
+
+/**
+ * Enables the spectrum stream
+ * @param rate frames per second, 0 switches the stream off
+ */
+void CatSpectrum_SetRate(uint8_t rate)
+{
+    if (rate > CAT_SPECTRUM_RATE_MAX)
+    {
+        rate = CAT_SPECTRUM_RATE_MAX;
+    }
+    cat_spectrum.rate = rate;
+    if (rate != 0)
+    {
+        cat_spectrum.interval_min = 100 / rate;
+        cat_spectrum.interval = cat_spectrum.interval_min;
+        cat_spectrum.last_time = ts.sysclock;
+    }
+}
+
+uint8_t CatSpectrum_GetRate()
+{
+    return cat_spectrum.rate;
+}
+
+/**
+ * Sends the current spectrum if the stream is enabled and a frame is due.
+ * To be called whenever the spectrum data has been updated.
+ */
+void CatSpectrum_Process()
+{
+    if (cat_spectrum.rate != 0 && CatDriver_GetInterfaceState() == CAT_CONNECTED
+            && ts.sysclock - cat_spectrum.last_time >= cat_spectrum.interval)
+    {
+        cat_spectrum.last_time = ts.sysclock;
+
+        const uint16_t len = CatSpectrum_BuildFrame(cat_spectrum_frame);
+        const uint16_t free_bytes = CDC_Transmit_Free_FS();
+
+        if (free_bytes >= len + CAT_SPECTRUM_CAT_RESERVE)
+        {
+            CDC_Transmit_FS(cat_spectrum_frame, len);
+            cat_spectrum.seq++;
+
+            if (free_bytes >= 3 * len + CAT_SPECTRUM_CAT_RESERVE && cat_spectrum.interval > cat_spectrum.interval_min)
+            {
+                // the host keeps up, slowly go faster
+                cat_spectrum.interval -= (cat_spectrum.interval + 7) / 8;
+                if (cat_spectrum.interval < cat_spectrum.interval_min)
+                {
+                    cat_spectrum.interval = cat_spectrum.interval_min;
+                }
+            }
+        }
+        else
+        {
+            // the host does not read fast enough, drop this frame and back off
+            cat_spectrum.interval *= 2;
+            if (cat_spectrum.interval > CAT_SPECTRUM_INTERVAL_MAX)
+            {
+                cat_spectrum.interval = CAT_SPECTRUM_INTERVAL_MAX;
+            }
+        }
+    }
+}
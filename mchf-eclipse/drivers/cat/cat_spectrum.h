@@ -0,0 +1,25 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     cat_spectrum.h                                                  **
+ **  Description:   spectrum streaming over the USB CAT (CDC) port                  **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#ifndef __CAT_SPECTRUM_H
+#define __CAT_SPECTRUM_H
+
+#include "uhsdr_types.h"
+
+#define CAT_SPECTRUM_RATE_MAX       50      // frames per second, more makes no sense with the spectrum frame rate limit
+
+void CatSpectrum_SetRate(uint8_t rate);
+uint8_t CatSpectrum_GetRate(void);
+void CatSpectrum_Process(void);
+
+#endif
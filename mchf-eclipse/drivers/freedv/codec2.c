@@ -191,7 +191,9 @@ struct CODEC2 * codec2_create(int mode)
     }
     c2->prev_e_dec = 1;
 
-    c2->nlp = nlp_create(&c2->c2const);
+    /* NLP uses the same FFT size as the encoder and shares its config */
+
+    c2->nlp = nlp_create(&c2->c2const, c2->fftr_fwd_cfg);
     if (c2->nlp == NULL) {
 	return NULL;
     }
@@ -527,6 +527,7 @@ void freedv_close(struct freedv *freedv) {
             FREE(freedv->mod_out);
         FREE(freedv->codeword_symbols);
         FREE(freedv->codeword_amps);
+        ldpc_layered_destroy(freedv->ldpc);
         FREE(freedv->ldpc);
         ofdm_destroy(freedv->ofdm);
     }
@@ -2485,3 +2486,179 @@ void freedv_get_modem_extended_stats(struct freedv *f, struct MODEM_STATS *stats
     
 }
 
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTIONS...: freedv_sync_detector_*
+
+  Modem only receivers, used to find out which FreeDV mode is on the
+  channel without running a complete decoder for each candidate mode.
+  Only the demodulator and its sync state machine run, there is no
+  FEC decoding and no speech decoder, so a detector needs a fraction
+  of the memory and cycles of a complete freedv instance.
+
+  A detector accepts blocks of any size, it buffers the samples
+  internally until it has the freedv_nin() worth of samples its modem
+  asks for.  So it can be fed from the same input stream as a running
+  freedv instance of a different mode.
+
+  The detector reports sync once the modem is confident:
+
+    1600: fdmdv sync held for FREEDV_DETECT_1600_FRAMES modem frames,
+          the fdmdv state machine alone occasionally syncs on noise
+    700D: OFDM sync state machine reached "synced", i.e. several
+          consecutive frames with a correct unique word
+
+  Only one OFDM modem can exist at a time, as ofdm.c keeps its
+  configuration in static variables.  So a 700D detector must not be
+  created while a 700D freedv instance is open.
+
+\*---------------------------------------------------------------------------*/
+
+#define FREEDV_DETECT_1600_FRAMES 25          /* 0.5s of continuous fdmdv sync */
+
+struct freedv_sync_detector {
+    int           mode;
+    struct FDMDV *fdmdv;
+    struct OFDM  *ofdm;
+    int           nin;                        /* samples the modem wants for its next call */
+    int           n_max;                      /* size of in[]                              */
+    int           n_in;                       /* samples currently held in in[]            */
+    int           sync_frames;                /* consecutive 1600 frames in sync           */
+    int           sync;
+    short        *in;
+};
+
+struct freedv_sync_detector *freedv_sync_detector_create(int mode) {
+    struct freedv_sync_detector *d;
+
+    if (!(FDV_MODE_ACTIVE( FREEDV_MODE_1600, mode) || FDV_MODE_ACTIVE( FREEDV_MODE_700D, mode)))
+        return NULL;
+
+    d = (struct freedv_sync_detector*)CALLOC(1, sizeof(struct freedv_sync_detector));
+    if (d == NULL)
+        return NULL;
+    d->mode = mode;
+
+    if (FDV_MODE_ACTIVE( FREEDV_MODE_1600, mode)) {
+        d->fdmdv = fdmdv_create(16);
+        d->nin   = FDMDV_NOM_SAMPLES_PER_FRAME;
+        d->n_max = FDMDV_MAX_SAMPLES_PER_FRAME;
+    }
+    if (FDV_MODE_ACTIVE( FREEDV_MODE_700D, mode)) {
+        struct OFDM_CONFIG *ofdm_config = (struct OFDM_CONFIG *) CALLOC(1, sizeof (struct OFDM_CONFIG));
+        if (ofdm_config != NULL) {
+            d->ofdm = ofdm_create(ofdm_config);
+            FREE(ofdm_config);
+        }
+        if (d->ofdm != NULL) {
+            d->nin   = ofdm_get_nin(d->ofdm);
+            d->n_max = ofdm_get_max_samples_per_frame();
+        }
+    }
+
+    if (d->fdmdv != NULL || d->ofdm != NULL)
+        d->in = (short*)MALLOC(sizeof(short)*d->n_max);
+
+    if (d->in == NULL) {
+        freedv_sync_detector_destroy(d);
+        return NULL;
+    }
+
+    return d;
+}
+
+void freedv_sync_detector_destroy(struct freedv_sync_detector *d) {
+    assert(d != NULL);
+
+    if (d->fdmdv != NULL)
+        fdmdv_destroy(d->fdmdv);
+    if (d->ofdm != NULL)
+        ofdm_destroy(d->ofdm);
+    if (d->in != NULL)
+        FREE(d->in);
+    FREE(d);
+}
+
+static void freedv_sync_detector_1600(struct freedv_sync_detector *d) {
+    int  rx_bits[fdmdv_bits_per_frame(d->fdmdv)];
+    int  reliable_sync_bit;
+    COMP rx_fdm[d->nin];
+    int  i;
+
+    for(i=0; i<d->nin; i++) {
+        rx_fdm[i].real = (float)d->in[i]/FDMDV_SCALE;
+        rx_fdm[i].imag = 0.0;
+    }
+
+    fdmdv_demod(d->fdmdv, rx_bits, &reliable_sync_bit, rx_fdm, &d->nin);
+
+    if (d->fdmdv->sync) {
+        if (d->sync_frames < FREEDV_DETECT_1600_FRAMES)
+            d->sync_frames++;
+    }
+    else {
+        d->sync_frames = 0;
+    }
+    d->sync = d->sync_frames >= FREEDV_DETECT_1600_FRAMES;
+}
+
+static void freedv_sync_detector_700d(struct freedv_sync_detector *d) {
+    struct OFDM        *ofdm = d->ofdm;
+    struct OFDM_CONFIG *ofdm_config = ofdm_get_config_param();
+    int   bitsperframe = ofdm_get_bits_per_frame();
+    int   nuwbits = (ofdm_config->ns - 1) * ofdm_config->bps - ofdm_config->txtbits;
+    int   ntxtbits = ofdm_config->txtbits;
+    int   npayload_syms = (bitsperframe - nuwbits - ntxtbits) / ofdm_config->bps;
+    float gain = 2.0 / OFDM_AMP_SCALE;       /* same scaling as freedv_rx() for 700D */
+
+    int     rx_bits[bitsperframe];
+    uint8_t rx_uw[nuwbits];
+    short   txt_bits[ntxtbits];
+    COMP    payload_syms[npayload_syms];
+    float   payload_amps[npayload_syms];
+
+    if (ofdm->sync_state == search) {
+        ofdm_sync_search_shorts(ofdm, d->in, gain);
+    }
+
+    if ((ofdm->sync_state == synced) || (ofdm->sync_state == trial)) {
+        ofdm_demod_shorts(ofdm, rx_bits, d->in, gain);
+        ofdm_disassemble_modem_frame(ofdm, rx_uw, payload_syms, payload_amps, txt_bits);
+    }
+
+    d->nin = ofdm_get_nin(ofdm);
+    ofdm_sync_state_machine(ofdm, rx_uw);
+    d->sync = ofdm->sync_state == synced;
+}
+
+/* returns the current sync state after the samples have been processed */
+
+int freedv_sync_detector_rx(struct freedv_sync_detector *d, short demod_in[], int n) {
+    assert(d != NULL);
+
+    while (n > 0) {
+        int count = d->nin - d->n_in;
+        if (count > n)
+            count = n;
+
+        memcpy(&d->in[d->n_in], demod_in, count*sizeof(short));
+        d->n_in += count;
+        demod_in += count;
+        n -= count;
+
+        if (d->n_in == d->nin) {
+            if (d->fdmdv != NULL)
+                freedv_sync_detector_1600(d);
+            else
+                freedv_sync_detector_700d(d);
+            d->n_in = 0;
+            assert(d->nin <= d->n_max);
+        }
+    }
+
+    return d->sync;
+}
+
+int freedv_sync_detector_get_sync(struct freedv_sync_detector *d) {return d->sync;}
+int freedv_sync_detector_get_mode(struct freedv_sync_detector *d) {return d->mode;}
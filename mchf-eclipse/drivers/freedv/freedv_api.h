@@ -138,6 +138,15 @@ struct freedv *freedv_open(int mode);
 struct freedv *freedv_open_advanced(int mode, struct freedv_advanced *adv);
 void freedv_close   (struct freedv *freedv);
 
+// Mode detection -------------------------------------------------------------
+
+struct freedv_sync_detector;
+struct freedv_sync_detector *freedv_sync_detector_create(int mode);
+void freedv_sync_detector_destroy       (struct freedv_sync_detector *d);
+int  freedv_sync_detector_rx            (struct freedv_sync_detector *d, short demod_in[], int n);
+int  freedv_sync_detector_get_sync      (struct freedv_sync_detector *d);
+int  freedv_sync_detector_get_mode      (struct freedv_sync_detector *d);
+
 // Transmit -------------------------------------------------------------------
 
 void freedv_tx      (struct freedv *freedv, short mod_out[], short speech_in[]);
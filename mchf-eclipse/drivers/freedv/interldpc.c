@@ -85,6 +85,23 @@ void set_data_bits_per_frame(struct LDPC *ldpc, int new_data_bits_per_frame, int
     ldpc->coded_syms_per_frame = ldpc->coded_bits_per_frame / bps;
 }
     
+/* selects LDPC_DEC_DEFAULT, falls back to the sum-product decoder if the
+   layered decoder can't get its memory. The layered schedule converges in
+   about half the iterations, so we halve max_iter to keep the worst case
+   decode time of frames which never converge in check. */
+
+void set_up_ldpc_decoder(struct LDPC *ldpc) {
+    ldpc->layered = NULL;
+    ldpc->dec_type = LDPC_DEC_DEFAULT;
+
+    if (ldpc->dec_type != LDPC_DEC_SUM_PRODUCT) {
+        if (ldpc_layered_setup(ldpc))
+            ldpc->max_iter /= 2;
+        else
+            ldpc->dec_type = LDPC_DEC_SUM_PRODUCT;
+    }
+}
+
 // TODO: this should be in (n,k) = (224,112) format, fix some time
 
 void set_up_hra_112_112(struct LDPC *ldpc, struct OFDM_CONFIG *config) {
@@ -103,6 +120,7 @@ void set_up_hra_112_112(struct LDPC *ldpc, struct OFDM_CONFIG *config) {
     /* provided for convenience and to match Octave variable names */
 
     set_up_ldpc_constants(ldpc, HRA_112_112_CODELENGTH, HRA_112_112_NUMBERPARITYBITS, config->bps);
+    set_up_ldpc_decoder(ldpc);
 }
 
 // Note code #defines below should be in (n,k) = (504,396)
@@ -121,6 +139,7 @@ void set_up_hra_504_396(struct LDPC *ldpc, struct OFDM_CONFIG *config) {
     ldpc->H_cols = (uint16_t *) HRAb_396_504_H_cols;
 
     set_up_ldpc_constants(ldpc, HRAb_396_504_CODELENGTH, HRAb_396_504_NUMBERPARITYBITS, config->bps);
+    set_up_ldpc_decoder(ldpc);
 }
 
 void ldpc_encode_frame(struct LDPC *ldpc, int codeword[], unsigned char tx_bits_char[]) {
@@ -38,6 +38,7 @@
 
 COMP test_acc(COMP v[], int n);
 void printf_n(COMP v[], int n);
+void set_up_ldpc_decoder(struct LDPC *ldpc);
 void set_up_hra_112_112(struct LDPC *ldpc, struct OFDM_CONFIG *);
 void set_up_hra_504_396(struct LDPC *ldpc, struct OFDM_CONFIG *c);
 void set_data_bits_per_frame(struct LDPC *ldpc, int new_data_bits_per_frame, int bps);
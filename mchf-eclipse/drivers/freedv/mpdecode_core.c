@@ -489,9 +489,18 @@ return(result);
 }
 
 
-/* Convenience function to call LDPC decoder from C programs */
+/* Convenience function to call LDPC decoder from C programs, uses the decoder selected by ldpc->dec_type */
 
 int run_ldpc_decoder(struct LDPC *ldpc, uint8_t out_char[], float input[], int *parityCheckCount) {
+    if ((ldpc->dec_type == LDPC_DEC_LAYERED_MIN_SUM || ldpc->dec_type == LDPC_DEC_LAYERED_MIN_SUM_Q) && ldpc->layered != NULL)
+        return run_ldpc_decoder_layered(ldpc, out_char, input, parityCheckCount);
+    else
+        return run_ldpc_decoder_sum_product(ldpc, out_char, input, parityCheckCount);
+}
+
+/* original flooding sum-product decoder, builds the node structures on every call */
+
+int run_ldpc_decoder_sum_product(struct LDPC *ldpc, uint8_t out_char[], float input[], int *parityCheckCount) {
     int         max_iter, dec_type;
     float       q_scale_factor, r_scale_factor;
     int         max_row_weight, max_col_weight;
@@ -566,6 +575,271 @@ int run_ldpc_decoder(struct LDPC *ldpc, uint8_t out_char[], float input[], int *
 }
 
 
+/*---------------------------------------------------------------------------*\
+
+  Layered normalised min-sum decoder.
+
+  The check nodes are processed one after the other and the posterior
+  LLRs are updated immediately (layered or "turbo decoding message
+  passing" schedule), so each check node sees the information of the
+  check nodes processed before it in the same iteration. This converges
+  in about half the iterations of the flooding schedule. Min-sum needs
+  no phi0() lookups, the normalisation of the check node output
+  recovers the loss to sum-product.
+
+  After each iteration the syndrome of the hard decisions is checked and
+  we stop as soon as all parity checks are satisfied, most frames only
+  need a few iterations.
+
+  The graph is derived once from H_rows/H_cols with init_c_v_nodes(),
+  so the layered decoder uses exactly the same code as the reference
+  decoder, including the implicit HRA parity columns. All memory is
+  allocated at setup, nothing is allocated while decoding.
+
+\*---------------------------------------------------------------------------*/
+
+/* normalisation of the min-sum check node output, 15/16 was the best
+   value for HRA_112_112 in "freedv_bench -l", it matches the frame
+   error rate of the sum-product decoder */
+#define LDPC_LAYERED_ALPHA 0.9375f
+
+int ldpc_layered_setup(struct LDPC *ldpc) {
+    int CodeLength = ldpc->CodeLength;
+    int NumberParityBits = ldpc->NumberParityBits;
+    int NumberRowsHcols = ldpc->NumberRowsHcols;
+    int shift, H1, i, j, e;
+
+    shift = (NumberParityBits + NumberRowsHcols) - CodeLength;
+    if (NumberRowsHcols == CodeLength) {
+        H1=0;
+        shift=0;
+    } else {
+        H1=1;
+    }
+
+    struct c_node *c_nodes = CALLOC(NumberParityBits, sizeof(struct c_node));
+    struct v_node *v_nodes = CALLOC(CodeLength, sizeof(struct v_node));
+    float *zero = CALLOC(CodeLength, sizeof(float));
+    struct LDPC_LAYERED *lay = CALLOC(1, sizeof(struct LDPC_LAYERED));
+
+    if (c_nodes == NULL || v_nodes == NULL || zero == NULL || lay == NULL) {
+        FREE(c_nodes); FREE(v_nodes); FREE(zero); FREE(lay);
+        return 0;
+    }
+
+    init_c_v_nodes(c_nodes, shift, NumberParityBits, ldpc->max_row_weight, ldpc->H_rows, H1, CodeLength,
+                   v_nodes, NumberRowsHcols, ldpc->H_cols, ldpc->max_col_weight, 0, zero);
+
+    for (i=0; i<NumberParityBits; i++) {
+        lay->edges += c_nodes[i].degree;
+        if (c_nodes[i].degree > lay->max_check_degree)
+            lay->max_check_degree = c_nodes[i].degree;
+    }
+
+    lay->check_start = CALLOC(NumberParityBits + 1, sizeof(uint16_t));
+    lay->check_vars = CALLOC(lay->edges, sizeof(uint16_t));
+    lay->r = CALLOC(lay->edges, sizeof(float));
+    lay->l = CALLOC(CodeLength, sizeof(float));
+    lay->r_q = CALLOC(lay->edges, sizeof(ldpc_msg_t));
+    lay->l_q = CALLOC(CodeLength, sizeof(int16_t));
+
+    int ok = lay->check_start && lay->check_vars && lay->r && lay->l && lay->r_q && lay->l_q;
+
+    if (ok) {
+        for (i=0, e=0; i<NumberParityBits; i++) {
+            lay->check_start[i] = e;
+            for (j=0; j<c_nodes[i].degree; j++)
+                lay->check_vars[e++] = c_nodes[i].subs[j].index;
+        }
+        lay->check_start[NumberParityBits] = e;
+    }
+
+    for (i=0; i<NumberParityBits; i++) FREE(c_nodes[i].subs);
+    for (i=0; i<CodeLength; i++) FREE(v_nodes[i].subs);
+    FREE(c_nodes);
+    FREE(v_nodes);
+    FREE(zero);
+
+    ldpc->layered = lay;
+    if (!ok) {
+        ldpc_layered_destroy(ldpc);
+    }
+
+    return ok;
+}
+
+void ldpc_layered_destroy(struct LDPC *ldpc) {
+    struct LDPC_LAYERED *lay = ldpc->layered;
+
+    if (lay != NULL) {
+        FREE(lay->check_start);
+        FREE(lay->check_vars);
+        FREE(lay->r);
+        FREE(lay->l);
+        FREE(lay->r_q);
+        FREE(lay->l_q);
+        FREE(lay);
+        ldpc->layered = NULL;
+    }
+}
+
+/* returns the number of satisfied parity checks of the hard decisions, bit = 1 if LLR < 0 */
+
+static int ldpc_layered_syndrome_f(struct LDPC_LAYERED *lay, int NumberParityBits) {
+    int satisfied = 0;
+
+    for (int m=0; m<NumberParityBits; m++) {
+        int parity = 0;
+        for (int e=lay->check_start[m]; e<lay->check_start[m+1]; e++)
+            parity ^= lay->l[lay->check_vars[e]] < 0;
+        satisfied += !parity;
+    }
+    return satisfied;
+}
+
+static int ldpc_layered_syndrome_q(struct LDPC_LAYERED *lay, int NumberParityBits) {
+    int satisfied = 0;
+
+    for (int m=0; m<NumberParityBits; m++) {
+        int parity = 0;
+        for (int e=lay->check_start[m]; e<lay->check_start[m+1]; e++)
+            parity ^= lay->l_q[lay->check_vars[e]] < 0;
+        satisfied += !parity;
+    }
+    return satisfied;
+}
+
+static int ldpc_layered_float(struct LDPC *ldpc, uint8_t out_char[], float input[], int *parityCheckCount) {
+    struct LDPC_LAYERED *lay = ldpc->layered;
+    int NumberParityBits = ldpc->NumberParityBits;
+    float q[lay->max_check_degree];
+    int iter, satisfied = 0;
+
+    for (int i=0; i<ldpc->CodeLength; i++)
+        lay->l[i] = input[i];
+    for (int e=0; e<lay->edges; e++)
+        lay->r[e] = 0.0f;
+
+    for (iter=0; iter<ldpc->max_iter; ) {
+        for (int m=0; m<NumberParityBits; m++) {
+            int start = lay->check_start[m];
+            int degree = lay->check_start[m+1] - start;
+            float *r = &lay->r[start];
+            uint16_t *vars = &lay->check_vars[start];
+            float min1 = 1E30f, min2 = 1E30f;
+            int min_idx = 0, sign = 0;
+
+            /* variable to check messages: posterior minus what this check contributed last time */
+            for (int k=0; k<degree; k++) {
+                q[k] = lay->l[vars[k]] - r[k];
+                float mag = fabsf(q[k]);
+                sign ^= q[k] < 0;
+                if (mag < min1) {
+                    min2 = min1;
+                    min1 = mag;
+                    min_idx = k;
+                } else if (mag < min2) {
+                    min2 = mag;
+                }
+            }
+
+            min1 *= LDPC_LAYERED_ALPHA;
+            min2 *= LDPC_LAYERED_ALPHA;
+
+            /* check to variable messages and immediate update of the posterior */
+            for (int k=0; k<degree; k++) {
+                float mag = (k == min_idx) ? min2 : min1;
+                r[k] = (sign ^ (q[k] < 0)) ? -mag : mag;
+                lay->l[vars[k]] = q[k] + r[k];
+            }
+        }
+        iter++;
+
+        satisfied = ldpc_layered_syndrome_f(lay, NumberParityBits);
+        if (satisfied == NumberParityBits)
+            break;
+    }
+
+    for (int i=0; i<ldpc->CodeLength; i++)
+        out_char[i] = lay->l[i] < 0;
+
+    *parityCheckCount = satisfied;
+    return iter;
+}
+
+static inline int32_t ldpc_sat(int32_t x, int32_t max) {
+    return x > max ? max : (x < -max ? -max : x);
+}
+
+static int ldpc_layered_fixed(struct LDPC *ldpc, uint8_t out_char[], float input[], int *parityCheckCount) {
+    struct LDPC_LAYERED *lay = ldpc->layered;
+    int NumberParityBits = ldpc->NumberParityBits;
+    int32_t q[lay->max_check_degree];
+    int iter, satisfied = 0;
+
+    for (int i=0; i<ldpc->CodeLength; i++)
+        lay->l_q[i] = ldpc_sat(lrintf(input[i] * LDPC_Q_SCALE), LDPC_Q_POST_MAX);
+    for (int e=0; e<lay->edges; e++)
+        lay->r_q[e] = 0;
+
+    for (iter=0; iter<ldpc->max_iter; ) {
+        for (int m=0; m<NumberParityBits; m++) {
+            int start = lay->check_start[m];
+            int degree = lay->check_start[m+1] - start;
+            ldpc_msg_t *r = &lay->r_q[start];
+            uint16_t *vars = &lay->check_vars[start];
+            int32_t min1 = LDPC_Q_MSG_MAX, min2 = LDPC_Q_MSG_MAX;
+            int min_idx = 0, sign = 0;
+
+            for (int k=0; k<degree; k++) {
+                q[k] = (int32_t)lay->l_q[vars[k]] - r[k];
+                int32_t mag = q[k] < 0 ? -q[k] : q[k];
+                sign ^= q[k] < 0;
+                if (mag < min1) {
+                    min2 = min1;
+                    min1 = mag;
+                    min_idx = k;
+                } else if (mag < min2) {
+                    min2 = mag;
+                }
+            }
+
+            /* normalisation by 15/16 == LDPC_LAYERED_ALPHA, the minima are already limited to the message range */
+            min1 = (min1 * 15) >> 4;
+            min2 = (min2 * 15) >> 4;
+
+            for (int k=0; k<degree; k++) {
+                int32_t mag = (k == min_idx) ? min2 : min1;
+                r[k] = (sign ^ (q[k] < 0)) ? -mag : mag;
+                lay->l_q[vars[k]] = ldpc_sat(q[k] + r[k], LDPC_Q_POST_MAX);
+            }
+        }
+        iter++;
+
+        satisfied = ldpc_layered_syndrome_q(lay, NumberParityBits);
+        if (satisfied == NumberParityBits)
+            break;
+    }
+
+    for (int i=0; i<ldpc->CodeLength; i++)
+        out_char[i] = lay->l_q[i] < 0;
+
+    *parityCheckCount = satisfied;
+    return iter;
+}
+
+/* layered decoder, ldpc_layered_setup() must have been called, returns the iteration count */
+
+int run_ldpc_decoder_layered(struct LDPC *ldpc, uint8_t out_char[], float input[], int *parityCheckCount) {
+    assert(ldpc->layered != NULL);
+
+    if (ldpc->dec_type == LDPC_DEC_LAYERED_MIN_SUM_Q)
+        return ldpc_layered_fixed(ldpc, out_char, input, parityCheckCount);
+    else
+        return ldpc_layered_float(ldpc, out_char, input, parityCheckCount);
+}
+
+
 void sd_to_llr(float llr[], double sd[], int n) {
     double sum, mean, sign, sumsq, estvar, estEsN0, x;
     int i;
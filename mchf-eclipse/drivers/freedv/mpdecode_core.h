@@ -15,6 +15,44 @@
 
 #include "comp.h"
 
+/* decoder types, ldpc->dec_type */
+
+#define LDPC_DEC_SUM_PRODUCT       0   /* original flooding sum-product decoder, reference */
+#define LDPC_DEC_LAYERED_MIN_SUM   2   /* layered normalised min-sum, float messages        */
+#define LDPC_DEC_LAYERED_MIN_SUM_Q 3   /* layered normalised min-sum, fixed point messages  */
+
+#ifndef LDPC_DEC_DEFAULT
+#define LDPC_DEC_DEFAULT LDPC_DEC_LAYERED_MIN_SUM
+#endif
+
+/* fixed point message format of LDPC_DEC_LAYERED_MIN_SUM_Q, int16 unless
+   LDPC_MSG_INT8 is defined. The posterior LLRs are always kept in int16. */
+
+#ifdef LDPC_MSG_INT8
+typedef int8_t ldpc_msg_t;
+#define LDPC_Q_SCALE     2.0f   /* LLR 1.0 == 2   */
+#define LDPC_Q_MSG_MAX   127
+#define LDPC_Q_POST_MAX  1023
+#else
+typedef int16_t ldpc_msg_t;
+#define LDPC_Q_SCALE     32.0f  /* LLR 1.0 == 32  */
+#define LDPC_Q_MSG_MAX   4095
+#define LDPC_Q_POST_MAX  32767
+#endif
+
+/* state of the layered decoders, built once from H_rows/H_cols by ldpc_layered_setup() */
+
+struct LDPC_LAYERED {
+    int         edges;
+    int         max_check_degree;
+    uint16_t   *check_start;    /* NumberParityBits+1 offsets into check_vars         */
+    uint16_t   *check_vars;     /* variable node of each edge, grouped by check node  */
+    float      *r;              /* check to variable messages, one per edge           */
+    float      *l;              /* posterior LLRs, one per variable node              */
+    ldpc_msg_t *r_q;            /* same in fixed point                                */
+    int16_t    *l_q;
+};
+
 struct LDPC {
     int max_iter;
     int dec_type;
@@ -37,11 +75,18 @@ struct LDPC {
 
     uint16_t *H_rows;
     uint16_t *H_cols;
+
+    /* NULL unless a layered decoder is used */
+    struct LDPC_LAYERED *layered;
 };
 
 void encode(struct LDPC *ldpc, unsigned char ibits[], unsigned char pbits[]);
 
 int run_ldpc_decoder(struct LDPC *ldpc, uint8_t out_char[], float input[], int *parityCheckCount);
+int run_ldpc_decoder_sum_product(struct LDPC *ldpc, uint8_t out_char[], float input[], int *parityCheckCount);
+int run_ldpc_decoder_layered(struct LDPC *ldpc, uint8_t out_char[], float input[], int *parityCheckCount);
+int ldpc_layered_setup(struct LDPC *ldpc);
+void ldpc_layered_destroy(struct LDPC *ldpc);
 
 void sd_to_llr(float llr[], double sd[], int n);
 void Demod2D(float symbol_likelihood[], COMP r[], COMP S_matrix[], float EsNo, float fading[], float mean_amp, int number_symbols);
@@ -36,6 +36,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*---------------------------------------------------------------------------*\
 
@@ -55,6 +56,10 @@
 #define NLP_NTAP 48	        /* Decimation LPF order */
 #undef  POST_PROCESS_MBE        /* choose post processor                */
 
+#if PE_FFT_SIZE != FFT_ENC
+#error "NLP shares the real FFT config of the encoder, PE_FFT_SIZE must equal FFT_ENC"
+#endif
+
 /* 8 to 16 kHz sample rate conversion */
 
 #define FDMDV_OS                 2                            /* oversampling rate                   */
@@ -124,10 +129,14 @@ typedef struct {
     int           Fs;                /* sample rate in Hz            */
     int           m;
     float         w[PMAX_M/DEC];     /* DFT window                   */
-    float         sq[PMAX_M];	     /* squared speech samples       */
+    float         dec[PMAX_M/DEC];   /* filtered and decimated       */
+                                     /* squared speech samples       */
     float         mem_x,mem_y;       /* memory for notch filter      */
-    float         mem_fir[NLP_NTAP]; /* decimation FIR filter memory */
-    codec2_fft_cfg  fft_cfg;         /* kiss FFT config              */
+    float        *sq;                /* decimation FIR filter memory */
+                                     /* followed by the latest       */
+                                     /* squared speech samples       */
+    codec2_fftr_cfg fftr_cfg;        /* real FFT config, shared with */
+                                     /* the encoder, not owned       */
     float        *Sn16k;	     /* Fs=16kHz input speech vector */
     FILE         *f;
 } NLP;
@@ -141,6 +150,33 @@ float post_process_sub_multiples(COMP Fw[],
 				 float *prev_f0);
 static void fdmdv_16_to_8(float out8k[], float in16k[], int n);
 
+/*---------------------------------------------------------------------------*\
+
+  nlp_dot()
+
+  Dot product used for the decimating FIR filter.  On the host the
+  taps are summed in order, which gives exactly the result of the
+  original per sample filter loop.
+
+\*---------------------------------------------------------------------------*/
+
+static inline float nlp_dot(const float x[], const float h[], int ntap)
+{
+    float acc;
+
+#ifdef FDV_ARM_MATH
+    arm_dot_prod_f32((float32_t*)x, (float32_t*)h, ntap, &acc);
+#else
+    int j;
+
+    acc = 0.0;
+    for(j=0; j<ntap; j++)
+	acc += x[j]*h[j];
+#endif
+
+    return acc;
+}
+
 /*---------------------------------------------------------------------------*\
 
   nlp_create()
@@ -149,11 +185,12 @@ static void fdmdv_16_to_8(float out8k[], float in16k[], int n);
 
 \*---------------------------------------------------------------------------*/
 
-void *nlp_create(C2CONST *c2const)
+void *nlp_create(C2CONST *c2const, codec2_fftr_cfg fftr_cfg)
 {
     NLP *nlp;
     int  i;
     int  m = c2const->m_pitch;
+    int  n = c2const->n_samp;
     int  Fs = c2const->Fs;
 
     nlp = (NLP*)malloc(sizeof(NLP));
@@ -179,24 +216,38 @@ void *nlp_create(C2CONST *c2const)
 
         /* most processing occurs at 8 kHz sample rate so halve m */
 
-        m /= 2;
+        m /= 2; n /= 2;
     }
 
     assert(m <= PMAX_M);
-    
+
+    /* the FIR filter is only evaluated at the samples kept by the
+       decimator, so the frame shift has to keep the decimation phase */
+
+    assert((n % DEC) == 0 && ((m - n) % DEC) == 0);
+
     for(i=0; i<m/DEC; i++) {
 	nlp->w[i] = 0.5 - 0.5*cosf(2*PI*i/(m/DEC-1));
     }
 
-    for(i=0; i<PMAX_M; i++)
-	nlp->sq[i] = 0.0;
+    for(i=0; i<PMAX_M/DEC; i++)
+	nlp->dec[i] = 0.0;
     nlp->mem_x = 0.0;
     nlp->mem_y = 0.0;
-    for(i=0; i<NLP_NTAP; i++)
-	nlp->mem_fir[i] = 0.0;
 
-    nlp->fft_cfg = codec2_fft_alloc (PE_FFT_SIZE, 0, NULL, NULL);
-    assert(nlp->fft_cfg != NULL);
+    nlp->sq = (float*)malloc(sizeof(float)*(NLP_NTAP - 1 + n));
+    if (nlp->sq == NULL) {
+        if (Fs == 16000) {
+            free(nlp->Sn16k);
+        }
+        free(nlp);
+        return NULL;
+    }
+    for(i=0; i<NLP_NTAP-1+n; i++)
+	nlp->sq[i] = 0.0;
+
+    assert(fftr_cfg != NULL);
+    nlp->fftr_cfg = fftr_cfg;
 
     return (void*)nlp;
 }
@@ -215,7 +266,7 @@ void nlp_destroy(void *nlp_state)
     assert(nlp_state != NULL);
     nlp = (NLP*)nlp_state;
 
-    codec2_fft_free(nlp->fft_cfg);
+    free(nlp->sq);
     if (nlp->Fs == 16000) {
         free(nlp->Sn16k);
     }
@@ -264,9 +315,11 @@ float nlp(
 {
     NLP   *nlp;
     float  notch;		    /* current notch filter output          */
-    COMP   Fw[PE_FFT_SIZE];	    /* DFT of squared signal (input/output) */
+    float *sq;                      /* latest squared speech samples        */
+    float  fx[PE_FFT_SIZE];         /* windowed, decimated squared signal   */
+    COMP   Fw[PE_FFT_SIZE/2+1];     /* DFT of squared signal                */
     float  gmax;
-    int    gmax_bin;
+    int    gmax_bin, max_bin;
     int    m, i, j;
     float  best_f0;
     PROFILE_VAR(start, tnotch, filter, peakpick, window, fft, magsq, shiftmem);
@@ -274,6 +327,7 @@ float nlp(
     assert(nlp_state != NULL);
     nlp = (NLP*)nlp_state;
     m = nlp->m;
+    sq = &nlp->sq[NLP_NTAP-1];
 
     /* Square, notch filter at DC, and LP filter vector */
 
@@ -284,8 +338,8 @@ float nlp(
     if (nlp->Fs == 8000) {
         /* Square latest input samples */
 
-        for(i=m-n; i<m; i++) {
-	  nlp->sq[i] = Sn[i]*Sn[i];
+        for(i=0; i<n; i++) {
+	  sq[i] = Sn[m-n+i]*Sn[m-n+i];
         }
     }
     else {
@@ -304,21 +358,20 @@ float nlp(
 
         /* Square latest input samples */
 
-        for(i=m-n, j=0; i<m; i++, j++) {
-	    nlp->sq[i] = Sn8k[j]*Sn8k[j];
+        for(i=0; i<n; i++) {
+	    sq[i] = Sn8k[i]*Sn8k[i];
         }
-        assert(j <= n);
     }
     //fprintf(stderr, "n: %d m: %d\n", n, m);
 
     PROFILE_SAMPLE(start);
 
-    for(i=m-n; i<m; i++) {	/* notch filter at DC */
-	notch = nlp->sq[i] - nlp->mem_x;
+    for(i=0; i<n; i++) {	/* notch filter at DC */
+	notch = sq[i] - nlp->mem_x;
 	notch += COEFF*nlp->mem_y;
-	nlp->mem_x = nlp->sq[i];
+	nlp->mem_x = sq[i];
 	nlp->mem_y = notch;
-	nlp->sq[i] = notch + 1.0;  /* With 0 input vectors to codec,
+	sq[i] = notch + 1.0;  /* With 0 input vectors to codec,
 				      kiss_fft() would take a long
 				      time to execute when running in
 				      real time.  Problem was traced
@@ -330,57 +383,60 @@ float nlp(
 
     PROFILE_SAMPLE_AND_LOG(tnotch, start, "      square and notch");
 
-    for(i=m-n; i<m; i++) {	/* FIR filter vector */
+    /* Shift decimated samples in buffer to make room for new samples */
 
-	for(j=0; j<NLP_NTAP-1; j++)
-	    nlp->mem_fir[j] = nlp->mem_fir[j+1];
-	nlp->mem_fir[NLP_NTAP-1] = nlp->sq[i];
+    for(i=0; i<(m-n)/DEC; i++)
+	nlp->dec[i] = nlp->dec[i+n/DEC];
 
-	nlp->sq[i] = 0.0;
-	for(j=0; j<NLP_NTAP; j++)
-	    nlp->sq[i] += nlp->mem_fir[j]*nlp_fir[j];
-    }
+    /* FIR filter vector, only the outputs kept by the decimator are
+       calculated. nlp->sq[] holds the last NLP_NTAP-1 input samples of
+       the previous call in front of the new ones, so each output is a
+       single dot product over the delay line */
+
+    for(i=0, j=(m-n)/DEC; i<n; i+=DEC, j++)
+	nlp->dec[j] = nlp_dot(&nlp->sq[i], nlp_fir, NLP_NTAP);
+
+    for(i=0; i<NLP_NTAP-1; i++)
+	nlp->sq[i] = nlp->sq[i+n];
 
     PROFILE_SAMPLE_AND_LOG(filter, tnotch, "      filter");
 
-    /* Decimate and DFT */
+    /* Window and DFT, the input is real so we use a real FFT */
 
-    for(i=0; i<PE_FFT_SIZE; i++) {
-	Fw[i].real = 0.0;
-	Fw[i].imag = 0.0;
-    }
-    for(i=0; i<m/DEC; i++) {
-	Fw[i].real = nlp->sq[i*DEC]*nlp->w[i];
-    }
+#ifdef FDV_ARM_MATH
+    arm_mult_f32(nlp->dec, nlp->w, fx, m/DEC);
+#else
+    for(i=0; i<m/DEC; i++)
+	fx[i] = nlp->dec[i]*nlp->w[i];
+#endif
+    for(i=m/DEC; i<PE_FFT_SIZE; i++)
+	fx[i] = 0.0;
     PROFILE_SAMPLE_AND_LOG(window, filter, "      window");
-    #ifdef DUMP
-    dump_dec(Fw);
-    #endif
 
-    // FIXME: check if this can be converted to a real fft
-    // since all imag inputs are 0
-    codec2_fft_inplace(nlp->fft_cfg, Fw);
+    codec2_fftr(nlp->fftr_cfg, fx, Fw);
     PROFILE_SAMPLE_AND_LOG(fft, window, "      fft");
 
-    for(i=0; i<PE_FFT_SIZE; i++)
-	Fw[i].real = Fw[i].real*Fw[i].real + Fw[i].imag*Fw[i].imag;
-
-    PROFILE_SAMPLE_AND_LOG(magsq, fft, "      mag sq");
-    #ifdef DUMP
-    dump_sq(m, nlp->sq);
-    dump_Fw(Fw);
-    #endif
-
     /* todo: express everything in f0, as pitch in samples is dep on Fs */
 
     int pmin = floor(SAMPLE_RATE*P_MIN_S);
     int pmax = floor(SAMPLE_RATE*P_MAX_S);
 
+    /* Only bins up to F0 max are searched, the post processors look
+       at most one bin beyond that */
+
+    max_bin = PE_FFT_SIZE*DEC/pmin;
+    assert(max_bin + 1 <= PE_FFT_SIZE/2);
+
+    for(i=0; i<=max_bin+1; i++)
+	Fw[i].real = Fw[i].real*Fw[i].real + Fw[i].imag*Fw[i].imag;
+
+    PROFILE_SAMPLE_AND_LOG(magsq, fft, "      mag sq");
+
     /* find global peak */
 
     gmax = 0.0;
     gmax_bin = PE_FFT_SIZE*DEC/pmax;
-    for(i=PE_FFT_SIZE*DEC/pmax; i<=PE_FFT_SIZE*DEC/pmin; i++) {
+    for(i=PE_FFT_SIZE*DEC/pmax; i<=max_bin; i++) {
 	if (Fw[i].real > gmax) {
 	    gmax = Fw[i].real;
 	    gmax_bin = i;
@@ -397,11 +453,6 @@ float nlp(
 
     PROFILE_SAMPLE_AND_LOG(shiftmem, peakpick,  "      post process");
 
-    /* Shift samples in buffer to make room for new samples */
-
-    for(i=0; i<m-n; i++)
-	nlp->sq[i] = nlp->sq[i+n];
-
     /* return pitch period in samples and F0 estimate */
 
     *pitch = (float)nlp->Fs/best_f0;
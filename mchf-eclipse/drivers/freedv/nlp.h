@@ -29,8 +29,9 @@
 #define __NLP__
 
 #include "comp.h"
+#include "codec2_fft.h"
 
-void *nlp_create(C2CONST *c2const);
+void *nlp_create(C2CONST *c2const, codec2_fftr_cfg fftr_cfg);
 void nlp_destroy(void *nlp_state);
 float nlp(void *nlp_state, float Sn[], int n, 
 	  float *pitch_samples, COMP Sw[], COMP W[], float *prev_f0);
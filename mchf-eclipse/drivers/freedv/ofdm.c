@@ -508,6 +508,16 @@ void ofdm_destroy(struct OFDM *ofdm) {
     FREE(ofdm->aphase_est_pilot_log);
     FREE(ofdm->tx_uw);
     FREE(ofdm);
+
+    /* the unique word tables are shared statics, allocated by every
+       ofdm_create(), so only one OFDM instance may exist at a time */
+
+    FREE(uw_ind);
+    FREE(uw_ind_sym);
+    FREE(tx_uw_syms);
+    uw_ind = NULL;
+    uw_ind_sym = NULL;
+    tx_uw_syms = NULL;
 }
 
 /* convert frequency domain into time domain */
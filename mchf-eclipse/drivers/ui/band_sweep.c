@@ -0,0 +1,303 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     band_sweep.c                                                    **
+ **  Description:   band sweep, stitches LO stepped spectra into a band panorama    **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * The band sweep shows the activity of the whole current band in the spectrum scope and waterfall.
+ *
+ * While the sweep runs, the LO is stepped through the band in BAND_SWEEP_STEP steps. After each
+ * LO change we wait until the oscillator and the codec delivered clean samples (see UiSpectrum_SkipSamples()),
+ * then one FFT frame of the spectrum display is taken. Of each frame only the bins from BAND_SWEEP_DC_GAP
+ * to BAND_SWEEP_DC_GAP + BAND_SWEEP_STEP above the LO are used, this keeps the DC offset and the edges
+ * of the codec passband out of the panorama, and each panorama bin is measured exactly once per pass.
+ * A panorama bin covers several frame bins on wide bands, we use the strongest one so that narrow
+ * carriers remain visible.
+ *
+ * The panorama replaces the averaged power spectrum of the spectrum display, so scope and waterfall
+ * render it without further changes. The sweep restarts at the band start until it is stopped.
+ *
+ * The LO steps keep the same minimum distance as RadioManagement_ChangeFrequency(), which protects the
+ * oscillator from too fast I2C frequency changes. A 350kHz band takes 20 steps, about 1.5s per pass.
+ *
+ * While sweeping, the audio is muted, the spectrum zoom is off and the transmitter is disabled. Any key,
+ * encoder, frequency change, PTT or TX stops the sweep and returns to the dial frequency.
+ */
+
+#include "uhsdr_board.h"
+#include "band_sweep.h"
+#include "radio_management.h"
+#include "osc_interface.h"
+#include "ui_spectrum.h"
+#include "ui_driver.h"
+#include "cat_driver.h"
+
+#define BAND_SWEEP_TUNE_TICKS       5           // sysclock ticks between two LO changes at least, as in RadioManagement_ChangeFrequency()
+#define BAND_SWEEP_SETTLE_MS        5           // LO and codec settle time after a small LO step
+#define BAND_SWEEP_SETTLE_LARGE_MS  20          // settle time after a large LO step (Si570 output freezes for up to 10ms)
+#define BAND_SWEEP_CAPTURE_TIMEOUT  50          // sysclock ticks, go on with the next step if no frame came in
+
+typedef enum
+{
+    BAND_SWEEP_TUNE = 0,    // waiting for the next LO change
+    BAND_SWEEP_CAPTURE,     // LO changed, waiting for a frame
+} BandSweep_State_t;
+
+typedef struct
+{
+    bool active;
+    BandSweep_State_t state;
+    uint32_t start;         // lowest frequency of the panorama in Hz
+    uint32_t span;          // width of the panorama in Hz
+    uint32_t dial;          // dial frequency at the start, any change stops the sweep
+    uint8_t magnify;        // spectrum zoom to restore after the sweep
+    bool dac_muted;         // audio muting to restore after the sweep
+    uint16_t step;          // current LO step
+    uint16_t step_num;      // LO steps per pass
+    uint32_t lo;            // LO frequency of the current step
+    uint32_t tune_time;     // sysclock of the last LO change
+    bool filled;            // false until the first frame has been added
+} BandSweep_t;
+
+static BandSweep_t band_sweep;
+
+bool BandSweep_IsActive()
+{
+    return band_sweep.active;
+}
+
+uint32_t BandSweep_GetStart()
+{
+    return band_sweep.start;
+}
+
+uint32_t BandSweep_GetSpan()
+{
+    return band_sweep.span;
+}
+
+static void BandSweep_NextStep()
+{
+    band_sweep.step++;
+    if (band_sweep.step >= band_sweep.step_num)
+    {
+        band_sweep.step = 0;
+    }
+    band_sweep.state = BAND_SWEEP_TUNE;
+}
+
+/**
+ * Tunes the LO to the current step, bypassing the normal dial frequency handling
+ */
+static void BandSweep_Tune()
+{
+    const uint32_t lo = band_sweep.start + band_sweep.step * BAND_SWEEP_STEP - BAND_SWEEP_DC_GAP;
+
+    if (osc->prepareNextFrequency(lo, df.temp_factor) == OSC_TUNE_IMPOSSIBLE)
+    {
+        // leave the old data for this part of the band
+        BandSweep_NextStep();
+    }
+    else
+    {
+        const bool is_large_step = osc->isNextStepLarge();
+        const Oscillator_ResultCodes_t result = osc->changeToNextFrequency();
+
+        ts.last_tuning = ts.sysclock;
+
+        // on i2c errors we simply try again with the next tick
+        if (result != OSC_COMM_ERROR && result != OSC_ERROR_VERIFY)
+        {
+            // ts.tune_freq always tells the real LO frequency, the spectrum center frequency depends on it
+            // and any regular frequency change (e.g. switching to TX) will see the difference and retune
+            ts.tune_freq = lo;
+            band_sweep.lo = lo;
+            band_sweep.tune_time = ts.sysclock;
+            band_sweep.state = BAND_SWEEP_CAPTURE;
+
+            UiSpectrum_SkipSamples((is_large_step ? BAND_SWEEP_SETTLE_LARGE_MS : BAND_SWEEP_SETTLE_MS) * (IQ_SAMPLE_RATE / 1000));
+        }
+    }
+}
+
+/**
+ * Starts the sweep over the band of the current dial frequency
+ * @return true if the sweep has been started
+ */
+bool BandSweep_Start()
+{
+    bool retval = false;
+
+    const BandInfo* band = RadioManagement_GetBand(df.tune_new);
+
+    if (band_sweep.active == false
+            && ts.txrx_mode == TRX_MODE_RX
+            && ts.menu_mode == false
+            && band != NULL
+            && RadioManagement_IsGenericBand(band) == false
+            && RadioManagement_Transverter_IsEnabled() == false
+            // each panorama bin must contain at least one frame bin center, see BandSweep_AddFrame()
+            && band->size <= (uint32_t)sd.spec_len * BAND_SWEEP_STEP)
+    {
+        band_sweep.start = band->tune;
+        band_sweep.span = band->size;
+        band_sweep.dial = df.tune_new;
+        band_sweep.magnify = sd.magnify;
+        band_sweep.dac_muted = ts.audio_dac_muting_flag;
+        band_sweep.step = 0;
+        band_sweep.step_num = (band->size + BAND_SWEEP_STEP - 1) / BAND_SWEEP_STEP;
+        band_sweep.state = BAND_SWEEP_TUNE;
+        band_sweep.filled = false;
+
+        ts.tx_disable |= TX_DISABLE_SWEEP;
+        ts.audio_dac_muting_flag = true;
+
+        // the panorama is built from the full bandwidth frames
+        sd.magnify = 0;
+        band_sweep.active = true;
+        UiDriver_SpectrumChangeLayoutParameters();
+
+        retval = true;
+    }
+    return retval;
+}
+
+/**
+ * Stops the sweep and returns to the dial frequency, does nothing if the sweep is not running
+ */
+void BandSweep_Stop()
+{
+    if (band_sweep.active == true)
+    {
+        band_sweep.active = false;
+
+        sd.magnify = band_sweep.magnify;
+        UiDriver_SpectrumChangeLayoutParameters();
+
+        // if the LO is rate limited right now, the main loop finishes the change since ts.tune_freq != ts.tune_freq_req
+        RadioManagement_ChangeFrequency(true, df.tune_new, ts.txrx_mode);
+
+        ts.audio_dac_muting_flag = band_sweep.dac_muted;
+        ts.tx_disable &= ~TX_DISABLE_SWEEP;
+    }
+}
+
+/**
+ * Runs the sweep, to be called every sysclock tick from the main loop.
+ */
+void BandSweep_Process()
+{
+    if (band_sweep.active == true)
+    {
+        if (ts.txrx_mode != TRX_MODE_RX
+                || ts.ptt_req
+                || Board_PttDahLinePressed()
+                || CatDriver_CatPttActive()
+                || ts.menu_mode
+                || df.tune_new != band_sweep.dial)
+        {
+            BandSweep_Stop();
+        }
+        else if (band_sweep.state == BAND_SWEEP_TUNE)
+        {
+            if (ts.sysclock - ts.last_tuning > BAND_SWEEP_TUNE_TICKS)
+            {
+                BandSweep_Tune();
+            }
+        }
+        else if (ts.sysclock - band_sweep.tune_time > BAND_SWEEP_CAPTURE_TIMEOUT)
+        {
+            // no frame, e.g. the display is blanked, keep the LO moving anyway
+            BandSweep_NextStep();
+        }
+    }
+}
+
+/**
+ * Adds a frame of the spectrum display to the panorama if we are waiting for one
+ *
+ * @param mag magnitudes of the frame in FFT order, taken at the current LO without zoom
+ * @param power panorama power in FFT order, takes the place of the averaged power spectrum
+ * @param num_bins number of bins of mag and power
+ * @return true if the frame has been used
+ */
+bool BandSweep_AddFrame(const float32_t* mag, float32_t* power, const uint16_t num_bins)
+{
+    bool retval = false;
+
+    if (band_sweep.active == true && band_sweep.state == BAND_SWEEP_CAPTURE)
+    {
+        const float32_t frame_bin_hz = IQ_SAMPLE_RATE_F / num_bins;
+        const float32_t pano_bin_hz = (float32_t)band_sweep.span / num_bins;
+        const int32_t frame_bin_min = ceilf(BAND_SWEEP_DC_GAP / frame_bin_hz);
+        const int32_t frame_bin_max = (BAND_SWEEP_DC_GAP + BAND_SWEEP_STEP) / frame_bin_hz;
+
+        // frequency offsets to the LO
+        const float32_t core_start = BAND_SWEEP_DC_GAP;
+        const float32_t core_end = BAND_SWEEP_DC_GAP + BAND_SWEEP_STEP;
+        const float32_t pano_offset = (float32_t)band_sweep.start - (float32_t)band_sweep.lo;
+
+        float32_t power_sum = 0;
+        uint16_t power_count = 0;
+
+        for (uint16_t pano_bin = 0; pano_bin < num_bins; pano_bin++)
+        {
+            const float32_t offset = pano_offset + (pano_bin + 0.5) * pano_bin_hz;
+
+            if (offset >= core_start && offset < core_end)
+            {
+                int32_t first = ceilf((offset - pano_bin_hz/2) / frame_bin_hz);
+                int32_t last = ceilf((offset + pano_bin_hz/2) / frame_bin_hz) - 1;
+                if (last < first)
+                {
+                    // narrow band, the panorama bin is smaller than a frame bin
+                    first = last = roundf(offset / frame_bin_hz);
+                }
+                first = first < frame_bin_min ? frame_bin_min : first;
+                last = last > frame_bin_max ? frame_bin_max : last;
+
+                float32_t peak = 1;
+                for (int32_t frame_bin = first; frame_bin <= last; frame_bin++)
+                {
+                    // positive frequencies are at the end of the FFT output (see UiSpectrum_ScaleFFT)
+                    const float32_t bin_power = mag[num_bins - frame_bin] * mag[num_bins - frame_bin];
+                    if (bin_power > peak)
+                    {
+                        peak = bin_power;
+                    }
+                }
+
+                power[(num_bins - 1 - pano_bin + num_bins/2) % num_bins] = peak;
+                power_sum += peak;
+                power_count++;
+            }
+        }
+
+        if (band_sweep.filled == false && power_count > 0)
+        {
+            // until the first pass is complete, the rest of the band shows the average of what we have
+            const float32_t power_avg = power_sum / power_count;
+            for (uint16_t pano_bin = 0; pano_bin < num_bins; pano_bin++)
+            {
+                const float32_t offset = pano_offset + (pano_bin + 0.5) * pano_bin_hz;
+                if (offset < core_start || offset >= core_end)
+                {
+                    power[(num_bins - 1 - pano_bin + num_bins/2) % num_bins] = power_avg;
+                }
+            }
+            band_sweep.filled = true;
+        }
+
+        BandSweep_NextStep();
+        retval = true;
+    }
+    return retval;
+}
@@ -0,0 +1,31 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     band_sweep.h                                                    **
+ **  Description:   band sweep, stitches LO stepped spectra into a band panorama    **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+#ifndef __BAND_SWEEP_H
+#define __BAND_SWEEP_H
+
+#include "uhsdr_types.h"
+#include "arm_math.h"
+
+#define BAND_SWEEP_DC_GAP           2000        // Hz, frame bins closer to the LO are not used (DC offset, LO noise)
+#define BAND_SWEEP_STEP             18000       // Hz, LO step = width of the used part of each frame above the DC gap
+
+bool BandSweep_Start(void);
+void BandSweep_Stop(void);
+bool BandSweep_IsActive(void);
+void BandSweep_Process(void);
+bool BandSweep_AddFrame(const float32_t* mag, float32_t* power, const uint16_t num_bins);
+uint32_t BandSweep_GetStart(void);
+uint32_t BandSweep_GetSpan(void);
+
+#endif
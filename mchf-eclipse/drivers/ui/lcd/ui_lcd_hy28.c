@@ -21,6 +21,7 @@
 
 #include "ui_lcd_hy28_fonts.h"
 #include "ui_lcd_hy28.h"
+#include "profiling.h"
 
 #define hspiDisplay hspi2
 #define SPI_DISPLAY SPI2
@@ -723,7 +724,9 @@ DMA_HandleTypeDef DMA_Handle;
 
 static inline void UiLcdHy28_SpiDmaStop()
 {
+    profileTimedEventStart(ProfileLcdDmaWait);
     while (DMA1_Stream4->CR & DMA_SxCR_EN) { asm(""); }
+    profileTimedEventStop(ProfileLcdDmaWait);
 }
 
 
@@ -1099,6 +1102,8 @@ static void UiLcdHy28_SetActiveWindow(uint16_t XLeft, uint16_t XRight, uint16_t
 
 static void UiLcdHy28_BulkWrite(uint16_t* pixel, uint32_t len)
 {
+    profileTimedEventStart(ProfileLcdWrite);
+    profileLcdBytes(len * sizeof(uint16_t));
 
 // if we are not using SPI DMA, we send the data as it comes
 // if we are using SPI DMA, we do this only if we are NOT using SPI
@@ -1134,6 +1139,7 @@ static void UiLcdHy28_BulkWrite(uint16_t* pixel, uint32_t len)
     }
 #endif
 
+    profileTimedEventStop(ProfileLcdWrite);
 }
 
 static void UiLcdHy28_FinishWaitBulkWrite()
@@ -1147,8 +1153,125 @@ static void UiLcdHy28_FinishWaitBulkWrite()
     }
 }
 
+/*
+ * Damage tracking for texts
+ *
+ * Much of the UI code redraws labels and values even if nothing has changed, e.g. after each mode or band change.
+ * We remember the screen area and a hash of the content (string, colors, font) of recently drawn texts. A text which
+ * is requested again at the same place with the same content is not sent to the display as long as no other drawing
+ * operation touched its area. To achieve this, each write to the display memory reports its area, and the text
+ * entries overlapping it are invalidated: UiLcdHy28_OpenBulkWrite() does this for all pixel writes through the
+ * bulk write window, the RA8875 drawing engine and scroll functions call UiLcdHy28_Damage() themselves.
+ * If the display content is lost or replaced as a whole (controller init, screen clear), the cache is cleared.
+ */
+#define TEXT_CACHE_ENTRIES      32
+
+typedef struct
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint32_t hash;
+    bool     valid;
+} TextCacheEntry_t;
+
+static struct
+{
+    uint16_t next;                      // entry to be replaced if there is no free entry
+    TextCacheEntry_t entry[TEXT_CACHE_ENTRIES];
+} textCache;
+
+/**
+ * reports a write to the display memory, the drawn texts in the area become invalid
+ */
+static void UiLcdHy28_Damage(uint16_t x, uint16_t width, uint16_t y, uint16_t height)
+{
+    for (uint32_t idx = 0; idx < TEXT_CACHE_ENTRIES; idx++)
+    {
+        TextCacheEntry_t* entry = &textCache.entry[idx];
+
+        if (entry->valid
+                && x < entry->x + entry->w && entry->x < x + width
+                && y < entry->y + entry->h && entry->y < y + height)
+        {
+            entry->valid = false;
+        }
+    }
+}
+
+/**
+ * forgets all drawn texts
+ */
+static void UiLcdHy28_TextCacheClear()
+{
+    memset(&textCache, 0, sizeof(textCache));
+}
+
+static uint32_t UiLcdHy28_TextHash(const char* str, uint16_t len, uint32_t clr_fg, uint32_t clr_bg, const sFONT* cf)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+
+    for (uint16_t idx = 0; idx < len; idx++)
+    {
+        hash = (hash ^ (uint8_t)str[idx]) * 16777619U;
+    }
+    hash = (hash ^ clr_fg) * 16777619U;
+    hash = (hash ^ clr_bg) * 16777619U;
+    hash = (hash ^ (uint32_t)(uintptr_t)cf) * 16777619U;
+
+    return hash;
+}
+
+/**
+ * @returns true if exactly this content is still visible in the area
+ */
+static bool UiLcdHy28_TextCacheIsDrawn(uint16_t x, uint16_t width, uint16_t y, uint16_t height, uint32_t hash)
+{
+    bool retval = false;
+
+    for (uint32_t idx = 0; retval == false && idx < TEXT_CACHE_ENTRIES; idx++)
+    {
+        const TextCacheEntry_t* entry = &textCache.entry[idx];
+
+        retval = entry->valid && entry->hash == hash
+                && entry->x == x && entry->w == width && entry->y == y && entry->h == height;
+    }
+    return retval;
+}
+
+/**
+ * remembers drawn content, to be called after the drawing since drawing invalidates the area
+ */
+static void UiLcdHy28_TextCacheSetDrawn(uint16_t x, uint16_t width, uint16_t y, uint16_t height, uint32_t hash)
+{
+    TextCacheEntry_t* entry = NULL;
+
+    for (uint32_t idx = 0; entry == NULL && idx < TEXT_CACHE_ENTRIES; idx++)
+    {
+        if (textCache.entry[idx].valid == false)
+        {
+            entry = &textCache.entry[idx];
+        }
+    }
+    if (entry == NULL)
+    {
+        entry = &textCache.entry[textCache.next];
+        textCache.next = (textCache.next + 1) % TEXT_CACHE_ENTRIES;
+    }
+
+    entry->x = x;
+    entry->w = width;
+    entry->y = y;
+    entry->h = height;
+    entry->hash = hash;
+    entry->valid = true;
+}
+
 static void UiLcdHy28_OpenBulkWrite(ushort x, ushort width, ushort y, ushort height)
 {
+    UiLcdHy28_Damage(x, width, y, height);
     UiLcdHy28_FinishWaitBulkWrite();
     UiLcdHy28_SetActiveWindow(x, x + width - 1, y, y + height - 1);
     UiLcdHy28_SetCursorA(x, y);
@@ -1234,6 +1357,7 @@ inline void UiLcdHy28_BulkPixel_CloseWrite()
 void UiLcdHy28_LcdClear(ushort Color)
 {
 	uint32_t MAX_X=mchf_display.MAX_X; uint32_t MAX_Y=mchf_display.MAX_Y;
+    UiLcdHy28_TextCacheClear();
     UiLcdHy28_OpenBulkWrite(0,MAX_X,0,MAX_Y);
 #ifdef USE_SPI_DMA
     if(UiLcdHy28_SpiDisplayUsed())
@@ -1292,6 +1416,7 @@ void UiLcdHy28_DrawFullRect_ILI(uint16_t Xpos, uint16_t Ypos, uint16_t Height, u
 #ifdef  USE_GFX_RA8875
 void UiLcdHy28_DrawFullRect_RA8875(uint16_t Xpos, uint16_t Ypos, uint16_t Height, uint16_t Width ,uint16_t color)
 {
+    UiLcdHy28_Damage(Xpos, Width, Ypos, Height);
     UiLcdRA8875_SetForegroundColor(color);
     UiLcdRa8875_WriteReg_16bit(0x91, Xpos);				//Horizontal start
     UiLcdRa8875_WriteReg_16bit(0x95, Xpos + Width-1);	//Horizontal end
@@ -1305,6 +1430,7 @@ void UiLcdHy28_DrawColorPoint_RA8875(uint16_t Xpos,uint16_t Ypos,uint16_t point)
 	uint16_t MAX_X=mchf_display.MAX_X; uint16_t MAX_Y=mchf_display.MAX_Y;
     if( Xpos < MAX_X && Ypos < MAX_Y )
     {
+        UiLcdHy28_Damage(Xpos, 1, Ypos, 1);
         UiLcdHy28_SetCursorA(Xpos, Ypos);
         UiLcdHy28_WriteRegRA8875(0x02, point);
     }
@@ -1379,8 +1505,17 @@ void UiLcdRA8875_setScrollMode(uint8_t mode)
         YB: y window end bottom
 */
 /**************************************************************************/
+static struct
+{
+    int16_t XL, XR, YT, YB;
+} ra8875_scroll_window;
+
 void UiLcdRA8875_setScrollWindow(int16_t XL,int16_t XR ,int16_t YT ,int16_t YB)
 {
+    ra8875_scroll_window.XL = XL;
+    ra8875_scroll_window.XR = XR;
+    ra8875_scroll_window.YT = YT;
+    ra8875_scroll_window.YB = YB;
 
 #define RA8875_HSSW0                  0x38//Horizontal Start Point 0 of Scroll Window
 //#define RA8875_HSSW1                0x39//Horizontal Start Point 1 of Scroll Window
@@ -1411,6 +1546,10 @@ void UiLcdRA8875_scroll(int16_t x,int16_t y)
 #define RA8875_VOFS0                  0x26//Vertical Scroll Offset Register 0
 #define RA8875_VOFS1                  0x27//Vertical Scroll Offset Register 1
 
+    // all of the scroll window shows different content afterwards
+    UiLcdHy28_Damage(ra8875_scroll_window.XL, ra8875_scroll_window.XR - ra8875_scroll_window.XL + 1,
+            ra8875_scroll_window.YT, ra8875_scroll_window.YB - ra8875_scroll_window.YT + 1);
+
     UiLcdRa8875_WriteReg_16bit(RA8875_HOFS0,x);
     UiLcdRa8875_WriteReg_16bit(RA8875_VOFS0,y);
 
@@ -1450,6 +1589,8 @@ void UiLcdHy28_DrawStraightLine_RA8875(uint16_t x, uint16_t y, uint16_t Length,
 			UiLcdHy28_DrawColorPoint_RA8875(x,y,color);
 		else
 		{
+			UiLcdHy28_Damage(x, x_end - x + 1, y, y_end - y + 1);
+
 			/* Horizontal + vertical start */
 			UiLcdRa8875_WriteReg_16bit(LCD_DLHSR0, x);
 			UiLcdRa8875_WriteReg_16bit(LCD_DLVSR0, y);
@@ -1557,6 +1698,7 @@ static void UiLcdHy28_BulkWriteColor(uint16_t Color, uint32_t len)
 #endif
     {
     	uint32_t i = len;
+    	profileLcdBytes(len * sizeof(uint16_t));
 #ifdef USE_GFX_RA8875
     	if(mchf_display.DeviceCode==0x8875)
     	{
@@ -1577,33 +1719,60 @@ static void UiLcdHy28_BulkWriteColor(uint16_t Color, uint32_t len)
 }
 
 
-#ifdef USE_8bit_FONT
-static void UiLcdHy28_DrawChar_8bit(ushort x, ushort y, char symb,ushort Color, ushort bkColor,const sFONT *cf)
+/*
+ * Text rendering
+ *
+ * Text is drawn line by line: all chars of a text line go out in a single bulk write window,
+ * pixel row by pixel row, instead of opening a window per char. The glyphs are taken from a small cache
+ * of already rasterized RGB565 glyphs (key: font, char, colors), so that frequently redrawn texts
+ * like the frequency digits are not rasterized pixel by pixel on every update. Glyphs which do not fit
+ * into the cache are rasterized row by row while drawing.
+ */
+#define GLYPH_CACHE_ENTRIES     12          // enough for the digits, dot and blank of the frequency display
+#define GLYPH_CACHE_PIXELS      (16*24)     // largest cached glyph, the large frequency digits
+#define GLYPH_WIDTH_MAX         32          // widest glyph (including spacing) of all fonts
+#define TEXT_RUN_MAX            64          // max number of chars drawn with one bulk write
+
+typedef struct
+{
+    const sFONT* cf;
+    char symb;
+    uint16_t Color;
+    uint16_t bkColor;
+    uint32_t used;                          // stamp of the last text run using the glyph, 0 = empty entry
+    uint16_t pixel[GLYPH_CACHE_PIXELS];
+} GlyphCacheEntry_t;
+
+typedef struct
 {
+    uint32_t stamp;                         // incremented for each text run
+    GlyphCacheEntry_t entry[GLYPH_CACHE_ENTRIES];
+} GlyphCache_t;
+
+// not in the mcHF CCM, which has no room left for the ~9.5kB, see GLYPH_CACHE_ENTRIES
+static GlyphCache_t glyphCache;
 
+#ifdef USE_8bit_FONT
+static symbolData_t* UiLcdHy28_Symbol_8bit(char symb, const sFONT *cf)
+{
     const uint16_t charIdx = (symb >= 0x20 && symb < cf->maxCode)? cf->offsetTable[symb - cf->firstCode] : 0xFFFF;
 
-    const uint8_t Font_H = cf->Height;
-    symbolData_t* sym_ptr = charIdx == 0xFFFF? NULL:((symbolData_t*)cf->table)+charIdx;
+    return charIdx == 0xFFFF? NULL:((symbolData_t*)cf->table)+charIdx;
+}
+
+static void UiLcdHy28_GlyphRow_8bit(char symb, uint16_t row, uint16_t Color, uint16_t bkColor, const sFONT *cf, uint16_t* pixel)
+{
+    symbolData_t* sym_ptr = UiLcdHy28_Symbol_8bit(symb, cf);
 
     const uint8_t Font_W = sym_ptr == NULL? cf->Width:sym_ptr->width;
 
     const uint16_t charSpacing = cf->Spacing;
 
-    UiLcdHy28_BulkPixel_OpenWrite(x, Font_W+charSpacing, y, Font_H);
-
     if(sym_ptr == NULL) // NON EXISTING SYMBOL
     {
-        for(int cntrY=0;cntrY < Font_H; cntrY++)
+        for(int cntrX=0; cntrX < Font_W; cntrX++)
         {
-            for(int cntrX=0; cntrX < Font_W; cntrX++)
-            {
-                UiLcdHy28_BulkPixel_Put(Color);
-            }
-            for(int cntrX=0; cntrX < charSpacing; cntrX++)
-            {
-                UiLcdHy28_BulkPixel_Put(bkColor);
-            }
+            *pixel++ = Color;
         }
     }
     else
@@ -1617,59 +1786,40 @@ static void UiLcdHy28_DrawChar_8bit(ushort x, ushort y, char symb,ushort Color,
         const int32_t ColFG_G=((Color>>5)&0x3f)  - ColBG_G;
         const int32_t ColFG_B=(Color&0x1f) - ColBG_B;
 
-        uint8_t *FontData=(uint8_t*)sym_ptr->data;
+        const uint8_t *FontData=((const uint8_t*)sym_ptr->data) + row * Font_W;
 
-        for(uint8_t cntrY=0;cntrY<Font_H;cntrY++)
+        for(uint8_t cntrX=0;cntrX<Font_W;cntrX++)
         {
-            for(uint8_t cntrX=0;cntrX<Font_W;cntrX++)
-            {
-                uint32_t pixel;
-                uint8_t FontD;
-
-                if(cntrY<Font_H)
-                {
-                    FontD=*FontData++;      //get one point from bitmap
-                }
-                else
-                {
-                    FontD=0;
-                }
+            const uint8_t FontD=*FontData++;      //get one point from bitmap
 
-                if(FontD==0)
-                {
-                    pixel=bkColor;
-                }
-                else
-                {
-                    //shading the foreground colour
-                    int32_t ColFG_Ro=(ColFG_R*FontD)>>8;
-                    int32_t ColFG_Go=(ColFG_G*FontD)>>8;
-                    int32_t ColFG_Bo=(ColFG_B*FontD)>>8;
-                    ColFG_Ro+=ColBG_R;
-                    ColFG_Go+=ColBG_G;
-                    ColFG_Bo+=ColBG_B;
-
-                    pixel=(ColFG_Ro<<11)|(ColFG_Go<<5)|ColFG_Bo;    //assembly of destination colour
-                }
-                UiLcdHy28_BulkPixel_Put(pixel);
+            if(FontD==0)
+            {
+                *pixel++=bkColor;
             }
-
-            // add spacing behind the character data
-            for(int n=Font_W; n < Font_W + charSpacing ; n++)
+            else
             {
-                UiLcdHy28_BulkPixel_Put(bkColor);
+                //shading the foreground colour
+                int32_t ColFG_Ro=(ColFG_R*FontD)>>8;
+                int32_t ColFG_Go=(ColFG_G*FontD)>>8;
+                int32_t ColFG_Bo=(ColFG_B*FontD)>>8;
+                ColFG_Ro+=ColBG_R;
+                ColFG_Go+=ColBG_G;
+                ColFG_Bo+=ColBG_B;
+
+                *pixel++=(ColFG_Ro<<11)|(ColFG_Go<<5)|ColFG_Bo;    //assembly of destination colour
             }
         }
     }
 
-    UiLcdHy28_BulkPixel_BufferFlush();
-    // flush all not yet  transferred pixel to display.
-    UiLcdHy28_CloseBulkWrite();
-
+    // add spacing behind the character data
+    for(int n=Font_W; n < Font_W + charSpacing ; n++)
+    {
+        *pixel++ = bkColor;
+    }
 }
 #endif
 
-static void UiLcdHy28_DrawChar_1bit(ushort x, ushort y, char symb,ushort Color, ushort bkColor,const sFONT *cf)
+static void UiLcdHy28_GlyphRow_1bit(char symb, uint16_t row, uint16_t Color, uint16_t bkColor, const sFONT *cf, uint16_t* pixel)
 {
     uint8_t   *ch = (uint8_t *)cf->table;
 
@@ -1678,72 +1828,187 @@ static void UiLcdHy28_DrawChar_1bit(ushort x, ushort y, char symb,ushort Color,
     // anything wider than 8 pixels uses two bytes
     ch+=(symb - 32) * cf->Height* ((cf->Width>8) ? 2 : 1 );
 
-    UiLcdHy28_OpenBulkWrite(x,cf->Width,y,cf->Height);
-    UiLcdHy28_BulkPixel_BufferInit();
+    uint32_t line_data; // stores pixel data for a character line, left most pixel is MSB
 
-    // we now get the pixel information line by line
-    for(uint32_t i = 0; i < cf->Height; i++)
+    // we read the current pixel line data (1 or 2 bytes)
+    if(cf->Width>8)
     {
-        uint32_t line_data; // stores pixel data for a character line, left most pixel is MSB
-
-        // we read the current pixel line data (1 or 2 bytes)
-        if(cf->Width>8)
+        if (cf->Width <= 12)
         {
-            if (cf->Width <= 12)
-            {
-                // small fonts <= 12 pixel width have left most pixel as MSB
-                // we have to reverse that
-                line_data  = ch[i*2+1]<<24;
-                line_data |= ch[i*2] << 16;
-            }
-            else
-            {
-                uint32_t interim;
-                interim  = ch[i*2+1]<<8;
-                interim |= ch[i*2];
-
-                line_data = __RBIT(interim); // rbit reverses a 32bit value bitwise
-            }
+            // small fonts <= 12 pixel width have left most pixel as MSB
+            // we have to reverse that
+            line_data  = ch[row*2+1]<<24;
+            line_data |= ch[row*2] << 16;
         }
         else
         {
-            // small fonts have left most pixel as MSB
-            // we have to reverse that
-            line_data = ch[i] << 24; // rbit reverses a 32bit value bitwise
+            uint32_t interim;
+            interim  = ch[row*2+1]<<8;
+            interim |= ch[row*2];
+
+            line_data = __RBIT(interim); // rbit reverses a 32bit value bitwise
         }
+    }
+    else
+    {
+        // small fonts have left most pixel as MSB
+        // we have to reverse that
+        line_data = ch[row] << 24; // rbit reverses a 32bit value bitwise
+    }
 
-        // now go through the data pixel by pixel
-        // and find out if it is background or foreground
-        // then place pixel color in buffer
-        uint32_t mask = 0x80000000U; // left most pixel aka MSB 32 bit mask
+    // now go through the data pixel by pixel
+    // and find out if it is background or foreground
+    // then place pixel color in buffer
+    uint32_t mask = 0x80000000U; // left most pixel aka MSB 32 bit mask
 
-        for(uint32_t j = 0; j < cf->Width; mask>>=1, j++)
-        {
-            UiLcdHy28_BulkPixel_Put((line_data & mask) != 0 ? Color : bkColor);
-            // we shift the mask in the for loop to the right one by one
-        }
+    for(uint32_t j = 0; j < cf->Width; mask>>=1, j++)
+    {
+        *pixel++ = (line_data & mask) != 0 ? Color : bkColor;
+        // we shift the mask in the for loop to the right one by one
     }
-    UiLcdHy28_BulkPixel_BufferFlush();
-    // flush all not yet  transferred pixel to display.
-    UiLcdHy28_CloseBulkWrite();
 }
 
-void UiLcdHy28_DrawChar(ushort x, ushort y, char symb,ushort Color, ushort bkColor,const sFONT *cf)
+/**
+ * @returns pixel width of the character including the spacing behind it
+ */
+static uint16_t UiLcdHy28_GlyphWidth(char symb, const sFONT *cf)
+{
+    uint16_t retval = cf->Width;
+#ifdef USE_8bit_FONT
+    if (cf->BitCount == 8)
+    {
+        symbolData_t* sym_ptr = UiLcdHy28_Symbol_8bit(symb, cf);
+        retval = (sym_ptr == NULL? cf->Width:sym_ptr->width) + cf->Spacing;
+    }
+#endif
+    return retval;
+}
+
+/**
+ * rasterizes one pixel row of a character, UiLcdHy28_GlyphWidth() pixels are written
+ */
+static void UiLcdHy28_GlyphRow(char symb, uint16_t row, uint16_t Color, uint16_t bkColor, const sFONT *cf, uint16_t* pixel)
 {
 #ifdef USE_8bit_FONT
 	switch(cf->BitCount)
 	{
 	case 1:		//1 bit font (basic type)
 #endif
-	    UiLcdHy28_DrawChar_1bit(x, y, symb, Color, bkColor, cf);
+	    UiLcdHy28_GlyphRow_1bit(symb, row, Color, bkColor, cf, pixel);
 #ifdef USE_8bit_FONT
 		break;
 	case 8:	//8 bit grayscaled font
-        UiLcdHy28_DrawChar_8bit(x, y, symb, Color, bkColor, cf);
+        UiLcdHy28_GlyphRow_8bit(symb, row, Color, bkColor, cf, pixel);
 	    break;
 	}
 #endif
+}
+
+/**
+ * @returns the rasterized character from the glyph cache (rasterized now if necessary) or NULL if it cannot be cached
+ */
+static const uint16_t* UiLcdHy28_GlyphCacheGet(char symb, uint16_t Color, uint16_t bkColor, const sFONT *cf, uint16_t width)
+{
+    const uint16_t* retval = NULL;
+
+    if (width * cf->Height <= GLYPH_CACHE_PIXELS)
+    {
+        GlyphCacheEntry_t* victim = NULL;
+
+        for (uint32_t idx = 0; retval == NULL && idx < GLYPH_CACHE_ENTRIES; idx++)
+        {
+            GlyphCacheEntry_t* entry = &glyphCache.entry[idx];
+
+            if (entry->used != 0 && entry->cf == cf && entry->symb == symb && entry->Color == Color && entry->bkColor == bkColor)
+            {
+                entry->used = glyphCache.stamp;
+                retval = entry->pixel;
+            }
+            // glyphs of the current text run must stay valid until it is drawn
+            else if (entry->used != glyphCache.stamp && (victim == NULL || entry->used < victim->used))
+            {
+                victim = entry;
+            }
+        }
+
+        if (retval == NULL && victim != NULL)
+        {
+            for (uint16_t row = 0; row < cf->Height; row++)
+            {
+                UiLcdHy28_GlyphRow(symb, row, Color, bkColor, cf, &victim->pixel[row * width]);
+            }
+            victim->cf = cf;
+            victim->symb = symb;
+            victim->Color = Color;
+            victim->bkColor = bkColor;
+            victim->used = glyphCache.stamp;
+            retval = victim->pixel;
+        }
+    }
+    return retval;
+}
+
+/**
+ * draws chars on a single line with one bulk write, the chars are placed Xshift pixels apart.
+ * A char overwrites the part of the previous one reaching beyond Xshift, a gap between chars is filled with bkColor.
+ * Nothing is drawn if the same text is still visible at this place.
+ */
+static void UiLcdHy28_DrawTextRun(uint16_t x, uint16_t y, const char *str, const uint16_t len, uint16_t Color, uint16_t bkColor, const sFONT *cf, uint16_t Xshift)
+{
+    const uint16_t* glyph[TEXT_RUN_MAX];
+    uint8_t glyph_width[TEXT_RUN_MAX];
+
+    const uint16_t width = (len - 1) * Xshift + UiLcdHy28_GlyphWidth(str[len - 1], cf);
+    const uint32_t hash = UiLcdHy28_TextHash(str, len, Color, bkColor, cf);
+
+    if (UiLcdHy28_TextCacheIsDrawn(x, width, y, cf->Height, hash) == false)
+    {
+        glyphCache.stamp++;
+
+        for (uint16_t idx = 0; idx < len; idx++)
+        {
+            glyph_width[idx] = UiLcdHy28_GlyphWidth(str[idx], cf);
+            glyph[idx] = UiLcdHy28_GlyphCacheGet(str[idx], Color, bkColor, cf, glyph_width[idx]);
+        }
+
+        UiLcdHy28_BulkPixel_OpenWrite(x, width, y, cf->Height);
+
+        for (uint16_t row = 0; row < cf->Height; row++)
+        {
+            for (uint16_t idx = 0; idx < len; idx++)
+            {
+                uint16_t row_pixel[GLYPH_WIDTH_MAX];
+                const uint16_t* pixel;
+
+                if (glyph[idx] != NULL)
+                {
+                    pixel = &glyph[idx][row * glyph_width[idx]];
+                }
+                else
+                {
+                    UiLcdHy28_GlyphRow(str[idx], row, Color, bkColor, cf, row_pixel);
+                    pixel = row_pixel;
+                }
 
+                const bool is_last = idx == len - 1;
+                const uint16_t visible = (is_last || glyph_width[idx] < Xshift) ? glyph_width[idx] : Xshift;
+
+                for (uint16_t col = 0; col < visible; col++)
+                {
+                    UiLcdHy28_BulkPixel_Put(pixel[col]);
+                }
+                for (uint16_t col = visible; is_last == false && col < Xshift; col++)
+                {
+                    UiLcdHy28_BulkPixel_Put(bkColor);
+                }
+            }
+        }
+
+        // flush all not yet  transferred pixel to display.
+        UiLcdHy28_BulkPixel_CloseWrite();
+
+        UiLcdHy28_TextCacheSetDrawn(x, width, y, cf->Height, hash);
+    }
 }
 
 const sFONT   *UiLcdHy28_Font(uint8_t font)
@@ -1764,11 +2029,20 @@ static void UiLcdHy28_PrintTextLen(uint16_t XposStart, uint16_t YposStart, const
 
     if (str != NULL)
     {
-        for (uint16_t idx = 0; idx < len; idx++)
+        for (uint16_t idx = 0; idx < len;)
         {
-            uint8_t TempChar = *str++;
+            // all chars up to the next line wrap are drawn at once
+            uint16_t run = 1;
+            for (; idx + run < len && run < TEXT_RUN_MAX && XposCurrent < (MAX_X - Xshift); run++)
+            {
+                XposCurrent += Xshift;
+            }
+            XposCurrent -= (run - 1) * Xshift;
 
-            UiLcdHy28_DrawChar(XposCurrent, YposCurrent, TempChar,clr_fg,clr_bg,cf);
+            UiLcdHy28_DrawTextRun(XposCurrent, YposCurrent, &str[idx], run, clr_fg, clr_bg, cf, Xshift);
+
+            idx += run;
+            XposCurrent += (run - 1) * Xshift;
 
             if(XposCurrent < (MAX_X - Xshift))
             {
@@ -1955,19 +2229,29 @@ static void UiLcdHy28_PrintTextCenteredLen(const uint16_t XposStart,const uint16
     const uint16_t txtW = UiLcdHy28_TextWidthLen(str, len, font);
     const uint16_t bbOffset = txtW>bbW?0:((bbW - txtW)+1)/2;
 
-    // we draw the part of the box not used by text.
-    if (bbOffset)
+    // the whole box including the background is remembered as drawn,
+    // the last char of the 8x8 font is one pixel wider than the text width
+    const uint16_t drawnW = (txtW + 1 > bbW) ? txtW + 1 : bbW;
+    const uint32_t hash = UiLcdHy28_TextHash(str, len, clr_fg, clr_bg, UiLcdHy28_Font(font));
+
+    if (UiLcdHy28_TextCacheIsDrawn(XposStart, drawnW, YposStart, bbH, hash) == false)
     {
-        UiLcdHy28_DrawFullRect(XposStart,YposStart,bbH,bbOffset,clr_bg);
-    }
+        // we draw the part of the box not used by text.
+        if (bbOffset)
+        {
+            UiLcdHy28_DrawFullRect(XposStart,YposStart,bbH,bbOffset,clr_bg);
+        }
 
-    UiLcdHy28_PrintTextLen((XposStart + bbOffset),YposStart,str, len, clr_fg,clr_bg,font);
+        UiLcdHy28_PrintTextLen((XposStart + bbOffset),YposStart,str, len, clr_fg,clr_bg,font);
 
-    // if the text is smaller than the box, we need to draw the end part of the
-    // box
-    if (txtW<bbW)
-    {
-        UiLcdHy28_DrawFullRect(XposStart+txtW+bbOffset,YposStart,bbH,bbW-(bbOffset+txtW),clr_bg);
+        // if the text is smaller than the box, we need to draw the end part of the
+        // box
+        if (txtW<bbW)
+        {
+            UiLcdHy28_DrawFullRect(XposStart+txtW+bbOffset,YposStart,bbH,bbW-(bbOffset+txtW),clr_bg);
+        }
+
+        UiLcdHy28_TextCacheSetDrawn(XposStart, drawnW, YposStart, bbH, hash);
     }
 }
 
@@ -2503,6 +2787,8 @@ uint8_t UiLcdHy28_Init()
 {
     uint8_t retval = DISPLAY_NONE;
     mchf_display.DeviceCode = 0x0000;
+    // whatever we drew before is gone after the controller reset
+    UiLcdHy28_TextCacheClear();
     UiLcdHy28_BacklightInit();
 
     for (uint16_t disp_idx = 1; retval == DISPLAY_NONE && display_infos[disp_idx].display_type != DISPLAY_NUM; disp_idx++)
@@ -27,6 +27,10 @@
 #include "audio_nr.h"
 #include "psk.h"
 #include "uhsdr_math.h"
+#include "cat_spectrum.h"
+#include "snap_estimator.h"
+#include "band_sweep.h"
+#include "profiling.h"
 /*
 #if defined(USE_DISP_480_320) || defined(USE_EXPERIMENTAL_MULTIRES)
 #define USE_DISP_480_320_SPEC
@@ -237,7 +241,6 @@ static const scope_scaling_info_t scope_scaling_factors[SCOPE_SCALE_NUM+1] =
 };
 
 static void     UiSpectrum_DrawFrequencyBar();
-static void		UiSpectrum_CalculateDBm();
 
 // FIXME: This is partially application logic and should be moved to UI and/or radio management
 // instead of monitoring change, changes should trigger update of spectrum configuration (from pull to push)
@@ -250,13 +253,24 @@ static void UiSpectrum_UpdateSpectrumPixelParameters()
     static uint16_t old_cw_sidetone_freq = 0;
     static uint16_t old_rtty_shift = 0;
     static uint8_t old_digital_mode = 0xFF;
+    static bool old_sweep = false;
 
     static bool force_update = true;
 
-    if (sd.magnify != old_magnify || force_update)
+    const bool sweep = BandSweep_IsActive();
+
+    if (sd.magnify != old_magnify || sweep != old_sweep || force_update)
     {
         old_magnify = sd.magnify;
-        sd.hz_per_pixel = IQ_SAMPLE_RATE_F/((1 << sd.magnify) * slayout.scope.w);     // magnify mode is on
+        old_sweep = sweep;
+        if (sweep)
+        {
+            sd.hz_per_pixel = (float32_t)BandSweep_GetSpan()/slayout.scope.w;            // band panorama
+        }
+        else
+        {
+            sd.hz_per_pixel = IQ_SAMPLE_RATE_F/((1 << sd.magnify) * slayout.scope.w);     // magnify mode is on
+        }
         force_update = true;
     }
 
@@ -265,7 +279,12 @@ static void UiSpectrum_UpdateSpectrumPixelParameters()
         old_iq_freq_mode = ts.iq_freq_mode;
         force_update = true;
 
-        if(!sd.magnify)     // is magnify mode on?
+        if (sweep)
+        {
+            // the panorama does not move with the LO, the line shows the dial frequency within the band
+            sd.rx_carrier_pos = ((float32_t)RadioManagement_GetRXDialFrequency() - (float32_t)BandSweep_GetStart())/sd.hz_per_pixel - 0.5;
+        }
+        else if(!sd.magnify)     // is magnify mode on?
         {
             sd.rx_carrier_pos = slayout.scope.w/2 - 0.5 - (AudioDriver_GetTranslateFreq()/sd.hz_per_pixel);
         }
@@ -442,18 +461,20 @@ static void UiSpectrum_FFTWindowFunction(char mode)
 
 static void UiSpectrum_SpectrumTopBar_GetText(char* wfbartext)
 {
+    // all variants are 32 chars long, with the magnification padded to 3 digits (up to 128x) the text
+    // keeps its position and just fills the 256 pixel wide title of the 320x240 layout
 
     if(is_waterfallmode() && is_scopemode())           // dual waterfall
     {
-        sprintf(wfbartext,"Dual%s < Magnify %2ux >",scope_scaling_factors[ts.spectrum_db_scale].label, (1<<sd.magnify));
+        sprintf(wfbartext,"Dual%s < Magnify %3ux >",scope_scaling_factors[ts.spectrum_db_scale].label, (1<<sd.magnify));
     }
     else if(is_waterfallmode())           //waterfall
     {
-        sprintf(wfbartext,"  %s   < Magnify %2ux >",scope_scaling_factors[0].label, (1<<sd.magnify));	// a small trick, we use the empty location of index 0 in the table
+        sprintf(wfbartext,"  %s   < Magnify %3ux >",scope_scaling_factors[0].label, (1<<sd.magnify));	// a small trick, we use the empty location of index 0 in the table
     }
     else                                                // scope
     {
-        sprintf(wfbartext," SC %s < Magnify %2ux >",scope_scaling_factors[ts.spectrum_db_scale].label, (1<<sd.magnify));	// a small trick, we use the empty location of index 0 in the table
+        sprintf(wfbartext," SC %s < Magnify %3ux >",scope_scaling_factors[ts.spectrum_db_scale].label, (1<<sd.magnify));	// a small trick, we use the empty location of index 0 in the table
     }
 
 
@@ -984,6 +1005,12 @@ static void UiSpectrum_InitSpectrumDisplayData()
     	break;
     }
 
+    // the wrap around of the sample counter has to be a multiple of the ring buffer size in iq samples
+    sd.fft_ring_len = sd.fft_iq_len + sd.fft_iq_len/2;
+    sd.samp_count_wrap = (sd.fft_ring_len/2) << 16;
+    sd.samp_count = 0;
+    sd.welch_frame_end = 0;
+
 
     sd.agc_rate = ((float32_t)ts.spectrum_agc_rate) / SPECTRUM_AGC_SCALING;	// calculate agc rate
     //
@@ -1041,26 +1068,20 @@ static void UiSpectrum_InitSpectrumDisplayData()
     sd.wfall_size = slayout.wfall.h;
 
     // now make sure we fit in
-    // please note, this works only if we have enough memory for have the lines
-    // otherwise we will reduce size of displayed waterfall
-    if((sd.wfall_size * slayout.scope.w) > sizeof(sd.waterfall))
-    {
-        //sd.doubleWaterfallLine = 1;
+    // if the full height does not fit with one byte per pixel, we store only 4 bit per pixel (16 instead of 64 colours)
+    // which gives us twice the lines. If this is still not enough, the lines are repeated on the display.
+    sd.wfall_packed = (sd.wfall_size * slayout.wfall.w) > sizeof(sd.waterfall);
+    sd.wfall_line_len = sd.wfall_packed ? (slayout.wfall.w + 1)/2 : slayout.wfall.w;
 
-
-        if (sd.wfall_size/2 * slayout.scope.w > sizeof(sd.waterfall))
-        {
-            // we caculate how many lines we can do with the amount of memory
-            // and adjust displayed line count accordingly.
-            sd.wfall_size = sizeof(sd.waterfall)/(slayout.scope.w);
-            // FIXME: Notify user of issue
-            // if memory is too small even with doubled
-            // lines
-        }
-        else
-        {
-            sd.wfall_size /= 2;
-        }
+    if (sd.wfall_size * sd.wfall_line_len > sizeof(sd.waterfall))
+    {
+        // we caculate how many lines we can do with the amount of memory
+        // and adjust displayed line count accordingly.
+        sd.wfall_size = sizeof(sd.waterfall)/sd.wfall_line_len;
+    }
+    if (sd.wfall_size > WATERFALL_HISTORY_MAX)
+    {
+        sd.wfall_size = WATERFALL_HISTORY_MAX;
     }
  /*   else
     {
@@ -1115,7 +1136,7 @@ static void UiSpectrum_DrawWaterfall()
 
     // After the above manipulation, clip the result to make sure that it is within the range of the palette table
     //for(uint16_t i = 0; i < sd.spec_len; i++)
-    uint8_t  * const waterfallline_ptr = &sd.waterfall[sd.wfall_line*slayout.wfall.w];
+    uint8_t  * const waterfallline_ptr = &sd.waterfall[sd.wfall_line*sd.wfall_line_len];
 
     for(uint16_t i = 0; i < slayout.wfall.w; i++)
     {
@@ -1124,10 +1145,28 @@ static void UiSpectrum_DrawWaterfall()
             sd.FFT_Samples[i] = NUMBER_WATERFALL_COLOURS - 1;   // yes - clip it
         }
 
-        waterfallline_ptr[i] = sd.FFT_Samples[i]; // save the manipulated value in the circular waterfall buffer
+        if (sd.wfall_packed)
+        {
+            // round to the nearest of the 16 colours, even pixels go to the low nibble
+            const uint8_t colour = ((uint16_t)sd.FFT_Samples[i] * (NUMBER_WATERFALL_PACKED_COLOURS-1) + (NUMBER_WATERFALL_COLOURS-1)/2) / (NUMBER_WATERFALL_COLOURS-1);
+            if (i & 1)
+            {
+                waterfallline_ptr[i/2] |= colour << 4;
+            }
+            else
+            {
+                waterfallline_ptr[i/2] = colour;
+            }
+        }
+        else
+        {
+            waterfallline_ptr[i] = sd.FFT_Samples[i]; // save the manipulated value in the circular waterfall buffer
+        }
     }
 
-    sd.waterfall_frequencies[sd.wfall_line] = sd.FFT_frequency;
+    // the panorama does not move, the lines must not be shifted against each other while the LO steps through the band
+    const uint32_t line_frequency = BandSweep_IsActive() ? BandSweep_GetStart() : sd.FFT_frequency;
+    sd.waterfall_frequencies[sd.wfall_line] = line_frequency;
     static uint8_t doubleLineStart=0;
 
 	// Draw lines from buffer
@@ -1160,14 +1199,24 @@ static void UiSpectrum_DrawWaterfall()
 
         uint16_t spectrum_pixel_buf[slayout.wfall.w];
 
-        const int32_t cur_center_hz = sd.FFT_frequency;
+        const int32_t cur_center_hz = line_frequency;
+
+        // the palette entries of the 16 colours of packed lines, spread over the full palette
+        uint16_t packed_colours[NUMBER_WATERFALL_PACKED_COLOURS];
+        if (sd.wfall_packed)
+        {
+            for (uint16_t colour = 0; colour < NUMBER_WATERFALL_PACKED_COLOURS; colour++)
+            {
+                packed_colours[colour] = sd.waterfall_colours[(colour * (NUMBER_WATERFALL_COLOURS-1) + (NUMBER_WATERFALL_PACKED_COLOURS-1)/2) / (NUMBER_WATERFALL_PACKED_COLOURS-1)];
+            }
+        }
 
         uint8_t doubleLine=doubleLineStart;
 
         // we update the display unless there is a ptt request, in this case we skip to the end.
         for(uint16_t lcnt = 0; ts.ptt_req == false && lcnt < slayout.wfall.h;)                 // set up counter for number of lines defining height of waterfall
         {
-            uint8_t  * const waterfallline_ptr = &sd.waterfall[lptr*slayout.wfall.w];
+            uint8_t  * const waterfallline_ptr = &sd.waterfall[lptr*sd.wfall_line_len];
 
 
             const int32_t line_center_hz = sd.waterfall_frequencies[lptr];
@@ -1212,9 +1261,20 @@ static void UiSpectrum_DrawWaterfall()
                 *pixel_buf_ptr++ = Black;
             }
 
-            for(uint16_t idx = pixel_start, i = 0; i < pixel_count; i++,idx++)
+            if (sd.wfall_packed)
             {
-                *pixel_buf_ptr++ = sd.waterfall_colours[waterfallline_ptr[idx]];    // write to memory using waterfall color from palette
+                for(uint16_t idx = pixel_start, i = 0; i < pixel_count; i++,idx++)
+                {
+                    const uint8_t colour = (waterfallline_ptr[idx/2] >> ((idx & 1) * 4)) & 0x0f;
+                    *pixel_buf_ptr++ = packed_colours[colour];
+                }
+            }
+            else
+            {
+                for(uint16_t idx = pixel_start, i = 0; i < pixel_count; i++,idx++)
+                {
+                    *pixel_buf_ptr++ = sd.waterfall_colours[waterfallline_ptr[idx]];    // write to memory using waterfall color from palette
+                }
             }
 
             // fill to the right border with black pixels
@@ -1257,7 +1317,8 @@ static void UiSpectrum_DrawWaterfall()
 
 static float32_t  UiSpectrum_ScaleFFTValue(const float32_t value, float32_t* min_p)
 {
-    float32_t sig = sd.display_offset + Math_log10f_fast(value) * sd.db_scale;     // take FFT data, do a log10 and multiply it to scale 10dB (fixed)
+    // value is a power, db_scale is meant for magnitudes, hence the 0.5
+    float32_t sig = sd.display_offset + Math_log10f_fast(value) * sd.db_scale * 0.5;     // take FFT data, do a log10 and multiply it to scale 10dB (fixed)
     // apply "AGC", vertical "sliding" offset (or brightness for waterfall)
 
     if (sig < *min_p)
@@ -1342,6 +1403,162 @@ static void UiSpectrum_ScaleFFT2SpectrumWidth(float32_t samples[], uint16_t from
 // Waterfall Display code written by C. Turner, KA7OEI, May 2015 entirely from "scratch"
 // - which is to say that I did not borrow any of it
 // from anywhere else, aside from keeping some of the general functions found in "Case 1".
+/*
+ * Welch spectrum estimation
+ *
+ * The audio driver writes the iq samples continuously into FFT_RingBuffer, it never waits for us.
+ * Here we take overlapping frames of fft_iq_len/2 iq samples out of the ring buffer, window them,
+ * and average the power spectra of the frames exponentially with a time constant given by the spectrum filter
+ * setting. The display just shows the current average, so all the frames processed between two
+ * display updates contribute to the picture. This lowers the variance of the noise floor a lot
+ * and makes weak signals visible, especially with higher zoom levels.
+ *
+ * The frames overlap by 3/4, with the Hann window this uses practically all of the information in the signal.
+ * At low zoom levels there is much more data than we need, so the frame rate is limited to
+ * SPECTRUM_WELCH_RATE_MAX frames per second to keep the load on the user level code low.
+ */
+#define SPECTRUM_WELCH_OVERLAP_DIV  4       // frame distance is frame length / SPECTRUM_WELCH_OVERLAP_DIV
+#define SPECTRUM_WELCH_RATE_MAX     50      // FFT frames per second at most
+#define SPECTRUM_FILTER_TAU         0.1     // seconds per spectrum filter step, averaging time constant
+
+/**
+ * @returns a - b for two sample counter values, taking the wrap around into account
+ */
+static int32_t UiSpectrum_SampleCountDiff(const uint32_t a, const uint32_t b)
+{
+    const int32_t wrap = sd.samp_count_wrap;
+    int32_t diff = (int32_t)a - (int32_t)b;
+
+    if (diff > wrap/2)
+    {
+        diff -= wrap;
+    }
+    else if (diff < -wrap/2)
+    {
+        diff += wrap;
+    }
+    return diff;
+}
+
+/**
+ * @returns sample counter value a + n, n may be negative
+ */
+static uint32_t UiSpectrum_SampleCountAdd(const uint32_t a, const int32_t n)
+{
+    int32_t sum = (int32_t)a + n;
+
+    if (sum >= (int32_t)sd.samp_count_wrap)
+    {
+        sum -= sd.samp_count_wrap;
+    }
+    else if (sum < 0)
+    {
+        sum += sd.samp_count_wrap;
+    }
+    return sum;
+}
+
+/**
+ * @returns number of iq samples between the ends of two consecutive Welch frames
+ */
+static int32_t UiSpectrum_WelchFrameDist()
+{
+    const int32_t frame_len = sd.fft_iq_len/2;
+    const int32_t sample_rate = IQ_SAMPLE_RATE >> sd.magnify;
+
+    int32_t frame_dist = frame_len / SPECTRUM_WELCH_OVERLAP_DIV;
+    if (frame_dist < sample_rate / SPECTRUM_WELCH_RATE_MAX)
+    {
+        frame_dist = sample_rate / SPECTRUM_WELCH_RATE_MAX;
+    }
+    return frame_dist;
+}
+
+/**
+ * @brief copies the next Welch frame from the ring buffer into FFT_Samples if one is available
+ * @param span_p returns the number of iq samples between the end of the previous frame and the end of this frame
+ * @returns true if FFT_Samples has been filled with a valid frame
+ */
+static bool UiSpectrum_WelchGetFrame(uint32_t* span_p)
+{
+    bool retval = false;
+
+    const int32_t frame_len = sd.fft_iq_len/2;                          // iq samples per frame
+    const int32_t reserve = sd.fft_ring_len/2 - frame_len;              // iq samples the audio driver may write while we read
+    const int32_t frame_dist = UiSpectrum_WelchFrameDist();
+
+    const uint32_t samp_count = sd.samp_count;
+    uint32_t frame_end = UiSpectrum_SampleCountAdd(sd.welch_frame_end, frame_dist);
+    const int32_t lag = UiSpectrum_SampleCountDiff(samp_count, frame_end);
+
+    if (lag >= 0)
+    {
+        if (lag > reserve/2)
+        {
+            // we are too late for this frame, go for the most recent one
+            frame_end = samp_count;
+        }
+
+        // ring buffer index of the first i/q value of the frame
+        const uint32_t start = (UiSpectrum_SampleCountAdd(frame_end, -frame_len) % (sd.fft_ring_len/2)) * 2;
+        const uint32_t first_part = (sd.fft_ring_len - start) < sd.fft_iq_len ? (sd.fft_ring_len - start) : sd.fft_iq_len;
+
+        arm_copy_f32(&sd.FFT_RingBuffer[start], &sd.FFT_Samples[0], first_part);
+        arm_copy_f32(&sd.FFT_RingBuffer[0], &sd.FFT_Samples[first_part], sd.fft_iq_len - first_part);
+
+        // the audio driver only overwrites our frame if it wrote more than reserve samples after the frame end
+        __DMB();
+        if (UiSpectrum_SampleCountDiff(sd.samp_count, frame_end) <= reserve)
+        {
+            *span_p = UiSpectrum_SampleCountDiff(frame_end, sd.welch_frame_end);
+            retval = true;
+        }
+        sd.welch_frame_end = frame_end;
+    }
+
+    return retval;
+}
+
+/**
+ * @brief adds the power spectrum of the latest frame (in FFT_MagData) to the exponential average in FFT_AVGData
+ * @param span number of iq samples since the previous frame
+ */
+static void UiSpectrum_WelchAverage(const uint32_t span)
+{
+    const float32_t tau = ts.spectrum_filter * SPECTRUM_FILTER_TAU;
+    const float32_t dt = (float32_t)span / (float32_t)(IQ_SAMPLE_RATE >> sd.magnify);
+    const float32_t alpha = 1.0 - expf(-dt/tau);
+
+    // avg = avg + alpha * (power - avg)
+    arm_mult_f32(sd.FFT_MagData, sd.FFT_MagData, sd.FFT_Samples, sd.spec_len);
+    arm_sub_f32(sd.FFT_Samples, sd.FFT_AVGData, sd.FFT_Samples, sd.spec_len);
+    arm_scale_f32(sd.FFT_Samples, alpha, sd.FFT_Samples, sd.spec_len);
+    arm_add_f32(sd.FFT_AVGData, sd.FFT_Samples, sd.FFT_AVGData, sd.spec_len);
+
+    for(uint32_t i = 0; i < sd.spec_len; i++)	 		// guarantee that the result will always be >= 0
+    {
+        if(sd.FFT_AVGData[i] < 1)
+        {
+            sd.FFT_AVGData[i] = 1;
+        }
+    }
+}
+
+/**
+ * @brief drops the frame in calculation and all frames with samples the audio driver writes within the next samples
+ * Used if the samples are known to be invalid, e.g. while the LO settles after a frequency change.
+ * @param samples number of iq samples to skip, at the spectrum sample rate
+ */
+void UiSpectrum_SkipSamples(const uint32_t samples)
+{
+    // the first frame starts after the skipped samples
+    sd.welch_frame_end = UiSpectrum_SampleCountAdd(sd.samp_count, (int32_t)samples + sd.fft_iq_len/2 - UiSpectrum_WelchFrameDist());
+    if (sd.state > 0 && sd.state < 4)
+    {
+        sd.state = 0;
+    }
+}
+
 /**
  * @briefs implement a staged calculation and drawing of the spectrum scope / waterfall
  * should not be called directly, go through UiSpectrum_Redraw which implements a rate limiter
@@ -1356,17 +1573,17 @@ static void UiSpectrum_RedrawSpectrum()
 						&& (ts.VirtualKeysShown_flag ==false);
 
 
+    static uint32_t welch_span;
+
     // Process implemented as state machine
     switch(sd.state)
     {
     case 0:
-        sd.reading_ringbuffer = true;
-        __DSB();
-        // we make sure the interrupt sees this variable value by ensure all memory operations have been done
-        // after this point
-        arm_copy_f32(&sd.FFT_RingBuffer[sd.samp_ptr],&sd.FFT_Samples[0],sd.fft_iq_len-sd.samp_ptr);
-        arm_copy_f32(&sd.FFT_RingBuffer[0],&sd.FFT_Samples[sd.fft_iq_len-sd.samp_ptr],sd.samp_ptr);
-        sd.reading_ringbuffer = false;
+        if (UiSpectrum_WelchGetFrame(&welch_span) == false)
+        {
+            // no new frame yet
+            break;
+        }
         // Apply gain to collected IQ samples and then do FFT
         // Scale input according to A/D gain and apply Window function
 
@@ -1428,24 +1645,20 @@ static void UiSpectrum_RedrawSpectrum()
         break;
     }
 
-    //  Low-pass filter amplitude magnitude data
+    //  Average the power of the frames
     case 3:
     {
-    	float32_t filt_factor = 1/(float)ts.spectrum_filter;		// use stored filter setting inverted to allow multiplication
-        arm_scale_f32(sd.FFT_AVGData, filt_factor, sd.FFT_Samples, sd.spec_len);	// get scaled version of previous data
-        arm_sub_f32(sd.FFT_AVGData, sd.FFT_Samples, sd.FFT_AVGData, sd.spec_len);	// subtract scaled information from old, average data
-        arm_scale_f32(sd.FFT_MagData, filt_factor, sd.FFT_Samples, sd.spec_len);	// get scaled version of new, input data
-        arm_add_f32(sd.FFT_Samples, sd.FFT_AVGData, sd.FFT_AVGData, sd.spec_len);	// add portion new, input data into average
-
-        for(uint32_t i = 0; i < sd.spec_len; i++)	 		// guarantee that the result will always be >= 0
+        if (BandSweep_IsActive())
         {
-            if(sd.FFT_AVGData[i] < 1)
-            {
-                sd.FFT_AVGData[i] = 1;
-            }
+            // the band panorama takes the place of the average, the CAT stream has no format for it
+            BandSweep_AddFrame(sd.FFT_MagData, sd.FFT_AVGData, sd.spec_len);
         }
+        else
+        {
+            UiSpectrum_WelchAverage(welch_span);
 
-        UiSpectrum_CalculateDBm();
+            CatSpectrum_Process();
+        }
 
         if (is_RedrawActive)
         {   //continue if there is no objection to display spectrum or waterfall
@@ -1454,7 +1667,8 @@ static void UiSpectrum_RedrawSpectrum()
                 ts.dial_moved = 0;	// Dial moved - reset indicator
                 UiSpectrum_DrawFrequencyBar();	// redraw frequency bar on the bottom of the display
             }
-        	sd.state++;
+            // only go on with the display if an update is due, otherwise continue with the next frame
+            sd.state = sd.RedrawType != 0 ? sd.state + 1 : 0;
         }
         else
         {
@@ -1490,6 +1704,8 @@ static void UiSpectrum_RedrawSpectrum()
     case 5:	// rescale waterfall horizontally, apply brightness/contrast, process pallate and put vertical line on screen, if enabled.
     	if (is_RedrawActive)		//this is needed for overwrite prevention if menu was drawn when sd.state>4
     	{
+    		profileTimedEventStart(ProfileUiSpectrum);
+
     		if(sd.RedrawType&Redraw_SCOPE)
     		{
     			UiSpectrum_DrawScope(sd.Old_PosData, sd.FFT_Samples);
@@ -1500,19 +1716,9 @@ static void UiSpectrum_RedrawSpectrum()
     			UiSpectrum_DrawWaterfall();
     		}
 
-
-    		if(((ts.waterfall.speed == 0)
-    				&&(ts.scope_speed == 0))
-					||(sd.RedrawType != 0)
-    		)
-    		{
-    			sd.state = 0;
-    		}
-    	}
-    	else
-    	{
-    		sd.state = 0;
+    		profileTimedEventStop(ProfileUiSpectrum);
     	}
+    	sd.state = 0;
 		sd.RedrawType=0;
     	break;
     default:
@@ -1640,6 +1846,45 @@ void UiSpectrum_DisplayFilterBW()
     }
 }
 
+/**
+ * @brief Draw the frequency bar for the band sweep panorama, the graticule labels show the kHz part of the frequency
+ */
+static void UiSpectrum_DrawSweepFrequencyBar()
+{
+    if (ts.spectrum_freqscale_colour != SPEC_BLACK)     // don't bother updating frequency scale if it is black (invisible)!
+    {
+        char txt[16];
+        uint32_t clr;
+        UiMenu_MapColors(ts.spectrum_freqscale_colour,NULL, &clr);
+
+        const uint8_t graticule_font = 4;
+        const uint16_t number_width = UiLcdHy28_TextWidth("    ",graticule_font);
+        const uint16_t pos_number_y = (slayout.graticule.y +  (slayout.graticule.h - UiLcdHy28_TextHeight(graticule_font))/2);
+        const int grid_count = pos_spectrum->SCOPE_GRID_VERT_COUNT;
+
+        for (int idx = 0; idx <= grid_count; idx++)
+        {
+            const uint16_t pos = idx == 0 ? 0 : (idx == grid_count ? slayout.scope.w - 1 : sd.vert_grid_id[idx-1]);
+            const uint32_t freq_khz = (BandSweep_GetStart() + pos * sd.hz_per_pixel + 500) / 1000;
+
+            snprintf(txt,16, "%03lu", freq_khz % 1000);
+
+            if (idx == 0) // left border
+            {
+                UiLcdHy28_PrintText( slayout.graticule.x + pos, pos_number_y,txt,clr,Black,graticule_font);
+            }
+            else if (idx == grid_count) // right border
+            {
+                UiLcdHy28_PrintTextRight( slayout.graticule.x + pos, pos_number_y,txt,clr,Black,graticule_font);
+            }
+            else
+            {
+                UiLcdHy28_PrintTextCentered(slayout.graticule.x +  pos - number_width/2,pos_number_y, number_width,txt,clr,Black,graticule_font);
+            }
+        }
+    }
+}
+
 /**
  * @brief Draw the frequency information on the frequency bar at the bottom of the spectrum scope based on the current frequency
  */
@@ -1650,7 +1895,11 @@ static void UiSpectrum_DrawFrequencyBar()
 
     UiSpectrum_UpdateSpectrumPixelParameters();
 
-    if (ts.spectrum_freqscale_colour != SPEC_BLACK)     // don't bother updating frequency scale if it is black (invisible)!
+    if (BandSweep_IsActive())
+    {
+        UiSpectrum_DrawSweepFrequencyBar();
+    }
+    else if (ts.spectrum_freqscale_colour != SPEC_BLACK)     // don't bother updating frequency scale if it is black (invisible)!
     {
         float32_t grat = 6.0f / (float32_t)(1 << sd.magnify);
 
@@ -1680,6 +1929,10 @@ static void UiSpectrum_DrawFrequencyBar()
         {
             freq_calc = roundf(freq_calc/50) / 20; // round graticule frequency to the nearest 50Hz
         }
+        else
+        {
+            freq_calc = roundf(freq_calc/10) / 100; // round graticule frequency to the nearest 10Hz
+        }
 
 
         int16_t centerIdx = -100; // UiSpectrum_GetGridCenterLine(0);
@@ -1873,252 +2126,70 @@ void UiSpectrum_CwSnapDisplay (float32_t delta)
 }
 
 
-void UiSpectrum_CalculateSnap(float32_t Lbin, float32_t Ubin, int posbin, float32_t bin_BW)
+/**
+ * SNAP is used to estimate the frequency of a carrier and subsequently tune the Rx frequency to that carrier frequency.
+ * It is usable in the following demodulation modes:
+ * AM & SAM
+ * CW -> a morse activity detector (built-in in the CW decoding algorithm) detects whenever a CW signal is present and allows
+ *       frequency estimation update ONLY when a carrier is present
+ * DIGIMODE -> BPSK
+ *
+ * The frequency comes from the SNAP estimator in the audio driver (see snap_estimator.c), independent of the spectrum display.
+ * To be called from the main loop, returns immediately if there is no new estimate.
+ */
+void UiSpectrum_CalculateSnap()
 {
-	// SNAP is used to estimate the frequency of a carrier and subsequently tune the Rx frequency to that carrier frequency
-	// At the moment (January 2018), it is usable in the following demodulation modes:
-	// AM & SAM
-	// CW -> a morse activity detector (built-in in the CW decoding algorithm) detects whenever a CW signal is present and allows
-	//       frequency estimation update ONLY when a carrier is present
-	// DIGIMODE -> BPSK
-	// DD4WH, Jan 2018
-	//
-	if(ads.CW_signal || (ts.dmod_mode == DEMOD_AM || ts.dmod_mode == DEMOD_SAM || (ts.dmod_mode == DEMOD_DIGI && ts.digital_mode == DigitalMode_BPSK)))
-		// this is only done, if there has been a pulse from the CW station that exceeds the threshold
-		// in the CW decoder section
-		// OR if we are in AM/SAM/Digi BPSK mode
-	{
-	    static float32_t freq_old = 10000000.0;
-	    float32_t help_freq = df.tune_old;
-	    // 1. lowpass filter all the relevant bins over 2 to 20 FFTs (?)
-	    // lowpass filtering already exists in the spectrum/waterfall display driver
-
-	    // 2. determine bin with maximum value inside these samples
-
-	    // look for maximum value and save the bin # for frequency delta calculation
-	    float32_t maximum = 0.0;
-	    float32_t maxbin = 1.0;
-	    float32_t delta1 = 0.0;
-	    float32_t delta2 = 0.0;
-	    float32_t delta = 0.0;
+    static bool snap_restarted = false;
 
-	    for (int c = (int)Lbin; c <= (int)Ubin; c++)   // search for FFT bin with highest value = carrier and save the no. of the bin in maxbin
-	    {
-	        if (maximum < sd.FFT_Samples[c])
-	        {
-	            maximum = sd.FFT_Samples[c];
-	            maxbin = c;
-	        }
-	    }
+    const bool is_bpsk = ts.dmod_mode == DEMOD_DIGI && ts.digital_mode == DigitalMode_BPSK;
+    const bool snap_active = cw_decoder_config.snap_enable && ts.txrx_mode == TRX_MODE_RX && BandSweep_IsActive() == false
+            && (ts.dmod_mode == DEMOD_CW || ts.dmod_mode == DEMOD_AM || ts.dmod_mode == DEMOD_SAM || is_bpsk);
 
-// 3. first frequency carrier offset calculation
-    // ok, we have found the maximum, now save first delta frequency
-//    delta1 = (maxbin - (float32_t)posbin) * bin_BW;
-    delta1 = ((maxbin + 1.0) - (float32_t)posbin) * bin_BW;
+    // where we expect the carrier relative to the rx frequency
+    float32_t center = 0.0;
+    float32_t range = SNAP_ESTIMATOR_RANGE_MAX;
 
-// 4. second frequency carrier offset calculation
-
-    if(maxbin < 1.0)
+    if (ts.dmod_mode == DEMOD_CW)
     {
-    	maxbin = 1.0;
+        center = (ts.cw_lsb ? -1.0 : 1.0) * (float32_t)ts.cw_sidetone_freq;
+        range = FilterInfo[ts.filters_p->id].width / 2;
     }
-    float32_t bin1 = sd.FFT_Samples[(int)maxbin-1];
-    float32_t bin2 = sd.FFT_Samples[(int)maxbin];
-    float32_t bin3 = sd.FFT_Samples[(int)maxbin+1];
-
-    if (bin1+bin2+bin3 == 0.0) bin1= 0.00000001; // prevent divide by 0
-
-    // estimate frequency of carrier by three-point-interpolation of bins around maxbin
-    // formula by (Jacobsen & Kootsookos 2007) equation (4) P=1.36 for Hanning window FFT function
-
-//    delta2 = (bin_BW * (1.75 * (bin3 - bin1)) / (bin1 + bin2 + bin3));
-    delta2 = (bin_BW * (1.36 * (bin3 - bin1)) / (bin1 + bin2 + bin3));
-    if(delta2 > bin_BW) delta2 = 0.0;
-    delta = delta1 + delta2;
-
-    if(ts.dmod_mode == DEMOD_CW)
-    { // only add offset, if in CW mode, not in AM/SAM etc.
-        const float32_t cw_offset = (ts.cw_lsb?1.0:-1.0)*(float32_t)ts.cw_sidetone_freq;
-        delta = delta + cw_offset;
-    }
-
-    if(ts.dmod_mode == DEMOD_DIGI && ts.digital_mode == DigitalMode_BPSK)
+    else if (is_bpsk)
     {
-    	if(ts.digi_lsb)
-    	{
-    		delta = delta + PSK_OFFSET; //
-    	}
-    	else
-    	{
-    		delta = delta - PSK_OFFSET; //
-    	}
+        center = ts.digi_lsb ? -PSK_OFFSET : PSK_OFFSET;
+        range = PSK_SNAP_RANGE;
     }
 
-    // make 10 frequency measurements and after that take the lowpass filtered frequency to tune to
+    SnapEstimator_Configure(snap_active, center, range);
 
-    help_freq = help_freq + delta;
-    // do we need a lowpass filter?
-    help_freq = 0.2 * help_freq + 0.8 * freq_old;
-    ads.snap_carrier_freq = (ulong) (help_freq);
-    freq_old = help_freq;
-
-	static uint8_t snap_counter = 0;
-#if	defined(STM32F7) || defined(STM32H7)
-	const int SNAP_COUNT_MAX = 10;
-#else
-	const int SNAP_COUNT_MAX = 6;
-#endif
-    if(sc.snap == true)
+    if (snap_active == false)
     {
-    	snap_counter++;
-    	if(snap_counter >= SNAP_COUNT_MAX) // take low pass filtered 6 freq measurements
-    	{
-    		// tune to frequency
-            // set frequency of Si570 with 4 * dialfrequency
-            df.tune_new = help_freq;
-    		// reset counter
-    		snap_counter = 0;
-    		sc.snap = false;
-    	}
+        sc.snap = false;
     }
-    // graphical TUNE HELPER display
-    UiSpectrum_CwSnapDisplay (delta);
-
-	}
-}
-
-static void UiSpectrum_CalculateDBm()
-{
-
-    //###########################################################################################################################################
-    //###########################################################################################################################################
-    // dBm/Hz-display DD4WH June, 9th 2016
-    // the dBm/Hz display gives an absolute measure of the signal strength of the sum of all signals inside the passband of the filter
-    // we take the FFT-magnitude values of the spectrum display FFT for this purpose (which are already calculated for the spectrum display),
-    // so the additional processor load and additional RAM usage should be close to zero
-    // this code also calculates the basis for the S-Meter (in sm.dbm and sm.dbmhz)
-    //
-    if( ts.txrx_mode == TRX_MODE_RX)
+    else if (sc.snap == true && snap_restarted == false)
     {
-        const float32_t slope = 19.8; // 19.6; --> empirical values derived from measurements by DL8MBY, 2016/06/30, Thanks!
-        const float32_t cons = ts.dbm_constant - 225 - (sd.fft_iq_len == 1024?3:0);
-        // the last term is for correcting the dbm value when a twice as large fft is being used (512 vs. 256)
-        const int buff_len_int = sd.fft_iq_len;
-        const float32_t buff_len = buff_len_int;
-
-        // width of a 256 tap FFT bin = 187.5Hz
-        // we have to take into account the magnify mode
-        // --> recalculation of bin_BW
-        // correct bin bandwidth is determined by the Zoom FFT display setting
-        const float32_t bin_BW = IQ_SAMPLE_RATE_F * 2.0 / (buff_len * (1 << sd.magnify)) ;
-
-        float32_t width = FilterInfo[ts.filters_p->id].width;
-        float32_t offset = ts.filters_p->offset;
-
-        if (offset == 0)
-        {
-            offset = width/2;
-        }
-
-        const float32_t lf_freq = offset - width/2;
-        const float32_t uf_freq = offset + width/2;
-
-        //	determine Lbin and Ubin from ts.dmod_mode and FilterInfo.width
-        //	= determine bandwith separately for lower and upper sideband
-
-        float32_t bw_LOWER = 0.0;
-        float32_t bw_UPPER = 0.0;
-
-        if (RadioManagement_UsesBothSidebands(ts.dmod_mode) == true)
-        {
-            bw_UPPER = uf_freq;
-            bw_LOWER = -uf_freq;
-        }
-        else if (RadioManagement_LSBActive(ts.dmod_mode) == true)
-        {
-            bw_UPPER = -lf_freq;
-            bw_LOWER = -uf_freq;
-        }
-        else if (is_demod_psk())
-        { // this is for experimental SNAP of BPSK carriers
-            bw_LOWER = PSK_OFFSET - PSK_SNAP_RANGE;
-            bw_UPPER = PSK_OFFSET + PSK_SNAP_RANGE;
-        }
-        else // USB
-        {
-            bw_UPPER = uf_freq;
-            bw_LOWER = lf_freq;
-        }
-
-
-        //  determine posbin (where we receive at the moment) from ts.iq_freq_mode
-
-        // frequency translation off, IF = 0 Hz OR
-        // in all magnify cases (2x up to 32x) the posbin is in the centre of the spectrum display
-
-        const int32_t bin_offset = sd.magnify != 0 ? 0 : (- (buff_len_int * AudioDriver_GetTranslateFreq( )) / (2 * IQ_SAMPLE_RATE));
-        const int32_t posbin = buff_len_int / 4 + bin_offset;  // right in the middle!
-
-
-        // calculate upper and lower limit for determination of signal strength
-        // = filter passband is between the lower bin Lbin and the upper bin Ubin
-        float32_t Lbin = (float32_t)posbin + roundf(bw_LOWER / bin_BW);
-        float32_t Ubin = (float32_t)posbin + roundf(bw_UPPER / bin_BW); // the bin on the upper sideband side
-
-        if(ts.dmod_mode == DEMOD_SAM && ads.sam_sideband == SAM_SIDEBAND_USB) // workaround to make SNAP and carrier offset display work with sideband-selected SAM
-        {
-            Lbin = Lbin - 1.0;
-        }
-
-        // take care of filter bandwidths that are larger than the displayed FFT bins
-        if(Lbin < 0)
-        {
-            Lbin = 0;
-        }
-
-        if (Ubin > (sd.spec_len-1))
-        {
-            Ubin = sd.spec_len-1;
-        }
-
-        for(int32_t i = 0; i < (buff_len_int/4); i++)
-        {
-            sd.FFT_Samples[sd.spec_len - i - 1] = sd.FFT_MagData[i + buff_len_int/4] * SCOPE_PREAMP_GAIN;	// get data
-        }
-        for(int32_t i = buff_len_int/4; i < (buff_len_int/2); i++)
-        {
-            sd.FFT_Samples[sd.spec_len - i - 1] = sd.FFT_MagData[i - buff_len_int/4] * SCOPE_PREAMP_GAIN;	// get data
-        }
-
-        // here would be the right place to start with the SNAP mode!
-        if(cw_decoder_config.snap_enable && (ts.dmod_mode == DEMOD_CW || ts.dmod_mode == DEMOD_AM || ts.dmod_mode == DEMOD_SAM || (ts.dmod_mode == DEMOD_DIGI && ts.digital_mode == DigitalMode_BPSK)))
-        {
-            UiSpectrum_CalculateSnap(Lbin, Ubin, posbin, bin_BW);
-        }
-
-        float32_t sum_db = 0.0;
-        // determine the sum of all the bin values in the passband
-        for (int c = Lbin; c <= (int)Ubin; c++)   // sum up all the values of all the bins in the passband
-        {
-            sum_db = sum_db + sd.FFT_Samples[c]; // / (float32_t)(1<<sd.magnify);
-        }
-        // we have to account for the larger number of bins that are summed up when using higher
-        // magnifications
-        // for example: if we have 34 bins to sum up for sd.magnify == 1, we sum up 68 bins for sd.magnify == 2
+        // SNAP has been requested, use only samples from now on
+        SnapEstimator_Restart();
+        snap_restarted = true;
+    }
 
-        //            sum_db /= (float32_t)sd.magnify + 1;
-        //            cons = cons - 3.0 * (sd.magnify);
+    float32_t delta;
+    if (SnapEstimator_Estimate(&delta) && (ts.dmod_mode != DEMOD_CW || ads.CW_signal))
+    {
+        ads.snap_carrier_freq = (ulong)(df.tune_old + delta);
 
-        if (sum_db > 0)
-        {
-            sm.dbm_cur = slope * Math_log10f_fast (sum_db) + cons;
-            sm.dbmhz_cur = sm.dbm_cur -  10 * Math_log10f_fast ((float32_t)(((int)Ubin-(int)Lbin) * bin_BW)) ;
-        }
-        else
+        if (sc.snap == true && snap_restarted == true)
         {
-            sm.dbm_cur = -145.0;
-            sm.dbmhz_cur = -145.0;
+            // tune to frequency
+            df.tune_new = ads.snap_carrier_freq;
+            sc.snap = false;
+            snap_restarted = false;
+            // the collected samples have been received on the old frequency
+            SnapEstimator_Restart();
+            delta = 0.0;
         }
+        // graphical TUNE HELPER display
+        UiSpectrum_CwSnapDisplay(delta);
     }
 }
 /*
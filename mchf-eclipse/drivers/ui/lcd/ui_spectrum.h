@@ -39,7 +39,9 @@ void UiSpectrum_CalculateDisplayFilterBW(float32_t* width_pixel_, float32_t* lef
 void UiSpectrum_DisplayFilterBW(void);
 
 void UiSpectrum_InitCwSnapDisplay (bool visible);
+void UiSpectrum_CalculateSnap(void);
 void UiSpectrum_ResetSpectrum(void);
+void UiSpectrum_SkipSamples(const uint32_t samples);
 uint16_t UiSprectrum_CheckNewGraticulePos(uint16_t new_y);
 
 // Settings for dB/division for spectrum display
@@ -160,6 +162,8 @@ enum
 #define INIT_SPEC_AGC_LEVEL					-80	// Initial offset for AGC level for spectrum/waterfall display
 
 #define	NUMBER_WATERFALL_COLOURS			64		// number of colors in the waterfall table
+#define	NUMBER_WATERFALL_PACKED_COLOURS		16		// number of colors in the waterfall table if 4 bit lines are used
+#define	WATERFALL_HISTORY_MAX				(2*(WATERFALL_HEIGHT+10))	// lines, the packed lines need half the memory
 
 
 #ifdef USE_DISP_320_240
@@ -189,23 +193,24 @@ enum
 typedef struct SpectrumDisplay
 {
     // Samples buffer
-    float32_t   FFT_RingBuffer[FFT_IQ_BUFF_LEN];
+    float32_t   FFT_RingBuffer[FFT_RING_BUFF_LEN];
     float32_t   FFT_Samples[FFT_IQ_BUFF_LEN];
-    float32_t   FFT_MagData[SPEC_BUFF_LEN];
-    float32_t   FFT_AVGData[SPEC_BUFF_LEN];     // IIR low-pass filtered FFT buffer data
+    float32_t   FFT_MagData[SPEC_BUFF_LEN];     // magnitude of the latest FFT frame
+    float32_t   FFT_AVGData[SPEC_BUFF_LEN];     // exponentially averaged power of the FFT frames
     uint32_t    FFT_frequency; // center frequency of stored FFT
     // scope pixel data
     uint16_t    Old_PosData[SPECTRUM_WIDTH_MAX];
 
     // Current data ptr
     uint32_t   samp_ptr;
-    volatile bool    reading_ringbuffer;
-    // if the user level code wants to read the ring buffer
-    // simply set this, and the audio driver will stop writing
-    // to the buffer.  This means we loose some samples here but this is not a problem I would think.
-    // if we don't want or should do this,
-    // we have to add a little extra space to the ringbuffer (one audio driver sample block), which gives sufficient
-    // space to add data to while we are reading.
+    // number of iq samples written to the ring buffer by the audio driver, updated after each block
+    // wraps at samp_count_wrap, a multiple of the ring buffer size, so samp_count also tells the ring position
+    // the audio driver never stops writing, the user level code checks after reading a frame from
+    // the ring buffer whether the frame has been overwritten in the meantime
+    volatile uint32_t samp_count;
+    uint32_t   samp_count_wrap;
+    uint32_t   welch_frame_end; // samp_count at the end of the last processed FFT frame
+    uint16_t   fft_ring_len;    // used part of FFT_RingBuffer, 3/2 * fft_iq_len
 
 
     // Addresses of vertical grid lines on x axis
@@ -223,7 +228,7 @@ typedef struct SpectrumDisplay
     uchar   enabled;
 
     // Variables used in spectrum display AGC
-    uint8_t   magnify;          // 2^magnify == zoom factor, max is 5
+    uint8_t   magnify;          // 2^magnify == zoom factor, max is 7
 
     uint16_t    spec_len;
     uint16_t    fft_iq_len;
@@ -241,7 +246,9 @@ typedef struct SpectrumDisplay
     uint8_t repeatWaterfallLine;				//line repeating count for waterfall size grater than number of data lines in waterfall array
     // uint8_t  waterfall[WATERFALL_MAX_LINES*SPECTRUM_WIDTH];    // circular buffer used for storing waterfall data - remember to increase this if the waterfall is made larger!
     uint8_t  waterfall[(WATERFALL_HEIGHT+10)*256];    // circular buffer used for storing waterfall data - remember to increase this if the waterfall is made larger!
-    uint32_t waterfall_frequencies[(WATERFALL_HEIGHT+10)]; // we reserve hopefully enough frequency stores here. We store for each line in waterfall the center frequency of it.
+    uint32_t waterfall_frequencies[WATERFALL_HISTORY_MAX]; // we reserve hopefully enough frequency stores here. We store for each line in waterfall the center frequency of it.
+    bool     wfall_packed;      // two 4 bit colour indices per byte in waterfall, used if the 8 bit lines do not fit
+    uint16_t wfall_line_len;    // bytes per line in waterfall
     //uint8_t wfall_DrawDirection;	//0=upward (water fountain), 1=downward (real waterfall)
     uint32_t wfall_line;        // pointer to current line of waterfall data
     uint32_t wfall_size;        // vertical size of the waterfall data (number of stored fft results)
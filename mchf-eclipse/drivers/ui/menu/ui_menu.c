@@ -34,6 +34,9 @@
 #include "radio_management.h"
 #include "soft_tcxo.h"
 #include "cw_decoder.h"
+#include "psk.h"
+#include "tx_dpd.h"
+#include "tx_mbc.h"
 
 #include "osc_si5351a.h"
 #include "osc_si570.h"
@@ -1661,6 +1664,19 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
             }
         }
         break;
+    case MENU_TX_MBC_PRESET:    // multiband speech processor preset
+        var_change = UiDriverMenuItemChangeUInt8(var, mode, &ts.tx_mbc_preset,
+                                              0,
+                                              TX_MBC_PRESET_NUM - 1,
+                                              TX_MBC_PRESET_DEFAULT,
+                                              1
+                                             );
+        if (ts.tx_comp_level == TX_AUDIO_COMPRESSION_MIN)
+        {
+            clr = Red;  // no compression at all, preset has no effect
+        }
+        txt_ptr = TxMbc_GetPresetName(ts.tx_mbc_preset);
+        break;
     case MENU_KEYER_MODE:   // Keyer mode
         var_change = UiDriverMenuItemChangeUInt8(var, mode, &ts.cw_keyer_mode,
                                               0,
@@ -1718,6 +1734,36 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
         snprintf(options,32, "  %u.%02u", ts.cw_keyer_weight/100,ts.cw_keyer_weight%100);
         break;
 
+    case MENU_CW_EDGE_SHAPE:  // keying envelope shape
+        var_change = UiDriverMenuItemChangeUInt8(var, mode, &ts.cw_edge_shape,
+                                              0,
+                                              CW_EDGE_SHAPE_NUM - 1,
+                                              CW_EDGE_SHAPE_BLACKMAN_HARRIS,
+                                              1
+                                             );
+
+        if(var_change)
+        {
+            CwGen_SetSpeed(); // rebuilds the envelope cache and adjusts element timing
+        }
+        txt_ptr = ts.cw_edge_shape == CW_EDGE_SHAPE_RAISED_COSINE ? " RAISED COS" : "BLACKM-HARR";
+        break;
+
+    case MENU_CW_EDGE_TIME:  // keying envelope rise/fall time
+        var_change = UiDriverMenuItemChangeUInt8(var, mode, &ts.cw_edge_time,
+                                              CW_EDGE_TIME_MIN,
+                                              CW_EDGE_TIME_MAX,
+                                              CW_EDGE_TIME_DEFAULT,
+                                              1
+                                             );
+
+        if(var_change)
+        {
+            CwGen_SetSpeed(); // rebuilds the envelope cache and adjusts element timing
+        }
+        snprintf(options,32, "  %ums", ts.cw_edge_time);
+        break;
+
     case MENU_SIDETONE_GAIN:    // sidetone gain
         var_change = UiDriverMenuItemChangeUInt8(var, mode, &ts.cw_sidetone_gain,
                                               0,
@@ -2095,23 +2141,29 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
         switch(sd.magnify)
         {
         case 1:
-            txt_ptr = " x2";
+            txt_ptr = "  x2";
             break;
         case 2:
-            txt_ptr = " x4";
+            txt_ptr = "  x4";
             break;
         case 3:
-            txt_ptr = " x8";
+            txt_ptr = "  x8";
             break;
         case 4:
-            txt_ptr = "x16";
+            txt_ptr = " x16";
             break;
         case 5:
-            txt_ptr = "x32";
+            txt_ptr = " x32";
+            break;
+        case 6:
+            txt_ptr = " x64";
+            break;
+        case 7:
+            txt_ptr = "x128";
             break;
         case 0:
         default:
-            txt_ptr = " x1";
+            txt_ptr = "  x1";
             break;
         }
         UiDriver_SpectrumChangeLayoutParameters();
@@ -2238,7 +2290,7 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
     case    MENU_DBM_DISPLAY:
         var_change = UiDriverMenuItemChangeUInt8(var, mode, &ts.display_dbm,
                                               0,
-                                              2,
+                                              3,
                                               0,
                                               1
                                              );
@@ -2251,6 +2303,9 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
         case 2: //
             txt_ptr = "  dBm/Hz";       // dbm/Hz display
             break;
+        case 3: //
+            txt_ptr = "dBm peak";       // dbm peak hold display
+            break;
         default:
         txt_ptr =  "     OFF";      // dbm display off
             break;
@@ -3843,7 +3898,7 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
             );
             if(var_change)
             {
-            	leakyLMS.two_mu = leakyLMS.two_mu_int / 1000000;
+            	leakyLMS.two_mu = leakyLMS.two_mu_int / 1000000.0;
             }
             snprintf(options, 32, " %4u",(unsigned int)leakyLMS.two_mu_int);
 
@@ -3857,23 +3912,20 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
             );
             if(var_change)
             {
-            	leakyLMS.gamma = leakyLMS.gamma_int / 1000;
+            	leakyLMS.gamma = leakyLMS.gamma_int / 1000.0;
             }
             snprintf(options, 32, " %4u",(unsigned int)leakyLMS.gamma_int);
 
         break;
 
         case MENU_DEBUG_ANR_TAPS:      //
+            // taps, delay and one block of samples have to fit into the delay line
             var_change = UiDriverMenuItemChangeInt16(var, mode, &leakyLMS.n_taps,
                     1,
-                    192,
+                    LEAKYLMSDLINE_SIZE - LEAKYLMS_BLOCK_SIZE - leakyLMS.delay,
                     64,
                     2
             );
-            if(var_change)
-            {
-//            	leakyLMS.gamma = leakyLMS.gamma_int / 1000;
-            }
             snprintf(options, 32, " %3u",(unsigned int)leakyLMS.n_taps);
 
         break;
@@ -3884,9 +3936,9 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
                     16,
                     2
             );
-            if(var_change)
+            if(var_change && leakyLMS.n_taps > LEAKYLMSDLINE_SIZE - LEAKYLMS_BLOCK_SIZE - leakyLMS.delay)
             {
-//            	leakyLMS.gamma = leakyLMS.gamma_int / 1000;
+                leakyLMS.n_taps = LEAKYLMSDLINE_SIZE - LEAKYLMS_BLOCK_SIZE - leakyLMS.delay;
             }
             snprintf(options, 32, " %3u",(unsigned int)leakyLMS.delay);
 
@@ -4135,21 +4187,14 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
         //     case MENU_DEBUG_NEW_NB:
         //         var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &ts.new_nb,0,options,&clr);
         //         break;//
-//#if defined(STM32F7) || defined(STM32H7)
-/*     case MENU_DEBUG_NR_FFT_SIZE:
-                 var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &nr_params.fft_256_enable,0,options,&clr);
-                 ts.NR_FFT_L = 128;
-                 ts.NR_FFT_LOOP_NO = 2;
-                 if(nr_params.fft_256_enable)
-                 {
-                	 ts.NR_FFT_LOOP_NO = 1;
-                	 ts.NR_FFT_L = 256;
-                 }
-        break;
+     case MENU_DEBUG_NR_FFT_SIZE:
+         // the NR engine picks up the new FFT size with the next buffer and restarts itself
+         var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &nr_params.fft_256_enable,0,options,&clr);
+         break;
      case MENU_DEBUG_NR_DEC_ENABLE:
-                 var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &ts.NR_decimation_enable,0,options,&clr);
-        break;
-//#endif
+         var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &nr_params.NR_decimation_enable,0,options,&clr);
+         break;
+/*
 //     case MENU_DEBUG_NR_ENABLE:
 //             var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &nr_params.enable,0,options,&clr);
 //         break;
@@ -4393,6 +4438,33 @@ void UiMenu_UpdateItem(uint16_t select, MenuProcessingMode_t mode, int pos, int
             var_change = UiDriverMenuItemChangeEnableOnOffFlag(var, mode, &ts.expflags1,0,options,&clr, EXPFLAGS1_SMOOTH_DYNAMIC_TUNE);
             clr = White;
             break;
+        case MENU_DEBUG_PSK_AFC:
+            var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &psk_ctrl_config.afc_enable,1,options,&clr);
+            break;
+        case MENU_DEBUG_PSK_PANORAMA:
+            var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &psk_ctrl_config.panorama_enable,0,options,&clr);
+            if (var_change)
+            {
+                // restart all channels so that the panorama starts searching from scratch
+                Psk_Modem_Init(ts.samp_rate);
+            }
+            break;
+        case MENU_DEBUG_TX_DPD:
+            temp_var_bool = TxDpd_IsEnabled();
+            var_change = UiDriverMenuItemChangeEnableOnOffBool(var, mode, &temp_var_bool, 0, options, &clr);
+            TxDpd_SetEnable(temp_var_bool);
+            break;
+        case MENU_DEBUG_TX_DPD_RESET:
+            txt_ptr = " Do it!";
+            clr = White;
+            if(var>=1)
+            {
+                TxDpd_ResetBand(ts.band->band_mode);
+                txt_ptr = "   Done";
+                var = 1;
+                clr = Green;
+            }
+            break;
 
     default:                        // Move to this location if we get to the bottom of the table!
         txt_ptr = "ERROR!";
@@ -279,10 +279,8 @@ enum
 //	MENU_DEBUG_NR_VAD_DELAY,
 	MENU_DEBUG_NR_BETA,
 //	MENU_DEBUG_NR_Mode,
-//#if defined(STM32F7) || defined(STM32H7)
-//	MENU_DEBUG_NR_FFT_SIZE,
-//	MENU_DEBUG_NR_DEC_ENABLE,
-//#endif
+	MENU_DEBUG_NR_FFT_SIZE,
+	MENU_DEBUG_NR_DEC_ENABLE,
 	MENU_DEBUG_NR_ASNR,
 	MENU_DEBUG_NR_GAIN_SMOOTH_WIDTH,
 	MENU_DEBUG_NR_GAIN_SMOOTH_THRESHOLD,
@@ -291,11 +289,13 @@ enum
 	MENU_DEBUG_ENABLE_STEREO,
 #endif
 	//	MENU_DEBUG_CW_DECODER,
-//	MENU_DEBUG_LEAKY_LMS,
-//	MENU_DEBUG_ANR_TAPS,
-//	MENU_DEBUG_ANR_DELAY,
-//	MENU_DEBUG_ANR_GAIN,
-//	MENU_DEBUG_ANR_LEAK,
+#ifdef USE_LEAKY_LMS
+	MENU_DEBUG_LEAKY_LMS,
+	MENU_DEBUG_ANR_TAPS,
+	MENU_DEBUG_ANR_DELAY,
+	MENU_DEBUG_ANR_GAIN,
+	MENU_DEBUG_ANR_LEAK,
+#endif
 	MENU_DEBUG_OSC_SI5351_PLLRESET,
 	MENU_DEBUG_HMC1023_COARSE,
 	MENU_DEBUG_HMC1023_FINE,
@@ -319,6 +319,13 @@ enum
     CONFIG_SMETER_ATTACK,
     CONFIG_SMETER_DECAY,
     MENU_DEBUG_SMOOTH_DYN_TUNE,
+    MENU_DEBUG_PSK_AFC,
+    MENU_DEBUG_PSK_PANORAMA,
+    MENU_DEBUG_TX_DPD,
+    MENU_DEBUG_TX_DPD_RESET,
+    MENU_TX_MBC_PRESET,
+    MENU_CW_EDGE_SHAPE,
+    MENU_CW_EDGE_TIME,
     MAX_RADIO_CONFIG_ITEM   // Number of radio configuration menu items - This must ALWAYS remain as the LAST item!
 };
 
@@ -28,11 +28,18 @@
 
 #include "uhsdr_hw_i2c.h"
 #include "uhsdr_rtc.h"
+#include "tx_dpd.h"
+#include "tx_mbc.h"
+#include "cw_gen.h"
 
 #if (MAX_VAR_ADDR > NB_OF_VAR)
     #error "Too many eeprom variables defined in ui_configuration.h (MAX_VAR_ADDR > NB_OF_VAR ). Please change maximum number of vars in eeprom.h"
 #endif
 
+#if (TX_DPD_BANDS != MAX_BANDS)
+    #error "TX_DPD_BANDS must match the number of tx bands, the predistortion tables are stored per band"
+#endif
+
 
 static int32_t UiConfiguration_CompareConfigBuildVersions(uint major, uint32_t minor, uint32_t release);
 
@@ -75,6 +82,8 @@ const ConfigEntryDescriptor ConfigEntryInfo[] =
     { ConfigEntry_UInt8, EEPROM_CW_KEYER_SPEED,&ts.cw_keyer_speed,CW_KEYER_SPEED_DEFAULT,CW_KEYER_SPEED_MIN, CW_KEYER_SPEED_MAX},
     { ConfigEntry_UInt8, EEPROM_CW_KEYER_MODE,&ts.cw_keyer_mode,CW_KEYER_MODE_IAM_B, 0, CW_KEYER_MAX_MODE},
     { ConfigEntry_UInt8, EEPROM_CW_KEYER_WEIGHT,&ts.cw_keyer_weight,CW_KEYER_WEIGHT_DEFAULT, CW_KEYER_WEIGHT_MIN, CW_KEYER_WEIGHT_MAX},
+    { ConfigEntry_UInt8, EEPROM_CW_EDGE_SHAPE,&ts.cw_edge_shape,CW_EDGE_SHAPE_BLACKMAN_HARRIS, 0, CW_EDGE_SHAPE_NUM-1},
+    { ConfigEntry_UInt8, EEPROM_CW_EDGE_TIME,&ts.cw_edge_time,CW_EDGE_TIME_DEFAULT, CW_EDGE_TIME_MIN, CW_EDGE_TIME_MAX},
     { ConfigEntry_UInt8, EEPROM_CW_SIDETONE_GAIN,&ts.cw_sidetone_gain,DEFAULT_SIDETONE_GAIN,0, SIDETONE_MAX_GAIN},
     { ConfigEntry_Int32_16 | Calib_Val, EEPROM_FREQ_CAL,&ts.freq_cal,0,MIN_FREQ_CAL,MAX_FREQ_CAL}, // MINOR INT DEFAULT PROBLEM
     { ConfigEntry_UInt8, EEPROM_AGC_WDSP_MODE,&agc_wdsp_conf.mode, 2,0,5},
@@ -159,6 +168,7 @@ const ConfigEntryDescriptor ConfigEntryInfo[] =
 #endif
 	//   { ConfigEntry_UInt8, EEPROM_MAX_RX_GAIN,&ts.max_rf_gain,MAX_RF_GAIN_DEFAULT,0,MAX_RF_GAIN_MAX},
     { ConfigEntry_Int16, EEPROM_TX_AUDIO_COMPRESS,&ts.tx_comp_level,TX_AUDIO_COMPRESSION_DEFAULT,TX_AUDIO_COMPRESSION_MIN,TX_AUDIO_COMPRESSION_MAX}, // NO INT DEFAULT PROBLEM
+    { ConfigEntry_UInt8, EEPROM_TX_MBC_PRESET,&ts.tx_mbc_preset,TX_MBC_PRESET_DEFAULT,0,TX_MBC_PRESET_NUM-1},
     { ConfigEntry_UInt8, EEPROM_TX_DISABLE,&ts.tx_disable,0,0,1},
     { ConfigEntry_UInt16, EEPROM_FLAGS1,&ts.flags1,FLAGS1_CONFIG_DEFAULT,0,0xffff},
     { ConfigEntry_UInt16, EEPROM_FLAGS2,&ts.flags2,FLAGS2_CONFIG_DEFAULT,0,0xffff},
@@ -202,7 +212,7 @@ const ConfigEntryDescriptor ConfigEntryInfo[] =
     { ConfigEntry_UInt8, EEPROM_CAT_XLAT,&ts.xlat,1,0,1},
     { ConfigEntry_UInt32_16, EEPROM_MANUAL_NOTCH,&ts.dsp.notch_frequency,800,200,5000},
     { ConfigEntry_UInt32_16, EEPROM_MANUAL_PEAK,&ts.dsp.peak_frequency,750,200,5000},
-    { ConfigEntry_UInt8, EEPROM_DISPLAY_DBM,&ts.display_dbm,0,0,2},
+    { ConfigEntry_UInt8, EEPROM_DISPLAY_DBM,&ts.display_dbm,0,0,3},
     { ConfigEntry_Int32_16 | Calib_Val, EEPROM_DBM_CALIBRATE,&ts.dbm_constant,0,-100,100}, // MINOR INT DEFAULT PROBLEM,see above
 //    { ConfigEntry_UInt8, EEPROM_S_METER,&ts.s_meter,0,0,2},
     { ConfigEntry_UInt8, EEPROM_DIGI_MODE_CONF,&ts.digital_mode,DigitalMode_None,0,DigitalMode_Num_Modes-1},
@@ -930,8 +940,10 @@ void UiConfiguration_LoadEepromValues(bool load_freq_mode_defaults, bool load_ee
     UiReadSettingEEPROM_Filter(load_eeprom_defaults);
 
     ConfigStorage_CopySerial2Array(EEPROM_KEYER_MEMORY_ADDRESS, (uint8_t *)ts.keyer_mode.macro, sizeof(ts.keyer_mode.macro));
+    ConfigStorage_CopySerial2Array(EEPROM_TX_DPD_ADDRESS, (uint8_t *)&tx_dpd_store, sizeof(tx_dpd_store));
 
     // post configuration loading actions below
+    TxDpd_Init(); // validates the loaded predistortion tables
     df.tuning_step  = tune_steps[df.selected_idx];
     ts.tx_gain[TX_AUDIO_LINEIN_R] = ts.tx_gain[TX_AUDIO_LINEIN_L];
 
@@ -1039,6 +1051,11 @@ uint16_t UiConfiguration_SaveEepromValues(void)
 
         retval = ConfigStorage_CopyArray2Serial(EEPROM_KEYER_MEMORY_ADDRESS, (uint8_t *)ts.keyer_mode.macro, sizeof(ts.keyer_mode.macro));
 
+        if (retval == HAL_OK)
+        {
+            retval = ConfigStorage_CopyArray2Serial(EEPROM_TX_DPD_ADDRESS, (uint8_t *)&tx_dpd_store, sizeof(tx_dpd_store));
+        }
+
     }
     return retval;
 }
@@ -88,7 +88,7 @@ uint16_t    UiConfiguration_SaveEepromValues(void);
 #define MAX_VOLUME_YELLOW_THRESH  16  // "MAX VOLUME" setting at or below which number will be YELLOW to warn user
 
 #define MAGNIFY_MIN                 0
-#define MAGNIFY_MAX                 5
+#define MAGNIFY_MAX                 7
 #define MAGNIFY_DEFAULT             0
 #define MAGNIFY_NUM                 (MAGNIFY_MAX+1)
 
@@ -612,7 +612,10 @@ uint16_t    UiConfiguration_SaveEepromValues(void);
 #define EEPROM_XVERTER_OFFSET_TX_LOW                429     // Secondary frequency by which the display is offset for transverter use, low word
 #define EEPROM_CW_DECODER_FLAGS                     430     // Various flags controlling operation of CW decoder
 #define EEPROM_BAND_REGION                          431     // store which region the TRX is being used in
-#define EEPROM_FIRST_UNUSED                         432		// change this if new value ids are introduced, must be correct at any time
+#define EEPROM_TX_MBC_PRESET                        432     // multiband tx speech processor preset
+#define EEPROM_CW_EDGE_SHAPE                        433     // shape of the cw keying envelope
+#define EEPROM_CW_EDGE_TIME                         434     // rise/fall time of the cw keying envelope in ms
+#define EEPROM_FIRST_UNUSED                         435		// change this if new value ids are introduced, must be correct at any time
 
 #define MAX_VAR_ADDR (EEPROM_FIRST_UNUSED - 1)
 
@@ -620,5 +623,6 @@ uint16_t    UiConfiguration_SaveEepromValues(void);
 // need to modify virtual EEPROM routines otherwise system may crash
 
 #define EEPROM_KEYER_MEMORY_ADDRESS		0x1000
+#define EEPROM_TX_DPD_ADDRESS			0x1400 // per band tx predistortion tables, see TxDpd_Store_t
 
 #endif /* DRIVERS_UI_UI_CONFIGURATION_H_ */
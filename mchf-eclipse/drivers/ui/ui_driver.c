@@ -28,6 +28,7 @@
 #include "adc.h"
 #include "drivers/ui/oscillator/osc_si5351a.h"
 #include "audio_nr.h"
+#include "audio_tap.h"
 #include "uhsdr_keypad.h"
 #include "serial_eeprom.h"
 #include "ui.h"
@@ -64,6 +65,8 @@
 
 #include "audio_convolution.h"
 #include "audio_agc.h"
+#include "uhsdr_math.h"
+#include "band_sweep.h"
 
 #define SPLIT_ACTIVE_COLOUR         		Yellow      // colour of "SPLIT" indicator when active
 #define SPLIT_INACTIVE_COLOUR           	Grey        // colour of "SPLIT" indicator when NOT active
@@ -87,6 +90,7 @@ static void		UiDriver_TimeScheduler();				// Also handles audio gain and switchi
 static void 	UiDriver_ChangeToNextDemodMode(bool select_alternative_mode);
 static void 	UiDriver_ChangeBand(bool is_up);
 static bool 	UiDriver_CheckFrequencyEncoder();
+static bool 	UiDriver_StopBandSweep();
 
 static void     UiDriver_DisplayBand(const BandInfo* band);
 static void     UiDriver_DisplayBandForFreq(uint32_t freq);
@@ -768,6 +772,9 @@ void UiDriver_FrequencyUpdateLOandDisplay(bool full_update)
 	}
 }
 
+// the FreeDV tx statistics "Unnn nnnms", the NR peak load "NR pk nnn%" or the UI statistics "Snn.n nnnn" are shown left of the load display
+#define UI_DRIVER_STATS_DEBUG_W (11 * 8)
+
 void UiDriver_DebugInfo_DisplayEnable(bool enable)
 {
 
@@ -776,6 +783,7 @@ void UiDriver_DebugInfo_DisplayEnable(bool enable)
 	if (enable == false)
 	{
 		UiLcdHy28_PrintText(ts.Layout->LOAD_X,ts.Layout->LOADANDDEBUG_Y,"     ",White,Black,0);
+		UiLcdHy28_PrintText(ts.Layout->LOAD_X - UI_DRIVER_STATS_DEBUG_W,ts.Layout->LOADANDDEBUG_Y,"          ",White,Black,0);
 	}
 
 	ts.show_debug_info = enable;
@@ -3380,6 +3388,7 @@ static bool UiDriver_CheckFrequencyEncoder()
 		ts.audio_int_counter = 0;		 //reset tick counter
 
 		UiDriver_LcdBlankingStartTimer();	// calculate/process LCD blanking timing
+		UiDriver_StopBandSweep();
 
 	}
 	if (pot_diff != 0 &&
@@ -3514,6 +3523,7 @@ static void UiDriver_CheckEncoderOne()
 		int8_t pot_diff_step = pot_diff < 0?-1:1;
 
 		UiDriver_LcdBlankingStartTimer();	// calculate/process LCD blanking timing
+		UiDriver_StopBandSweep();
 		// Take appropriate action
 		switch(ts.enc_one_mode)
 		{
@@ -3565,6 +3575,7 @@ static void UiDriver_CheckEncoderTwo()
 	if (pot_diff != 0)
 	{
 		UiDriver_LcdBlankingStartTimer();	// calculate/process LCD blanking timing
+		UiDriver_StopBandSweep();
 
 		if(ts.menu_mode)
 		{
@@ -3845,6 +3856,7 @@ static void UiDriver_CheckEncoderThree()
 		int8_t pot_diff_step = pot_diff < 0?-1:1;
 
 		UiDriver_LcdBlankingStartTimer();	// calculate/process LCD blanking timing
+		UiDriver_StopBandSweep();
 		if (filter_path_change)
 		{
 			AudioFilter_NextApplicableFilterPath(PATH_ALL_APPLICABLE | (pot_diff < 0?PATH_DOWN:PATH_UP),AudioFilter_GetFilterModeFromDemodMode(ts.dmod_mode),ts.filter_path);
@@ -4494,7 +4506,7 @@ static void UiDriver_DisplayModulationType()
 #if defined(USE_FREEDV)
 	    if  (ts.digital_mode == DigitalMode_FreeDV)
 	    {
-	        txt = freedv_modes[freedv_conf.mode].label;
+	        txt = FreeDV_Get_ModeLabel();
 	    }
 	    else
 #endif
@@ -4601,6 +4613,11 @@ static void UiDriver_DisplayDbm()
             val = sm.dbmhz;
             unit_label = "dBm/Hz";
             break;
+        case DISPLAY_S_METER_DBM_PEAK:
+            display_something = true;
+            val = sm.dbm_peak;
+            unit_label = "dBm pk";
+            break;
         }
 
         if ((display_something == true) && (val!=oldVal))
@@ -4632,6 +4649,39 @@ void RadioManagement_HandleIqGainAndSMeter()
     {
         RadioManagement_HandleRxIQSignalCodecGain();
 
+        // the passband power meter in the audio driver publishes a new result every 1/PASSBAND_METER_RATE seconds,
+        // we are called less often and simply take the latest one.
+        // The powers are relative to the codec output, so we take out the codec gain
+        float32_t power, peak_power;
+        if (AudioDriver_PassbandMeterRead(&power, &peak_power))
+        {
+            const float32_t gain_inv = 1.0 / ads.codec_gain_calc;
+            const float32_t gain2_inv = gain_inv * gain_inv;
+            const float32_t cons = PASSBAND_METER_DBM_OFFSET + ts.dbm_constant;
+
+            sm.dbm_cur = power > 0 ? 10 * Math_log10f_fast(power * gain2_inv) + cons : -145.0;
+            sm.dbm_peak_cur = peak_power > 0 ? 10 * Math_log10f_fast(peak_power * gain2_inv) + cons : -145.0;
+
+            // peak hold: a higher peak is taken at once, otherwise the last one is held for a while
+            if (sm.dbm_peak_cur >= sm.dbm_peak || sm.dbm_peak_hold == 0)
+            {
+                sm.dbm_peak = sm.dbm_peak_cur;
+                sm.dbm_peak_hold = SMETER_PEAK_HOLD_INTERVALS;
+            }
+            else
+            {
+                sm.dbm_peak_hold--;
+            }
+
+            // the bandwidth the power has been measured in
+            float32_t width = FilterInfo[ts.filters_p->id].width;
+            if (RadioManagement_UsesBothSidebands(ts.dmod_mode))
+            {
+                width *= 2;
+            }
+            sm.dbmhz_cur = sm.dbm_cur - 10 * Math_log10f_fast(width);
+        }
+
         // lowpass IIR filter
         // Wheatley 2011: two averagers with two time constants
         // IIR filter with one element analog to 1st order RC filter
@@ -6419,7 +6469,7 @@ void UiAction_ChangeFrequencyByTouch()
 		{
 			step = 10;					// adjust to 10Hz
 		}
-		if(sd.magnify == 5)
+		if(sd.magnify >= 5)
 		{
 			step = 1;					// adjust to 1Hz
 		}
@@ -6507,6 +6557,29 @@ static void UiAction_ChangeBacklightBrightness()
 	incr_wrap_uint8(&ts.lcd_backlight_brightness,LCD_DIMMING_LEVEL_MIN,LCD_DIMMING_LEVEL_MAX);
 }
 
+/**
+ * Stops a running band sweep, to be called on any user input
+ * @return true if a sweep has been stopped
+ */
+static bool UiDriver_StopBandSweep()
+{
+	bool retval = BandSweep_IsActive();
+	if (retval)
+	{
+		BandSweep_Stop();
+		UiDriver_FButton_F5Tune();
+	}
+	return retval;
+}
+
+static void UiAction_ToggleBandSweep()
+{
+	if (UiDriver_StopBandSweep() == false && BandSweep_Start())
+	{
+		UiDriver_FButton_F5Tune();		// tx is disabled while sweeping
+	}
+}
+
 static void UiAction_ToggleTxDisable()
 {
 	if(ts.txrx_mode == TRX_MODE_RX)			// do NOT allow mode change in TUNE mode or transmit mode
@@ -7010,7 +7083,7 @@ static const keyaction_descr_t keyactions_normal[] =
 		{ BUTTON_F5_PRESSED, 	UiAction_ToggleTuneMode,					UiAction_ToggleTxDisable },
 		{ BUTTON_G1_PRESSED, 	UiAction_ChangeDemodMode,					UiAction_ChangeDemodModeToAlternativeMode },
 		{ BUTTON_G2_PRESSED, 	UiAction_ChangeToNextDspMode,				UiAction_ToggleDspEnable },
-		{ BUTTON_G3_PRESSED, 	UiAction_ChangePowerLevel,					KEYACTION_NOP },
+		{ BUTTON_G3_PRESSED, 	UiAction_ChangePowerLevel,					UiAction_ToggleBandSweep },
 		{ BUTTON_G4_PRESSED, 	UiAction_ChangeFilterBW,					UiAction_ChangeRxFilterOrFmToneBurst },
 		{ BUTTON_M1_PRESSED, 	UiDriver_ChangeEncoderOneMode,				UiAction_ToggleKeyerMode },
 		{ BUTTON_M2_PRESSED, 	UiDriver_ChangeEncoderTwoMode,				UiAction_ToggleNoiseblanker },
@@ -7053,8 +7126,9 @@ static void UiDriver_HandleKeyboard()
 		UiDriver_LcdBlankingStartTimer();	// calculate/process LCD blanking timing
 		AudioManagement_KeyBeep();  // make keyboard beep, if enabled
 
-		bool keyIsProcessed = false;
-		if (ts.keyer_mode.active == true)
+		// a key press only ends a band sweep
+		bool keyIsProcessed = UiDriver_StopBandSweep();
+		if (keyIsProcessed == false && ts.keyer_mode.active == true)
 		{
 			keyIsProcessed = UiDriver_ProcessKeyActions(&key_sets[2]);
 		}
@@ -7169,12 +7243,13 @@ void UiDriver_TaskHandler_HighPrioTasks()
 #endif // USE_FREEDV
 
 #ifdef USE_ALTERNATE_NR
-        if ((is_dsp_nb_active() || is_dsp_nr()) && (ads.decimated_freq == 12000))
+        if (is_dsp_nb_active() || is_dsp_nr())
         {
 
             AudioNr_HandleNoiseReduction();
         }
 #endif
+        AudioTap_ProcessDeferred();
     }
 #ifdef USE_HIGH_PRIO_PTT
     if (RadioManagement_SwitchTxRx_Possible())
@@ -7417,6 +7492,7 @@ void UiDriver_TaskHandler_MainTasks()
 #ifndef USE_HIGH_PRIO_PTT
 		RadioManagement_HandlePttOnOff();
 #endif
+		BandSweep_Process();
 		RadioManagement_UpdatePowerAndVSWR();
 		RadioManagement_TxRxSwitching_Enable();
 		if (ts.twinpeaks_tested == TWINPEAKS_CODEC_RESTART)
@@ -7428,6 +7504,7 @@ void UiDriver_TaskHandler_MainTasks()
 	}
 
 	UiSpectrum_Redraw();
+	UiSpectrum_CalculateSnap();
 
 	// Expect the code below to be executed around every 40 - 80ms.
 	// The exact time between two calls is unknown and varies with different
@@ -7442,12 +7519,17 @@ void UiDriver_TaskHandler_MainTasks()
 		    // we update all the meters (either TX or RX) no more than 25 times a second
 			if (UiDriver_TimerExpireAndRewind(SCTimer_SMETER,now,4))
 			{
+				profileTimedEventStart(ProfileUiMeters);
 	            UiDriver_HandleTXMeters();
 	            RadioManagement_HandleIqGainAndSMeter();
 				UiDriver_HandleSMeter();
+				profileTimedEventStop(ProfileUiMeters);
 #ifdef USE_FREEDV
 				if (ts.dmod_mode == DEMOD_DIGI && ts.digital_mode == DigitalMode_FreeDV)
 				{
+#ifdef FDV_MODE_AUTO
+				    FreeDv_HandleAutoSwitch();
+#endif
 			        FreeDv_DisplayUpdate();
 				}
 #endif // USE_FREEDV
@@ -7487,6 +7569,7 @@ void UiDriver_TaskHandler_MainTasks()
 
 				uint32_t load =  pe_ptr->duration / (pe_ptr->count * (1120));
 				profileTimedEventReset(ProfileAudioInterrupt);
+				profileUiStatsUpdate();
 				char str[20];
 				snprintf(str,20,"L%3u%%",(unsigned int)load);
 				if(ts.show_debug_info)
@@ -7494,6 +7577,38 @@ void UiDriver_TaskHandler_MainTasks()
 					UiLcdHy28_PrintText(ts.Layout->LOAD_X,ts.Layout->LOADANDDEBUG_Y,str,White,Black,0);
 				}
 #endif
+				uint32_t tap_overruns = 0;
+				const char* tap_name = AudioTap_GetDeferredOverruns(&tap_overruns);
+#ifdef USE_FREEDV
+				if(ts.show_debug_info && ts.dvmode == true && ts.digital_mode == DigitalMode_FreeDV)
+				{
+					// FreeDV tx underruns and the current lead-in in ms (8 modem samples per ms)
+					snprintf(str,20,"U%3u %3ums",(unsigned int)(freedv_tx_stats.underruns % 1000),(unsigned int)(freedv_tx_stats.lead_in / 8));
+					UiLcdHy28_PrintText(ts.Layout->LOAD_X - UI_DRIVER_STATS_DEBUG_W,ts.Layout->LOADANDDEBUG_Y,str,White,Black,0);
+				}
+				else
+#endif
+				if(ts.show_debug_info && tap_name != NULL)
+				{
+					// how often the decoder running outside the audio interrupt fell behind and lost audio
+					snprintf(str,20,"%-4.4s ov%3u",tap_name,(unsigned int)(tap_overruns % 1000));
+					UiLcdHy28_PrintText(ts.Layout->LOAD_X - UI_DRIVER_STATS_DEBUG_W,ts.Layout->LOADANDDEBUG_Y,str,White,Black,0);
+				}
+				else if(ts.show_debug_info && is_dsp_nr() && nr_params.cycles_budget != 0)
+				{
+					// longest spectral NR run since the last update in percent of the time until the next NR buffer is complete
+					uint64_t nr_load = (uint64_t)nr_params.cycles_peak * 100 / nr_params.cycles_budget;
+					snprintf(str,20,"NR pk %3u%%",(unsigned int)(nr_load > 999 ? 999 : nr_load));
+					UiLcdHy28_PrintText(ts.Layout->LOAD_X - UI_DRIVER_STATS_DEBUG_W,ts.Layout->LOADANDDEBUG_Y,str,White,Black,0);
+					nr_params.cycles_peak = 0;
+				}
+				else if(ts.show_debug_info)
+				{
+					// average duration of a scope/waterfall update in ms and the LCD data rate in kB/s
+					const ProfileUiStats_t* ui_stats = &eventProfile.ui_stats;
+					snprintf(str,20,"S%2u.%1u %4u",(unsigned int)(ui_stats->spectrum_us / 1000) % 100,(unsigned int)(ui_stats->spectrum_us / 100) % 10,(unsigned int)(ui_stats->lcd_bytes_per_s / 1000) % 10000);
+					UiLcdHy28_PrintText(ts.Layout->LOAD_X - UI_DRIVER_STATS_DEBUG_W,ts.Layout->LOADANDDEBUG_Y,str,White,Black,0);
+				}
 			}
 			if (UiDriver_TimerExpireAndRewind(SCTimer_RTC,now,100))
 			{
@@ -7527,7 +7642,7 @@ void UiDriver_TaskHandler_MainTasks()
 				RadioManagement_TxRxSwitching_Enable();
 				UiDriver_DisplayMemoryLabel();				// this is because a frequency dialing via CAT must be indicated if "CAT in sandbox" is active
 			}
-			else if (df.temp_factor_changed  || ts.tune_freq != ts.tune_freq_req)
+			else if ((df.temp_factor_changed  || ts.tune_freq != ts.tune_freq_req) && BandSweep_IsActive() == false) // the band sweep owns the LO while it runs
 			{
 				// this handles the cases where the dial frequency remains the same but the
 				// LO tune frequency needs adjustment, e.g. in CW mode  or if temp of LO changes
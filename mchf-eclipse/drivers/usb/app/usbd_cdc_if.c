@@ -353,6 +353,32 @@ uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len)
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  CDC_Transmit_Free_FS
+  *         Number of bytes which can be passed to CDC_Transmit_FS without
+  *         overwriting data which has not been sent yet.
+  *         @note
+  *         CDC_Transmit_FS itself does not check this, callers which may
+  *         produce more data than the host reads (e.g. streaming) must do it.
+  *         The packet currently in transfer is still read by the USB hardware,
+  *         so it counts as used.
+  *
+  * @retval number of free bytes in the transmit buffer
+  */
+uint16_t CDC_Transmit_Free_FS(void)
+{
+  const uint32_t ptr_out = CDC_Tx_PtrOut % APP_TX_DATA_SIZE;
+  int32_t free_bytes = (int32_t)ptr_out - (int32_t)CDC_Tx_PtrIn - 1;
+
+  if (free_bytes < 0)
+  {
+      free_bytes += APP_TX_DATA_SIZE;
+  }
+
+  free_bytes -= CDC_DATA_FS_IN_PACKET_SIZE;
+
+  return free_bytes < 0 ? 0 : free_bytes;
+}
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
 /**
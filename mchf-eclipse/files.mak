@@ -36,6 +36,7 @@ drivers/ui/lcd/ui_lcd_hy28_fonts.c \
 drivers/ui/lcd/ui_spectrum.c \
 drivers/ui/encoder/ui_rotary.c \
 drivers/ui/radio_management.c \
+drivers/ui/band_sweep.c \
 drivers/ui/ui_configuration.c \
 drivers/ui/ui_driver.c \
 drivers/freedv/c2wideband.c \
@@ -93,12 +94,14 @@ drivers/freedv/quantise.c \
 drivers/freedv/sine.c \
 drivers/freedv/varicode.c \
 drivers/cat/cat_driver.c \
+drivers/cat/cat_spectrum.c \
 drivers/audio/softdds/dds_table.c \
 drivers/audio/softdds/softdds.c \
 drivers/audio/filters/fir_rx_decimate_4.c \
 drivers/audio/filters/fir_rx_decimate_4_min_lpf.c \
 drivers/audio/filters/fir_rx_interpolate_16.c \
 drivers/audio/filters/fir_rx_interpolate_16_10kHz.c \
+drivers/audio/filters/fir_zoom_fft_decimate.c \
 drivers/audio/filters/iir_10k.c \
 drivers/audio/filters/iir_10k_neu.c \
 drivers/audio/filters/iir_15k_hpf_fm_squelch.c \
@@ -149,12 +152,18 @@ drivers/audio/audio_driver.c \
 drivers/audio/audio_filter.c \
 drivers/audio/audio_convolution.c \
 drivers/audio/audio_nr.c \
+drivers/audio/audio_tap.c \
 drivers/audio/audio_management.c \
 drivers/audio/freedv_uhsdr.c \
 drivers/audio/freedv_test_data.c \
 drivers/audio/freq_shift.c \
+drivers/audio/zoom_decimate.c \
+drivers/audio/snap_estimator.c \
+drivers/audio/rx_q15.c \
 drivers/audio/rtty.c \
 drivers/audio/psk.c \
+drivers/audio/tx_dpd.c \
+drivers/audio/tx_mbc.c \
 drivers/audio/rb.c \
 drivers/audio/tx_processor.c \
 drivers/ui/lcd/ui_lcd_layouts.c \
@@ -388,6 +388,12 @@ typedef struct TransceiverState
 #define CW_KEYER_WEIGHT_MAX     (150)
 #define CW_KEYER_WEIGHT_MIN      (50)
 
+    uint8_t cw_edge_shape;     // keying envelope shape, see CwGen_EdgeShape_t
+    uint8_t cw_edge_time;      // keying envelope rise and fall time in ms
+#define CW_EDGE_TIME_DEFAULT     (5)
+#define CW_EDGE_TIME_MAX         (10)
+#define CW_EDGE_TIME_MIN         (2)
+
     uint8_t cw_rx_delay; // break time
 #define CW_TX2RX_DELAY_DEFAULT     8
 #define CW_RX_DELAY_MAX         50  // Maximum TX to RX turnaround setting
@@ -416,6 +422,7 @@ typedef struct TransceiverState
     uint32_t	tx_mic_gain_mult;
     uint8_t	tx_gain[TX_AUDIO_NUM];
     int16_t	tx_comp_level;			// Used to hold compression level which is used to calculate other values for compression.  0 = manual.
+    uint8_t	tx_mbc_preset;			// multiband speech processor preset, 0 = off, classic ALC is used
 
     // Global tuning flag - in every demod mode
     uint8_t 	tune;
@@ -503,6 +510,7 @@ typedef struct TransceiverState
 #define TX_DISABLE_USER         2
 #define TX_DISABLE_OUTOFRANGE	4
 #define TX_DISABLE_RXMODE       8
+#define TX_DISABLE_SWEEP        16
     uint8_t	tx_disable;		// >0 if no transmit permitted, use RadioManagement_IsTxDisabled() to get boolean
 
     uint16_t	flags1;					// Used to hold individual status flags, stored in EEPROM location "EEPROM_FLAGS1"
@@ -657,6 +665,7 @@ typedef struct TransceiverState
 //#define DISPLAY_S_METER_STD   0
 #define DISPLAY_S_METER_DBM   1
 #define DISPLAY_S_METER_DBMHZ 2
+#define DISPLAY_S_METER_DBM_PEAK 3
 
 //    #define TX_FILTER_NONE			0
     #define TX_FILTER_SOPRANO		1
@@ -96,6 +96,12 @@
 // leave this switched on, until we have a new autonotch filter approach
 #define USE_LMS_AUTONOTCH
 
+// leaky LMS noise reduction and autonotch, selectable in the debug menu instead of the CMSIS LMS
+// needs about 3kB of RAM for its delay line and coefficients, which the STM32F4 builds cannot spare
+#if defined(STM32F7) || defined(STM32H7)
+#define USE_LEAKY_LMS
+#endif
+
 // save processor time for the STM32F4
 // changes lowpass decimation filters to 89 taps instead of 199 taps
 // because they run at 48ksps, this is a considerable decrease in processing power
@@ -103,6 +109,17 @@
 //#define USE_SMALL_HILBERT_DECIMATION_FILTERS
 #endif
 
+// save processor time for the STM32F4
+// runs decimation and Hilbert filter of the SSB/CW receiver
+// with the CMSIS Q15 functions, which make use of the dual 16bit MAC instructions of the Cortex-M4
+// reduces the dynamic range of this part of the receive path to 16 bits: the truncated filter outputs
+// add about 0.5 LSB rms of noise, which raises the audio noise floor by ~3dB if the receiver noise
+// at the codec is only ~1 LSB (quiet band), and by less than 0.3dB from 4 LSB on, see "make rx-q15-test"
+// therefore not enabled by default, use it if the F4 runs out of processor time
+#ifdef STM32F4
+//#define USE_RX_Q15
+#endif
+
 // save processor time for the STM32F4
 // changes lowpass decimation filters to 89 taps instead of 199 taps
 // because they run at 48ksps, this is a considerable decrease in processing power
@@ -0,0 +1,1056 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     freedv_bench.c                                                  **
+ **  Description:   host benchmark of the FreeDV / codec2 modes used by the firmware**
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It runs the FreeDV encoder and decoder of the modes
+ * we use (1600 and 700D) on the build host and reports
+ *
+ * - time per frame for freedv_comptx and freedv_rx (the calls used by freedv_uhsdr.c)
+ * - heap high water mark of a mode (codec2 allocates all its state with malloc at freedv_open)
+ * - time spent in the FFTs, nlp, newamp1 and the LDPC decoder (inclusive, nlp contains its FFTs)
+ * - an estimate of the cycles per frame on Cortex-M4 (mcHF, 168MHz) and Cortex-M7 (OVI40, 216MHz)
+ *
+ * Build and run with "make freedv-bench", see Makefile.
+ *
+ * The per function numbers are collected by wrapping the functions at link time (--wrap), so
+ * the codec2 sources stay untouched. The host uses the kiss_fft implementation, on the target
+ * the FFTs are done by the CMSIS DSP lib, so the FFT share on the target is smaller.
+ *
+ * The cycle estimate is host time * host clock * target factor. The target factors are rough,
+ * calibrate them with the freedv_comptx profiling point (ProfileTP7) in freedv_uhsdr.c
+ * if you need better numbers.
+ *
+ * The transmitter is fed with a synthetic voice signal, the receiver gets the real part of the
+ * transmitter output plus the noise from noise_samples.h at the requested SNR.
+ *
+ * With -l the LDPC decoders of 700D are compared instead: the reference sum-product decoder
+ * against the layered min-sum decoder in float and fixed point. It first decodes the test
+ * vector of HRA_112_112.c, then measures bit and frame error rate, iterations and time per
+ * codeword over BPSK/AWGN for a range of Eb/N0. The exit code is not 0 if a layered decoder
+ * fails on the test vector, loses more than 10% frames against the reference from 1.5dB on or
+ * does not need less than half of its iterations there.
+ *
+ * With -p the pitch estimator nlp() is compared against nlp_ref(), the implementation before the
+ * decimation filter and the DFT were optimised (nlp_ref.c). Both get the same synthetic voiced, noisy
+ * and silent input, the pitch estimates have to be identical in every frame, otherwise the exit code
+ * is not 0.
+ *
+ * With -a a recording with noise, 1600 and 700D segments is generated and the mode detection
+ * is tested on it: first the modem only sync detectors of both modes on their own (detection time,
+ * false syncs), then the auto receiver of freedv_uhsdr.c (decoder of one mode plus detector of
+ * the other one) with its mode switches and heap high water mark.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freedv_api.h"
+#include "codec2_fft.h"
+#include "kiss_fftr.h"
+#include "nlp.h"
+#include "nlp_ref.h"
+#include "sine.h"
+#include "newamp1.h"
+#include "mpdecode_core.h"
+#include "interldpc.h"
+#include "HRA_112_112.h"
+
+// unit variance complex noise, 60000 samples
+#include "noise_samples.h"
+
+#define BENCH_NOISE_LEN     (sizeof(noise)/sizeof(noise[0]))
+#define BENCH_FRAMES_DEFAULT 250
+#define BENCH_SNR_DEFAULT   10.0
+
+// rough number of target cycles per host cycle, see comment at the top
+#define BENCH_M4_FACTOR_DEFAULT 2.5
+#define BENCH_M7_FACTOR_DEFAULT 1.5
+
+typedef enum
+{
+    BenchFuncFFT = 0,
+    BenchFuncNlp,
+    BenchFuncNewamp1,
+    BenchFuncLdpc,
+    BenchFuncNum
+} BenchFunc_t;
+
+static const char* bench_func_names[BenchFuncNum] =
+{
+    "FFT (kiss_fft/fftr/fftri)",
+    "nlp.c nlp()",
+    "newamp1 quantiser",
+    "mpdecode_core LDPC decoder",
+};
+
+typedef struct
+{
+    uint64_t ns;
+    uint32_t calls;
+    uint32_t active;    // nesting depth, only the outermost call is timed
+    uint64_t start;
+} BenchFuncStats_t;
+
+static BenchFuncStats_t bench_func[BenchFuncNum];
+
+typedef struct
+{
+    size_t current;
+    size_t peak;
+    uint32_t allocs;
+} BenchHeap_t;
+
+static BenchHeap_t bench_heap;
+
+static uint64_t Bench_Now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static inline void Bench_FuncEnter(BenchFunc_t f)
+{
+    if (bench_func[f].active++ == 0)
+    {
+        bench_func[f].start = Bench_Now();
+    }
+}
+
+static inline void Bench_FuncLeave(BenchFunc_t f)
+{
+    if (--bench_func[f].active == 0)
+    {
+        bench_func[f].ns += Bench_Now() - bench_func[f].start;
+        bench_func[f].calls++;
+    }
+}
+
+/*
+ * heap accounting, every block carries its size in front of the user data
+ */
+typedef union
+{
+    size_t size;
+    max_align_t align;
+} BenchHeapHeader_t;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+static void Bench_HeapAdd(size_t size)
+{
+    bench_heap.current += size;
+    bench_heap.allocs++;
+    if (bench_heap.current > bench_heap.peak)
+    {
+        bench_heap.peak = bench_heap.current;
+    }
+}
+
+void* __wrap_malloc(size_t size)
+{
+    BenchHeapHeader_t* h = __real_malloc(sizeof(BenchHeapHeader_t) + size);
+    if (h == NULL)
+    {
+        return NULL;
+    }
+    h->size = size;
+    Bench_HeapAdd(size);
+    return h + 1;
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size)
+{
+    void* ptr = __wrap_malloc(nmemb * size);
+    if (ptr != NULL)
+    {
+        memset(ptr, 0, nmemb * size);
+    }
+    return ptr;
+}
+
+void __wrap_free(void* ptr)
+{
+    if (ptr != NULL)
+    {
+        BenchHeapHeader_t* h = (BenchHeapHeader_t*)ptr - 1;
+        bench_heap.current -= h->size;
+        __real_free(h);
+    }
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    void* ptr_new = __wrap_malloc(size);
+    if (ptr_new != NULL && ptr != NULL)
+    {
+        BenchHeapHeader_t* h = (BenchHeapHeader_t*)ptr - 1;
+        memcpy(ptr_new, ptr, h->size < size ? h->size : size);
+        __wrap_free(ptr);
+    }
+    return ptr_new;
+}
+
+/*
+ * timed wrappers of the functions we are interested in
+ */
+void __real_kiss_fft(kiss_fft_cfg cfg, const kiss_fft_cpx* fin, kiss_fft_cpx* fout);
+void __real_kiss_fftr(kiss_fftr_cfg cfg, const kiss_fft_scalar* timedata, kiss_fft_cpx* freqdata);
+void __real_kiss_fftri(kiss_fftr_cfg cfg, const kiss_fft_cpx* freqdata, kiss_fft_scalar* timedata);
+float __real_nlp(void* nlp_state, float Sn[], int n, float* pitch_samples, COMP Sw[], COMP W[], float* prev_f0);
+void __real_newamp1_model_to_indexes(C2CONST* c2const, int indexes[], MODEL* model, float rate_K_vec[], float rate_K_sample_freqs_kHz[],
+                                     int K, float* mean, float rate_K_vec_no_mean[], float rate_K_vec_no_mean_[]);
+void __real_newamp1_indexes_to_model(C2CONST* c2const, MODEL model_[], COMP H[], float* interpolated_surface_, float prev_rate_K_vec_[],
+                                     float* Wo_left, int* voicing_left, float rate_K_sample_freqs_kHz[], int K,
+                                     codec2_fft_cfg fwd_cfg, codec2_fft_cfg inv_cfg, int indexes[]);
+int __real_run_ldpc_decoder(struct LDPC* ldpc, uint8_t out_char[], float input[], int* parityCheckCount);
+
+void __wrap_kiss_fft(kiss_fft_cfg cfg, const kiss_fft_cpx* fin, kiss_fft_cpx* fout)
+{
+    Bench_FuncEnter(BenchFuncFFT);
+    __real_kiss_fft(cfg, fin, fout);
+    Bench_FuncLeave(BenchFuncFFT);
+}
+
+void __wrap_kiss_fftr(kiss_fftr_cfg cfg, const kiss_fft_scalar* timedata, kiss_fft_cpx* freqdata)
+{
+    Bench_FuncEnter(BenchFuncFFT);
+    __real_kiss_fftr(cfg, timedata, freqdata);
+    Bench_FuncLeave(BenchFuncFFT);
+}
+
+void __wrap_kiss_fftri(kiss_fftr_cfg cfg, const kiss_fft_cpx* freqdata, kiss_fft_scalar* timedata)
+{
+    Bench_FuncEnter(BenchFuncFFT);
+    __real_kiss_fftri(cfg, freqdata, timedata);
+    Bench_FuncLeave(BenchFuncFFT);
+}
+
+float __wrap_nlp(void* nlp_state, float Sn[], int n, float* pitch_samples, COMP Sw[], COMP W[], float* prev_f0)
+{
+    Bench_FuncEnter(BenchFuncNlp);
+    float retval = __real_nlp(nlp_state, Sn, n, pitch_samples, Sw, W, prev_f0);
+    Bench_FuncLeave(BenchFuncNlp);
+    return retval;
+}
+
+void __wrap_newamp1_model_to_indexes(C2CONST* c2const, int indexes[], MODEL* model, float rate_K_vec[], float rate_K_sample_freqs_kHz[],
+                                     int K, float* mean, float rate_K_vec_no_mean[], float rate_K_vec_no_mean_[])
+{
+    Bench_FuncEnter(BenchFuncNewamp1);
+    __real_newamp1_model_to_indexes(c2const, indexes, model, rate_K_vec, rate_K_sample_freqs_kHz, K, mean, rate_K_vec_no_mean, rate_K_vec_no_mean_);
+    Bench_FuncLeave(BenchFuncNewamp1);
+}
+
+void __wrap_newamp1_indexes_to_model(C2CONST* c2const, MODEL model_[], COMP H[], float* interpolated_surface_, float prev_rate_K_vec_[],
+                                     float* Wo_left, int* voicing_left, float rate_K_sample_freqs_kHz[], int K,
+                                     codec2_fft_cfg fwd_cfg, codec2_fft_cfg inv_cfg, int indexes[])
+{
+    Bench_FuncEnter(BenchFuncNewamp1);
+    __real_newamp1_indexes_to_model(c2const, model_, H, interpolated_surface_, prev_rate_K_vec_, Wo_left, voicing_left, rate_K_sample_freqs_kHz, K, fwd_cfg, inv_cfg, indexes);
+    Bench_FuncLeave(BenchFuncNewamp1);
+}
+
+int __wrap_run_ldpc_decoder(struct LDPC* ldpc, uint8_t out_char[], float input[], int* parityCheckCount)
+{
+    Bench_FuncEnter(BenchFuncLdpc);
+    int retval = __real_run_ldpc_decoder(ldpc, out_char, input, parityCheckCount);
+    Bench_FuncLeave(BenchFuncLdpc);
+    return retval;
+}
+
+/*
+ * synthetic voice: harmonics of a gliding pitch with a syllable envelope and some unvoiced noise bursts
+ */
+typedef struct
+{
+    uint32_t n;
+    float phase;
+    uint32_t rnd;
+} BenchVoice_t;
+
+static void Bench_VoiceGenerate(BenchVoice_t* v, short* speech, int len, int fs)
+{
+    for (int idx = 0; idx < len; idx++, v->n++)
+    {
+        const float t = (float)v->n / fs;
+        const float f0 = 140.0 + 40.0 * sinf(2 * M_PI * 0.7 * t);
+        const float syllable = 0.5 + 0.5 * sinf(2 * M_PI * 3.0 * t);
+        const bool unvoiced = fmodf(t, 1.3) > 1.1;
+
+        v->phase += 2 * M_PI * f0 / fs;
+        if (v->phase > 2 * M_PI)
+        {
+            v->phase -= 2 * M_PI;
+        }
+
+        float sample = 0;
+        if (unvoiced)
+        {
+            v->rnd = v->rnd * 1664525 + 1013904223;
+            sample = ((int32_t)v->rnd >> 16) / 32768.0 * 0.3;
+        }
+        else
+        {
+            // 1/h spectrum up to 3.5kHz, similar to the glottal excitation
+            for (int h = 1; h * f0 < 3500.0; h++)
+            {
+                sample += sinf(h * v->phase) / h;
+            }
+            sample *= 0.4;
+        }
+        speech[idx] = 8000.0 * syllable * sample;
+    }
+}
+
+typedef struct
+{
+    double frame_ms;
+    double tx_us;
+    double rx_us;
+    size_t heap_peak;
+    bool synced;
+} BenchResult_t;
+
+static bool Bench_RunMode(const char* name, int mode, int frames, float snr_db, BenchResult_t* res)
+{
+    memset(bench_func, 0, sizeof(bench_func));
+    memset(&bench_heap, 0, sizeof(bench_heap));
+
+    struct freedv* f = freedv_open(mode);
+    if (f == NULL)
+    {
+        printf("%s: mode not available in this build\n", name);
+        return false;
+    }
+
+    const int n_speech = freedv_get_n_speech_samples(f);
+    const int n_modem = freedv_get_n_nom_modem_samples(f);
+    const int n_max_modem = freedv_get_n_max_modem_samples(f);
+    const int fs_modem = freedv_get_modem_sample_rate(f);
+
+    // the application buffers are not part of the codec memory, so they bypass the heap accounting
+    short* speech_in = __real_malloc(sizeof(short) * n_speech);
+    short* speech_out = __real_malloc(sizeof(short) * (n_speech > n_max_modem ? n_speech : n_max_modem) * 2);
+    COMP* mod = __real_malloc(sizeof(COMP) * n_modem);
+    short* channel = __real_malloc(sizeof(short) * (n_modem + n_max_modem));
+
+    BenchVoice_t voice = { 0 };
+    uint64_t tx_ns = 0, rx_ns = 0;
+    uint32_t rx_calls = 0;
+    int channel_len = 0;
+    size_t noise_idx = 0;
+    float noise_scale = 0;
+    bool synced = false;
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        Bench_VoiceGenerate(&voice, speech_in, n_speech, 8000);
+
+        uint64_t start = Bench_Now();
+        freedv_comptx(f, mod, speech_in);
+        tx_ns += Bench_Now() - start;
+
+        if (frame == 0)
+        {
+            float power = 0;
+            for (int idx = 0; idx < n_modem; idx++)
+            {
+                power += mod[idx].real * mod[idx].real;
+            }
+            // the real part of the noise has a variance of 0.5 over the full modem bandwidth, we refer the SNR to 3kHz like FreeDV does
+            noise_scale = sqrtf(power / n_modem / powf(10.0, snr_db / 10.0) * (fs_modem / 2) / 3000.0 / 0.5);
+        }
+
+        for (int idx = 0; idx < n_modem; idx++, noise_idx = (noise_idx + 1) % BENCH_NOISE_LEN)
+        {
+            channel[channel_len++] = mod[idx].real + noise_scale * noise[noise_idx].real;
+        }
+
+        int nin;
+        while (channel_len >= (nin = freedv_nin(f)))
+        {
+            start = Bench_Now();
+            freedv_rx(f, speech_out, channel);
+            rx_ns += Bench_Now() - start;
+            rx_calls++;
+
+            memmove(channel, &channel[nin], sizeof(short) * (channel_len - nin));
+            channel_len -= nin;
+            synced |= freedv_get_sync(f) != 0;
+        }
+    }
+
+    res->frame_ms = 1000.0 * n_modem / fs_modem;
+    res->tx_us = tx_ns / 1000.0 / frames;
+    // the receiver is called with varying number of samples, so we normalize to the nominal frame
+    res->rx_us = rx_ns / 1000.0 / frames;
+    res->heap_peak = bench_heap.peak;
+    res->synced = synced;
+
+    printf("\n%s: %d frames of %.1fms, %d speech / %d modem samples per frame, %u rx calls\n",
+           name, frames, res->frame_ms, n_speech, n_modem, (unsigned)rx_calls);
+    printf("  freedv_comptx          %9.1f us/frame\n", res->tx_us);
+    printf("  freedv_rx              %9.1f us/frame (decoder %s)\n", res->rx_us, synced ? "synced" : "NOT synced");
+    printf("  heap high water mark   %9zu bytes in %u allocations\n", res->heap_peak, (unsigned)bench_heap.allocs);
+    printf("  per function (inclusive, tx + rx):\n");
+    for (int fn = 0; fn < BenchFuncNum; fn++)
+    {
+        const double us = bench_func[fn].ns / 1000.0 / frames;
+        printf("    %-28s %9.1f us/frame %5.1f%% %8u calls\n", bench_func_names[fn], us,
+               100.0 * us / (res->tx_us + res->rx_us), (unsigned)bench_func[fn].calls);
+    }
+
+    __real_free(speech_in);
+    __real_free(speech_out);
+    __real_free(mod);
+    __real_free(channel);
+    freedv_close(f);
+
+    return true;
+}
+
+static void Bench_PrintBudget(const char* name, const BenchResult_t* res, float host_ghz, const char* core, float core_mhz, float factor)
+{
+    const double budget = core_mhz * 1000.0 * res->frame_ms;
+    const double tx = res->tx_us * host_ghz * 1000.0 * factor;
+    const double rx = res->rx_us * host_ghz * 1000.0 * factor;
+
+    printf("  %-6s %-16s %6.1fM cycles/frame budget, tx %6.2fM (%5.1f%%) rx %6.2fM (%5.1f%%) %s\n",
+           name, core, budget / 1e6, tx / 1e6, 100 * tx / budget, rx / 1e6, 100 * rx / budget,
+           (tx > budget || rx > budget) ? "DOES NOT FIT" : ((tx > 0.5 * budget || rx > 0.5 * budget) ? "tight" : "ok"));
+}
+
+/*
+ * LDPC decoder comparison
+ */
+#define BENCH_LDPC_CHECK_EBN0       1.5     // the checks against the reference start at this Eb/N0
+#define BENCH_LDPC_MAX_FER_RATIO    1.1     // frame errors of a layered decoder relative to the reference
+#define BENCH_LDPC_MAX_ITER_RATIO   0.5     // iterations of a layered decoder relative to the reference
+
+typedef struct
+{
+    const char* name;
+    int dec_type;
+    int max_iter;
+    uint32_t bit_errors;
+    uint32_t frame_errors;
+    uint64_t iterations;
+    uint64_t ns;
+    // totals from BENCH_LDPC_CHECK_EBN0 on
+    uint32_t check_frame_errors;
+    uint64_t check_iterations;
+} BenchLdpcDecoder_t;
+
+static bool Bench_Check(const char* name, bool ok)
+{
+    printf("  %-56s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static float Bench_Gauss(uint32_t* rnd)
+{
+    // Box-Muller, the two uniform numbers are never 0
+    *rnd = *rnd * 1664525 + 1013904223;
+    const float u1 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    *rnd = *rnd * 1664525 + 1013904223;
+    const float u2 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    return sqrtf(-2 * logf(u1)) * cosf(2 * M_PI * u2);
+}
+
+static int Bench_LdpcDecode(struct LDPC* ldpc, BenchLdpcDecoder_t* dec, uint8_t* out, float* llr, int* pcc)
+{
+    ldpc->dec_type = dec->dec_type;
+    ldpc->max_iter = dec->max_iter;
+
+    const uint64_t start = Bench_Now();
+    const int iter = run_ldpc_decoder(ldpc, out, llr, pcc);
+    dec->ns += Bench_Now() - start;
+    dec->iterations += iter;
+    return iter;
+}
+
+/**
+ * @return true if all layered decoders pass the checks against the reference decoder
+ */
+static bool Bench_RunLdpc(int frames)
+{
+    bool ok = true;
+    struct OFDM_CONFIG config = { .bps = 2 };
+    struct LDPC ldpc;
+
+    set_up_hra_112_112(&ldpc, &config);
+    if (ldpc.layered == NULL && ldpc_layered_setup(&ldpc) == 0)
+    {
+        printf("LDPC: layered decoder setup failed\n");
+        return false;
+    }
+
+    BenchLdpcDecoder_t decoders[] =
+    {
+        { .name = "sum-product (reference)", .dec_type = LDPC_DEC_SUM_PRODUCT, .max_iter = HRA_112_112_MAX_ITER },
+        { .name = "layered min-sum float", .dec_type = LDPC_DEC_LAYERED_MIN_SUM, .max_iter = HRA_112_112_MAX_ITER / 2 },
+#ifdef LDPC_MSG_INT8
+        { .name = "layered min-sum int8", .dec_type = LDPC_DEC_LAYERED_MIN_SUM_Q, .max_iter = HRA_112_112_MAX_ITER / 2 },
+#else
+        { .name = "layered min-sum int16", .dec_type = LDPC_DEC_LAYERED_MIN_SUM_Q, .max_iter = HRA_112_112_MAX_ITER / 2 },
+#endif
+    };
+    const int decoders_num = sizeof(decoders) / sizeof(decoders[0]);
+
+    const int n = ldpc.CodeLength;
+    const int k = ldpc.ldpc_data_bits_per_frame;
+    uint8_t out[n];
+    float llr[n];
+    int pcc;
+
+    printf("\nLDPC HRA_112_112, test vector:\n");
+    for (int d = 0; d < decoders_num; d++)
+    {
+        const int iter = Bench_LdpcDecode(&ldpc, &decoders[d], out, (float*)HRA_112_112_input, &pcc);
+        int errors = 0;
+        for (int i = 0; i < k; i++)
+        {
+            errors += out[i] != HRA_112_112_detected_data[i];
+        }
+        printf("  %-24s %3d iterations, %3d/%d checks ok, %d errors against detected_data\n",
+               decoders[d].name, iter, pcc, ldpc.NumberParityBits, errors);
+        ok &= pcc == ldpc.NumberParityBits && errors == 0;
+    }
+
+    printf("\nLDPC HRA_112_112, BPSK/AWGN, %d codewords per point:\n", frames);
+    printf("  %-7s %-24s %10s %10s %8s %10s\n", "Eb/N0", "decoder", "BER", "FER", "iter", "us/cw");
+
+    uint32_t rnd = 1;
+    for (float ebn0 = 0.0; ebn0 <= 4.01; ebn0 += 0.5)
+    {
+        // rate 1/2 code
+        const float sigma = sqrtf(1.0 / (2 * 0.5 * powf(10.0, ebn0 / 10.0)));
+        for (int d = 0; d < decoders_num; d++)
+        {
+            decoders[d].bit_errors = decoders[d].frame_errors = 0;
+            decoders[d].iterations = decoders[d].ns = 0;
+        }
+
+        for (int f = 0; f < frames; f++)
+        {
+            uint8_t data[k];
+            uint8_t parity[ldpc.NumberParityBits];
+            for (int i = 0; i < k; i++)
+            {
+                rnd = rnd * 1664525 + 1013904223;
+                data[i] = rnd >> 31;
+            }
+            encode(&ldpc, data, parity);
+
+            for (int i = 0; i < n; i++)
+            {
+                const uint8_t bit = i < k ? data[i] : parity[i - k];
+                const float y = (bit ? -1.0 : 1.0) + sigma * Bench_Gauss(&rnd);
+                llr[i] = 2 * y / (sigma * sigma);
+            }
+
+            for (int d = 0; d < decoders_num; d++)
+            {
+                Bench_LdpcDecode(&ldpc, &decoders[d], out, llr, &pcc);
+                int errors = 0;
+                for (int i = 0; i < k; i++)
+                {
+                    errors += out[i] != data[i];
+                }
+                decoders[d].bit_errors += errors;
+                decoders[d].frame_errors += errors != 0;
+            }
+        }
+
+        for (int d = 0; d < decoders_num; d++)
+        {
+            printf("  %5.1fdB %-24s %10.2e %10.2e %8.2f %10.1f\n", ebn0, decoders[d].name,
+                   (double)decoders[d].bit_errors / k / frames, (double)decoders[d].frame_errors / frames,
+                   (double)decoders[d].iterations / frames, decoders[d].ns / 1000.0 / frames);
+            if (ebn0 >= BENCH_LDPC_CHECK_EBN0 - 0.01)
+            {
+                decoders[d].check_frame_errors += decoders[d].frame_errors;
+                decoders[d].check_iterations += decoders[d].iterations;
+            }
+        }
+    }
+
+    printf("\nLDPC checks, totals from %.1fdB on:\n", BENCH_LDPC_CHECK_EBN0);
+    Bench_Check("all decoders decode the test vector", ok);
+    const BenchLdpcDecoder_t* ref = &decoders[0];
+    for (int d = 1; d < decoders_num; d++)
+    {
+        char name[80];
+        snprintf(name, sizeof(name), "%s: %u frame errors, reference %u", decoders[d].name,
+                 (unsigned int)decoders[d].check_frame_errors, (unsigned int)ref->check_frame_errors);
+        ok &= Bench_Check(name, decoders[d].check_frame_errors <= BENCH_LDPC_MAX_FER_RATIO * ref->check_frame_errors);
+        snprintf(name, sizeof(name), "%s: %.0f%% of the reference iterations", decoders[d].name,
+                 100.0 * decoders[d].check_iterations / ref->check_iterations);
+        ok &= Bench_Check(name, decoders[d].check_iterations < BENCH_LDPC_MAX_ITER_RATIO * ref->check_iterations);
+    }
+
+    ldpc_layered_destroy(&ldpc);
+    return ok;
+}
+
+/*
+ * pitch estimator comparison
+ */
+#define BENCH_NLP_FRAMES_PER_FRAME  40  // -n gives the number of codec frames, -p runs this many times more pitch frames
+#define BENCH_NLP_SEGMENT           100 // frames per input segment, 1s
+
+/**
+ * Synthetic input for the pitch estimators, segments of 1s cycle through clean voiced speech, voiced
+ * speech with noise (10dB SNR), noise only and silence. The voiced signal has a gliding F0 of 70..380Hz
+ * and harmonics up to 3.8kHz shaped by two formants.
+ */
+static void Bench_NlpInput(float* dst, int n, int frame, double* phase, uint32_t* rnd)
+{
+    const int type = (frame / BENCH_NLP_SEGMENT) % 4;
+    const bool voiced = type == 0 || type == 1;
+    const float noise = type == 1 ? 1500 : (type == 2 ? 2000 : 0);
+
+    for (int i = 0; i < n; i++)
+    {
+        const double t = (frame * n + i) / 8000.0;
+        const double f0 = 225 + 155 * sin(2 * M_PI * 0.13 * t) * cos(2 * M_PI * 0.029 * t);
+        float v = 0;
+
+        *phase = fmod(*phase + 2 * M_PI * f0 / 8000.0, 2 * M_PI);
+        if (voiced)
+        {
+            for (int k = 1; k * f0 < 3800; k++)
+            {
+                const double f = k * f0;
+                const double formants = 1 + 2 * exp(-pow((f - 700) / 200, 2)) + exp(-pow((f - 1200) / 300, 2));
+                v += 6000.0 / k * formants * cos(k * *phase);
+            }
+        }
+        dst[i] = v + noise * Bench_Gauss(rnd);
+    }
+}
+
+/**
+ * @return true if nlp() and nlp_ref() return the same pitch in every frame
+ */
+static bool Bench_RunNlp(int frames)
+{
+    C2CONST c2const = c2const_create(8000, N_S);
+    codec2_fftr_cfg fftr_cfg = codec2_fftr_alloc(FFT_ENC, 0, NULL, NULL);
+    void* nlp_state = nlp_create(&c2const, fftr_cfg);
+    void* ref_state = nlp_ref_create(&c2const);
+
+    const int m = c2const.m_pitch;
+    const int n = c2const.n_samp;
+    float sn[m];
+    float sn_ref[m];
+    COMP sw[FFT_ENC] = { 0 };
+    COMP w[FFT_ENC] = { 0 };
+    float prev_f0 = 1 / P_MAX_S;
+    float prev_f0_ref = 1 / P_MAX_S;
+    double phase = 0;
+    uint32_t rnd = 1;
+    uint64_t ns = 0, ns_ref = 0;
+    int mismatches = 0, voiced_frames = 0, first_mismatch = -1;
+    float max_diff = 0;
+
+    memset(sn, 0, sizeof(sn));
+    for (int f = 0; f < frames; f++)
+    {
+        memmove(sn, &sn[n], (m - n) * sizeof(float));
+        Bench_NlpInput(&sn[m - n], n, f, &phase, &rnd);
+        // each estimator gets its own copy of the input
+        memcpy(sn_ref, sn, sizeof(sn));
+
+        float pitch, pitch_ref;
+        uint64_t start = Bench_Now();
+        const float f0 = nlp(nlp_state, sn, n, &pitch, sw, w, &prev_f0);
+        ns += Bench_Now() - start;
+        start = Bench_Now();
+        const float f0_ref = nlp_ref(ref_state, sn_ref, n, &pitch_ref, sw, w, &prev_f0_ref);
+        ns_ref += Bench_Now() - start;
+
+        if (f0 != f0_ref || pitch != pitch_ref)
+        {
+            if (first_mismatch < 0)
+            {
+                first_mismatch = f;
+            }
+            mismatches++;
+            max_diff = fmaxf(max_diff, fabsf(f0 - f0_ref));
+        }
+        voiced_frames += (f / BENCH_NLP_SEGMENT) % 4 < 2;
+    }
+
+    printf("\nnlp() against nlp_ref(), %d frames (%d voiced, the others noise or silence):\n", frames, voiced_frames);
+    printf("  nlp()     %6.1f us/frame\n", ns / 1000.0 / frames);
+    printf("  nlp_ref() %6.1f us/frame\n", ns_ref / 1000.0 / frames);
+    if (mismatches > 0)
+    {
+        printf("  %d frames differ, the first one is %d, largest F0 difference %.2fHz\n", mismatches, first_mismatch, max_diff);
+    }
+    const bool ok = Bench_Check("identical F0 and pitch in every frame", mismatches == 0);
+
+    nlp_destroy(nlp_state);
+    nlp_ref_destroy(ref_state);
+    codec2_fftr_free(fftr_cfg);
+    return ok;
+}
+
+/*
+ * mixed mode recording for -a, BENCH_MODE_NOISE is noise only
+ */
+#define BENCH_MODE_NOISE (-1)
+
+typedef struct
+{
+    int mode;
+    float seconds;
+} BenchSegment_t;
+
+static const BenchSegment_t bench_auto_segments[] =
+{
+    { BENCH_MODE_NOISE, 3 },
+    { FREEDV_MODE_1600, 8 },
+    { BENCH_MODE_NOISE, 3 },
+    { FREEDV_MODE_700D, 10 },
+    { FREEDV_MODE_1600, 8 },
+    { FREEDV_MODE_700D, 10 },
+    { FREEDV_MODE_1600, 8 },
+    { BENCH_MODE_NOISE, 5 },
+};
+
+#define BENCH_AUTO_SEGMENTS (sizeof(bench_auto_segments)/sizeof(bench_auto_segments[0]))
+
+static const char* Bench_ModeName(int mode)
+{
+    return mode == FREEDV_MODE_1600 ? "1600" : (mode == FREEDV_MODE_700D ? "700D" : "noise");
+}
+
+static int Bench_SegmentAt(const int* seg_start, int pos)
+{
+    int seg = 0;
+    while (seg + 1 < BENCH_AUTO_SEGMENTS && pos >= seg_start[seg + 1])
+    {
+        seg++;
+    }
+    return seg;
+}
+
+/**
+ * @return true if every FreeDV segment is decoded, the receiver only switches to the mode of the segment
+ * and the detectors do not sync on the other mode or on noise
+ */
+static bool Bench_RunAuto(float snr_db)
+{
+    int seg_start[BENCH_AUTO_SEGMENTS + 1];
+    int len = 0;
+    for (int seg = 0; seg < BENCH_AUTO_SEGMENTS; seg++)
+    {
+        seg_start[seg] = len;
+        len += bench_auto_segments[seg].seconds * 8000;
+    }
+    seg_start[BENCH_AUTO_SEGMENTS] = len;
+
+    // the recording is generated before any receiver exists, only one OFDM modem may be open at a time
+    float* clean = __real_calloc(len + 2000, sizeof(float));
+    short* rec = __real_malloc(sizeof(short) * len);
+    double power = 0;
+    int power_n = 0;
+
+    for (int seg = 0; seg < BENCH_AUTO_SEGMENTS; seg++)
+    {
+        const int mode = bench_auto_segments[seg].mode;
+        if (mode == BENCH_MODE_NOISE)
+        {
+            continue;
+        }
+        struct freedv* f = freedv_open(mode);
+        const int n_speech = freedv_get_n_speech_samples(f);
+        const int n_modem = freedv_get_n_nom_modem_samples(f);
+        short speech[n_speech];
+        COMP mod[n_modem];
+        BenchVoice_t voice = { 0 };
+
+        for (int pos = seg_start[seg]; pos < seg_start[seg + 1]; pos += n_modem)
+        {
+            Bench_VoiceGenerate(&voice, speech, n_speech, 8000);
+            freedv_comptx(f, mod, speech);
+            for (int idx = 0; idx < n_modem && pos + idx < seg_start[seg + 1]; idx++)
+            {
+                clean[pos + idx] = mod[idx].real;
+                power += mod[idx].real * mod[idx].real;
+                power_n++;
+            }
+        }
+        freedv_close(f);
+    }
+
+    // real noise of unit variance covers 4kHz, the SNR is referred to 3kHz
+    const float noise_scale = sqrtf(power / power_n / powf(10.0, snr_db / 10.0) / 0.75);
+    uint32_t rnd = 1;
+    for (int idx = 0; idx < len; idx++)
+    {
+        float sample = clean[idx] + noise_scale * Bench_Gauss(&rnd);
+        rec[idx] = sample > 32767 ? 32767 : (sample < -32768 ? -32768 : sample);
+    }
+    __real_free(clean);
+
+    printf("\nmode detection on a mixed recording, SNR %.1fdB:", snr_db);
+    for (int seg = 0; seg < BENCH_AUTO_SEGMENTS; seg++)
+    {
+        printf(" %s %.0fs", Bench_ModeName(bench_auto_segments[seg].mode), bench_auto_segments[seg].seconds);
+    }
+    printf("\n");
+
+    // 1. both detectors on their own, time of the first sync in each segment
+    memset(&bench_heap, 0, sizeof(bench_heap));
+    struct freedv_sync_detector* det[2];
+    size_t det_heap[2];
+    for (int d = 0; d < 2; d++)
+    {
+        const size_t before = bench_heap.current;
+        det[d] = freedv_sync_detector_create(d == 0 ? FREEDV_MODE_1600 : FREEDV_MODE_700D);
+        det_heap[d] = bench_heap.current - before;
+    }
+    float first_sync[BENCH_AUTO_SEGMENTS][2];
+    int sync_prev[2] = { 0, 0 };
+    uint64_t det_ns[2] = { 0, 0 };
+    for (int seg = 0; seg < BENCH_AUTO_SEGMENTS; seg++)
+    {
+        first_sync[seg][0] = first_sync[seg][1] = -1;
+    }
+
+    for (int pos = 0; pos < len; pos += 160)
+    {
+        const int seg = Bench_SegmentAt(seg_start, pos);
+        for (int d = 0; d < 2; d++)
+        {
+            const uint64_t start = Bench_Now();
+            const int sync = freedv_sync_detector_rx(det[d], &rec[pos], 160);
+            det_ns[d] += Bench_Now() - start;
+            if (sync && !sync_prev[d] && first_sync[seg][d] < 0)
+            {
+                first_sync[seg][d] = (pos + 160 - seg_start[seg]) / 8000.0;
+            }
+            sync_prev[d] = sync;
+        }
+    }
+    for (int d = 0; d < 2; d++)
+    {
+        freedv_sync_detector_destroy(det[d]);
+    }
+
+    printf("  sync detectors alone, heap %zu / %zu bytes, %.1f / %.1f us per second of signal (1600 / 700D)\n",
+           det_heap[0], det_heap[1], det_ns[0] / 1000.0 / (len / 8000.0), det_ns[1] / 1000.0 / (len / 8000.0));
+    printf("    segment  1600 detector  700D detector\n");
+    int false_syncs = 0;
+    for (int seg = 0; seg < BENCH_AUTO_SEGMENTS; seg++)
+    {
+        const int mode = bench_auto_segments[seg].mode;
+        printf("    %-7s", Bench_ModeName(mode));
+        for (int d = 0; d < 2; d++)
+        {
+            const bool expected = mode == (d == 0 ? FREEDV_MODE_1600 : FREEDV_MODE_700D);
+            if (first_sync[seg][d] < 0)
+            {
+                printf("  %13s", expected ? "MISSED" : "-");
+            }
+            else
+            {
+                printf("  %8.2fs %4s", first_sync[seg][d], expected ? "" : "FALSE");
+                false_syncs += !expected;
+            }
+        }
+        printf("\n");
+    }
+
+    // 2. the receiver as run by freedv_uhsdr.c in auto mode: decoder of one mode, detector of the other
+    memset(&bench_heap, 0, sizeof(bench_heap));
+    int active = FREEDV_MODE_1600;
+    struct freedv* f = freedv_open(active);
+    struct freedv_sync_detector* other = freedv_sync_detector_create(FREEDV_MODE_700D);
+    float decoded_at[BENCH_AUTO_SEGMENTS];
+    for (int seg = 0; seg < BENCH_AUTO_SEGMENTS; seg++)
+    {
+        decoded_at[seg] = -1;
+    }
+    short speech_out[2 * 1280];
+    int switches = 0;
+    int wrong_switches = 0;
+
+    printf("  auto receiver, starts with the 1600 decoder:\n");
+    for (int pos = 0; pos + freedv_nin(f) <= len;)
+    {
+        const int nin = freedv_nin(f);
+        freedv_rx(f, speech_out, &rec[pos]);
+        pos += nin;
+
+        const int seg = Bench_SegmentAt(seg_start, pos - 1);
+        if (freedv_get_sync(f) && bench_auto_segments[seg].mode == active && decoded_at[seg] < 0)
+        {
+            decoded_at[seg] = (pos - seg_start[seg]) / 8000.0;
+        }
+
+        // same policy as FreeDv_AutoDetect() / FreeDv_AutoSwitch(): the detector always listens,
+        // we switch once it has sync and the decoder has not
+        bool found = freedv_sync_detector_rx(other, &rec[pos - nin], nin) != 0 && freedv_get_sync(f) == 0;
+
+        if (found)
+        {
+            freedv_sync_detector_destroy(other);
+            freedv_close(f);
+            active = active == FREEDV_MODE_1600 ? FREEDV_MODE_700D : FREEDV_MODE_1600;
+            f = freedv_open(active);
+            other = freedv_sync_detector_create(active == FREEDV_MODE_1600 ? FREEDV_MODE_700D : FREEDV_MODE_1600);
+            switches++;
+            const bool wrong = bench_auto_segments[seg].mode != active;
+            wrong_switches += wrong;
+            printf("    %6.2fs switched to %s (segment %s)%s\n", pos / 8000.0, Bench_ModeName(active),
+                   Bench_ModeName(bench_auto_segments[seg].mode), wrong ? " WRONG" : "");
+        }
+    }
+    freedv_sync_detector_destroy(other);
+    freedv_close(f);
+
+    int missed = 0;
+    printf("    segment  decoded after\n");
+    for (int seg = 0; seg < BENCH_AUTO_SEGMENTS; seg++)
+    {
+        const int mode = bench_auto_segments[seg].mode;
+        if (mode != BENCH_MODE_NOISE)
+        {
+            printf("    %-7s  ", Bench_ModeName(mode));
+            if (decoded_at[seg] < 0)
+            {
+                printf("MISSED\n");
+                missed++;
+            }
+            else
+            {
+                printf("%.2fs\n", decoded_at[seg]);
+            }
+        }
+    }
+    printf("  %d switches, %d segments missed, %d false detector syncs, heap high water mark in auto mode %zu bytes\n",
+           switches, missed, false_syncs, bench_heap.peak);
+
+    __real_free(rec);
+
+    bool ok = true;
+    ok &= Bench_Check("every FreeDV segment decoded", missed == 0);
+    ok &= Bench_Check("no switch to the wrong mode", wrong_switches == 0);
+    ok &= Bench_Check("no false detector syncs", false_syncs == 0);
+    return ok;
+}
+
+static void Bench_Usage(const char* prog)
+{
+    printf("usage: %s [-l|-p|-a] [-n frames] [-s snr_db] [-g host_ghz] [-4 m4_factor] [-7 m7_factor]\n", prog);
+    printf("  -l  compare the LDPC decoders instead of running the modes, exit code 1 if a check fails\n");
+    printf("  -p  compare the pitch estimator against the reference implementation, %d pitch frames per frame, exit code 1 if they differ\n",
+           BENCH_NLP_FRAMES_PER_FRAME);
+    printf("  -a  run the 1600/700D mode detection on a mixed mode recording instead of running the modes, exit code 1 if a check fails\n");
+    printf("  -n  number of frames per mode or codewords per Eb/N0 (%d)\n", BENCH_FRAMES_DEFAULT);
+    printf("  -s  channel SNR in dB in 3kHz (%.1f)\n", BENCH_SNR_DEFAULT);
+    printf("  -g  host clock in GHz, used for the cycle estimate (3.0)\n");
+    printf("  -4  Cortex-M4 cycles per host cycle (%.1f)\n", BENCH_M4_FACTOR_DEFAULT);
+    printf("  -7  Cortex-M7 cycles per host cycle (%.1f)\n", BENCH_M7_FACTOR_DEFAULT);
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = BENCH_FRAMES_DEFAULT;
+    float snr_db = BENCH_SNR_DEFAULT;
+    float host_ghz = 3.0;
+    float m4_factor = BENCH_M4_FACTOR_DEFAULT;
+    float m7_factor = BENCH_M7_FACTOR_DEFAULT;
+    bool ldpc_only = false;
+    bool nlp_only = false;
+    bool auto_only = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "lpan:s:g:4:7:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l': ldpc_only = true; break;
+        case 'p': nlp_only = true; break;
+        case 'a': auto_only = true; break;
+        case 'n': frames = atoi(optarg); break;
+        case 's': snr_db = atof(optarg); break;
+        case 'g': host_ghz = atof(optarg); break;
+        case '4': m4_factor = atof(optarg); break;
+        case '7': m7_factor = atof(optarg); break;
+        default:
+            Bench_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (frames < 1)
+    {
+        frames = 1;
+    }
+
+    if (ldpc_only)
+    {
+        const bool ok = Bench_RunLdpc(frames);
+        printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+        return ok ? 0 : 1;
+    }
+
+    if (nlp_only)
+    {
+        const bool ok = Bench_RunNlp(frames * BENCH_NLP_FRAMES_PER_FRAME);
+        printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+        return ok ? 0 : 1;
+    }
+
+    if (auto_only)
+    {
+        const bool ok = Bench_RunAuto(snr_db);
+        printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+        return ok ? 0 : 1;
+    }
+
+    BenchResult_t res_1600, res_700d;
+    const bool have_1600 = Bench_RunMode("1600", FREEDV_MODE_1600, frames, snr_db, &res_1600);
+    const bool have_700d = Bench_RunMode("700D", FREEDV_MODE_700D, frames, snr_db, &res_700d);
+
+    printf("\nestimated target load (host %.2fGHz, M4 factor %.2f, M7 factor %.2f), tx and rx never run at the same time:\n",
+           host_ghz, m4_factor, m7_factor);
+    if (have_1600)
+    {
+        Bench_PrintBudget("1600", &res_1600, host_ghz, "M4 168MHz mcHF", 168, m4_factor);
+        Bench_PrintBudget("1600", &res_1600, host_ghz, "M7 216MHz OVI40", 216, m7_factor);
+    }
+    if (have_700d)
+    {
+        Bench_PrintBudget("700D", &res_700d, host_ghz, "M4 168MHz mcHF", 168, m4_factor);
+        Bench_PrintBudget("700D", &res_700d, host_ghz, "M7 216MHz OVI40", 216, m7_factor);
+    }
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: nlp_ref.h
+  AUTHOR......: David Rowe
+  DATE CREATED: 23/3/93
+
+  Non Linear Pitch (NLP) estimation functions, reference version for the
+  comparison in freedv-bench, see nlp_ref.c.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  Copyright (C) 2009 David Rowe
+
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __NLP_REF__
+#define __NLP_REF__
+
+#include "comp.h"
+
+void *nlp_ref_create(C2CONST *c2const);
+void nlp_ref_destroy(void *nlp_state);
+float nlp_ref(void *nlp_state, float Sn[], int n,
+	  float *pitch_samples, COMP Sw[], COMP W[], float *prev_f0);
+
+#endif
@@ -0,0 +1,369 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     nr_test.c                                                       **
+ **  Description:   host test of the spectral noise reduction engine                **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It builds audio_nr.c for the build host and runs the spectral
+ * noise reduction engine (spectral_noise_reduction_3) for both FFT lengths at all sample rates
+ * the buffer producer can deliver (6, 12 and 24ksps).
+ *
+ * - transparency: during the 20 frames of the initial noise estimate the spectrum is not touched,
+ *   analysis window, real FFT, inverse FFT, synthesis window and overlap-add must return the input
+ *   delayed by half an FFT length
+ * - noise reduction: keyed harmonics of 200Hz (400..2800Hz, a crude voice) in white noise, a steady
+ *   carrier is stationary and would end up in the noise estimate. The engine has to improve the SNR,
+ *   lower the noise between the pulses and keep the signal level. FFT128 is checked with looser limits
+ *   per sample rate, the measured values minus a small margin: its bins are as wide as half the harmonic
+ *   spacing and wider at 24ksps, so the harmonics share their bins with more noise and the gain averaging
+ *   across neighbouring bins pulls them down
+ * - processing time: host time per NR buffer and the cycle budget the firmware compares the measured
+ *   peak against (nr_params.cycles_budget, shown as "NR pk" in the debug info line)
+ *
+ * audio_nr.c is included below, the board, FreeDV and profiling headers it uses are replaced
+ * by the few stubs it needs. Build and run with "make nr-test", see Makefile.
+ * The exit code is not 0 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arm_math.h"
+#include "comp.h"
+
+// keep the firmware headers out, audio_nr.c only needs the stubs below from them
+#define __UHSDR_BOARD_CONFIG_H
+#define __freedv_mchf__
+#define __PROFILING_H
+
+#define USE_ALTERNATE_NR
+#define __MCHF_SPECIALMEM
+#define __IO volatile
+
+#define NR_BUFFER_NUM  4
+#define NR_BUFFER_SIZE 256
+#define NR_BUFFER_FIFO_SIZE (NR_BUFFER_NUM+1)
+
+typedef struct {
+   COMP samples[NR_BUFFER_SIZE];
+}  NR_Buffer;
+
+typedef struct
+{
+    NR_Buffer nr_audio_buff[NR_BUFFER_NUM];
+} MultiModeBuffer_t;
+
+static MultiModeBuffer_t mmb;
+
+static struct
+{
+    const struct
+    {
+        uint16_t id;
+        float32_t offset;
+    }* filters_p;
+    struct
+    {
+        uint8_t nb_setting;
+    } dsp;
+    uint8_t dsp_nr_strength;
+    uint8_t special_functions_enabled;
+} ts;
+
+static struct
+{
+    float32_t width;
+} FilterInfo[1];
+
+static uint32_t SystemCoreClock = 168000000;
+
+#define pow10f(x) powf(10.0, (x))
+
+#define profileTimedEventStart(x)
+#define profileTimedEventStop(x)
+#define profileCycleCount_get() 0
+
+bool is_dsp_nr(void)
+{
+    return true;
+}
+
+bool is_dsp_nb_active(void)
+{
+    return false;
+}
+
+#include "audio_nr.c"
+
+/**
+ * C version of the CMSIS bit reversal used by arm_cfft_f32, the library only has it in assembler
+ * (arm_bitreversal2.S). The table holds pairs of byte offsets of the complex values to swap.
+ */
+void arm_bitreversal_32(uint32_t* pSrc, const uint16_t bitRevLen, const uint16_t* pBitRevTable)
+{
+    for (uint16_t idx = 0; idx < bitRevLen; idx += 2)
+    {
+        const uint32_t a = pBitRevTable[idx] >> 2;
+        const uint32_t b = pBitRevTable[idx + 1] >> 2;
+        uint32_t tmp;
+
+        tmp = pSrc[a];
+        pSrc[a] = pSrc[b];
+        pSrc[b] = tmp;
+
+        tmp = pSrc[a + 1];
+        pSrc[a + 1] = pSrc[b + 1];
+        pSrc[b + 1] = tmp;
+    }
+}
+
+#define TEST_SECONDS            10
+#define TEST_HARMONIC_MIN       400.0
+#define TEST_HARMONIC_MAX       2800.0
+#define TEST_HARMONIC_SPACING   200.0
+#define TEST_HARMONIC_AMPLITUDE 0.1     // per harmonic
+#define TEST_NOISE              0.1     // sigma, +5dB SNR during the pulses over the full bandwidth
+#define TEST_KEY_PERIOD         0.5     // seconds, the signal is on during the first half
+#define TEST_SETTLE             1.0     // seconds until the first pulse
+#define TEST_INIT_FRAMES        20      // frames of the initial noise estimate, see spectral_noise_reduction_3
+#define TEST_MAX_RECON_ERROR    1e-5
+
+typedef struct
+{
+    double min_snr_gain_db;
+    double min_noise_supp_db;
+    double max_level_loss_db;
+} TestLimits_t;
+
+static const TestLimits_t test_limits_fft256 = { 5.0, 8.0, 1.5 };
+
+static const struct
+{
+    uint32_t sample_rate;
+    TestLimits_t limits_fft128; // measured: SNR +1.1dB, +0.2dB, +1.4dB; noise -11.6dB, -10.9dB, -9.7dB; level -3.80dB, -4.08dB, -3.27dB
+} test_rates[] =
+{
+    { 6000,  { 0.5, 10.5, 4.3 } },
+    { 12000, { 0.0, 10.0, 4.5 } },
+    { 24000, { 0.8, 9.0, 3.8 } },
+};
+
+static struct
+{
+    uint16_t id;
+    float32_t offset;
+} test_filter;
+
+static double Test_Gauss(uint32_t* rnd)
+{
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u1 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u2 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+/**
+ * @return envelope of the keyed signal at time t: off during the settling time, then on for the first half
+ * of each TEST_KEY_PERIOD with 5ms raised cosine edges
+ */
+static double Test_Key(double t)
+{
+    const double edge = 0.005;
+    double env = 0;
+
+    if (t >= TEST_SETTLE)
+    {
+        const double pos = fmod(t - TEST_SETTLE, TEST_KEY_PERIOD);
+        if (pos < edge)
+        {
+            env = 0.5 * (1 - cos(M_PI * pos / edge));
+        }
+        else if (pos < TEST_KEY_PERIOD / 2 - edge)
+        {
+            env = 1;
+        }
+        else if (pos < TEST_KEY_PERIOD / 2)
+        {
+            env = 0.5 * (1 - cos(M_PI * (TEST_KEY_PERIOD / 2 - pos) / edge));
+        }
+    }
+    return env;
+}
+
+static bool Test_Check(const char* name, bool ok)
+{
+    printf("  %-56s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/**
+ * Sets the engine up like NR_Init() and the buffer producer do, the passband covers all bins but DC
+ */
+static void Test_NrInit(bool fft_256, uint32_t sample_rate)
+{
+    NR_Init();
+    nr_params.fft_256_enable = fft_256;
+    nr_params.NR_sample_rate = sample_rate;
+    NR2.power_threshold_int = 40;
+
+    test_filter.offset = sample_rate / 4.0;
+    FilterInfo[0].width = sample_rate / 2.0;
+    ts.filters_p = (void*)&test_filter;
+}
+
+static bool Test_Engine(bool fft_256, uint32_t sample_rate, const TestLimits_t* limits)
+{
+    bool ok = true;
+    float32_t in[NR_FFT_SIZE];
+    float32_t out[NR_FFT_SIZE];
+    uint32_t rnd = 1;
+
+    const uint16_t fft_l = fft_256 ? 256 : 128;
+    const uint16_t hop = fft_l / 2;
+    const uint32_t buffers = TEST_SECONDS * sample_rate / NR_FFT_SIZE;
+    const uint32_t len = buffers * NR_FFT_SIZE;
+    const uint32_t init_len = TEST_INIT_FRAMES * hop;
+
+    float32_t* sig = malloc(len * sizeof(float32_t));
+    float32_t* noisy = malloc(len * sizeof(float32_t));
+    float32_t* result = malloc(len * sizeof(float32_t));
+
+    for (uint32_t idx = 0; idx < len; idx++)
+    {
+        double v = 0;
+        // fixed but different start phases keep the crest factor of the sum low
+        for (uint32_t h = TEST_HARMONIC_MIN / TEST_HARMONIC_SPACING; h * TEST_HARMONIC_SPACING <= TEST_HARMONIC_MAX; h++)
+        {
+            v += sin(2 * M_PI * h * TEST_HARMONIC_SPACING * idx / sample_rate + h * h);
+        }
+        sig[idx] = TEST_HARMONIC_AMPLITUDE * Test_Key((double)idx / sample_rate) * v;
+        noisy[idx] = sig[idx] + TEST_NOISE * Test_Gauss(&rnd);
+    }
+
+    Test_NrInit(fft_256, sample_rate);
+
+    const clock_t start = clock();
+    for (uint32_t buf = 0; buf < buffers; buf++)
+    {
+        memcpy(in, &noisy[buf * NR_FFT_SIZE], sizeof(in));
+        spectral_noise_reduction_3(in, out);
+        memcpy(&result[buf * NR_FFT_SIZE], out, sizeof(out));
+    }
+    const double us_per_buffer = (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / buffers;
+
+    // the output is delayed by hop samples
+    double recon_error = 0;
+    for (uint32_t idx = hop; idx < init_len; idx++)
+    {
+        recon_error = fmax(recon_error, fabs(result[idx] - noisy[idx - hop]));
+    }
+
+    // signal level from the middle of the pulses, noise suppression from the middle of the gaps
+    double sig_gain = 0;
+    double sig_power = 0;
+    double gap_in = 0;
+    double gap_out = 0;
+    for (uint32_t idx = TEST_SETTLE * sample_rate + hop; idx < len; idx++)
+    {
+        const double t = fmod((double)(idx - hop) / sample_rate - TEST_SETTLE, TEST_KEY_PERIOD) / TEST_KEY_PERIOD;
+        if (t > 0.1 && t < 0.4)
+        {
+            sig_gain += result[idx] * sig[idx - hop];
+            sig_power += sig[idx - hop] * sig[idx - hop];
+        }
+        else if (t > 0.6 && t < 0.9)
+        {
+            gap_in += noisy[idx - hop] * noisy[idx - hop];
+            gap_out += result[idx] * result[idx];
+        }
+    }
+    sig_gain /= sig_power;
+
+    // SNR over everything after the settling time, the noise is what is left after removing the scaled signal
+    double signal = 0;
+    double noise_in = 0;
+    double noise_out = 0;
+    for (uint32_t idx = TEST_SETTLE * sample_rate + hop; idx < len; idx++)
+    {
+        const double t = sig[idx - hop];
+        const double n_in = noisy[idx - hop] - t;
+        const double n_out = result[idx] - sig_gain * t;
+        signal += t * t;
+        noise_in += n_in * n_in;
+        noise_out += n_out * n_out;
+    }
+
+    const double snr_in_db = 10 * log10(signal / noise_in);
+    const double snr_out_db = 10 * log10(sig_gain * sig_gain * signal / noise_out);
+    const double supp_db = 10 * log10(gap_in / gap_out);
+    const double level_db = 20 * log10(fabs(sig_gain));
+
+    printf("\nFFT%u at %5uHz: budget %7u cycles (%.1fms at %uMHz), host %6.1fus per buffer of %d samples\n",
+            fft_l, (unsigned int)sample_rate, (unsigned int)nr_params.cycles_budget,
+            nr_params.cycles_budget * 1e3 / SystemCoreClock, (unsigned int)(SystemCoreClock / 1000000),
+            us_per_buffer, NR_FFT_SIZE);
+    printf("  reconstruction error %.2g, SNR %.1fdB -> %.1fdB, noise between the pulses -%.1fdB, signal level %+.2fdB\n",
+            recon_error, snr_in_db, snr_out_db, supp_db, level_db);
+
+    ok &= Test_Check("transparent while estimating the initial noise", recon_error < TEST_MAX_RECON_ERROR);
+    char name[64];
+    snprintf(name, sizeof(name), "SNR improved by at least %.1fdB", limits->min_snr_gain_db);
+    ok &= Test_Check(name, snr_out_db - snr_in_db > limits->min_snr_gain_db);
+    snprintf(name, sizeof(name), "noise between the pulses at least %.1fdB lower", limits->min_noise_supp_db);
+    ok &= Test_Check(name, supp_db > limits->min_noise_supp_db);
+    snprintf(name, sizeof(name), "signal level kept within %.1fdB", limits->max_level_loss_db);
+    ok &= Test_Check(name, fabs(level_db) < limits->max_level_loss_db);
+    ok &= Test_Check("cycle budget matches the buffer time",
+            nr_params.cycles_budget == (uint32_t)((uint64_t)SystemCoreClock * NR_FFT_SIZE / sample_rate));
+
+    free(sig);
+    free(noisy);
+    free(result);
+    return ok;
+}
+
+static void Test_Usage(const char* prog)
+{
+    printf("usage: %s [-c MHz]\n", prog);
+    printf("  -c  target core clock for the cycle budget (%u)\n", (unsigned int)(SystemCoreClock / 1000000));
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "c:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': SystemCoreClock = atoi(optarg) * 1000000; break;
+        default:
+            Test_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    bool ok = true;
+    for (uint32_t idx = 0; idx < sizeof(test_rates) / sizeof(test_rates[0]); idx++)
+    {
+        ok &= Test_Engine(false, test_rates[idx].sample_rate, &test_rates[idx].limits_fft128);
+        ok &= Test_Engine(true, test_rates[idx].sample_rate, &test_limits_fft256);
+    }
+
+    printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+    return ok ? 0 : 1;
+}
@@ -14,6 +14,7 @@
 
 // Common
 #include "uhsdr_board.h"
+#include <string.h>
 #include "profiling.h"
 
 /*
@@ -67,3 +68,75 @@ void profileEventsTracePrint()
             }
 #endif
 }
+
+/**
+ * Records the period of the main loop, to be called once per main loop pass
+ */
+void profileMainLoop()
+{
+#ifdef PROFILE_EVENTS
+    // upper limits of the histogram bins in us
+    static const uint32_t loop_bin_us[PROFILE_LOOP_BINS - 1] = { 100, 250, 500, 1000, 2500, 5000, 10000 };
+
+    const uint32_t now = profileCycleCount_get();
+
+    if (eventProfile.loop_start != 0)
+    {
+        const uint32_t period_us = (now - eventProfile.loop_start) / (SystemCoreClock / 1000000);
+
+        uint32_t bin = 0;
+        while (bin < PROFILE_LOOP_BINS - 1 && period_us >= loop_bin_us[bin])
+        {
+            bin++;
+        }
+        if (eventProfile.loop_histogram[bin] < UINT16_MAX)
+        {
+            eventProfile.loop_histogram[bin]++;
+        }
+    }
+    eventProfile.loop_start = now;
+#endif
+}
+
+#ifdef PROFILE_EVENTS
+static uint16_t profileTimedEventAverageUs(const ProfiledEventNames pe, const uint32_t cycles_per_us)
+{
+    const ProfilingTimedEvent* ev_ptr = profileTimedEventGet(pe);
+    return ev_ptr->count == 0 ? 0 : ev_ptr->duration / ((uint64_t)ev_ptr->count * cycles_per_us);
+}
+#endif
+
+/**
+ * Calculates the UI statistics (eventProfile.ui_stats) since the last call and restarts the measurement.
+ * The interval should be well below 25s, the cycle counter wraps around after 2^32 cycles.
+ */
+void profileUiStatsUpdate()
+{
+#ifdef PROFILE_EVENTS
+    const uint32_t now = profileCycleCount_get();
+    const uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    const uint32_t interval_us = (now - eventProfile.ui_stats_start) / cycles_per_us;
+
+    if (interval_us > 0)
+    {
+        ProfileUiStats_t* stats = &eventProfile.ui_stats;
+
+        stats->interval_ms = interval_us / 1000;
+        stats->spectrum_us = profileTimedEventAverageUs(ProfileUiSpectrum, cycles_per_us);
+        stats->spectrum_per_s = (uint64_t)eventProfile.event[ProfileUiSpectrum].count * 1000000 / interval_us;
+        stats->meters_us = profileTimedEventAverageUs(ProfileUiMeters, cycles_per_us);
+        stats->lcd_write_us = profileTimedEventAverageUs(ProfileLcdWrite, cycles_per_us);
+        stats->lcd_dma_wait_permille = eventProfile.event[ProfileLcdDmaWait].duration * 1000 / ((uint64_t)interval_us * cycles_per_us);
+        stats->lcd_bytes_per_s = (uint64_t)eventProfile.lcd_bytes * 1000000 / interval_us;
+        memcpy(stats->loop_histogram, eventProfile.loop_histogram, sizeof(stats->loop_histogram));
+    }
+
+    profileTimedEventReset(ProfileUiSpectrum);
+    profileTimedEventReset(ProfileUiMeters);
+    profileTimedEventReset(ProfileLcdWrite);
+    profileTimedEventReset(ProfileLcdDmaWait);
+    eventProfile.lcd_bytes = 0;
+    memset(eventProfile.loop_histogram, 0, sizeof(eventProfile.loop_histogram));
+    eventProfile.ui_stats_start = now;
+#endif
+}
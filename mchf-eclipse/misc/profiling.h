@@ -28,6 +28,10 @@ typedef enum {
     ProfileTP9,
     ProfileFreeDV,
     FreeDVTXUnderrun,
+    ProfileUiSpectrum,      // drawing of scope and waterfall
+    ProfileUiMeters,        // update of all meters
+    ProfileLcdWrite,        // UiLcdHy28_BulkWrite
+    ProfileLcdDmaWait,      // waiting for the end of a LCD SPI DMA transfer
     EventProfileMax
 } ProfiledEventNames;
 
@@ -38,8 +42,30 @@ typedef struct {
     uint64_t duration; // to get average divide duration by count
 } ProfilingTimedEvent;
 
+#define PROFILE_LOOP_BINS 8     // main loop period ranges: <100us, <250us, <500us, <1ms, <2.5ms, <5ms, <10ms, >=10ms
+
+/*
+ * UI statistics of the last interval, see profileUiStatsUpdate()
+ * This is sent as is (little endian) as response to the CAT command UHSDR_UI_PROFILE, do not change the layout.
+ */
+typedef struct {
+    uint16_t interval_ms;           // length of the interval
+    uint16_t spectrum_us;           // average duration of drawing scope and waterfall
+    uint16_t spectrum_per_s;        // scope/waterfall updates per second
+    uint16_t meters_us;             // average duration of updating the meters
+    uint16_t lcd_write_us;          // average duration of a LCD bulk write
+    uint16_t lcd_dma_wait_permille; // part of the time spent waiting for the LCD SPI DMA
+    uint32_t lcd_bytes_per_s;       // pixel data sent to the LCD
+    uint16_t loop_histogram[PROFILE_LOOP_BINS]; // number of main loop passes per period range
+} ProfileUiStats_t;
+
 typedef struct {
     ProfilingTimedEvent event[EventProfileMax];
+    uint32_t lcd_bytes;             // pixel data sent to the LCD since the last UI statistics update
+    uint32_t loop_start;            // cycle count at the start of the current main loop pass
+    uint16_t loop_histogram[PROFILE_LOOP_BINS];
+    uint32_t ui_stats_start;        // cycle count at the last UI statistics update
+    ProfileUiStats_t ui_stats;
 } EventProfile_t;
 
 extern EventProfile_t eventProfile;
@@ -75,6 +101,8 @@ inline void profileEvent(const ProfiledEventNames pe) {
  */
 
 void profileEventsTracePrint();
+void profileMainLoop();
+void profileUiStatsUpdate();
 
 
 inline void profileTimedEventInit();
@@ -82,6 +110,7 @@ inline void profileTimedEventStart(const ProfiledEventNames pe);
 inline void profileTimedEventStop(const ProfiledEventNames pe);
 inline void profileTimedEventReset(const ProfiledEventNames pe);
 inline  ProfilingTimedEvent* profileTimedEventGet(const ProfiledEventNames pe);
+inline void profileLcdBytes(const uint32_t bytes);
 
 
 // INLINE IMPLEMENTATIONS
@@ -166,6 +195,13 @@ inline  ProfilingTimedEvent* profileTimedEventGet(const ProfiledEventNames pe)
     return pe_ptr;
 }
 
+inline void profileLcdBytes(const uint32_t bytes)
+{
+#ifdef PROFILE_EVENTS
+    eventProfile.lcd_bytes += bytes;
+#endif
+}
+
 
 
 #endif
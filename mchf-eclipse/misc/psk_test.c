@@ -0,0 +1,369 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     psk_test.c                                                      **
+ **  Description:   host test of the BPSK demodulator and its AFC                   **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It builds psk.c for the build host and feeds the demodulator
+ * with a generated BPSK signal (raised cosine phase reversals, varicode text, noise) whose carrier
+ * is off the channel frequency.
+ *
+ * - tuned channel: for each speed the carrier is placed above and below PSK_OFFSET, the AFC must
+ *   move the VCO onto the carrier and the text must be decoded. With the AFC off the VCO must stay.
+ * - panorama: a signal in the slot of channel 1 has to be found by the carrier search, the AFC
+ *   must lock onto it and the channel must decode the text.
+ * - interferer rejection: a carrier TEST_REJECTION_OFFSET_MIN or more away from the channel must reach the
+ *   symbol processing at least TEST_MIN_REJECTION_DB below a carrier on the channel frequency. This is
+ *   the alias rejection of the decimation filter, measured behind the symbol rate lowpass of the
+ *   widest speed, so nothing else helps.
+ *
+ * psk.c is included below, the UI, radio management and audio driver headers it uses are replaced by
+ * the few stubs it needs. Build and run with "make psk-test", see Makefile.
+ * The exit code is not 0 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+
+// keep the firmware headers out, psk.c only needs the stubs below from them
+#define __UI_DRIVER_H
+#define DRIVERS_UI_RADIO_MANAGEMENT_H_
+#define __AUDIO_DRIVER_H
+
+void UiDriver_TextMsgPutChar(char ch);
+void RadioManagement_Request_TxOff(void);
+
+static struct
+{
+    int af_disabled;
+} ads;
+
+#include "psk.c"
+
+#define TEST_BLOCK_SIZE     16      // 12ksps samples per call of the demodulator
+#define TEST_AMPLITUDE      0.5
+#define TEST_NOISE          0.1     // noise sigma, 14dB SNR in a 3kHz bandwidth
+#define TEST_AFC_TOLERANCE  0.5     // Hz between locked VCO and carrier
+#define TEST_TEXT_LEN       1024
+#define TEST_SECONDS_DEFAULT 20
+#define TEST_MIN_REJECTION_DB       70.0
+#define TEST_REJECTION_OFFSET_MIN   375.0   // Hz, the decimation filter stopband starts PSK_DECIM_RATE - 125Hz away
+#define TEST_REJECTION_SETTLE       0.5     // seconds before the measurement starts
+#define TEST_REJECTION_LEN          2.0     // seconds of measurement
+
+static const char test_message[] = "CQ CQ de UHSDR pse k ";
+
+static char test_text[TEST_TEXT_LEN];
+static uint32_t test_text_len;
+
+void UiDriver_TextMsgPutChar(char ch)
+{
+    if (test_text_len < TEST_TEXT_LEN - 1)
+    {
+        test_text[test_text_len++] = ch;
+        test_text[test_text_len] = '\0';
+    }
+}
+
+void RadioManagement_Request_TxOff()
+{
+}
+
+uint8_t DigiModes_TxBufferHasData()
+{
+    return 0;
+}
+
+bool DigiModes_TxBufferRemove(uint8_t* c_ptr, digi_buff_consumer_t consumer)
+{
+    return false;
+}
+
+typedef struct
+{
+    double freq;
+    double phase;
+    double baud;
+    double symbol_pos;      // position within the current symbol, 0..1
+    int8_t sign_last;       // carrier sign of the previous symbol
+    int8_t sign;            // carrier sign of the current symbol
+    uint32_t bits;          // bits of the current character, sent MSB first
+    uint8_t bit_count;      // number of bits of the current character left to send
+    uint32_t preamble;      // number of reversals still to send before the text starts
+    uint32_t msg_idx;
+    uint32_t rnd;
+} TestBpskTx_t;
+
+static double Test_Gauss(uint32_t* rnd)
+{
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u1 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u2 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static void Test_TxInit(TestBpskTx_t* tx, double freq, double baud)
+{
+    memset(tx, 0, sizeof(*tx));
+    tx->freq = freq;
+    tx->phase = 1.0;
+    tx->baud = baud;
+    tx->sign_last = 1;
+    tx->sign = 1;
+    tx->preamble = 32;
+    tx->rnd = 1;
+}
+
+/**
+ * @return next bit to send: preamble zeros, then the varicode of the message followed by two zeros per char
+ */
+static uint8_t Test_TxNextBit(TestBpskTx_t* tx)
+{
+    uint8_t bit = 0;
+    if (tx->preamble > 0)
+    {
+        tx->preamble--;
+    }
+    else
+    {
+        if (tx->bit_count == 0)
+        {
+            // varicode followed by two zero bits as char separator
+            const uint16_t code = psk_varicode[(uint8_t)test_message[tx->msg_idx]];
+            tx->bits = code << 2;
+            tx->bit_count = 2;
+            while ((code >> (tx->bit_count - 2)) != 0)
+            {
+                tx->bit_count++;
+            }
+            tx->msg_idx = (tx->msg_idx + 1) % (sizeof(test_message) - 1);
+        }
+        tx->bit_count--;
+        bit = (tx->bits >> tx->bit_count) & 1;
+    }
+    return bit;
+}
+
+/**
+ * Generates BPSK at the 12ksps rate of the demodulator, a zero bit is a phase reversal with a
+ * raised cosine envelope, a one bit keeps the carrier
+ */
+static void Test_TxGen(TestBpskTx_t* tx, float32_t* dst, uint16_t len)
+{
+    for (uint16_t idx = 0; idx < len; idx++)
+    {
+        const double env = 0.5 * (1 + cos(M_PI * tx->symbol_pos));
+        const double amp = tx->sign_last * env + tx->sign * (1 - env);
+        dst[idx] = TEST_AMPLITUDE * amp * cos(tx->phase) + TEST_NOISE * Test_Gauss(&tx->rnd);
+
+        tx->phase = fmod(tx->phase + 2 * M_PI * tx->freq / PSK_SAMPLE_RATE, 2 * M_PI);
+        tx->symbol_pos += tx->baud / PSK_SAMPLE_RATE;
+        if (tx->symbol_pos >= 1.0)
+        {
+            tx->symbol_pos -= 1.0;
+            tx->sign_last = tx->sign;
+            if (Test_TxNextBit(tx) == 0)
+            {
+                tx->sign = -tx->sign;
+            }
+        }
+    }
+}
+
+static bool Test_Check(const char* name, bool ok)
+{
+    printf("  %-56s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static void Test_Run(TestBpskTx_t* tx, int seconds)
+{
+    float32_t buf[TEST_BLOCK_SIZE];
+
+    test_text_len = 0;
+    test_text[0] = '\0';
+    for (uint32_t n = 0; n < (uint32_t)seconds * PSK_SAMPLE_RATE; n += TEST_BLOCK_SIZE)
+    {
+        Test_TxGen(tx, buf, TEST_BLOCK_SIZE);
+        Psk_Demodulator_ProcessBlock(buf, TEST_BLOCK_SIZE);
+    }
+}
+
+/**
+ * Tuned channel with a carrier off PSK_OFFSET
+ */
+static bool Test_Tuned(psk_speed_t speed, double offset, bool afc, int seconds)
+{
+    bool ok = true;
+    TestBpskTx_t tx;
+
+    psk_ctrl_config.speed_idx = speed;
+    psk_ctrl_config.afc_enable = afc;
+    psk_ctrl_config.panorama_enable = false;
+    Psk_Modem_Init(PSK_SAMPLE_RATE);
+
+    Test_TxInit(&tx, PSK_OFFSET + offset, psk_speeds[speed].value);
+    Test_Run(&tx, seconds);
+
+    const float32_t freq = Psk_Demodulator_GetChannelFreq(0);
+    printf("\nBPSK%s carrier %+.1fHz, AFC %s: VCO %.2fHz, %s\n", psk_speeds[speed].label, offset, afc ? "on" : "off",
+            freq, Psk_Demodulator_IsChannelLocked(0) ? "locked" : "not locked");
+    printf("  text: %.60s\n", test_text);
+
+    if (afc)
+    {
+        ok &= Test_Check("AFC follows the carrier", fabs(freq - tx.freq) < TEST_AFC_TOLERANCE);
+        ok &= Test_Check("channel locked", Psk_Demodulator_IsChannelLocked(0));
+        // the second half of the output, the text has to be decoded all the time, not only at the start
+        ok &= Test_Check("text decoded", strstr(&test_text[test_text_len / 2], test_message) != NULL);
+    }
+    else
+    {
+        ok &= Test_Check("VCO stays on the channel frequency", freq == PSK_OFFSET);
+    }
+    return ok;
+}
+
+/**
+ * Panorama channel 1 has to find a signal in its slot
+ */
+static bool Test_Panorama(double freq, int seconds)
+{
+    bool ok = true;
+    TestBpskTx_t tx;
+
+    psk_ctrl_config.speed_idx = PSK_SPEED_31;
+    psk_ctrl_config.afc_enable = true;
+    psk_ctrl_config.panorama_enable = true;
+    Psk_Modem_Init(PSK_SAMPLE_RATE);
+
+    Test_TxInit(&tx, freq, psk_speeds[PSK_SPEED_31].value);
+    Test_Run(&tx, seconds);
+
+    const float32_t chan_freq = Psk_Demodulator_GetChannelFreq(1);
+    printf("\npanorama, BPSK 31 carrier at %.1fHz: channel 1 VCO %.2fHz, %s\n", freq, chan_freq,
+            Psk_Demodulator_IsChannelLocked(1) ? "locked" : "not locked");
+    printf("  text: %.60s\n", test_text);
+
+    ok &= Test_Check("channel 1 finds the carrier", fabs(chan_freq - freq) < TEST_AFC_TOLERANCE);
+    ok &= Test_Check("channel 1 locked", Psk_Demodulator_IsChannelLocked(1));
+    ok &= Test_Check("text decoded", strstr(test_text, "|1:") != NULL && strstr(test_text, "UHSDR") != NULL);
+    ok &= Test_Check("tuned channel does not decode it", Psk_Demodulator_IsChannelLocked(0) == false);
+    return ok;
+}
+
+/**
+ * Feeds a carrier to the tuned channel and measures the power of the baseband behind the symbol rate lowpass
+ * @return power relative to full scale in dB
+ */
+static double Test_ChannelPower(double freq)
+{
+    float32_t buf[TEST_BLOCK_SIZE];
+    const PskChannel_t* chan = &psk_state.rx_chan[0];
+
+    psk_ctrl_config.speed_idx = PSK_SPEED_125;
+    psk_ctrl_config.afc_enable = false;
+    psk_ctrl_config.panorama_enable = false;
+    Psk_Modem_Init(PSK_SAMPLE_RATE);
+
+    double sum = 0;
+    uint32_t count = 0;
+    const double phase_step = 2 * M_PI * freq / PSK_SAMPLE_RATE;
+    for (uint32_t n = 0; n < (TEST_REJECTION_SETTLE + TEST_REJECTION_LEN) * PSK_SAMPLE_RATE; n += TEST_BLOCK_SIZE)
+    {
+        for (uint32_t idx = 0; idx < TEST_BLOCK_SIZE; idx++)
+        {
+            buf[idx] = TEST_AMPLITUDE * cos(fmod(phase_step * (n + idx), 2 * M_PI));
+        }
+        Psk_Demodulator_ProcessBlock(buf, TEST_BLOCK_SIZE);
+
+        if (n >= TEST_REJECTION_SETTLE * PSK_SAMPLE_RATE)
+        {
+            sum += (double)chan->prev_re * chan->prev_re + (double)chan->prev_im * chan->prev_im;
+            count++;
+        }
+    }
+    return sum > 0 ? 10 * log10(sum / count) : -300.0;
+}
+
+/**
+ * Carriers outside the channel must not reach the symbol processing
+ */
+static bool Test_Rejection(void)
+{
+    static const double offsets[] = { -375, 375, 400, 450, 500, 550, 625, 750, 1000, 1500, 2000, 3000, 4500 };
+
+    const double ref = Test_ChannelPower(PSK_OFFSET);
+    double worst = -1000, worst_offset = 0;
+    for (uint32_t idx = 0; idx < sizeof(offsets) / sizeof(offsets[0]); idx++)
+    {
+        const double rel = Test_ChannelPower(PSK_OFFSET + offsets[idx]) - ref;
+        if (rel > worst)
+        {
+            worst = rel;
+            worst_offset = offsets[idx];
+        }
+    }
+
+    printf("\ninterferer %.0fHz or more off the channel: worst %.1fdB at %+.0fHz\n", TEST_REJECTION_OFFSET_MIN, worst, worst_offset);
+
+    char name[64];
+    snprintf(name, sizeof(name), "interferer rejected by at least %.0fdB", TEST_MIN_REJECTION_DB);
+    return Test_Check(name, worst < -TEST_MIN_REJECTION_DB);
+}
+
+static void Test_Usage(const char* prog)
+{
+    printf("usage: %s [-t seconds]\n", prog);
+    printf("  -t  signal length per test in seconds (%d), the panorama test runs twice as long\n", TEST_SECONDS_DEFAULT);
+}
+
+int main(int argc, char* argv[])
+{
+    int seconds = TEST_SECONDS_DEFAULT;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': seconds = atoi(optarg); break;
+        default:
+            Test_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    // the AFC pull-in range is limited by the quality threshold: the phase drift per symbol must stay
+    // well below 45 degrees, i.e. the carrier within about a tenth of the baud rate
+    bool ok = true;
+    ok &= Test_Tuned(PSK_SPEED_31, 3.0, true, seconds);
+    ok &= Test_Tuned(PSK_SPEED_31, -3.0, true, seconds);
+    ok &= Test_Tuned(PSK_SPEED_63, 6.0, true, seconds);
+    ok &= Test_Tuned(PSK_SPEED_63, -6.0, true, seconds);
+    ok &= Test_Tuned(PSK_SPEED_125, 12.0, true, seconds);
+    ok &= Test_Tuned(PSK_SPEED_125, -12.0, true, seconds);
+    ok &= Test_Tuned(PSK_SPEED_31, 3.0, false, seconds);
+    // the search sweeps upwards, the second carrier is first met half the baud rate below it, where
+    // the squared symbol phase is as stable as on the carrier itself
+    ok &= Test_Panorama(PSK_OFFSET + PSK_PANORAMA_SPACING + 12.0, 2 * seconds);
+    ok &= Test_Panorama(PSK_OFFSET + PSK_PANORAMA_SPACING + 47.0, 2 * seconds);
+    ok &= Test_Rejection();
+
+    printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+    return ok ? 0 : 1;
+}
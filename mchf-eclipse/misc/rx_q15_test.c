@@ -0,0 +1,362 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     rx_q15_test.c                                                   **
+ **  Description:   host comparison of the Q15 and the float SSB receive path       **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It runs the decimation, Hilbert transform and sideband
+ * demodulation of the SSB/CW receiver with the float CMSIS functions (as in AudioDriver_RxProcessor)
+ * and with the Q15 path of the firmware (rx_q15.c, USE_RX_Q15) on the same 16 bit IQ input and compares the results.
+ *
+ * - noise floor: receiver noise of a few LSB only, the Q15 path adds about 0.5 LSB rms of its own
+ *   (truncation of the filter outputs). This is printed down to the codec noise level, the audio
+ *   noise floor must not rise noticeably from TEST_NOISE_FLOOR_MIN LSB of receiver noise on.
+ * - strong signal: a tone near full scale, the difference between both paths must stay far below
+ *   the signal and the Q15 path must not clip
+ * - opposite sideband: suppression of a tone in the other sideband, it must stay above
+ *   TEST_MIN_SUPP_DB with the Q15 coefficients
+ *
+ * Both filter paths of SSB are covered: bandwidths up to 3k6 decimate before the 199 tap
+ * Hilbert filter (with either decimation filter), wider ones decimate after the 89 tap Hilbert filter.
+ *
+ * rx_q15.c and the filter tables are included below, the board header is kept out.
+ * Build and run with "make rx-q15-test", see Makefile.
+ * The exit code is not 0 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+
+// keep the HAL out, the filter tables only need arm_math.h
+#define __MCHF_BOARD_H
+
+// as in uhsdr_board_config.h
+#define IQ_BLOCK_SIZE (32)
+// the Q15 path under test, all memory is the same on the host
+#define USE_RX_Q15
+#define __MCHF_SPECIALMEM
+
+#include "filters.h"
+#include "iq_rx_filter.c"
+#include "fir_rx_decimate_4.c"
+#include "rx_q15.c"
+
+#define TEST_SAMPLE_RATE        48000
+#define TEST_BLOCK_SIZE         IQ_BLOCK_SIZE
+#define TEST_DECIMATION_RATE    4       // RX_DECIMATION_RATE_12KHZ
+#define TEST_SETTLE_SAMPLES     1024    // 12ksps output samples not evaluated while the filters fill up
+#define TEST_TONE_FREQ          1000.0
+#define TEST_SECONDS_DEFAULT    4
+
+#define TEST_MAX_NOISE_RISE_DB  0.5     // at TEST_NOISE_FLOOR_MIN LSB receiver noise
+#define TEST_NOISE_FLOOR_MIN    4.0
+#define TEST_MIN_SINAD_DB       70      // strong signal, float path as reference
+#define TEST_MIN_SUPP_DB        70      // opposite sideband suppression
+
+typedef struct
+{
+    const char* name;
+    const float32_t* i_coeffs;
+    const float32_t* q_coeffs;
+    uint16_t num_taps;
+    const arm_fir_decimate_instance_f32* decimate;
+    bool use_decimatedIQ;
+} TestPath_t;
+
+static const TestPath_t test_paths[] =
+{
+    { "SSB <= 3k6, FirRxDecimate", i_rx_new_coeffs, q_rx_new_coeffs, IQ_RX_NUM_TAPS_HI, &FirRxDecimate, true },
+    { "SSB <= 3k6, FirRxDecimate_sideband_supp", i_rx_new_coeffs, q_rx_new_coeffs, IQ_RX_NUM_TAPS_HI, &FirRxDecimate_sideband_supp, true },
+    { "SSB 3k8 LPF", i_rx_4k5_coeffs, q_rx_4k5_coeffs, IQ_RX_NUM_TAPS, &FirRxDecimate, false },
+};
+
+typedef struct
+{
+    arm_fir_instance_f32 hilbert_i;
+    arm_fir_instance_f32 hilbert_q;
+    arm_fir_decimate_instance_f32 decimate_i;
+    arm_fir_decimate_instance_f32 decimate_q;
+    float32_t hilbert_state_i[IQ_RX_NUM_TAPS_MAX + TEST_BLOCK_SIZE];
+    float32_t hilbert_state_q[IQ_RX_NUM_TAPS_MAX + TEST_BLOCK_SIZE];
+    float32_t decimate_state_i[IQ_RX_NUM_TAPS + TEST_BLOCK_SIZE];
+    float32_t decimate_state_q[IQ_RX_NUM_TAPS + TEST_BLOCK_SIZE];
+} TestRx_t;
+
+typedef struct
+{
+    float32_t* out_float;
+    float32_t* out_q15;
+    uint32_t len;
+} TestResult_t;
+
+static TestRx_t test_rx;
+
+static double Test_Gauss(uint32_t* rnd)
+{
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u1 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u2 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+/**
+ * Sets up the float filters like AudioFilter_SetRxHilbertAndDecimationFIR(), the Q15 path from them as the firmware does
+ */
+static void Test_RxInit(TestRx_t* rx, const TestPath_t* path)
+{
+    memset(rx, 0, sizeof(*rx));
+
+    arm_fir_init_f32(&rx->hilbert_i, path->num_taps, (float32_t*)path->i_coeffs, rx->hilbert_state_i, TEST_BLOCK_SIZE);
+    arm_fir_init_f32(&rx->hilbert_q, path->num_taps, (float32_t*)path->q_coeffs, rx->hilbert_state_q, TEST_BLOCK_SIZE);
+    arm_fir_decimate_init_f32(&rx->decimate_i, path->decimate->numTaps, TEST_DECIMATION_RATE,
+            path->decimate->pCoeffs, rx->decimate_state_i, TEST_BLOCK_SIZE);
+    arm_fir_decimate_init_f32(&rx->decimate_q, path->decimate->numTaps, TEST_DECIMATION_RATE,
+            path->decimate->pCoeffs, rx->decimate_state_q, TEST_BLOCK_SIZE);
+
+    RxQ15_SetRxHilbertAndDecimationFIR(&rx->hilbert_i, &rx->hilbert_q, &rx->decimate_i);
+}
+
+/**
+ * USB demodulation of one block with the float functions, as in AudioDriver_RxProcessor()
+ */
+static void Test_RxFloat(TestRx_t* rx, bool use_decimatedIQ, float32_t* i_buffer, float32_t* q_buffer, float32_t* dst)
+{
+    const uint16_t blockSizeDecim = TEST_BLOCK_SIZE / TEST_DECIMATION_RATE;
+    const uint16_t blockSizeIQ = use_decimatedIQ ? blockSizeDecim : TEST_BLOCK_SIZE;
+
+    if (use_decimatedIQ)
+    {
+        arm_fir_decimate_f32(&rx->decimate_i, i_buffer, i_buffer, TEST_BLOCK_SIZE);
+        arm_fir_decimate_f32(&rx->decimate_q, q_buffer, q_buffer, TEST_BLOCK_SIZE);
+    }
+    arm_fir_f32(&rx->hilbert_i, i_buffer, i_buffer, blockSizeIQ);
+    arm_fir_f32(&rx->hilbert_q, q_buffer, q_buffer, blockSizeIQ);
+    arm_add_f32(i_buffer, q_buffer, i_buffer, blockSizeIQ);
+    if (use_decimatedIQ == false)
+    {
+        arm_fir_decimate_f32(&rx->decimate_i, i_buffer, i_buffer, blockSizeIQ);
+    }
+    memcpy(dst, i_buffer, blockSizeDecim * sizeof(float32_t));
+}
+
+/**
+ * Feeds both paths with a tone of the given amplitude (negative frequency = LSB) plus gaussian noise,
+ * rounded to 16 bit like the codec samples
+ */
+static void Test_Run(const TestPath_t* path, double freq, double amplitude, double noise, int seconds, TestResult_t* res)
+{
+    float32_t i_buffer[TEST_BLOCK_SIZE];
+    float32_t q_buffer[TEST_BLOCK_SIZE];
+    float32_t i_copy[TEST_BLOCK_SIZE];
+    float32_t q_copy[TEST_BLOCK_SIZE];
+    uint32_t rnd = 1;
+    double phase = 0;
+
+    const uint32_t blocks = (uint32_t)seconds * TEST_SAMPLE_RATE / TEST_BLOCK_SIZE;
+    const uint32_t blockSizeDecim = TEST_BLOCK_SIZE / TEST_DECIMATION_RATE;
+
+    res->len = blocks * blockSizeDecim;
+    res->out_float = malloc(res->len * sizeof(float32_t));
+    res->out_q15 = malloc(res->len * sizeof(float32_t));
+
+    Test_RxInit(&test_rx, path);
+
+    for (uint32_t block = 0; block < blocks; block++)
+    {
+        for (uint16_t idx = 0; idx < TEST_BLOCK_SIZE; idx++)
+        {
+            const double i = amplitude * cos(phase) + noise * Test_Gauss(&rnd);
+            const double q = amplitude * sin(phase) + noise * Test_Gauss(&rnd);
+            i_buffer[idx] = fmin(fmax(round(i), -32768), 32767);
+            q_buffer[idx] = fmin(fmax(round(q), -32768), 32767);
+            phase = fmod(phase + 2 * M_PI * freq / TEST_SAMPLE_RATE, 2 * M_PI);
+        }
+        memcpy(i_copy, i_buffer, sizeof(i_copy));
+        memcpy(q_copy, q_buffer, sizeof(q_copy));
+
+        RxQ15_SidebandDemod(i_copy, q_copy, &res->out_q15[block * blockSizeDecim], false, path->use_decimatedIQ,
+                TEST_BLOCK_SIZE, path->use_decimatedIQ ? blockSizeDecim : TEST_BLOCK_SIZE, blockSizeDecim);
+        Test_RxFloat(&test_rx, path->use_decimatedIQ, i_buffer, q_buffer, &res->out_float[block * blockSizeDecim]);
+    }
+}
+
+static void Test_Free(TestResult_t* res)
+{
+    free(res->out_float);
+    free(res->out_q15);
+}
+
+static double Test_Mean(const float32_t* x, uint32_t len)
+{
+    double sum = 0;
+    for (uint32_t idx = TEST_SETTLE_SAMPLES; idx < len; idx++)
+    {
+        sum += x[idx];
+    }
+    return sum / (len - TEST_SETTLE_SAMPLES);
+}
+
+/**
+ * @return power of x, or of x - y if y is not NULL, without the DC component
+ */
+static double Test_Power(const float32_t* x, const float32_t* y, uint32_t len)
+{
+    const double mean = Test_Mean(x, len) - (y != NULL ? Test_Mean(y, len) : 0);
+    double sum = 0;
+    for (uint32_t idx = TEST_SETTLE_SAMPLES; idx < len; idx++)
+    {
+        const double v = x[idx] - (y != NULL ? y[idx] : 0) - mean;
+        sum += v * v;
+    }
+    return sum / (len - TEST_SETTLE_SAMPLES);
+}
+
+static double Test_Peak(const float32_t* x, uint32_t len)
+{
+    double peak = 0;
+    for (uint32_t idx = TEST_SETTLE_SAMPLES; idx < len; idx++)
+    {
+        peak = fmax(peak, fabs(x[idx]));
+    }
+    return peak;
+}
+
+static bool Test_Check(const char* name, bool ok)
+{
+    printf("  %-56s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/**
+ * Audio noise floor of both paths with receiver noise only
+ */
+static bool Test_NoiseFloor(const TestPath_t* path, double noise, int seconds)
+{
+    bool ok = true;
+    TestResult_t res;
+
+    Test_Run(path, 0, 0, noise, seconds, &res);
+
+    const double p_float = Test_Power(res.out_float, NULL, res.len);
+    const double p_err = Test_Power(res.out_q15, res.out_float, res.len);
+    const double rise_db = 10 * log10((p_float + p_err) / p_float);
+
+    printf("  noise %4.1f LSB: float %6.2f LSB rms, Q15 error %5.2f LSB rms, DC %+5.2f LSB, noise floor +%.2fdB\n",
+            noise, sqrt(p_float), sqrt(p_err), Test_Mean(res.out_q15, res.len) - Test_Mean(res.out_float, res.len), rise_db);
+    if (noise >= TEST_NOISE_FLOOR_MIN)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "noise floor rise at %.0f LSB below %.1fdB", noise, TEST_MAX_NOISE_RISE_DB);
+        ok &= Test_Check(name, rise_db < TEST_MAX_NOISE_RISE_DB);
+    }
+    Test_Free(&res);
+    return ok;
+}
+
+/**
+ * A tone near full scale, error of the Q15 path relative to the float path
+ */
+static bool Test_StrongSignal(const TestPath_t* path, double amplitude, int seconds)
+{
+    bool ok = true;
+    TestResult_t res;
+
+    Test_Run(path, TEST_TONE_FREQ, amplitude, 1.0, seconds, &res);
+
+    const double sinad_db = 10 * log10(Test_Power(res.out_float, NULL, res.len) / Test_Power(res.out_q15, res.out_float, res.len));
+    const double peak_float = Test_Peak(res.out_float, res.len);
+    const double peak_q15 = Test_Peak(res.out_q15, res.len);
+
+    printf("  tone %.0f: output peak float %.0f, Q15 %.0f, Q15 vs. float %.1fdB\n", amplitude, peak_float, peak_q15, sinad_db);
+
+    char name[64];
+    snprintf(name, sizeof(name), "Q15 error at least %ddB below the signal", TEST_MIN_SINAD_DB);
+    ok &= Test_Check(name, sinad_db > TEST_MIN_SINAD_DB);
+    if (peak_float < 32767)
+    {
+        ok &= Test_Check("no clipping", peak_q15 < 32767);
+    }
+    Test_Free(&res);
+    return ok;
+}
+
+/**
+ * Suppression of a tone in the opposite sideband
+ */
+static bool Test_OppositeSideband(const TestPath_t* path, double amplitude, int seconds)
+{
+    bool ok = true;
+    TestResult_t usb, lsb;
+
+    Test_Run(path, TEST_TONE_FREQ, amplitude, 0, seconds, &usb);
+    Test_Run(path, -TEST_TONE_FREQ, amplitude, 0, seconds, &lsb);
+
+    const double supp_float = 10 * log10(Test_Power(usb.out_float, NULL, usb.len) / Test_Power(lsb.out_float, NULL, lsb.len));
+    const double supp_q15 = 10 * log10(Test_Power(usb.out_q15, NULL, usb.len) / Test_Power(lsb.out_q15, NULL, lsb.len));
+
+    printf("  opposite sideband suppression at %.0fHz: float %.1fdB, Q15 %.1fdB\n", TEST_TONE_FREQ, supp_float, supp_q15);
+
+    char name[64];
+    snprintf(name, sizeof(name), "Q15 suppression at least %ddB", TEST_MIN_SUPP_DB);
+    ok &= Test_Check(name, supp_q15 > TEST_MIN_SUPP_DB);
+    Test_Free(&usb);
+    Test_Free(&lsb);
+    return ok;
+}
+
+static void Test_Usage(const char* prog)
+{
+    printf("usage: %s [-t seconds]\n", prog);
+    printf("  -t  signal length per test in seconds (%d)\n", TEST_SECONDS_DEFAULT);
+}
+
+int main(int argc, char* argv[])
+{
+    int seconds = TEST_SECONDS_DEFAULT;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': seconds = atoi(optarg); break;
+        default:
+            Test_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    bool ok = true;
+    for (uint32_t idx = 0; idx < sizeof(test_paths) / sizeof(test_paths[0]); idx++)
+    {
+        const TestPath_t* path = &test_paths[idx];
+
+        printf("\n%s: %d tap Hilbert, %d tap decimation %s\n", path->name, path->num_taps, path->decimate->numTaps,
+                path->use_decimatedIQ ? "before" : "after");
+        ok &= Test_NoiseFloor(path, 0.5, seconds);
+        ok &= Test_NoiseFloor(path, 1.0, seconds);
+        ok &= Test_NoiseFloor(path, 2.0, seconds);
+        ok &= Test_NoiseFloor(path, 4.0, seconds);
+        ok &= Test_NoiseFloor(path, 8.0, seconds);
+        ok &= Test_StrongSignal(path, 16000, seconds);
+        ok &= Test_StrongSignal(path, 30000, seconds);
+        ok &= Test_OppositeSideband(path, 16000, seconds);
+    }
+
+    printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+    return ok ? 0 : 1;
+}
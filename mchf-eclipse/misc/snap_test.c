@@ -0,0 +1,243 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     snap_test.c                                                     **
+ **  Description:   host test of the SNAP carrier frequency estimator               **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It builds snap_estimator.c together with the zoom fft decimator
+ * for the build host and feeds it a carrier in white noise, in blocks of IQ_BLOCK_SIZE samples as
+ * the audio interrupt does. After each block the estimate is polled as in the main loop.
+ *
+ * Each run starts with SnapEstimator_Restart() (the SNAP button) while the carrier is present.
+ * The carrier is placed at several distances from the center of the search (CW sidetone above and
+ * below the rx frequency, AM carrier at the rx frequency) with a random phase. For each SNR it checks:
+ *
+ * - frequency error: all estimates after the settling time are within +-TEST_MAX_ERROR of the true distance
+ * - settling time: the time from the restart to the first estimate from which on all estimates are within
+ *   +-TEST_MAX_ERROR is less than TEST_MAX_SETTLE
+ *
+ * The SNR is the carrier power relative to the noise power in TEST_SNR_BANDWIDTH. At +20dB the largest
+ * error is about 0.065Hz, below about +15dB single estimates start to miss the +-0.1Hz, the 171ms
+ * window is too short to average more noise out.
+ *
+ * snap_estimator.c, zoom_decimate.c and fir_zoom_fft_decimate.c are included below, the board header is kept out.
+ * Build and run with "make snap-test", see Makefile.
+ * The exit code is not 0 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+
+// keep the firmware headers out, the estimator only needs the stubs below from them
+#define __MCHF_BOARD_H
+
+// as in uhsdr_board_config.h
+#define IQ_SAMPLE_RATE (48000)
+#define IQ_SAMPLE_RATE_F ((float32_t)IQ_SAMPLE_RATE)
+#define IQ_INTERRUPT_FREQ (1500)
+#define IQ_BLOCK_SIZE (IQ_SAMPLE_RATE/IQ_INTERRUPT_FREQ)
+
+#include "arm_math.h"
+// the CMSIS barrier is an ARM instruction
+#define __DMB() __sync_synchronize()
+
+#include "fir_zoom_fft_decimate.c"
+#include "zoom_decimate.c"
+#include "snap_estimator.c"
+
+/**
+ * C version of the CMSIS bit reversal used by arm_cfft_f32 as in nr_test.c, the library only has it in assembler
+ */
+void arm_bitreversal_32(uint32_t* pSrc, const uint16_t bitRevLen, const uint16_t* pBitRevTable)
+{
+    for (uint16_t idx = 0; idx < bitRevLen; idx += 2)
+    {
+        const uint32_t a = pBitRevTable[idx] >> 2;
+        const uint32_t b = pBitRevTable[idx + 1] >> 2;
+        uint32_t tmp;
+
+        tmp = pSrc[a];
+        pSrc[a] = pSrc[b];
+        pSrc[b] = tmp;
+
+        tmp = pSrc[a + 1];
+        pSrc[a + 1] = pSrc[b + 1];
+        pSrc[b + 1] = tmp;
+    }
+}
+
+#define TEST_AMPLITUDE          1000.0  // carrier amplitude, codec range
+#define TEST_SNR_BANDWIDTH      2500.0  // Hz
+#define TEST_RUN_TIME           1.5     // seconds after the restart
+#define TEST_MAX_ERROR          0.1     // Hz
+#define TEST_MAX_SETTLE         0.2     // seconds
+#define TEST_RANGE              250.0   // Hz, search range around the center
+
+typedef struct
+{
+    const char* name;
+    float32_t center;
+    float32_t delta;
+} TestCarrier_t;
+
+static const TestCarrier_t test_carriers[] =
+{
+    { "CW USB", 700.0, 37.3 },
+    { "CW USB", 700.0, -181.65 },
+    { "CW LSB", -700.0, 12.34 },
+    { "CW LSB", -700.0, -96.8 },
+    { "AM", 0.0, 3.21 },
+    { "AM", 0.0, -55.55 },
+};
+
+static const float test_snr_db[] = { 40.0, 30.0, 20.0 };
+
+static bool Test_Check(const char* name, bool ok)
+{
+    printf("  %-56s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static double Test_Gauss(uint32_t* rnd)
+{
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u1 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u2 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+/**
+ * Runs the estimator on one carrier
+ * @param settle_p returns the settling time in seconds, TEST_RUN_TIME if it never settles
+ * @param error_p returns the largest error of the estimates after the settling time in Hz
+ */
+static void Test_Run(const TestCarrier_t* carrier, float snr_db, uint32_t* rnd, double* settle_p, double* error_p)
+{
+    // noise power per sample for the SNR in TEST_SNR_BANDWIDTH, I and Q get half of it each
+    const double noise_power = TEST_AMPLITUDE * TEST_AMPLITUDE / pow(10, snr_db / 10) * IQ_SAMPLE_RATE / TEST_SNR_BANDWIDTH;
+    const double noise_sigma = sqrt(noise_power / 2);
+
+    const double freq = carrier->center + carrier->delta;
+    const double phase0 = 2 * M_PI * (*rnd = *rnd * 1664525 + 1013904223) / 4294967296.0;
+
+    double settle = TEST_RUN_TIME;
+    double error_max = 0;
+    bool settled = false;
+
+    SnapEstimator_Configure(true, carrier->center, TEST_RANGE);
+    SnapEstimator_Restart();
+
+    const uint32_t len = TEST_RUN_TIME * IQ_SAMPLE_RATE;
+    for (uint32_t n = 0; n < len; n += IQ_BLOCK_SIZE)
+    {
+        float32_t i_buf[IQ_BLOCK_SIZE], q_buf[IQ_BLOCK_SIZE];
+
+        for (uint32_t idx = 0; idx < IQ_BLOCK_SIZE; idx++)
+        {
+            const double phase = fmod(phase0 + 2 * M_PI * freq * (n + idx) / IQ_SAMPLE_RATE, 2 * M_PI);
+            i_buf[idx] = TEST_AMPLITUDE * cos(phase) + noise_sigma * Test_Gauss(rnd);
+            q_buf[idx] = TEST_AMPLITUDE * sin(phase) + noise_sigma * Test_Gauss(rnd);
+        }
+
+        SnapEstimator_ProcessSamples(i_buf, q_buf, IQ_BLOCK_SIZE);
+
+        float32_t delta;
+        if (SnapEstimator_Estimate(&delta))
+        {
+            const double error = fabs(delta - carrier->delta);
+            if (error <= TEST_MAX_ERROR)
+            {
+                if (settled == false)
+                {
+                    settled = true;
+                    settle = (double)(n + IQ_BLOCK_SIZE) / IQ_SAMPLE_RATE;
+                    error_max = error;
+                }
+            }
+            else
+            {
+                // an estimate outside the tolerance, start over
+                settled = false;
+                settle = TEST_RUN_TIME;
+                error_max = error;
+            }
+            if (settled && error > error_max)
+            {
+                error_max = error;
+            }
+        }
+    }
+
+    *settle_p = settle;
+    *error_p = error_max;
+}
+
+static bool Test_Snr(float snr_db)
+{
+    bool ok = true;
+    uint32_t rnd = 1;
+    double settle_max = 0;
+    double error_max = 0;
+
+    printf("\nSNR %+.0fdB in %.0fHz\n", snr_db, TEST_SNR_BANDWIDTH);
+
+    for (uint32_t idx = 0; idx < sizeof(test_carriers) / sizeof(test_carriers[0]); idx++)
+    {
+        double settle, error;
+        Test_Run(&test_carriers[idx], snr_db, &rnd, &settle, &error);
+        printf("  %-6s %+5.0fHz %+8.2fHz: settled after %3.0fms, max. error %.3fHz\n", test_carriers[idx].name,
+                test_carriers[idx].center, test_carriers[idx].delta, settle * 1000, error);
+        settle_max = fmax(settle_max, settle);
+        error_max = fmax(error_max, error);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "frequency error after settling within +-%.1fHz", TEST_MAX_ERROR);
+    ok &= Test_Check(name, error_max <= TEST_MAX_ERROR);
+    snprintf(name, sizeof(name), "settling time less than %.0fms", TEST_MAX_SETTLE * 1000);
+    ok &= Test_Check(name, settle_max < TEST_MAX_SETTLE);
+
+    return ok;
+}
+
+static void Test_Usage(const char* prog)
+{
+    printf("usage: %s\n", prog);
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "h")) != -1)
+    {
+        switch (opt)
+        {
+        default:
+            Test_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    bool ok = true;
+    for (uint32_t idx = 0; idx < sizeof(test_snr_db) / sizeof(test_snr_db[0]); idx++)
+    {
+        ok &= Test_Snr(test_snr_db[idx]);
+    }
+
+    printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,411 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     softdds_bench.c                                                 **
+ **  Description:   host spectral purity test and benchmark of the soft DDS         **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It builds softdds.c and dds_table.c for the build host and
+ *
+ * - measures the spurious free dynamic range (SFDR) of the interpolated quarter wave lookup
+ *   (softdds_nextSampleFloat), of the int16 output used by PSK and RTTY (softdds_nextSample),
+ *   of the block generated IQ tone (softdds_genIQSingleTone) and of the two tone test signal
+ *   (softdds_genIQTwoTone, spurs relative to one of the tones)
+ * - does the same for the 10 bit full wave int16 table without interpolation we used before
+ *   as a reference
+ * - reports the time per sample of these functions and of sinf()/cosf() on the host
+ *
+ * Build and run with "make softdds-bench", see Makefile. The exit code is not 0 if one of the
+ * soft DDS signals has spurs above SOFTDDS_BENCH_SFDR_MIN dBc.
+ *
+ * All tones are placed exactly on an FFT bin (the dds step is a multiple of 2^32/N), so no window
+ * is needed and every other bin which is not 0 is a spur of the generator.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "softdds.h"
+
+#define BENCH_FFT_BITS          16
+#define BENCH_FFT_LEN           (1 << BENCH_FFT_BITS)
+#define BENCH_SAMP_RATE         48000
+#define BENCH_BLOCK_SIZE        32
+
+// the request for the interpolated dds was "below -90dBc", we are clearly better
+#define SOFTDDS_BENCH_SFDR_MIN  100.0
+
+#define BENCH_SAMPLES_DEFAULT   (BENCH_SAMP_RATE * 100)
+
+// tones in fft bins, odd so that all phases of the accumulator grid are visited
+static const uint32_t bench_tone_bins[] = { 601, 1271, 5461, 11111, 25601 };
+
+// two tone pair, about 700Hz and 1900Hz like the tx two tone test
+#define BENCH_TWO_TONE_A        955
+#define BENCH_TWO_TONE_B        2595
+
+typedef struct
+{
+    double re;
+    double im;
+} BenchComplex_t;
+
+static BenchComplex_t bench_fft[BENCH_FFT_LEN];
+static float32_t bench_i[BENCH_FFT_LEN];
+static float32_t bench_q[BENCH_FFT_LEN];
+
+// the soft dds before the interpolation was added: 10 bit full wave table, phase truncated
+static int16_t bench_old_table[DDS_TBL_SIZE];
+
+static uint64_t Bench_Now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static void Bench_OldTableInit()
+{
+    for (int i = 0; i < DDS_TBL_SIZE; i++)
+    {
+        bench_old_table[i] = 32767 * sin(2 * M_PI * i / DDS_TBL_SIZE);
+    }
+}
+
+static inline int16_t Bench_OldNextSample(soft_dds_t* dds)
+{
+    const int16_t retval = bench_old_table[dds->acc >> SOFTDDS_ACC_SHIFT];
+    dds->acc += dds->step;
+    return retval;
+}
+
+static void Bench_OldIQ(soft_dds_t* dds, float32_t* i_buff, float32_t* q_buff, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        i_buff[i] = bench_old_table[dds->acc >> SOFTDDS_ACC_SHIFT];
+        q_buff[i] = -bench_old_table[(uint32_t)(dds->acc + SOFTDDS_QUARTER) >> SOFTDDS_ACC_SHIFT];
+        dds->acc += dds->step;
+    }
+}
+
+/**
+ * in place radix 2 fft of bench_fft
+ */
+static void Bench_Fft()
+{
+    for (uint32_t i = 1, j = 0; i < BENCH_FFT_LEN; i++)
+    {
+        uint32_t bit = BENCH_FFT_LEN >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j)
+        {
+            const BenchComplex_t t = bench_fft[i];
+            bench_fft[i] = bench_fft[j];
+            bench_fft[j] = t;
+        }
+    }
+
+    for (uint32_t len = 2; len <= BENCH_FFT_LEN; len <<= 1)
+    {
+        const double ang = -2 * M_PI / len;
+        for (uint32_t i = 0; i < BENCH_FFT_LEN; i += len)
+        {
+            for (uint32_t k = 0; k < len / 2; k++)
+            {
+                const BenchComplex_t w = { cos(ang * k), sin(ang * k) };
+                BenchComplex_t* a = &bench_fft[i + k];
+                BenchComplex_t* b = &bench_fft[i + k + len / 2];
+                const BenchComplex_t t = { b->re * w.re - b->im * w.im, b->re * w.im + b->im * w.re };
+                b->re = a->re - t.re;
+                b->im = a->im - t.im;
+                a->re += t.re;
+                a->im += t.im;
+            }
+        }
+    }
+}
+
+/**
+ * SFDR of the signal in bench_fft relative to the carrier bins
+ * @param carrier fft bins of the wanted tones, the first one is the reference
+ * @param real the signal is real, only the positive frequencies are looked at
+ * @param spur_bin returns the bin of the worst spur
+ * @return SFDR in dB
+ */
+static double Bench_Sfdr(const uint32_t* carrier, int carriers, bool real, uint32_t* spur_bin)
+{
+    Bench_Fft();
+
+    const uint32_t bins = real ? BENCH_FFT_LEN / 2 + 1 : BENCH_FFT_LEN;
+    double spur = 0;
+    *spur_bin = 0;
+
+    for (uint32_t k = 0; k < bins; k++)
+    {
+        bool is_carrier = false;
+        for (int c = 0; c < carriers; c++)
+        {
+            is_carrier |= k == carrier[c];
+        }
+        const double p = bench_fft[k].re * bench_fft[k].re + bench_fft[k].im * bench_fft[k].im;
+        if (is_carrier == false && p > spur)
+        {
+            spur = p;
+            *spur_bin = k;
+        }
+    }
+
+    const double p_carrier = bench_fft[carrier[0]].re * bench_fft[carrier[0]].re + bench_fft[carrier[0]].im * bench_fft[carrier[0]].im;
+    // floor at the double precision noise of the fft
+    return 10 * log10(p_carrier / fmax(spur, p_carrier * 1e-24));
+}
+
+static float32_t Bench_BinFreq(uint32_t bin)
+{
+    return (float32_t)bin * BENCH_SAMP_RATE / BENCH_FFT_LEN;
+}
+
+static void Bench_DdsInit(soft_dds_t* dds, uint32_t bin)
+{
+    // the bin frequency is exact in float and results in a step of bin * 2^32/BENCH_FFT_LEN
+    softdds_setFreqDDS(dds, Bench_BinFreq(bin), BENCH_SAMP_RATE, false);
+}
+
+/**
+ * Analyses the signal in bench_fft and prints the result
+ * @param checked the SFDR must reach SOFTDDS_BENCH_SFDR_MIN
+ * @return false if the check failed
+ */
+static bool Bench_Report(const char* name, const uint32_t* carrier, int carriers, bool real, bool checked)
+{
+    uint32_t spur_bin;
+    const double sfdr = Bench_Sfdr(carrier, carriers, real, &spur_bin);
+    // upper half of a complex spectrum are the negative frequencies
+    const float32_t spur_freq = Bench_BinFreq(spur_bin) - (spur_bin > BENCH_FFT_LEN / 2 ? BENCH_SAMP_RATE : 0);
+    const bool ok = checked == false || sfdr >= SOFTDDS_BENCH_SFDR_MIN;
+    printf("  %-28s %8.1fHz %7.1fdBc  worst spur %8.1fHz  %s\n", name, Bench_BinFreq(carrier[0]), sfdr, spur_freq,
+           checked ? (ok ? "ok" : "FAILED") : "");
+    return ok;
+}
+
+static bool Bench_RunSfdr()
+{
+    bool ok = true;
+    printf("SFDR, %d point FFT, tones on a bin, pass above %.0fdBc:\n", BENCH_FFT_LEN, SOFTDDS_BENCH_SFDR_MIN);
+
+    for (int t = 0; t < sizeof(bench_tone_bins) / sizeof(bench_tone_bins[0]); t++)
+    {
+        const uint32_t bin = bench_tone_bins[t];
+        soft_dds_t dds;
+
+        Bench_DdsInit(&dds, bin);
+        for (int i = 0; i < BENCH_FFT_LEN; i++)
+        {
+            bench_fft[i] = (BenchComplex_t) { softdds_nextSampleFloat(&dds), 0 };
+        }
+        ok &= Bench_Report("softdds_nextSampleFloat", &bin, 1, true, true);
+
+        Bench_DdsInit(&dds, bin);
+        for (int i = 0; i < BENCH_FFT_LEN; i++)
+        {
+            bench_fft[i] = (BenchComplex_t) { softdds_nextSample(&dds), 0 };
+        }
+        // the int16 rounding alone limits this to about 100dBc, not checked
+        Bench_Report("softdds_nextSample (int16)", &bin, 1, true, false);
+
+        Bench_DdsInit(&dds, bin);
+        for (int i = 0; i < BENCH_FFT_LEN; i += BENCH_BLOCK_SIZE)
+        {
+            softdds_genIQSingleTone(&dds, &bench_i[i], &bench_q[i], BENCH_BLOCK_SIZE);
+        }
+        for (int i = 0; i < BENCH_FFT_LEN; i++)
+        {
+            bench_fft[i] = (BenchComplex_t) { bench_i[i], bench_q[i] };
+        }
+        ok &= Bench_Report("softdds_genIQSingleTone", &bin, 1, false, true);
+
+        Bench_DdsInit(&dds, bin);
+        for (int i = 0; i < BENCH_FFT_LEN; i++)
+        {
+            bench_fft[i] = (BenchComplex_t) { Bench_OldNextSample(&dds), 0 };
+        }
+        Bench_Report("old 10 bit table", &bin, 1, true, false);
+
+        Bench_DdsInit(&dds, bin);
+        Bench_OldIQ(&dds, bench_i, bench_q, BENCH_FFT_LEN);
+        for (int i = 0; i < BENCH_FFT_LEN; i++)
+        {
+            bench_fft[i] = (BenchComplex_t) { bench_i[i], bench_q[i] };
+        }
+        Bench_Report("old 10 bit table IQ", &bin, 1, false, false);
+    }
+
+    soft_dds_t dds_a, dds_b;
+    Bench_DdsInit(&dds_a, BENCH_TWO_TONE_A);
+    Bench_DdsInit(&dds_b, BENCH_TWO_TONE_B);
+    for (int i = 0; i < BENCH_FFT_LEN; i += BENCH_BLOCK_SIZE)
+    {
+        softdds_genIQTwoTone(&dds_a, &dds_b, &bench_i[i], &bench_q[i], BENCH_BLOCK_SIZE);
+    }
+    for (int i = 0; i < BENCH_FFT_LEN; i++)
+    {
+        bench_fft[i] = (BenchComplex_t) { bench_i[i], bench_q[i] };
+    }
+    const uint32_t two_tone_bins[] = { BENCH_TWO_TONE_A, BENCH_TWO_TONE_B };
+    ok &= Bench_Report("softdds_genIQTwoTone", two_tone_bins, 2, false, true);
+
+    return ok;
+}
+
+static void Bench_PrintTime(const char* name, uint64_t ns, uint32_t samples)
+{
+    printf("  %-28s %6.2fns/sample\n", name, (double)ns / samples);
+}
+
+static void Bench_RunTime(uint32_t samples)
+{
+    soft_dds_t dds_a, dds_b;
+    volatile float32_t sink_f = 0;
+    volatile int32_t sink_i = 0;
+    uint64_t start;
+
+    samples -= samples % BENCH_BLOCK_SIZE;
+    printf("\ntime on the host, %u samples, blocks of %d:\n", samples, BENCH_BLOCK_SIZE);
+
+    Bench_DdsInit(&dds_a, bench_tone_bins[1]);
+    Bench_DdsInit(&dds_b, BENCH_TWO_TONE_B);
+
+    start = Bench_Now();
+    for (uint32_t n = 0; n < samples; n += BENCH_BLOCK_SIZE)
+    {
+        float32_t sum = 0;
+        for (int i = 0; i < BENCH_BLOCK_SIZE; i++)
+        {
+            sum += softdds_nextSampleFloat(&dds_a);
+        }
+        sink_f += sum;
+    }
+    Bench_PrintTime("softdds_nextSampleFloat", Bench_Now() - start, samples);
+
+    start = Bench_Now();
+    for (uint32_t n = 0; n < samples; n += BENCH_BLOCK_SIZE)
+    {
+        int32_t sum = 0;
+        for (int i = 0; i < BENCH_BLOCK_SIZE; i++)
+        {
+            sum += softdds_nextSample(&dds_a);
+        }
+        sink_i += sum;
+    }
+    Bench_PrintTime("softdds_nextSample", Bench_Now() - start, samples);
+
+    start = Bench_Now();
+    for (uint32_t n = 0; n < samples; n += BENCH_BLOCK_SIZE)
+    {
+        int32_t sum = 0;
+        for (int i = 0; i < BENCH_BLOCK_SIZE; i++)
+        {
+            sum += Bench_OldNextSample(&dds_a);
+        }
+        sink_i += sum;
+    }
+    Bench_PrintTime("old 10 bit table", Bench_Now() - start, samples);
+
+    start = Bench_Now();
+    for (uint32_t n = 0; n < samples; n += BENCH_BLOCK_SIZE)
+    {
+        softdds_genIQSingleTone(&dds_a, bench_i, bench_q, BENCH_BLOCK_SIZE);
+        sink_f += bench_i[n & (BENCH_BLOCK_SIZE - 1)];
+    }
+    Bench_PrintTime("softdds_genIQSingleTone", Bench_Now() - start, samples);
+
+    start = Bench_Now();
+    for (uint32_t n = 0; n < samples; n += BENCH_BLOCK_SIZE)
+    {
+        Bench_OldIQ(&dds_a, bench_i, bench_q, BENCH_BLOCK_SIZE);
+        sink_f += bench_i[n & (BENCH_BLOCK_SIZE - 1)];
+    }
+    Bench_PrintTime("old 10 bit table IQ", Bench_Now() - start, samples);
+
+    start = Bench_Now();
+    for (uint32_t n = 0; n < samples; n += BENCH_BLOCK_SIZE)
+    {
+        softdds_genIQTwoTone(&dds_a, &dds_b, bench_i, bench_q, BENCH_BLOCK_SIZE);
+        sink_f += bench_i[n & (BENCH_BLOCK_SIZE - 1)];
+    }
+    Bench_PrintTime("softdds_genIQTwoTone", Bench_Now() - start, samples);
+
+    const float32_t w = 2 * M_PI * Bench_BinFreq(bench_tone_bins[1]) / BENCH_SAMP_RATE;
+    start = Bench_Now();
+    for (uint32_t n = 0; n < samples; n += BENCH_BLOCK_SIZE)
+    {
+        for (int i = 0; i < BENCH_BLOCK_SIZE; i++)
+        {
+            const float32_t a = w * ((n + i) & 0xffff);
+            bench_i[i] = sinf(a);
+            bench_q[i] = -cosf(a);
+        }
+        sink_f += bench_i[n & (BENCH_BLOCK_SIZE - 1)];
+    }
+    Bench_PrintTime("sinf/cosf IQ (reference)", Bench_Now() - start, samples);
+}
+
+static void Bench_Usage(const char* prog)
+{
+    printf("usage: %s [-n samples] [-s]\n", prog);
+    printf("  -n  number of samples for the time measurement (%d)\n", BENCH_SAMPLES_DEFAULT);
+    printf("  -s  spectral purity test only\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int samples = BENCH_SAMPLES_DEFAULT;
+    bool sfdr_only = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:sh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': samples = atoi(optarg); break;
+        case 's': sfdr_only = true; break;
+        default:
+            Bench_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (samples < BENCH_BLOCK_SIZE)
+    {
+        samples = BENCH_BLOCK_SIZE;
+    }
+
+    Bench_OldTableInit();
+
+    const bool ok = Bench_RunSfdr();
+
+    if (sfdr_only == false)
+    {
+        Bench_RunTime(samples);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,353 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     tx_dpd_test.c                                                   **
+ **  Description:   host test of the tx predistortion with a simulated PA          **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It builds tx_dpd.c for the build host and runs the
+ * predistortion against a Saleh model of a PA (AM/AM and AM/PM) driven by a two tone signal.
+ *
+ * - offline: PA input/output pairs are fed to TxDpd_StatsAccumulate/TxDpd_Fit directly
+ * - online: the transmitter interface is used like the audio interrupt does it (TxDpd_GetLut,
+ *   TxDpd_ProcessSample, TxDpd_Capture), the loopback has a delay, an unknown gain and phase, noise and optionally
+ *   swapped I and Q. The delay found by the alignment must be the simulated one. The envelope
+ *   of the two tone signal repeats every 40 samples, so a voice like multi tone signal is
+ *   transmitted while adapting.
+ * - no loopback: the loopback input is noise only, the tables must not change
+ *
+ * The IMD3 products of the PA output are measured before and after the adaptation.
+ * Build and run with "make tx-dpd-test", see Makefile. The exit code is not 0 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <complex.h>
+#include <unistd.h>
+
+#include "tx_dpd.h"
+
+#define TEST_SAMP_RATE      48000
+#define TEST_BLOCK_SIZE     32
+#define TEST_FULL_SCALE     32768.0
+#define TEST_BAND           3
+
+// two tone test signal, 10Hz raster so that a measurement over TEST_MEASURE_LEN is coherent
+#define TEST_TONE_1         700
+#define TEST_TONE_2         1900
+#define TEST_MEASURE_LEN    4800
+// peak envelope of the two tone signal relative to full scale
+#define TEST_DRIVE_DEFAULT  0.4
+
+// Saleh PA model, input and output normalized to full scale
+#define TEST_PA_ALPHA_A     2.0
+#define TEST_PA_BETA_A      1.0
+#define TEST_PA_ALPHA_P     0.5
+#define TEST_PA_BETA_P      1.0
+
+// loopback path
+#define TEST_LOOP_DELAY     77
+#define TEST_LOOP_GAIN      0.3
+#define TEST_LOOP_PHASE     1.1
+#define TEST_LOOP_NOISE     1e-4
+
+// required IMD3 improvement by the adaptation
+#define TEST_IMD_GAIN_MIN   15.0
+
+#define TEST_SECONDS_DEFAULT 4
+
+// multi tone signal for the online adaptation, all on the 10Hz raster, repeats every TEST_MEASURE_LEN samples
+static const float test_voice_freq[] = { 330, 570, 820, 1150, 1360, 1710, 2030, 2280, 2650 };
+static const float test_voice_phase[] = { 0.3, 2.1, 4.4, 1.7, 5.9, 0.8, 3.3, 2.6, 4.9 };
+static float32_t test_voice_i[TEST_MEASURE_LEN];
+static float32_t test_voice_q[TEST_MEASURE_LEN];
+
+typedef struct
+{
+    double complex delay_line[TEST_LOOP_DELAY + 1];
+    uint32_t pos;
+    bool mirrored;
+    bool connected;
+    uint32_t rnd;
+} TestLoopback_t;
+
+static uint32_t test_time;   // sample counter of the two tone generator
+
+static double Test_Gauss(uint32_t* rnd)
+{
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u1 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    *rnd = *rnd * 1664525 + 1013904223;
+    const double u2 = ((*rnd >> 8) + 1.0) / 16777217.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static void Test_TwoTone(float32_t* i_buf, float32_t* q_buf, uint16_t len, double drive)
+{
+    for (uint16_t idx = 0; idx < len; idx++, test_time++)
+    {
+        const double t = (double)(test_time % TEST_SAMP_RATE) / TEST_SAMP_RATE;
+        const double complex x = drive * TEST_FULL_SCALE / 2 * (cexp(I * 2 * M_PI * TEST_TONE_1 * t) + cexp(I * 2 * M_PI * TEST_TONE_2 * t));
+        i_buf[idx] = creal(x);
+        q_buf[idx] = cimag(x);
+    }
+}
+
+/**
+ * Prepares the multi tone signal, scaled to a peak envelope of drive
+ */
+static void Test_VoiceInit(double drive)
+{
+    static double complex x[TEST_MEASURE_LEN];
+    double peak = 0;
+
+    for (uint32_t n = 0; n < TEST_MEASURE_LEN; n++)
+    {
+        x[n] = 0;
+        for (int k = 0; k < sizeof(test_voice_freq) / sizeof(test_voice_freq[0]); k++)
+        {
+            x[n] += cexp(I * (2 * M_PI * test_voice_freq[k] * n / TEST_SAMP_RATE + test_voice_phase[k]));
+        }
+        peak = fmax(peak, cabs(x[n]));
+    }
+    for (uint32_t n = 0; n < TEST_MEASURE_LEN; n++)
+    {
+        test_voice_i[n] = creal(x[n]) * drive * TEST_FULL_SCALE / peak;
+        test_voice_q[n] = cimag(x[n]) * drive * TEST_FULL_SCALE / peak;
+    }
+}
+
+static void Test_Voice(float32_t* i_buf, float32_t* q_buf, uint16_t len)
+{
+    for (uint16_t idx = 0; idx < len; idx++, test_time++)
+    {
+        i_buf[idx] = test_voice_i[test_time % TEST_MEASURE_LEN];
+        q_buf[idx] = test_voice_q[test_time % TEST_MEASURE_LEN];
+    }
+}
+
+static double complex Test_Pa(double complex x)
+{
+    const double r = cabs(x) / TEST_FULL_SCALE;
+    const double a = TEST_PA_ALPHA_A * r / (1 + TEST_PA_BETA_A * r * r);
+    const double p = TEST_PA_ALPHA_P * r * r / (1 + TEST_PA_BETA_P * r * r);
+    return r > 0 ? x / cabs(x) * a * TEST_FULL_SCALE * cexp(I * p) : 0;
+}
+
+static double complex Test_Dft(const double complex* y, uint32_t len, double freq)
+{
+    double complex sum = 0;
+    for (uint32_t n = 0; n < len; n++)
+    {
+        sum += y[n] * cexp(-I * 2 * M_PI * freq * n / TEST_SAMP_RATE);
+    }
+    return sum;
+}
+
+/**
+ * Applies the predistortion of TEST_BAND like the final tx stage (TxProcessor_IqFinalKernel) does it
+ */
+static void Test_Predistort(float32_t* i_buf, float32_t* q_buf)
+{
+    const TxDpd_Lut_t* lut = TxDpd_GetLut(TEST_BAND);
+
+    if (lut != NULL)
+    {
+        TxDpd_Process(lut, i_buf, q_buf, TEST_BLOCK_SIZE, TEST_FULL_SCALE);
+    }
+}
+
+/**
+ * IMD3 of the PA output with the current predistortion of TEST_BAND
+ * @return worst third order product in dBc
+ */
+static double Test_MeasureImd(double drive)
+{
+    static double complex y[TEST_MEASURE_LEN];
+    float32_t i_buf[TEST_BLOCK_SIZE], q_buf[TEST_BLOCK_SIZE];
+
+    test_time = 0;
+    for (uint32_t n = 0; n < TEST_MEASURE_LEN; n += TEST_BLOCK_SIZE)
+    {
+        Test_TwoTone(i_buf, q_buf, TEST_BLOCK_SIZE, drive);
+        Test_Predistort(i_buf, q_buf);
+        for (uint16_t idx = 0; idx < TEST_BLOCK_SIZE; idx++)
+        {
+            y[n + idx] = Test_Pa(i_buf[idx] + I * q_buf[idx]);
+        }
+    }
+
+    const double tone = fmin(cabs(Test_Dft(y, TEST_MEASURE_LEN, TEST_TONE_1)), cabs(Test_Dft(y, TEST_MEASURE_LEN, TEST_TONE_2)));
+    const double imd = fmax(cabs(Test_Dft(y, TEST_MEASURE_LEN, 2 * TEST_TONE_1 - TEST_TONE_2)), cabs(Test_Dft(y, TEST_MEASURE_LEN, 2 * TEST_TONE_2 - TEST_TONE_1)));
+    return 20 * log10(imd / tone);
+}
+
+static void Test_ResetTables()
+{
+    tx_dpd_store.magic = 0;
+    TxDpd_Init();
+    TxDpd_SetEnable(true);
+}
+
+static bool Test_Check(const char* name, bool ok)
+{
+    printf("  %-56s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/**
+ * Fit from perfectly aligned PA input/output pairs, a few iterations with the full correction
+ */
+static bool Test_Offline(double drive)
+{
+    bool ok = true;
+    float32_t i_buf[TEST_BLOCK_SIZE], q_buf[TEST_BLOCK_SIZE], y_i[TEST_BLOCK_SIZE], y_q[TEST_BLOCK_SIZE];
+    TxDpd_PaStats_t stats;
+
+    printf("offline fit, drive %.2f:\n", drive);
+    Test_ResetTables();
+
+    const double imd_start = Test_MeasureImd(drive);
+    printf("  IMD3 without predistortion %7.1fdBc\n", imd_start);
+
+    double imd = imd_start;
+    for (int iter = 1; iter <= 5; iter++)
+    {
+        TxDpd_StatsReset(&stats);
+        test_time = 0;
+        while (stats.count < TX_DPD_CAPTURE_MIN * 2)
+        {
+            Test_TwoTone(i_buf, q_buf, TEST_BLOCK_SIZE, drive);
+            Test_Predistort(i_buf, q_buf);
+            for (uint16_t idx = 0; idx < TEST_BLOCK_SIZE; idx++)
+            {
+                const double complex y = Test_Pa(i_buf[idx] + I * q_buf[idx]);
+                y_i[idx] = creal(y);
+                y_q[idx] = cimag(y);
+            }
+            TxDpd_StatsAccumulate(&stats, i_buf, q_buf, y_i, y_q, TEST_BLOCK_SIZE, TEST_FULL_SCALE);
+        }
+        ok &= Test_Check("TxDpd_Fit accepts the data", TxDpd_Fit(&stats, &tx_dpd_store.band[TEST_BAND], 1.0));
+        // the table has changed behind the back of the transmitter interface, like after loading the configuration
+        TxDpd_Init();
+        imd = Test_MeasureImd(drive);
+        printf("  IMD3 after fit %d            %7.1fdBc\n", iter, imd);
+    }
+
+    ok &= Test_Check("IMD3 improvement offline", imd_start - imd >= TEST_IMD_GAIN_MIN);
+    return ok;
+}
+
+static void Test_LoopbackInit(TestLoopback_t* loop, bool connected, bool mirrored)
+{
+    memset(loop, 0, sizeof(*loop));
+    loop->connected = connected;
+    loop->mirrored = mirrored;
+    loop->rnd = 1;
+}
+
+/**
+ * PA and loopback path: delay, gain, phase, noise, optionally swapped I and Q
+ */
+static void Test_Loopback(TestLoopback_t* loop, const float32_t* x_i, const float32_t* x_q, float32_t* y_i, float32_t* y_q, uint16_t len)
+{
+    for (uint16_t idx = 0; idx < len; idx++)
+    {
+        loop->delay_line[loop->pos % (TEST_LOOP_DELAY + 1)] = Test_Pa(x_i[idx] + I * x_q[idx]);
+        loop->pos++;
+        double complex y = loop->connected ? loop->delay_line[loop->pos % (TEST_LOOP_DELAY + 1)] * TEST_LOOP_GAIN * cexp(I * TEST_LOOP_PHASE) : 0;
+        y += TEST_LOOP_NOISE * TEST_FULL_SCALE * (Test_Gauss(&loop->rnd) + I * Test_Gauss(&loop->rnd));
+
+        y_i[idx] = loop->mirrored ? cimag(y) : creal(y);
+        y_q[idx] = loop->mirrored ? creal(y) : cimag(y);
+    }
+}
+
+/**
+ * Adaptation through the transmitter interface, as done in the audio interrupt
+ */
+static bool Test_Online(double drive, int seconds, bool connected, bool mirrored)
+{
+    bool ok = true;
+    float32_t i_buf[TEST_BLOCK_SIZE], q_buf[TEST_BLOCK_SIZE], y_i[TEST_BLOCK_SIZE], y_q[TEST_BLOCK_SIZE];
+    TestLoopback_t loop;
+
+    printf("\nonline adaptation, drive %.2f, loopback %s:\n", drive, connected ? (mirrored ? "I/Q swapped" : "connected") : "noise only");
+    Test_ResetTables();
+    TxDpd_CaptureReset();
+    Test_LoopbackInit(&loop, connected, mirrored);
+
+    const TxDpd_Table_t table_start = tx_dpd_store.band[TEST_BAND];
+    const double imd_start = Test_MeasureImd(drive);
+    printf("  IMD3 without predistortion %7.1fdBc\n", imd_start);
+
+    Test_VoiceInit(drive);
+    test_time = 0;
+    for (uint32_t n = 0; n < (uint32_t)seconds * TEST_SAMP_RATE; n += TEST_BLOCK_SIZE)
+    {
+        Test_Voice(i_buf, q_buf, TEST_BLOCK_SIZE);
+        Test_Predistort(i_buf, q_buf);
+        Test_Loopback(&loop, i_buf, q_buf, y_i, y_q, TEST_BLOCK_SIZE);
+        TxDpd_Capture(i_buf, q_buf, y_i, y_q, TEST_BLOCK_SIZE, TEST_BAND, TEST_FULL_SCALE);
+    }
+
+    const double imd = Test_MeasureImd(drive);
+    printf("  IMD3 after %ds              %7.1fdBc, loopback delay found %d\n", seconds, imd, TxDpd_CaptureDelay());
+
+    if (connected)
+    {
+        ok &= Test_Check("loopback delay", TxDpd_CaptureDelay() == TEST_LOOP_DELAY);
+        ok &= Test_Check("IMD3 improvement online", imd_start - imd >= TEST_IMD_GAIN_MIN);
+    }
+    else
+    {
+        ok &= Test_Check("no alignment without loopback", TxDpd_CaptureDelay() < 0);
+        ok &= Test_Check("table unchanged without loopback", memcmp(&table_start, &tx_dpd_store.band[TEST_BAND], sizeof(table_start)) == 0);
+    }
+    return ok;
+}
+
+static void Test_Usage(const char* prog)
+{
+    printf("usage: %s [-d drive] [-t seconds]\n", prog);
+    printf("  -d  peak envelope of the test signals relative to full scale (%.2f)\n", TEST_DRIVE_DEFAULT);
+    printf("  -t  transmit time of the online adaptation in seconds (%d)\n", TEST_SECONDS_DEFAULT);
+}
+
+int main(int argc, char* argv[])
+{
+    double drive = TEST_DRIVE_DEFAULT;
+    int seconds = TEST_SECONDS_DEFAULT;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd': drive = atof(optarg); break;
+        case 't': seconds = atoi(optarg); break;
+        default:
+            Test_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    bool ok = Test_Offline(drive);
+    ok &= Test_Online(drive, seconds, true, false);
+    ok &= Test_Online(drive, seconds, true, true);
+    ok &= Test_Online(drive, seconds, false, false);
+
+    printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+    return ok ? 0 : 1;
+}
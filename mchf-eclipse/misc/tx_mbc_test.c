@@ -0,0 +1,384 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     tx_mbc_test.c                                                   **
+ **  Description:   host test of the multiband tx speech compressor                 **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It builds tx_mbc.c for the build host and checks:
+ *
+ * - crossover: the sum of the three bands has a flat magnitude response, tones in the middle of each
+ *   band end up mostly in their band
+ * - limiter: a voice like multi tone signal with a syllable envelope and levels from far below to
+ *   far above the ceiling is processed with all presets, no output sample and no midpoint between
+ *   two output samples may exceed the ceiling times the gain scaling
+ * - look-ahead: a burst far above the ceiling starting abruptly after silence has to be limited from
+ *   its first sample on and has to leave the processor exactly one block later
+ * - talk power: the output level of quiet syllables has to rise from preset to preset,
+ *   LIGHT < MEDIUM < DX, while the loud ones are held at the ceiling
+ *
+ * tx_mbc.c is included below, the board and audio driver headers it uses are replaced by
+ * the few stubs it needs. Build and run with "make tx-mbc-test", see Makefile.
+ * The exit code is not 0 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+
+// keep the firmware headers out, tx_mbc.c only needs the stubs below from them
+#define __MCHF_BOARD_H
+#define __AUDIO_DRIVER_H
+
+// as in uhsdr_board_config.h
+#define IQ_SAMPLE_RATE (48000)
+#define AUDIO_SAMPLE_RATE (48000)
+#define IQ_INTERRUPT_FREQ (1500)
+#define IQ_BLOCK_SIZE (IQ_SAMPLE_RATE/IQ_INTERRUPT_FREQ)
+#define AUDIO_BLOCK_SIZE (AUDIO_SAMPLE_RATE/IQ_INTERRUPT_FREQ)
+
+#include "tx_mbc.h"
+
+#define pow10f(x) powf(10.0, (x))
+
+#define B0 0
+#define B1 1
+#define B2 2
+#define A1 3
+#define A2 4
+
+// the biquad helpers below are copies of the ones in audio_driver.c
+void AudioDriver_SetBiquadCoeffs(float32_t* coeffsTo,const float32_t* coeffsFrom)
+{
+    coeffsTo[0] = coeffsFrom[0];
+    coeffsTo[1] = coeffsFrom[1];
+    coeffsTo[2] = coeffsFrom[2];
+    coeffsTo[3] = coeffsFrom[3];
+    coeffsTo[4] = coeffsFrom[4];
+}
+
+static void AudioDriver_ScaleBiquadCoeffs(float32_t coeffs[5],const float32_t scalingA, const float32_t scalingB)
+{
+    coeffs[A1] = coeffs[A1] / scalingA;
+    coeffs[A2] = coeffs[A2] / scalingA;
+
+    coeffs[B0] = coeffs[B0] / scalingB;
+    coeffs[B1] = coeffs[B1] / scalingB;
+    coeffs[B2] = coeffs[B2] / scalingB;
+}
+
+void AudioDriver_CalcLowpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS)
+{
+    float32_t w0 = 2 * PI * f0 / FS;
+    float32_t alpha = sinf(w0) / (2 * Q);
+    float32_t cosw0 = cosf(w0);
+
+    coeffs[B0] = (1 - cosw0) / 2;
+    coeffs[B1] = 1 - cosw0;
+    coeffs[B2] = (1 - cosw0) / 2;
+    float32_t scaling = 1 + alpha;
+    coeffs[A1] = 2 * cosw0; // already negated!
+    coeffs[A2] = alpha - 1; // already negated!
+
+    AudioDriver_ScaleBiquadCoeffs(coeffs,scaling, scaling);
+}
+
+void AudioDriver_CalcHighpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS)
+{
+    float32_t w0 = 2 * PI * f0 / FS;
+    float32_t alpha = sinf(w0) / (2 * Q);
+    float32_t cosw0 = cosf(w0);
+
+    coeffs[B0] = (1 + cosw0) / 2;
+    coeffs[B1] = -(1 + cosw0);
+    coeffs[B2] = (1 + cosw0) / 2;
+    float32_t scaling = 1 + alpha;
+    coeffs[A1] = 2 * cosw0; // already negated!
+    coeffs[A2] = alpha - 1; // already negated!
+
+    AudioDriver_ScaleBiquadCoeffs(coeffs,scaling, scaling);
+}
+
+void AudioDriver_CalcAllpass(float32_t coeffs[5], float32_t f0, float32_t Q, float32_t FS)
+{
+    float32_t w0 = 2 * PI * f0 / FS;
+    float32_t alpha = sinf(w0) / (2 * Q);
+    float32_t cosw0 = cosf(w0);
+
+    coeffs[B0] = 1 - alpha;
+    coeffs[B1] = -2 * cosw0;
+    coeffs[B2] = 1 + alpha;
+    float32_t scaling = 1 + alpha;
+    coeffs[A1] = 2 * cosw0; // already negated!
+    coeffs[A2] = alpha - 1; // already negated!
+
+    AudioDriver_ScaleBiquadCoeffs(coeffs,scaling, scaling);
+}
+
+#include "tx_mbc.c"
+
+#define TEST_BLOCK_SIZE         AUDIO_BLOCK_SIZE
+#define TEST_CEILING            30000.0 // ALC_KNEE
+#define TEST_SECONDS            10
+#define TEST_MAX_XOVER_DEV_DB   0.01
+#define TEST_SYLLABLE_LEN       (AUDIO_SAMPLE_RATE / 4)
+#define TEST_QUIET_SYLLABLE     1       // index of the -20dB syllable in Test_Voice
+#define TEST_MIN_TALK_STEP_DB   3.0     // level increase of quiet speech from preset to preset
+
+// power share of a tone in the middle of a band
+static const double test_min_band_share[TX_MBC_BANDS] = { 0.98, 0.9, 0.95 };
+
+// voice like multi tone signal: fundamental and formant like harmonics
+static const float test_voice_freq[] = { 180, 360, 540, 720, 1080, 1440, 1980, 2520, 2880 };
+static const float test_voice_amp[] = { 0.5, 1.0, 0.8, 0.6, 0.5, 0.35, 0.3, 0.2, 0.1 };
+
+static bool Test_Check(const char* name, bool ok)
+{
+    printf("  %-56s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/**
+ * @return voice like signal at sample idx: 4 syllables per second with a raised cosine envelope, the level of
+ * each syllable steps through -40..+12dB relative to the ceiling
+ */
+static float32_t Test_Voice(uint32_t idx)
+{
+    static const float32_t levels_db[] = { -40, -20, -10, -3, 0, 6, 12, -6, -30, 3 };
+    const uint32_t syllable = idx / TEST_SYLLABLE_LEN;
+    const float32_t pos = (float32_t)(idx % TEST_SYLLABLE_LEN) / TEST_SYLLABLE_LEN;
+    const float32_t level = TEST_CEILING * powf(10.0, levels_db[syllable % 10] / 20.0);
+    const float32_t env = 0.5 * (1 - cosf(2 * M_PI * pos));
+
+    float32_t v = 0;
+    for (uint32_t k = 0; k < sizeof(test_voice_freq) / sizeof(test_voice_freq[0]); k++)
+    {
+        v += test_voice_amp[k] * sinf(2 * M_PI * test_voice_freq[k] * idx / AUDIO_SAMPLE_RATE + k * k);
+    }
+    // the amplitudes add up to about 4.35, peaks of the sum are about 3
+    return level * env * v / 3.0;
+}
+
+/**
+ * Feeds a tone into the crossover
+ * @param power_p power of each band after the filters have settled
+ * @return power of the band sum relative to the input power
+ */
+static double Test_CrossoverTone(float32_t freq, double power_p[TX_MBC_BANDS])
+{
+    float32_t in[TEST_BLOCK_SIZE];
+    float32_t peak[TX_MBC_BANDS];
+    double power_in = 0;
+    double power_sum = 0;
+
+    TxMbc_Configure(TX_MBC_PRESET_MEDIUM, TEST_BLOCK_SIZE, TEST_CEILING);
+    TxMbc_Reset();
+    for (int b = 0; b < TX_MBC_BANDS; b++)
+    {
+        power_p[b] = 0;
+    }
+
+    for (uint32_t n = 0; n < AUDIO_SAMPLE_RATE; n += TEST_BLOCK_SIZE)
+    {
+        for (uint32_t i = 0; i < TEST_BLOCK_SIZE; i++)
+        {
+            in[i] = TEST_CEILING * sinf(2 * M_PI * freq * (n + i) / AUDIO_SAMPLE_RATE);
+        }
+        TxMbc_SplitBands(in, TEST_BLOCK_SIZE, peak);
+        // skip the settling of the filters, 1s is a whole number of periods of all test tones
+        if (n >= AUDIO_SAMPLE_RATE / 10)
+        {
+            for (uint32_t i = 0; i < TEST_BLOCK_SIZE; i++)
+            {
+                const double sum = tx_mbc.band_buf[0][i] + tx_mbc.band_buf[1][i] + tx_mbc.band_buf[2][i];
+                power_in += in[i] * in[i];
+                power_sum += sum * sum;
+                for (int b = 0; b < TX_MBC_BANDS; b++)
+                {
+                    power_p[b] += tx_mbc.band_buf[b][i] * tx_mbc.band_buf[b][i];
+                }
+            }
+        }
+    }
+    return power_sum / power_in;
+}
+
+static bool Test_Crossover()
+{
+    bool ok = true;
+    const float32_t flat_freq[] = { 100, 300, 600, 1000, 1800, 2500, 3500, 6000 };
+    // middle of each band on a logarithmic scale, the upper band ends with the 3kHz tx filter
+    const float32_t band_freq[TX_MBC_BANDS] = { 200, 1040, 3200 };
+    double power[TX_MBC_BANDS];
+
+    printf("\ncrossover %.0fHz / %.0fHz\n", TX_MBC_XOVER_LOW_FREQ, TX_MBC_XOVER_HIGH_FREQ);
+
+    double max_dev_db = 0;
+    for (uint32_t k = 0; k < sizeof(flat_freq) / sizeof(flat_freq[0]); k++)
+    {
+        max_dev_db = fmax(max_dev_db, fabs(10 * log10(Test_CrossoverTone(flat_freq[k], power))));
+    }
+    printf("  band sum: largest deviation from a flat response %.3fdB\n", max_dev_db);
+
+    for (int b = 0; b < TX_MBC_BANDS; b++)
+    {
+        Test_CrossoverTone(band_freq[b], power);
+        const double share = power[b] / (power[0] + power[1] + power[2]);
+        char name[64];
+        snprintf(name, sizeof(name), "%.0fHz: at least %.0f%% of the power in band %d", band_freq[b], test_min_band_share[b] * 100, b);
+        ok &= Test_Check(name, share > test_min_band_share[b]);
+    }
+
+    ok &= Test_Check("band sum has a flat magnitude response", max_dev_db < TEST_MAX_XOVER_DEV_DB);
+    return ok;
+}
+
+/**
+ * Runs a preset over the voice signal
+ * @param quiet_db_p output power of the syllables 20dB below the ceiling, relative to the ceiling
+ */
+static bool Test_Limiter(uint8_t preset, float32_t gain_scaling, float32_t* quiet_db_p)
+{
+    bool ok = true;
+    float32_t buf[TEST_BLOCK_SIZE];
+    const float32_t limit = TEST_CEILING * gain_scaling * (1 + 1e-5);
+
+    TxMbc_Reset();
+
+    float32_t out_peak = 0;
+    float32_t prev = 0;
+    double power = 0;
+    uint32_t count = 0;
+    float32_t gain_reduction_min = 1;
+    bool gain_reduction_valid = true;
+
+    for (uint32_t n = 0; n < TEST_SECONDS * AUDIO_SAMPLE_RATE; n += TEST_BLOCK_SIZE)
+    {
+        for (uint32_t i = 0; i < TEST_BLOCK_SIZE; i++)
+        {
+            buf[i] = Test_Voice(n + i);
+        }
+        TxMbc_Process(buf, TEST_BLOCK_SIZE, preset, TEST_CEILING, gain_scaling);
+
+        const float32_t gr = TxMbc_GetGainReduction();
+        gain_reduction_valid &= gr > 0 && gr <= 1;
+        gain_reduction_min = fminf(gain_reduction_min, gr);
+
+        for (uint32_t i = 0; i < TEST_BLOCK_SIZE; i++)
+        {
+            // the linear midpoint is a lower bound of the true peak between the samples
+            out_peak = fmaxf(out_peak, fmaxf(fabsf(buf[i]), fabsf(0.5f * (buf[i] + prev))));
+            prev = buf[i];
+            if ((n + i) / TEST_SYLLABLE_LEN % 10 == TEST_QUIET_SYLLABLE)
+            {
+                power += buf[i] * buf[i];
+                count++;
+            }
+        }
+    }
+    *quiet_db_p = 10 * log10(power / count / (TEST_CEILING * gain_scaling * TEST_CEILING * gain_scaling));
+
+    printf("\npreset %s, gain scaling %.2f: output peak %.1f%% of the ceiling, -20dB syllables at %.1fdB, max. gain reduction %.1fdB\n",
+            TxMbc_GetPresetName(preset), gain_scaling, out_peak * 100 / (TEST_CEILING * gain_scaling),
+            *quiet_db_p, 20 * log10(gain_reduction_min));
+
+    ok &= Test_Check("output never exceeds the ceiling", out_peak <= limit);
+    ok &= Test_Check("limiter reached the ceiling", out_peak > 0.9 * TEST_CEILING * gain_scaling);
+    ok &= Test_Check("reported gain reduction within 0..1", gain_reduction_valid && gain_reduction_min < 1);
+    return ok;
+}
+
+/**
+ * A tone burst 12dB above the ceiling starts abruptly in the middle of a block after silence. The limiter has
+ * to catch its very first samples and the burst has to leave the processor exactly one block later.
+ */
+static bool Test_Onset(uint8_t preset)
+{
+    bool ok = true;
+    float32_t buf[TEST_BLOCK_SIZE];
+    const uint32_t onset = AUDIO_SAMPLE_RATE / 2 + TEST_BLOCK_SIZE / 2 + 3;
+    const float32_t amp = TEST_CEILING * 4;
+
+    TxMbc_Reset();
+
+    uint32_t first_out = 0;
+    float32_t out_peak = 0;
+    for (uint32_t n = 0; n < AUDIO_SAMPLE_RATE; n += TEST_BLOCK_SIZE)
+    {
+        for (uint32_t i = 0; i < TEST_BLOCK_SIZE; i++)
+        {
+            buf[i] = n + i >= onset ? amp * cosf(2 * M_PI * 1050 * (n + i - onset) / AUDIO_SAMPLE_RATE) : 0;
+        }
+        TxMbc_Process(buf, TEST_BLOCK_SIZE, preset, TEST_CEILING, 1.0);
+        for (uint32_t i = 0; i < TEST_BLOCK_SIZE; i++)
+        {
+            if (first_out == 0 && buf[i] != 0)
+            {
+                first_out = n + i;
+            }
+            out_peak = fmaxf(out_peak, fabsf(buf[i]));
+        }
+    }
+
+    printf("\npreset %s, burst at +12dB after silence: output starts %d samples after the input, peak %.1f%% of the ceiling\n",
+            TxMbc_GetPresetName(preset), (int)(first_out - onset), out_peak * 100 / TEST_CEILING);
+    ok &= Test_Check("output delayed by exactly one block", first_out == onset + TEST_BLOCK_SIZE);
+    ok &= Test_Check("first samples of the burst limited", out_peak <= TEST_CEILING * (1 + 1e-5));
+    return ok;
+}
+
+static void Test_Usage(const char* prog)
+{
+    printf("usage: %s\n", prog);
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "h")) != -1)
+    {
+        switch (opt)
+        {
+        default:
+            Test_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    bool ok = true;
+    float32_t quiet_db[TX_MBC_PRESET_NUM];
+    float32_t quiet_scaled_db;
+
+    ok &= Test_Crossover();
+    for (uint8_t preset = TX_MBC_PRESET_LIGHT; preset < TX_MBC_PRESET_NUM; preset++)
+    {
+        ok &= Test_Limiter(preset, 1.0, &quiet_db[preset]);
+    }
+    ok &= Test_Limiter(TX_MBC_PRESET_DX, 0.5, &quiet_scaled_db);
+    for (uint8_t preset = TX_MBC_PRESET_LIGHT; preset < TX_MBC_PRESET_NUM; preset++)
+    {
+        ok &= Test_Onset(preset);
+    }
+
+    printf("\ntalk power\n");
+    char name[64];
+    snprintf(name, sizeof(name), "quiet speech with MEDIUM at least %.0fdB above LIGHT", TEST_MIN_TALK_STEP_DB);
+    ok &= Test_Check(name, quiet_db[TX_MBC_PRESET_MEDIUM] - quiet_db[TX_MBC_PRESET_LIGHT] > TEST_MIN_TALK_STEP_DB);
+    snprintf(name, sizeof(name), "quiet speech with DX at least %.0fdB above MEDIUM", TEST_MIN_TALK_STEP_DB);
+    ok &= Test_Check(name, quiet_db[TX_MBC_PRESET_DX] - quiet_db[TX_MBC_PRESET_MEDIUM] > TEST_MIN_TALK_STEP_DB);
+    ok &= Test_Check("gain scaling does not change the compression", fabsf(quiet_scaled_db - quiet_db[TX_MBC_PRESET_DX]) < 0.01);
+
+    printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+    return ok ? 0 : 1;
+}
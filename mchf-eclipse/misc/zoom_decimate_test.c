@@ -0,0 +1,236 @@
+/*  -*-  mode: c; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4; coding: utf-8  -*-  */
+/************************************************************************************
+ **                                                                                 **
+ **                                        UHSDR                                    **
+ **               a powerful firmware for STM32 based SDR transceivers              **
+ **                                                                                 **
+ **---------------------------------------------------------------------------------**
+ **                                                                                 **
+ **  File name:     zoom_decimate_test.c                                            **
+ **  Description:   host test of the CIC + FIR zoom fft decimator                   **
+ **  Licence:       GNU GPLv3                                                       **
+ ************************************************************************************/
+
+/*
+ * This is NOT part of the firmware. It builds zoom_decimate.c and the filter table
+ * fir_zoom_fft_decimate.c for the build host and checks for each magnify level 1 ... 7:
+ *
+ * - passband: complex tones up to +-40% of the output sample rate, i.e. the inner 80% of the
+ *   displayed spectrum, pass with a gain within +-TEST_MAX_RIPPLE_DB
+ * - alias rejection: complex tones which alias into the inner 80% of the displayed spectrum
+ *   are attenuated by at least TEST_MIN_ALIAS_REJECTION_DB, all of them up to the input Nyquist frequency
+ * - carry over: with 32 samples per call (one audio interrupt block) and 128x, most calls return
+ *   no sample at all, the phases kept across the calls have to give exactly the output of a
+ *   single call for the whole signal
+ *
+ * The tones are fed in blocks of IQ_BLOCK_SIZE samples as in the audio interrupt.
+ *
+ * zoom_decimate.c and fir_zoom_fft_decimate.c are included below, the board header is kept out.
+ * Build and run with "make zoom-decimate-test", see Makefile.
+ * The exit code is not 0 if a check fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+
+// keep the firmware headers out, the decimator needs nothing from them
+#define __MCHF_BOARD_H
+
+// as in uhsdr_board_config.h
+#define IQ_SAMPLE_RATE (48000)
+#define IQ_INTERRUPT_FREQ (1500)
+#define IQ_BLOCK_SIZE (IQ_SAMPLE_RATE/IQ_INTERRUPT_FREQ)
+
+#include "fir_zoom_fft_decimate.c"
+#include "zoom_decimate.c"
+
+#define TEST_AMPLITUDE                  16000.0 // about half the codec range
+#define TEST_MEASURE_LEN                64      // output samples per measurement
+#define TEST_MAX_RIPPLE_DB              0.25
+#define TEST_MIN_ALIAS_REJECTION_DB     60.0
+#define TEST_PASSBAND                   0.4     // edge of the inner 80% of the output bandwidth, relative to the output rate
+#define TEST_STEPS                      8       // frequencies per passband half
+#define TEST_CARRY_MAGNIFY              7
+#define TEST_CARRY_BLOCKS               256
+
+static bool Test_Check(const char* name, bool ok)
+{
+    printf("  %-56s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+/**
+ * Decimates a complex tone and measures the output power after the filters have settled
+ * @param freq tone frequency in Hz, negative frequencies are below the rx frequency
+ * @return power gain in dB
+ */
+static double Test_Gain(const uint8_t magnify, const double freq)
+{
+    static ZoomDecimate_t zd;
+    float32_t i_buf[IQ_BLOCK_SIZE], q_buf[IQ_BLOCK_SIZE];
+
+    ZoomDecimate_Init(&zd, magnify);
+
+    // the FIR history has to be filled with valid samples, the CIC needs its 4 stages on top
+    const uint32_t settle = zd.num_taps / zd.fir_rate + ZOOM_DECIMATE_CIC_STAGES + 1;
+    const double phase_step = 2 * M_PI * freq / IQ_SAMPLE_RATE;
+    // twice the input we need, in case the decimator does not deliver
+    const uint32_t len_max = 2 * (settle + TEST_MEASURE_LEN) * (1 << magnify);
+
+    uint32_t out_count = 0;
+    double sum = 0;
+    for (uint32_t n = 0; out_count < settle + TEST_MEASURE_LEN && n < len_max; n += IQ_BLOCK_SIZE)
+    {
+        for (uint32_t idx = 0; idx < IQ_BLOCK_SIZE; idx++)
+        {
+            const double phase = fmod(phase_step * (n + idx), 2 * M_PI);
+            i_buf[idx] = TEST_AMPLITUDE * cos(phase);
+            q_buf[idx] = TEST_AMPLITUDE * sin(phase);
+        }
+
+        const uint16_t count = ZoomDecimate_Process(&zd, i_buf, q_buf, i_buf, q_buf, IQ_BLOCK_SIZE);
+        for (uint16_t idx = 0; idx < count; idx++, out_count++)
+        {
+            if (out_count >= settle && out_count < settle + TEST_MEASURE_LEN)
+            {
+                sum += (double)i_buf[idx] * i_buf[idx] + (double)q_buf[idx] * q_buf[idx];
+            }
+        }
+    }
+
+    const double power = out_count >= settle + TEST_MEASURE_LEN ? sum / TEST_MEASURE_LEN : 0;
+    return power > 0 ? 10 * log10(power / (TEST_AMPLITUDE * TEST_AMPLITUDE)) : -300.0;
+}
+
+static bool Test_Magnify(const uint8_t magnify)
+{
+    const double out_rate = (double)IQ_SAMPLE_RATE / (1 << magnify);
+    bool ok = true;
+
+    printf("\n%3ux: %6.0fsps out, CIC %2u, FIR %u with %u taps\n", 1 << magnify, out_rate,
+            ZoomFFTDecimate[magnify].cic_rate, ZoomFFTDecimate[magnify].fir_rate, ZoomFFTDecimate[magnify].num_taps);
+
+    double gain_min = 1000, gain_max = -1000;
+    for (int step = -TEST_STEPS; step <= TEST_STEPS; step++)
+    {
+        const double gain = Test_Gain(magnify, out_rate * TEST_PASSBAND * step / TEST_STEPS);
+        gain_min = fmin(gain_min, gain);
+        gain_max = fmax(gain_max, gain);
+    }
+
+    // everything which ends up within +-TEST_PASSBAND of the output rate after the decimation
+    double alias_max = -1000, alias_freq = 0;
+    const int k_max = (int)ceil(IQ_SAMPLE_RATE / 2 / out_rate);
+    for (int k = -k_max; k <= k_max; k++)
+    {
+        for (int step = -TEST_STEPS; step <= TEST_STEPS && k != 0; step++)
+        {
+            const double freq = out_rate * (k + TEST_PASSBAND * step / TEST_STEPS);
+            if (fabs(freq) <= IQ_SAMPLE_RATE / 2)
+            {
+                const double gain = Test_Gain(magnify, freq);
+                if (gain > alias_max)
+                {
+                    alias_max = gain;
+                    alias_freq = freq;
+                }
+            }
+        }
+    }
+
+    printf("  passband gain %+.3f ... %+.3fdB, worst alias %.1fdB at %+.0fHz\n", gain_min, gain_max, alias_max, alias_freq);
+
+    char name[64];
+    snprintf(name, sizeof(name), "passband flat within +-%.2fdB", TEST_MAX_RIPPLE_DB);
+    ok &= Test_Check(name, gain_min > -TEST_MAX_RIPPLE_DB && gain_max < TEST_MAX_RIPPLE_DB);
+    snprintf(name, sizeof(name), "aliases rejected by at least %.0fdB", TEST_MIN_ALIAS_REJECTION_DB);
+    ok &= Test_Check(name, alias_max < -TEST_MIN_ALIAS_REJECTION_DB);
+
+    return ok;
+}
+
+/**
+ * Compares the block wise decimation of a noise signal with a single call for the whole signal
+ */
+static bool Test_CarryOver(void)
+{
+    static float32_t i_in[TEST_CARRY_BLOCKS * IQ_BLOCK_SIZE], q_in[TEST_CARRY_BLOCKS * IQ_BLOCK_SIZE];
+    static float32_t i_ref[TEST_CARRY_BLOCKS * IQ_BLOCK_SIZE], q_ref[TEST_CARRY_BLOCKS * IQ_BLOCK_SIZE];
+    static float32_t i_out[TEST_CARRY_BLOCKS * IQ_BLOCK_SIZE], q_out[TEST_CARRY_BLOCKS * IQ_BLOCK_SIZE];
+    static ZoomDecimate_t zd;
+    const uint32_t len = TEST_CARRY_BLOCKS * IQ_BLOCK_SIZE;
+    const uint16_t decimation = 1 << TEST_CARRY_MAGNIFY;
+
+    printf("\ncarry over: %u samples per call, %ux\n", IQ_BLOCK_SIZE, decimation);
+
+    uint32_t seed = 1;
+    for (uint32_t idx = 0; idx < len; idx++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        i_in[idx] = TEST_AMPLITUDE * ((int32_t)seed / 2147483648.0);
+        seed = seed * 1664525 + 1013904223;
+        q_in[idx] = TEST_AMPLITUDE * ((int32_t)seed / 2147483648.0);
+    }
+
+    ZoomDecimate_Init(&zd, TEST_CARRY_MAGNIFY);
+    const uint16_t ref_count = ZoomDecimate_Process(&zd, i_in, q_in, i_ref, q_ref, len);
+
+    ZoomDecimate_Init(&zd, TEST_CARRY_MAGNIFY);
+    uint32_t out_count = 0;
+    bool per_call_ok = true;
+    for (uint32_t block = 0; block < TEST_CARRY_BLOCKS; block++)
+    {
+        const uint16_t count = ZoomDecimate_Process(&zd, &i_in[block * IQ_BLOCK_SIZE], &q_in[block * IQ_BLOCK_SIZE],
+                &i_out[out_count], &q_out[out_count], IQ_BLOCK_SIZE);
+        // one output every decimation / IQ_BLOCK_SIZE calls
+        per_call_ok &= count == ((block + 1) % (decimation / IQ_BLOCK_SIZE) == 0 ? 1 : 0);
+        out_count += count;
+    }
+
+    bool same = out_count == ref_count;
+    for (uint32_t idx = 0; idx < out_count && same; idx++)
+    {
+        same = i_out[idx] == i_ref[idx] && q_out[idx] == q_ref[idx];
+    }
+
+    bool ok = true;
+    ok &= Test_Check("one output sample every 4th call", per_call_ok);
+    ok &= Test_Check("number of output samples is input / decimation", out_count == len / decimation && ref_count == len / decimation);
+    ok &= Test_Check("block wise output identical to a single call", same);
+
+    return ok;
+}
+
+static void Test_Usage(const char* prog)
+{
+    printf("usage: %s\n", prog);
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "h")) != -1)
+    {
+        switch (opt)
+        {
+        default:
+            Test_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    bool ok = true;
+    for (uint8_t magnify = 1; magnify < ZOOM_FFT_DECIMATE_NUM; magnify++)
+    {
+        ok &= Test_Magnify(magnify);
+    }
+    ok &= Test_CarryOver();
+
+    printf("\n%s\n", ok ? "all checks passed" : "some checks FAILED");
+    return ok ? 0 : 1;
+}
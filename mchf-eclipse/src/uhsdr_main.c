@@ -331,7 +331,7 @@ void TransceiverStateInit(void)
 
 
     ts.s_meter = 1;                         // S-Meter configuration, 0 = old school, 1 = dBm-based, 2=dBm/Hz-based
-    //CONFIG LOADED:ts.display_dbm = 0;                     // style of dBm display, 0=OFF, 1= dbm, 2= dbm/Hz
+    //CONFIG LOADED:ts.display_dbm = 0;                     // style of dBm display, 0=OFF, 1= dbm, 2= dbm/Hz, 3= dbm peak
     //    ts.dBm_count = 0;                     // timer start
     //CONFIG LOADED:ts.tx_filter = 0;                       // which TX filter has been chosen by the user
     //CONFIG LOADED: ts.iq_auto_correction = 1;              // disable/enable automatic IQ correction
@@ -487,6 +487,7 @@ int mchfMain(void)
     // Transceiver main loop
     for(;;)
     {
+        profileMainLoop();
         // UI events processing
         UiDriver_TaskHandler_MainTasks();
     }
@@ -23,6 +23,7 @@ __status__ = "Prototype"
 
 import sys
 import os
+import struct
 
 class CatCmdFt817:
     """
@@ -42,6 +43,17 @@ class CatCmd(CatCmdFt817):
     """
     this will return the bytes ['U', 'H' , 'S', 'D', 'R' ] and is used to identify an UHSDR with high enough firmware level
     """
+
+    UHSDR_SPECTRUM_STREAM = 0x43
+    """
+    P1 is the number of spectrum frames per second, 0 switches the stream off. Returns the accepted rate as one byte.
+    The frames are sent in between the CAT responses, use SpectrumStreamDecoder to extract them
+    """
+
+    UHSDR_UI_PROFILE = 0x44
+    """
+    returns the 32 byte UI statistics of the last interval (ProfileUiStats_t in misc/profiling.h), use readUiProfile
+    """
     
 class UhsdrConfigIndex:
     """
@@ -107,6 +119,30 @@ class catCommands:
         return res == bytearray("UHSDR", 'utf-8')
    
 
+    def setSpectrumStream(self, rate):
+        cmd = bytearray([ rate & 0xff, 0x00, 0x00, 0x00, CatCmd.UHSDR_SPECTRUM_STREAM])
+        ok,res = self.execute(cmd,1)
+        if ok:
+            return res[0]
+        else:
+            return ok
+
+    def readUiProfile(self):
+        """
+        returns the UI statistics of the last interval as dictionary or False
+        """
+        cmd = bytearray([ 0x00, 0x00, 0x00, 0x00, CatCmd.UHSDR_UI_PROFILE])
+        ok,res = self.execute(cmd,32)
+        if ok:
+            values = struct.unpack("<6HI8H", bytes(res))
+            return { "interval_ms": values[0], "spectrum_us": values[1], "spectrum_per_s": values[2],
+                     "meters_us": values[3], "lcd_write_us": values[4], "lcd_dma_wait_permille": values[5],
+                     "lcd_bytes_per_s": values[6],
+                     # main loop passes with periods <100us, <250us, <500us, <1ms, <2.5ms, <5ms, <10ms, >=10ms
+                     "loop_histogram": list(values[7:]) }
+        else:
+            return ok
+
     def writeEEPROM(self, addr, value16bit):
         cmd = bytearray([ (addr & 0xff00)>>8,addr & 0xff, (value16bit & 0xff) >> 0, (value16bit & 0xff00) >> 8, CatCmd.WRITE_EEPROM])
         ok,res = self.execute(cmd,1)
@@ -119,6 +155,115 @@ class catCommands:
         return self.writeEEPROM(index + 0x8000, value);
 
 
+class SpectrumFrame:
+    """
+    One decoded spectrum frame, levels are in dB in ascending frequency order
+    """
+    def __init__(self, seq, centerBin, centerFreq, binWidth, magnify, levels):
+        self.seq = seq
+        self.centerBin = centerBin
+        self.centerFreq = centerFreq
+        self.binWidth = binWidth
+        self.magnify = magnify
+        self.levels = levels
+
+    def frequency(self, binIdx):
+        """
+        returns the frequency of bin binIdx in Hz
+        """
+        return self.centerFreq + (binIdx - self.centerBin) * self.binWidth
+
+
+class SpectrumStreamDecoder:
+    """
+    Extracts the binary spectrum frames from the data read from the CAT port,
+    see drivers/cat/cat_spectrum.c for the frame format.
+    Any other data (CAT responses, incomplete or damaged frames) is skipped
+    """
+    SYNC = bytearray([0xA5, ord('S'), ord('P')])
+    VERSION = 1
+    HEADER_LEN = 24
+
+    def __init__(self):
+        self.buf = bytearray()
+
+    @staticmethod
+    def fletcher16(data):
+        sum1 = 0
+        sum2 = 0
+        for byte in data:
+            sum1 = (sum1 + byte) % 255
+            sum2 = (sum2 + sum1) % 255
+        return (sum2 << 8) | sum1
+
+    @staticmethod
+    def decodeLevels(payload, numBins):
+        """
+        returns the list of quantized levels or None if the payload is invalid
+        """
+        levels = []
+        prev = 0
+        idx = 0
+        while idx < len(payload) and len(levels) < numBins:
+            code = payload[idx]
+            idx += 1
+            if code < 0x40:
+                for diff in ((code >> 3) & 0x07, code & 0x07):
+                    prev += diff - 8 if diff > 3 else diff
+                    levels.append(prev)
+            elif code < 0x80:
+                diff = code & 0x3f
+                prev += diff - 64 if diff > 31 else diff
+                levels.append(prev)
+            elif code < 0xc0:
+                levels.extend([prev] * ((code & 0x3f) + 1))
+            elif code == 0xc0 and idx < len(payload):
+                prev = payload[idx]
+                idx += 1
+                levels.append(prev)
+            else:
+                return None
+        if idx != len(payload) or len(levels) != numBins:
+            return None
+        return levels
+
+    def feed(self, data):
+        """
+        adds received data and returns the list of frames completed by it
+        """
+        import struct
+
+        self.buf.extend(data)
+        frames = []
+        while True:
+            start = self.buf.find(self.SYNC)
+            if start < 0:
+                # keep a possible partial sync at the end
+                del self.buf[:max(0, len(self.buf) - len(self.SYNC) + 1)]
+                break
+            del self.buf[:start]
+            if len(self.buf) < self.HEADER_LEN:
+                break
+            version, seq, numBins, centerBin, centerFreq, binWidth, levelRef, levelStep, magnify, payloadLen = \
+                struct.unpack_from("<BHHHIIhBBH", self.buf, 3)
+            frameLen = self.HEADER_LEN + payloadLen + 2
+            if len(self.buf) < frameLen:
+                break
+            checksum = struct.unpack_from("<H", self.buf, frameLen - 2)[0]
+            levels = None
+            if version == self.VERSION and checksum == self.fletcher16(self.buf[:frameLen - 2]):
+                levels = self.decodeLevels(self.buf[self.HEADER_LEN:frameLen - 2], numBins)
+            if levels is None:
+                # not a frame, continue searching after this sync
+                del self.buf[:1]
+                continue
+            step = levelStep * 0.1
+            frames.append(SpectrumFrame(seq, centerBin, centerFreq, binWidth / 1000.0, magnify,
+                                        [ (levelRef * 0.5) + level * step for level in levels ]))
+            del self.buf[:frameLen]
+        return frames
+
+
 class UhsdrConfig():
     """
     CONFIG MANAGEMENT: Handling of reading / writing TRX configurations, detection of TRX presence etc.
@@ -0,0 +1,84 @@
+"""
+Tests for the spectrum stream decoder in uhsdr.py
+
+The reference frame has been generated by the firmware encoder (drivers/cat/cat_spectrum.c)
+compiled for the host, from a 256 bin spectrum with a noise floor between 40 and 41.1 dB,
+bins 0 ... 27 at exactly 40 dB and three carriers.
+
+Run with: python -m unittest uhsdr_spectrum_test
+
+This program is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with
+this program. If not, see <http://www.gnu.org/licenses/>.
+"""
+
+from __future__ import print_function
+
+__license__ = "GPLv3"
+
+import unittest
+import binascii
+import uhsdr
+
+REFERENCE_FRAME = bytearray(binascii.unhexlify(
+    "a5535001000000017f0090c0d6008d5b00005000050380009b108039398039803938083f170839813f0939388008803f0f80"
+    "098030093280380f0f0f0f800f800f800e800f160f0f108138c05a4ac001800f80088039383908803f0f17810f0fc036c000"
+    "09380f803a380f0f0e08800f0f0e10310887328139393f1782083f8009301616170e80170f80380f8010833f0f16161616"
+    "088138b7e9"))
+
+
+class SpectrumStreamTest(unittest.TestCase):
+
+    def checkReferenceFrame(self, frame):
+        self.assertEqual(frame.seq, 0)
+        self.assertEqual(len(frame.levels), 256)
+        self.assertEqual(frame.centerBin, 127)
+        self.assertEqual(frame.centerFreq, 14074000)
+        self.assertEqual(frame.magnify, 3)
+        self.assertAlmostEqual(frame.binWidth, 48000.0 / 8 / 256, places=2)
+        self.assertEqual(frame.levels[:28], [40.0] * 28)
+        carriers = dict((idx, level) for idx, level in enumerate(frame.levels) if level > 42)
+        self.assertEqual(carriers, { 116: 85.0, 117: 90.0, 147: 67.0 })
+        self.assertTrue(all(40.0 <= level <= 41.5 for idx, level in enumerate(frame.levels) if idx not in carriers))
+
+    def testReferenceFrame(self):
+        frames = uhsdr.SpectrumStreamDecoder().feed(REFERENCE_FRAME)
+        self.assertEqual(len(frames), 1)
+        self.checkReferenceFrame(frames[0])
+
+    def testMixedWithCatResponses(self):
+        # UHSDR_ID response, a stray partial sync, the frame in small pieces, a frequency response
+        data = bytearray(b"UHSDR") + bytearray([0xA5, ord('S')]) + REFERENCE_FRAME + bytearray([0x14, 0x07, 0x40, 0x00, 0x01])
+        decoder = uhsdr.SpectrumStreamDecoder()
+        frames = []
+        for pos in range(0, len(data), 7):
+            frames.extend(decoder.feed(data[pos:pos + 7]))
+        self.assertEqual(len(frames), 1)
+        self.checkReferenceFrame(frames[0])
+
+    def testDamagedFrameIsSkipped(self):
+        damaged = bytearray(REFERENCE_FRAME)
+        damaged[60] ^= 0x01
+        frames = uhsdr.SpectrumStreamDecoder().feed(damaged + REFERENCE_FRAME)
+        self.assertEqual(len(frames), 1)
+        self.checkReferenceFrame(frames[0])
+
+    def testAllCodes(self):
+        # pair (+3,-4), single -32, run of 3, literal 200, single +31
+        payload = bytearray([0x1c, 0x60, 0x82, 0xc0, 200, 0x5f])
+        self.assertEqual(uhsdr.SpectrumStreamDecoder.decodeLevels(payload, 8), [3, -1, -33, -33, -33, -33, 200, 231])
+        # payload and number of bins do not match
+        self.assertIsNone(uhsdr.SpectrumStreamDecoder.decodeLevels(payload, 7))
+        # reserved code
+        self.assertIsNone(uhsdr.SpectrumStreamDecoder.decodeLevels(bytearray([0xc1]), 1))
+
+
+if __name__ == '__main__':
+    unittest.main()
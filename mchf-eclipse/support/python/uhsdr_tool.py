@@ -1,7 +1,7 @@
 """
 This module contains experimental code for using the (extend) UHSDR API
 and contains a small commandline client for backup and restore of
-the UHSDR configuration data from/to a TRX
+the UHSDR configuration data from/to a TRX and for reading the spectrum stream
 
 This program is free software: you can redistribute it and/or modify it under
 the terms of the GNU General Public License as published by the Free Software
@@ -47,6 +47,24 @@ def listUHSDRSerial():
         retval = False,[ vars(comport)  for comport in serial.tools.list_ports.comports()]
     return retval
 
+def printSpectrumFrames(myCAT, mySer, count):
+    """
+    enables the spectrum stream, prints count frames as one line of "frequency level" pairs each and disables the stream again
+    """
+    rate = myCAT.setSpectrumStream(10)
+    if rate is False:
+        uhsdr.eprint("... enabling the spectrum stream failed")
+        return
+    uhsdr.eprint("Receiving spectrum frames at up to", rate, "frames per second:")
+    decoder = uhsdr.SpectrumStreamDecoder()
+    received = 0
+    while received < count:
+        for frame in decoder.feed(bytearray(mySer.read(256))):
+            if received < count:
+                print(" ".join("{:.0f} {:.1f}".format(frame.frequency(idx), level) for idx, level in enumerate(frame.levels)))
+                received += 1
+    myCAT.setSpectrumStream(0)
+
 def backupRestoreApp():
     import serial
     """
@@ -64,6 +82,7 @@ def backupRestoreApp():
     parser.add_argument("-b","--backup", help="backup the UHSDR TRX configuration to file", action="store_true")
     parser.add_argument("-r","--restore", help="restore the UHSDR TRX configuration from file", action="store_true")
     parser.add_argument("-p","--port", help="UHSDR serial port either by number (COM<num> in Windows, Linux /dev/ttyACM<num>) or full device name ( e.g. '/dev/cu.modemABCD', all operating systems )", type=str, default="undefined serial port name")
+    parser.add_argument("-s","--spectrum", help="receive the given number of spectrum frames from the TRX and print them", type=int, default=0)
     parser.add_argument("-f","--file", help="filename to backup to/restore from, if not defined 'uhsdr_config.json' is used", type=str, default="uhsdr_config.json")
 
     args = parser.parse_args()
@@ -122,6 +141,8 @@ def backupRestoreApp():
                         outfile.close()
                 else:
                     uhsdr.eprint("... could not read data sucessfully")
+            elif args.spectrum > 0:
+                printSpectrumFrames(myCAT, mySer, args.spectrum)
             elif args.restore:
                 with open(args.file, 'r') as infile:
                     data = json.load(infile)